@@ -5,6 +5,18 @@
 #include "model.hpp"
 
 #include "structs.hpp"
+#include "frustum_culling.hpp"
+#include "aabb_tree.hpp"
+#include "mesh_bvh.hpp"
+#include "star_field.hpp"
+#include "orbit_geometry.hpp"
+#include "simulation.hpp"
+#include "scene_graph.hpp"
+#include "post_processing.hpp"
+#include "software_rasterizer.hpp"
+#include "asset_manager.hpp"
+#include "clustered_lighting.hpp"
+#include "gbuffer.hpp"
 
 using namespace gl;
 
@@ -23,6 +35,7 @@ class ApplicationSolar : public Application {
 
   // update uniform locations and values
   void uploadUniforms();
+  void uploadProgramUniforms(std::string const& name);
   // update projection matrix
   void updateProjection();
   // react to key input
@@ -32,6 +45,10 @@ class ApplicationSolar : public Application {
 
   // draw all objects
   void render() const;
+  // draw the last frame with the software rasterizer
+  void renderSoftware(SoftwareRasterizer& target) const;
+  // load everything the last frame requested
+  void finishLoading();
 
     
 
@@ -39,50 +56,98 @@ class ApplicationSolar : public Application {
     void initializeShaderPrograms();
     void initializeGeometry();
     void updateView();
-    void upload_planet_transforms(int planetIndex) const;
+    void buildScene();
+    void simulateBodies(double sim_time, std::vector<glm::fmat4>& transforms);
+    void updateBodyTransforms() const;
+    void cullScene() const;
+    void pickBody() const;
+    void requestAssets() const;
+    void upload_planet_transforms(int planetIndex, shader_program const& program) const;
     void upload_stars() const;
     void upload_Orbits() const;
     void upload_skybox() const;
-    void upload_quad() const;
+    void upload_planets(bool deferred) const;
+    void upload_deferred_lighting() const;
+    void upload_lights(shader_program const& program) const;
     
 private:
     void fillOrbits();
-    void fillStars();
-//    void fillLights();
+    model fillStars();
+    void fillLights();
     //void buildSkybox();
-    float randPos();
-    float randCol();
-    void loadAllTextures();
-    void loadTexture(std::string name, GLuint texId);
-    void loadNormalMap(GLenum targetTextureUnit);
-    void setupOffscreenRendering();
+    void registerAssets();
+    std::vector<std::string> textureNames() const;
+    std::vector<pixel_data> decodeTextures() const;
+    void setupPostProcessing();
+    void updatePostProcessing();
     void createCameraBuffer();
     
     
     
-    std::vector< float > starBuffer;
-    std::vector< float > orbitBuffer;
+    star_field starField;
+    circle_lods orbitCircles;
     std::vector< float > skyBoxBuffer;
-    //ass 6 bonus
-//    std::vector<light> lights;
+    //ass 6 bonus - point lights scattered around the orbits, shaded per cluster
+    std::vector<point_light> lights;
     
     
     
-    // cpu representation of models
-    model_object planet_object;
-    model_object star_object;
+    // gpu representation of models
     model_object orbit_object;
     model_object skybox_object;
-    model_object screenquad_object;
     
-    GLuint texBufferIDs[NUM_SPHERES + 2];
-    GLuint rb_handle;
-    GLuint drawBufferTexture;
-    GLuint fbo_handle;
+    //textures and meshes streamed in as frames request them, with placeholders until then
+    mutable AssetManager assets;
+    AssetManager::handle planetTextures[NUM_SPHERES];
+    AssetManager::handle skyboxTexture;
+    AssetManager::handle normalMap;
+    AssetManager::handle planetMesh;
+    AssetManager::handle starMesh;
+    
+    //point lights binned into froxels each frame they are on
+    mutable ClusteredLighting pointLights;
+    
+    //transient offscreen attachments, handed out per frame
+    mutable RenderTargetPool renderTargets;
+    //offscreen targets and passes after the scene is drawn
+    mutable PostProcessing postProcessing;
+    std::size_t compositePass = 0;
+    //albedo and normals of the planets when they are shaded deferred
+    mutable GBuffer gBuffer;
+    
+    //decoded textures for software rendering, kept once it was used
+    mutable std::vector<pixel_data> softwareTextures;
+    
     GLuint ubo_handle;
+    GLuint orbitInstanceBuffer = 0;
+    GLuint orbitInstanceTexture = 0;
     
     int Post_Processing_Flag = 0;
     
+    //per frame body transforms, orbit frames and visibility
+    //recomputed inside render, so mutable
+    mutable std::vector<glm::fmat4> simulatedTransforms;
+    mutable glm::fmat4 bodyTransforms[NUM_SPHERES];
+    mutable glm::fmat4 bodyNormalMatrices[NUM_SPHERES];
+    mutable glm::fmat4 orbitFrames[NUM_SPHERES];
+    mutable glm::fmat4 orbitTransforms[NUM_SPHERES];
+    mutable sphere_set bodyBounds;
+    //boxes of bodies for picking, handles are body indices
+    mutable aabb_tree bodyTree;
+    //triangles of the planet sphere, rays are traced in body space
+    mesh_bvh planetSurface;
+    mutable sphere_set orbitBounds;
+    mutable std::vector<unsigned> visibleBodies;
+    mutable std::vector<unsigned> visibleOrbits;
+    mutable std::vector<unsigned> visibleChunks;
+    mutable std::vector<GLint> starFirsts;
+    mutable std::vector<GLsizei> starCounts;
+    mutable std::vector<unsigned> orbitLevels;
+    mutable std::vector<GLsizei> orbitLevelCounts;
+    mutable std::vector<glm::fmat4> orbitInstances;
+    float viewportHeight = 1.0f;
+    glm::uvec2 viewportSize{1, 1};
+    
     //ass 6
     camera_buffer CameraBuffer;
     
@@ -90,6 +155,10 @@ private:
     //bool motionOn;
     bool orbitsOn;
     bool starsOn;
+    bool lightsOn;
+    bool deferredOn;
+    //planet shading mode selected with keys 1 and 2, 2 uses the cel shaded variant
+    int shaderMode;
 
     //relative earth values
   float EARTH_SIZE = 0.45f;
@@ -110,11 +179,16 @@ private:
 					   {"uranus",  EARTH_SIZE * 3.01f,   EARTH_SPEED * 0.85f, EARTH_ORBIT * 5.2f,    -0.05f,  -1, false , {0.039, 0.596, 0.741}},//uranus
 					   {"neptune",  EARTH_SIZE * 2.88f,   EARTH_SPEED * 0.8f,   EARTH_ORBIT * 6.05f,   -0.02f,  -1, false , {0.247, 0.223, 0.952}} };//neptune
     
-    std::vector< float >  screenQuad = {-1.0, -1.0, 0.0,
-                            1.0, -1.0, 0.0,
-                            -1.0, 1.0, 0.0,
-                            1.0, 1.0, 0.0};
+    //body hierarchy, only touched by the simulation once it runs
+    scene_graph solarSystem;
+    scene_graph::node systemRoot;
+    //node moving each body along its orbit, the body itself and the frame its orbit is drawn in
+    scene_graph::node orbitNodes[NUM_SPHERES];
+    scene_graph::node bodyNodes[NUM_SPHERES];
+    scene_graph::node orbitFrameNodes[NUM_SPHERES];
     
+    //steps body animation on its own thread, declared last as it reads the planets and scene
+    mutable Simulation simulation;
     
         
  
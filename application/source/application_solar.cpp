@@ -3,8 +3,12 @@
 
 #include "utils.hpp"
 #include "shader_loader.hpp"
-#include "model_loader.hpp"
+#include "sphere_geometry.hpp"
 #include "texture_loader.hpp"
+#include "profiler.hpp"
+#include "jobs.hpp"
+#include "memory_accounting.hpp"
+#include "asset_manager.hpp"
 
 #include <glbinding/gl/gl.h>
 // use gl definitions from glbinding 
@@ -20,52 +24,90 @@ using namespace gl;
 #include <math.h>
 #include <iostream>
 
-#define NUM_STARS 1000
-#define NUM_POINTS_ON_ORBIT 100
-#define NUM_LIGHTS 7
-
-//model definitions
-model star_model{};
-model planet_model{};
-model orbit_model{};
-model screenquad_model{};
+//tessellation of the generated planet sphere, also used for the skybox
+#define PLANET_RINGS 32
+#define PLANET_SEGMENTS 64
+//coarse sphere drawn until the planet sphere is loaded
+#define PLACEHOLDER_RINGS 8
+#define PLACEHOLDER_SEGMENTS 16
+
+#define NUM_STARS 1000000
+#define STAR_SEED 119027
+#define STAR_CHUNKS_PER_AXIS 8
+//star density at full screen coverage, distant chunks draw a brightness sorted prefix
+#define STARS_PER_PIXEL 0.002f
+//orbit circle resolutions and target on screen segment length
+#define MIN_ORBIT_SEGMENTS 16
+#define MAX_ORBIT_SEGMENTS 512
+#define ORBIT_PIXELS_PER_SEGMENT 8.0f
+//texture unit of the orbit instance transforms
+#define ORBIT_INSTANCE_UNIT 14
+//point lights around the orbits, switched on with K
+#define NUM_LIGHTS 10000
+#define LIGHT_SEED 6
+//froxel grid the lights are binned into, depth range of the projection
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define CLUSTER_NEAR 0.1f
+#define CLUSTER_FAR 100.0f
+//seconds per simulation step, bodies are interpolated between steps when rendering
+#define SIMULATION_TIMESTEP (1.0 / 120.0)
+
+//bodies move this far before their picking boxes are updated
+#define BODY_TREE_MARGIN 0.5f
+#define PICK_DISTANCE 1000.0f
+//planet shader permutation flags
+#define PLANET_BUMP_MAP 1u
+#define PLANET_CEL_SHADING 2u
+#define PLANET_POINT_LIGHTS 4u
+//deferred lighting shader permutation flags
+#define DEFERRED_CEL_SHADING 1u
+#define DEFERRED_POINT_LIGHTS 2u
+//first texture unit of post processing inputs, below are planet, normal map and orbit textures
+#define POST_TEXTURE_UNIT 15
+//texture units of the skybox and the earth normal map, planets use the unit of their index
+#define SKYBOX_TEXTURE_UNIT 10
+#define NORMAL_MAP_UNIT 12
+//texture units of the point light data and the light lists of the clusters
+#define LIGHT_DATA_UNIT 11
+#define CLUSTER_LIGHTS_UNIT 13
+//first of the geometry buffer units, planet textures are bound again for every draw
+#define GBUFFER_UNIT 0
+//post processing flag bits beyond the composite shader features
+#define PP_BLUR (1u << 3)
+#define PP_BLOOM (1u << 4)
+//composite shader permutation flag adding the bloom texture
+#define COMPOSITE_BLOOM (1u << 3)
 
 ApplicationSolar::ApplicationSolar(std::string const& resource_path)
  :Application{resource_path}
-, planet_object{}, star_object{}, orbit_object{}, skybox_object{}, screenquad_object{}, CameraBuffer{}
+, orbit_object{}, skybox_object{}, assets{}
+, pointLights{cluster_grid{CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, CLUSTER_NEAR, CLUSTER_FAR}}, renderTargets{}, postProcessing{renderTargets, POST_TEXTURE_UNIT}, gBuffer{renderTargets}, bodyTree{BODY_TREE_MARGIN}, CameraBuffer{}
+, simulation{[this](double time, std::vector<glm::fmat4>& transforms) { simulateBodies(time, transforms); },
+             2 * NUM_SPHERES, SIMULATION_TIMESTEP}
 {
     //set states
     orbitsOn = true;
     starsOn = false;
+    lightsOn = false;
+    deferredOn = false;
+    shaderMode = 0;
     
     //generate vertices information=======================================
 
-    //fill stars buffer
-    fillStars();
     //fill orbit buffer
-    orbit_object.num_elements = NUM_POINTS_ON_ORBIT;
     fillOrbits();
-
-    //load textures and normal maps from files======================
-    
-    //load textures
-    loadAllTextures();
-    //load normal map
-    loadNormalMap(GL_TEXTURE12);
-    
-    //initialise frame buffers - assignment 5
-    setupOffscreenRendering();
     
+    //scatter point lights, binned every frame once they are switched on
+    fillLights();
+
+    //register textures, normal map and meshes, they are loaded once a frame needs them
+    registerAssets();
     
-    //configure models ============================================
+    //initialise post processing passes and their frame buffers - assignment 5
+    setupPostProcessing();
     
-    model planet_model = model_loader::obj(m_resource_path + "models/sphere.obj", model::NORMAL | model::TEXCOORD | model::TANGENT);
-    //star model uses 'normal' space for colour attributes
-    star_model = {starBuffer, model::POSITION | model::NORMAL};
-    //only use position for orbits and quad
-    orbit_model = {orbitBuffer, model::POSITION};
-    screenquad_model = {screenQuad, model::POSITION};
-
     
     //set starting view ============================================
     m_view_transform = glm::translate(m_view_transform, glm::fvec3{ 0.0f, 0.0f, 10.0f });
@@ -77,6 +119,10 @@ ApplicationSolar::ApplicationSolar(std::string const& resource_path)
     initializeShaderPrograms();
     
     createCameraBuffer();
+    
+    //animate bodies on the simulation thread
+    buildScene();
+    simulation.start();
   
 }
 
@@ -91,336 +137,639 @@ void ApplicationSolar::createCameraBuffer(){
     //set size and usage
     glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBuffer), &CameraBuffer, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    memory_accounting::track_buffer(ubo_handle, memory_accounting::UNIFORMS, sizeof(CameraBuffer), "camera uniforms");
+}
+
+void ApplicationSolar::setupPostProcessing(){
+    
+    //scene is rendered into a full resolution target with depth,
+    //blur and bloom work on smaller ping-pong pairs
+    postProcessing.add_target("scene", 0, GL_RGB8, true);
+    postProcessing.add_target("half_a", 1, GL_RGB8);
+    postProcessing.add_target("half_b", 1, GL_RGB8);
+    postProcessing.add_target("quarter_a", 2, GL_RGB8);
+    postProcessing.add_target("quarter_b", 2, GL_RGB8);
+    postProcessing.add_target("eighth_a", 3, GL_RGB8);
+    postProcessing.add_target("eighth_b", 3, GL_RGB8);
+    
+    //pass setups, programs are looked up when drawing so rebuilt programs are used
+    auto downsample = [this](unsigned features) {
+        return [this, features](glm::fvec2 const& texel) {
+            shader_program const& program = getPermutation("downsample", features);
+            glUseProgram(program.handle);
+            glUniform1i(program.u_locs.at("ColourTex"), POST_TEXTURE_UNIT);
+            glUniform2f(program.u_locs.at("TexelSize"), texel.x, texel.y);
+        };
+    };
+    auto blur = [this](glm::fvec2 direction) {
+        return [this, direction](glm::fvec2 const& texel) {
+            shader_program const& program = m_shaders.at("blur");
+            glUseProgram(program.handle);
+            glUniform1i(program.u_locs.at("ColourTex"), POST_TEXTURE_UNIT);
+            glUniform2f(program.u_locs.at("Direction"), direction.x * texel.x, direction.y * texel.y);
+        };
+    };
+    auto upsample = [this](glm::fvec2 const& texel) {
+        shader_program const& program = m_shaders.at("upsample");
+        glUseProgram(program.handle);
+        glUniform1i(program.u_locs.at("ColourTex"), POST_TEXTURE_UNIT);
+        glUniform2f(program.u_locs.at("TexelSize"), texel.x, texel.y);
+    };
+    //mirroring and greyscale are applied when compositing, bits match Post_Processing_Flag
+    auto composite = [this](glm::fvec2 const&) {
+        unsigned features = unsigned(Post_Processing_Flag) & 7u;
+        if (Post_Processing_Flag & PP_BLOOM) {
+            features |= COMPOSITE_BLOOM;
+        }
+        shader_program const& program = getPermutation("quad", features);
+        glUseProgram(program.handle);
+        glUniform1i(program.u_locs.at("TexID"), POST_TEXTURE_UNIT);
+        glUniform1i(program.u_locs.at("BloomTex"), POST_TEXTURE_UNIT + 1);
+    };
+    
+    //blur - separable gaussian at half resolution, composited instead of the scene
+    postProcessing.add_pass("blur", {"scene"}, "half_a", downsample(0));
+    postProcessing.add_pass("blur", {"half_a"}, "half_b", blur(glm::fvec2{1.0f, 0.0f}));
+    postProcessing.add_pass("blur", {"half_b"}, "half_a", blur(glm::fvec2{0.0f, 1.0f}));
+    
+    //bloom - bright parts are blurred down to an eighth of the resolution
+    //and added back up, so the glow gets wide at little cost
+    postProcessing.add_pass("bloom", {"scene"}, "half_b", downsample(1));
+    postProcessing.add_pass("bloom", {"half_b"}, "quarter_a", downsample(0));
+    postProcessing.add_pass("bloom", {"quarter_a"}, "quarter_b", blur(glm::fvec2{1.0f, 0.0f}));
+    postProcessing.add_pass("bloom", {"quarter_b"}, "quarter_a", blur(glm::fvec2{0.0f, 1.0f}));
+    postProcessing.add_pass("bloom", {"quarter_a"}, "eighth_a", downsample(0));
+    postProcessing.add_pass("bloom", {"eighth_a"}, "eighth_b", blur(glm::fvec2{1.0f, 0.0f}));
+    postProcessing.add_pass("bloom", {"eighth_b"}, "eighth_a", blur(glm::fvec2{0.0f, 1.0f}));
+    postProcessing.add_pass("bloom", {"eighth_a"}, "quarter_a", upsample, true);
+    
+    //final pass to the screen
+    compositePass = postProcessing.add_pass("composite", {"scene", "quarter_a"}, "", composite);
+    
+    updatePostProcessing();
 }
 
-void ApplicationSolar::setupOffscreenRendering(){
+//skip passes of disabled effects
+void ApplicationSolar::updatePostProcessing(){
     
-    //get screen size
-    GLint viewportData[4];
-    glGetIntegerv(GL_VIEWPORT, viewportData);
+    bool blurOn = (Post_Processing_Flag & PP_BLUR) != 0;
+    postProcessing.set_enabled("blur", blurOn);
+    postProcessing.set_enabled("bloom", (Post_Processing_Flag & PP_BLOOM) != 0);
+    postProcessing.set_input(compositePass, 0, blurOn ? "half_a" : "scene");
+}
+
+//file names of planet textures followed by the starscape, in texture index order
+std::vector<std::string> ApplicationSolar::textureNames() const{
     
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < NUM_SPHERES; i++) {
+        names.push_back(planets[i].name);
+    }
+    //starscape texture from https://tylercreatesworlds.deviantart.com/art/The-Candle-s-Wick-383265630
+    names.push_back("stars_a");
+    return names;
+}
+
+//decode planet textures followed by the starscape, in texture index order
+std::vector<pixel_data> ApplicationSolar::decodeTextures() const{
     
-    //create texture
-    //switch active texture
-    glActiveTexture(GL_TEXTURE13);
-    //generate texture object
-    glGenTextures(1, &drawBufferTexture);
-    //bind texture to 2D texture binding point of active unit
-    glBindTexture(GL_TEXTURE_2D, drawBufferTexture);
-    //add empty texture image
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, viewportData[2], viewportData[3], 0,
-                 GL_RGB, GL_FLOAT, 0);
+    std::vector<std::string> names = textureNames();
     
-    //define sampling parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    //decode files as jobs
+    std::vector<pixel_data> textures(names.size());
+    jobs::parallel_for(0, names.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            textures[i] = texture_loader::file(m_resource_path + "textures/" + names[i] + ".png");
+        }
+    });
+    return textures;
+}
+
+//planet, skybox and normal map textures with their colours as placeholders,
+//the planet sphere with a coarse one and the star field with nothing until it is generated
+void ApplicationSolar::registerAssets(){
     
+    std::vector<std::string> names = textureNames();
+    for (std::size_t i = 0; i < NUM_SPHERES; i++) {
+        planetTextures[i] = assets.texture(m_resource_path + "textures/" + names[i] + ".png", planets[i].RGBColour, names[i]);
+    }
+    skyboxTexture = assets.texture(m_resource_path + "textures/" + names[NUM_SPHERES] + ".png", glm::fvec3{0.0f}, names[NUM_SPHERES]);
+    //flat normal
+    normalMap = assets.texture(m_resource_path + "normal_maps/earth_bumpmap.png", glm::fvec3{0.5f, 0.5f, 1.0f}, "earth_bumpmap");
+    
+    //generated with texture coordinates and tangents instead of parsing a file, kept for software rendering
+    model::attrib_flag_t attributes = model::NORMAL | model::TEXCOORD | model::TANGENT;
+    AssetManager::handle placeholder = assets.mesh(sphere_geometry::uv_sphere(PLACEHOLDER_RINGS, PLACEHOLDER_SEGMENTS, attributes), GL_TRIANGLES, "planet placeholder");
+    planetMesh = assets.mesh([attributes]() {
+        return sphere_geometry::uv_sphere(PLANET_RINGS, PLANET_SEGMENTS, attributes);
+    }, placeholder, GL_TRIANGLES, "planet");
+    
+    //stars are only generated once they are switched on
+    starMesh = assets.mesh([this]() {
+        return fillStars();
+    }, AssetManager::NONE, GL_POINTS, "stars");
+}
+
+//request textures and meshes of the next frame by size on screen,
+//bodies outside the view are prefetched by distance with a priority below all visible ones
+void ApplicationSolar::requestAssets() const{
     
-    //create render buffer (for depth buffer)
-    glGenRenderbuffers(1, &rb_handle);
-    glBindRenderbuffer(GL_RENDERBUFFER, rb_handle);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, viewportData[2], viewportData[3]);
+    glm::fvec3 cameraPosition{m_view_transform[3]};
+    float pixelsPerUnit = CameraBuffer.ProjectionMatrix[1][1] * viewportHeight * 0.5f;
+    std::vector<bool> visible(NUM_SPHERES, false);
+    for (unsigned i : visibleBodies) {
+        visible[i] = true;
+    }
     
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
+        float distance = glm::length(glm::fvec3{bodyTransforms[i][3]} - cameraPosition);
+        float priority = 1.0f / (1.0f + distance);
+        if (visible[i]) {
+            //projected radius in pixels, capped when the camera is inside the body
+            priority = 1.0f + planets[i].size * pixelsPerUnit / std::max(distance, planets[i].size);
+        }
+        assets.request(planetTextures[i], priority);
+        if (planets[i].name == "earth") {
+            assets.request(normalMap, priority);
+        }
+    }
     
-    //setup FBO
-    glGenFramebuffers(1, &fbo_handle);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_handle);
-    //define attachments
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, drawBufferTexture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER, rb_handle);
+    //skybox and stars cover the screen
+    assets.request(skyboxTexture, viewportHeight);
+    assets.request(planetMesh, viewportHeight);
+    if (starsOn) {
+        assets.request(starMesh, viewportHeight);
+    }
+}
+
+void ApplicationSolar::finishLoading() {
+    assets.finish();
+}
+
+void ApplicationSolar::fillOrbits(){
     
-    //create draw buffers
-    GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
-    glDrawBuffers(1, draw_buffers);
+    //all orbits share unit circles at several resolutions,
+    //radius, skew and parent frame are applied per instance
+    orbitCircles = orbit_geometry::unit_circles(MIN_ORBIT_SEGMENTS, MAX_ORBIT_SEGMENTS);
+    //vertices stay on the cpu for lod selection and software rendering
+    memory_accounting::track_host(&orbitCircles, memory_accounting::GEOMETRY, sizeof(float) * orbitCircles.vertices.data.size(), "orbit circles");
+}
+
+
+//runs as a job, the field is only read once its vertices are resident
+model ApplicationSolar::fillStars(){
     
-    //check validity
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (status != GL_FRAMEBUFFER_COMPLETE){
-        throw std::logic_error("framebuffer not correctly initialised");
-    }
+    //stars are binned into chunks for culling, colour is stored in 'normal' space
+    //same seed gives the same field on any number of threads
+    starField = star_generator::generate(NUM_STARS, STAR_SEED, 80.0f, STAR_CHUNKS_PER_AXIS);
+    //chunks stay on the cpu for culling, the asset manager keeps the vertices
+    memory_accounting::track_host(&starField, memory_accounting::GEOMETRY, sizeof(star_chunk) * starField.chunks.size(), "star chunks");
+    model vertices{};
+    std::swap(vertices, starField.vertices);
+    return vertices;
+}
+
+//point lights in a flat disc around the sun, each lighting only its surroundings
+//same seed gives the same lights every run
+void ApplicationSolar::fillLights(){
     
+    philox4x32 rng{LIGHT_SEED};
+    std::uint32_t random[4];
+    for (std::uint32_t i = 0; i < NUM_LIGHTS; i++) {
+        
+        std::uint32_t counter[4] = {i, 0, 0, 0};
+        rng.generate(counter, random);
+        
+        point_light NewLight;
+        
+        //fill position, uniform over the area of the disc between the inner and outer orbits
+        float distance = std::sqrt(glm::mix(3.0f * 3.0f, 60.0f * 60.0f, philox4x32::to_unit(random[0])));
+        float angle = philox4x32::to_unit(random[1]) * 2.0f * float(M_PI);
+        float height = (philox4x32::to_unit(random[2]) - 0.5f) * 3.0f;
+        NewLight.position = glm::fvec3{std::cos(angle) * distance, height, std::sin(angle) * distance};
+        
+        //fill radius
+        NewLight.radius = glm::mix(1.0f, 3.0f, philox4x32::to_unit(random[3]));
+        
+        //fill colour, a saturated hue
+        counter[1] = 1;
+        rng.generate(counter, random);
+        glm::fvec3 hue = glm::abs(glm::fract(glm::fvec3{philox4x32::to_unit(random[0])} + glm::fvec3{0.0f, 2.0f / 3.0f, 1.0f / 3.0f}) * 6.0f - 3.0f) - 1.0f;
+        NewLight.colour = glm::clamp(hue, 0.0f, 1.0f) * 0.8f;
+        
+        lights.push_back(NewLight);
+    }
     
 }
 
-//loads a normal map
-void ApplicationSolar::loadNormalMap(GLenum targetTextureUnit){
+
+void ApplicationSolar::render() const {
     
-    //load texture from file for this planet
-    pixel_data newTexture = texture_loader::file(m_resource_path + "normal_maps/earth_bumpmap.png");
+    //fetch interpolated body transforms once per frame and find visible bodies/orbits
+    {
+        profiler::cpu_scope scope{"update"};
+        updateBodyTransforms();
+        cullScene();
+    }
     
-    GLuint TEX_POSITION = 11;
+    //start loading what this frame needs and upload finished loads
+    {
+        profiler::cpu_scope scope{"assets"};
+        requestAssets();
+        assets.update();
+    }
     
-    //set ID
-    texBufferIDs[TEX_POSITION] = TEX_POSITION;
+    //bin the point lights in view into clusters and upload their lists
+    if (lightsOn) {
+        profiler::cpu_scope scope{"lights"};
+        pointLights.update(lights, CameraBuffer.ViewMatrix, CameraBuffer.ProjectionMatrix, viewportSize);
+    }
     
-    //switch active texture
-    glActiveTexture(targetTextureUnit);
-    //generate texture object
-    glGenTextures(1, &texBufferIDs[TEX_POSITION]);
-    //bind texture to 2D texture binding point of active unit
-    glBindTexture(GL_TEXTURE_2D, texBufferIDs[TEX_POSITION]);
+    //==================================================================
+    //planets
+    if (deferredOn) {
+        //geometry once into the geometry buffer, which shares the scene target's depth
+        {
+            profiler::gpu_scope scope{"geometry"};
+            gBuffer.bind(postProcessing.size("scene"), postProcessing.depth_texture("scene"));
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            upload_planets(true);
+        }
+        //then every pixel is lit once, the depth is sampled so it stays detached
+        {
+            profiler::gpu_scope scope{"lighting"};
+            postProcessing.bind("scene", false);
+            glClear(GL_COLOR_BUFFER_BIT);
+            upload_deferred_lighting();
+            gBuffer.release();
+        }
+        //the remaining passes draw over the lit planets with depth test
+        postProcessing.bind("scene");
+    }
+    else {
+        //set to render to texture (via FBO), attachments are taken from the pool for this frame
+        postProcessing.bind("scene");
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        
+        profiler::gpu_scope scope{"planets"};
+        upload_planets(false);
+    }
     
-    //define sampling parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    //==================================================================
+    //stars
     
-    //define texture data and texture format
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)newTexture.width, (GLsizei)newTexture.height, 0, newTexture.channels, newTexture.channel_type, newTexture.ptr());
-}
-
-//cycle through all planets and load relevant textures
-void ApplicationSolar::loadAllTextures(){
+    if (starsOn) {
+        profiler::gpu_scope scope{"stars"};
+        upload_stars();
+    }
     
-    //holds texture info
-    pixel_data newTexture;
+    {
+        profiler::gpu_scope scope{"skybox"};
+        upload_skybox();
+    }
     
-    //for each planet
-    int i;
-    for (i = 0; i < (sizeof(planets) / sizeof(planets[0])); i++) {
-
-        loadTexture(planets[i].name, i);
-        
+    //==================================================================
+    //orbit(s)
+    if (orbitsOn) {
+        profiler::gpu_scope scope{"orbits"};
+        upload_Orbits();
     }
-
-    //starscape texture from https://tylercreatesworlds.deviantart.com/art/The-Candle-s-Wick-383265630
-    loadTexture("stars_a", i);
-
+    
+    
+    //==================================================================
+    //post processing, ends with the screen quad
+    {
+        profiler::gpu_scope scope{"post processing"};
+        postProcessing.render();
+    }
+    //free render targets that stayed unused, e.g. after resizing or disabling effects
+    renderTargets.collect();
     
 }
 
-//loads a single texture given a file name and a texture index
-void ApplicationSolar::loadTexture(std::string name, GLuint texId){
+//draw the last frame on the cpu, following the gl passes above
+//bodies stay where render() placed them, so both images show the same moment
+//bump mapping, point lights, blur and bloom are not reproduced
+void ApplicationSolar::renderSoftware(SoftwareRasterizer& target) const {
+    
+    cullScene();
+    if (softwareTextures.empty()) {
+        softwareTextures = decodeTextures();
+        std::size_t bytes = 0;
+        for (pixel_data const& texture : softwareTextures) {
+            bytes += texture.pixels.size();
+        }
+        memory_accounting::track_host(&softwareTextures, memory_accounting::TEXTURES, bytes, "software textures");
+    }
     
-    //load texture from file for this planet
-    pixel_data newTexture = texture_loader::file(m_resource_path + "textures/" + name + ".png");
+    target.set_camera(CameraBuffer.ViewMatrix, CameraBuffer.ProjectionMatrix);
+    target.clear();
     
-    //set ID
-    texBufferIDs[texId] = (GLuint)texId;
+    //planets
+    glm::fvec3 cameraPosition{m_view_transform[3]};
+    for (unsigned i : visibleBodies) {
+        raster_material material{};
+        material.texture = &softwareTextures[i];
+        //the sun is lit from the camera, planets from the sun
+        material.light_position = planets[i].name == "sun" ? cameraPosition : glm::fvec3{0.0f};
+        material.cel_shading = shaderMode == 2;
+        target.draw_triangles(assets.mesh_data(planetMesh), bodyTransforms[i], material);
+    }
     
-    //switch active texture
-    glActiveTexture((GLenum) (GL_TEXTURE0 + texId));
-    //generate texture object
-    glGenTextures(1, &texBufferIDs[texId]);
-    //bind texture to 2D texture binding point of active unit
-    glBindTexture(GL_TEXTURE_2D, texBufferIDs[texId]);
+    //stars
+    if (starsOn && assets.resident(starMesh)) {
+        frustum view{CameraBuffer.ProjectionMatrix * CameraBuffer.ViewMatrix};
+        culling::cull(view, starField.bounds, visibleChunks);
+        for (unsigned i : visibleChunks) {
+            star_chunk const& chunk = starField.chunks[i];
+            GLsizei count = star_generator::lod_count(chunk, CameraBuffer.ViewMatrix, CameraBuffer.ProjectionMatrix, viewportHeight, STARS_PER_PIXEL);
+            target.draw_points(assets.mesh_data(starMesh), chunk.first, count, glm::fmat4{});
+        }
+    }
     
-    //define sampling parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    //skybox follows the camera rotation only, so undo the translation of the view
+    {
+        raster_material material{};
+        material.texture = &softwareTextures[NUM_SPHERES];
+        material.colour = glm::fvec3{0.5f};
+        material.lit = false;
+        material.depth_write = false;
+        glm::fmat4 rotation{glm::fmat3{CameraBuffer.ViewMatrix}};
+        glm::fmat4 model_matrix = glm::scale(glm::fmat4{}, glm::fvec3{80.0f});
+        target.draw_triangles(assets.mesh_data(planetMesh), glm::inverse(CameraBuffer.ViewMatrix) * rotation * model_matrix, material);
+    }
     
-    //define texture data and texture format
-//    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)newTexture.width, (GLsizei)newTexture.height, 0, newTexture.channels, newTexture.channel_type, newTexture.ptr());
+    //orbits, at the resolution the gl path would pick
+    if (orbitsOn) {
+        for (unsigned i : visibleOrbits) {
+            if (i == 0) {
+                continue;
+            }
+            unsigned level = orbit_geometry::select_lod(orbitCircles, orbitTransforms[i], CameraBuffer.ViewMatrix, CameraBuffer.ProjectionMatrix, viewportHeight, ORBIT_PIXELS_PER_SEGMENT);
+            target.draw_line_loop(orbitCircles.vertices, orbitCircles.first[level], orbitCircles.segments[level], orbitTransforms[i], glm::fvec3{1.0f});
+        }
+    }
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, newTexture.width, newTexture.height, 0, newTexture.channels, newTexture.channel_type, newTexture.ptr());
+    target.flush();
     
+    //mirroring and greyscale of the composite pass
+    unsigned flags = unsigned(Post_Processing_Flag);
+    if ((flags & 7u) != 0) {
+        target.post_process([flags](SoftwareRasterizer const& source, unsigned x, unsigned y) {
+            if (flags & 2u) {
+                y = source.height() - 1 - y;
+            }
+            if (flags & 4u) {
+                x = source.width() - 1 - x;
+            }
+            glm::fvec3 colour = source.colour(x, y);
+            if (flags & 1u) {
+                colour = glm::fvec3{glm::dot(colour, glm::fvec3{0.2126f, 0.7152f, 0.0722f})};
+            }
+            return colour;
+        });
+    }
 }
 
-
-
-
-void ApplicationSolar::fillOrbits(){
+//build the body hierarchy: every body hangs below a node moving it along its orbit,
+//moons orbit inside their planet's orbit node
+void ApplicationSolar::buildScene() {
     
-    //FOR each planet/moon
-    // calculate values and add append to orbit points array
+    systemRoot = solarSystem.add(scene_graph::NONE);
     
-    //cycle through planet array, not including sun
-    for (int i = 0; i < (sizeof(planets) / sizeof(planets[0])); i++) {
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
         
-        planet thisPlanet = planets[i];
+        planet const& body = planets[i];
         
-        int pointsPerOrbit = NUM_POINTS_ON_ORBIT;
-        float increment = 2.0f * (float)M_PI / (float)pointsPerOrbit;
-        float radius = thisPlanet.distToOrigin;
-        float skew = thisPlanet.orbitSkew;
+        //moons are added below their parent
+        if (body.isMoon) {
+            continue;
+        }
         
+        orbitNodes[i] = solarSystem.add(systemRoot);
+        bodyNodes[i] = solarSystem.add(orbitNodes[i], transform_state{glm::fvec3{0.0f}, glm::fquat{}, glm::fvec3{body.size}});
+        //planet orbits are static loops around the origin
+        orbitFrameNodes[i] = systemRoot;
         
-        for (float rad = 0.f; rad < (2.0f * M_PI); rad += increment){
-            
-            //x
-            orbitBuffer.push_back(radius * cosf(rad));
-            //y
-            orbitBuffer.push_back(radius * -skew * cosf(rad));
-            //z
-            orbitBuffer.push_back(radius * sinf(rad));
+        if (body.hasMoonAtIndex > 0) {
             
+            int moon = body.hasMoonAtIndex;
+            orbitNodes[moon] = solarSystem.add(orbitNodes[i]);
+            bodyNodes[moon] = solarSystem.add(orbitNodes[moon], transform_state{glm::fvec3{0.0f}, glm::fquat{}, glm::fvec3{planets[moon].size}});
+            //moon orbit follows the planet, turned into the plane the moon rotates in
+            glm::fquat turn = glm::angleAxis(float(M_PI / 2.f), glm::fvec3{ 0.0f, 0.0f, 1.0f });
+            orbitFrameNodes[moon] = solarSystem.add(orbitNodes[i], transform_state{glm::fvec3{0.0f}, turn, glm::fvec3{1.0f}});
         }
     }
     
+    //picking boxes are moved into place every frame
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
+        bodyTree.add(glm::fvec3{0.0f}, glm::fvec3{0.0f});
+    }
+    //same tessellation as the drawn planets, so picks land on the visible surface
+    planetSurface.build(sphere_geometry::uv_sphere(PLANET_RINGS, PLANET_SEGMENTS));
 }
 
-
-void ApplicationSolar::fillStars(){
-    
-    //fill star buffer here with random position and colours
-    star_object.num_elements = NUM_STARS;
-    for (int i = 0; i < star_object.num_elements; i++){
-        
-        starBuffer.push_back(randPos());
-        starBuffer.push_back(randPos());
-        starBuffer.push_back(randPos());
-        
-        starBuffer.push_back(randCol());
-        starBuffer.push_back(randCol());
-        starBuffer.push_back(randCol());
-    }
-}
-
-//only for SSBO - not implemented as would need to upgrade
-//void ApplicationSolar::fillLights(){
-//    
-//    //fill lights with sensible values
-//    for (int i = 0; i < NUM_LIGHTS ; i++) {
-//        
-//        light NewLight;
-//        
-//        //fill position
-//        NewLight.position = glm::vec3(randPos(), randPos(), randPos());
-//        
-//        //fill colour
-//        NewLight.color = glm::vec3(randCol(), randCol(), randCol());
-//        
-//        //fill radius
-//        NewLight.radius = glm::vec3(randCol(), 0.0, 0.0);
-//        
-//        lights.push_back(NewLight);
-//    }
-//    
-//}
-
-
-void ApplicationSolar::render() const {
+//advance orbits and spins, then write model matrices of all bodies followed by the frames their orbits are drawn in
+//runs on the simulation thread at a fixed timestep
+void ApplicationSolar::simulateBodies(double sim_time, std::vector<glm::fmat4>& transforms) {
     
+    float time = float(sim_time);
     
-    
-    //set to render to texture (via FBO)
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_handle);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    
-    //==================================================================
-    //planets
-    
-    // bind shader to upload uniforms
-    glUseProgram(m_shaders.at("planet").handle);
-    // bind the VAO to draw
-    glBindVertexArray(planet_object.vertex_AO);
-
-    // cycle through members of planet array and apply model matrix
-    for (int i = 0; i < (sizeof(planets) / sizeof(planets[0])); i++) {
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
         
-        planet testPlanet = planets[i];
+        planet const& body = planets[i];
         
-        // don't render if 'planet' is a moon
-        if (testPlanet.isMoon == false) {
-            
-            // upload planet
-            upload_planet_transforms(i);
-        }
+        // use rotation speed and planet skew to create planet's orbit, moons orbit around x
+        glm::fvec3 axis = body.isMoon ? glm::fvec3{ 1.0f, 0.0f, 0.0f } : glm::normalize(glm::fvec3{ body.orbitSkew, 1.0f, 0.0f });
+        glm::fquat orbit_rotation = glm::angleAxis(time * body.rotationSpeed, axis);
+        solarSystem.set_rotation(orbitNodes[i], orbit_rotation);
+        // use planet.distToOrigin to move planet away from its orbit centre
+        solarSystem.set_translation(orbitNodes[i], orbit_rotation * glm::fvec3{ 0.0f, 0.0f, body.distToOrigin });
         
+        //add planet rotation on it's axis - const for all
+        if (!body.isMoon) {
+            solarSystem.set_rotation(bodyNodes[i], glm::angleAxis(float(time * M_PI / 10), glm::fvec3{ 0.0f, 1.0f, 0.0f }));
+        }
     }
     
-    //==================================================================
-    //stars
+    solarSystem.update();
     
-    if (starsOn) {
-        upload_stars();
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
+        transforms[i] = solarSystem.world(bodyNodes[i]);
+        transforms[NUM_SPHERES + i] = solarSystem.world(orbitFrameNodes[i]);
     }
+}
+
+//fetch body transforms and orbit frames for this frame, interpolated between the latest simulation steps
+void ApplicationSolar::updateBodyTransforms() const {
     
-    upload_skybox();
+    simulation.interpolate(simulatedTransforms);
     
-    //==================================================================
-    //orbit(s)
-    if (orbitsOn) {
-        upload_Orbits();
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
+        bodyTransforms[i] = simulatedTransforms[i];
+        orbitFrames[i] = simulatedTransforms[NUM_SPHERES + i];
+        orbitTransforms[i] = orbit_geometry::orbit_transform(orbitFrames[i], planets[i].distToOrigin, planets[i].orbitSkew);
     }
     
+    //normal matrices of all bodies for the current camera in one batch
+    transforms::view_matrices(CameraBuffer.ViewMatrix, bodyTransforms, NUM_SPHERES, nullptr, bodyNormalMatrices);
     
-    //==================================================================
-    //screen quad
-    
-    //set to render to texture (via FBO)
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    //sphere model has unit radius, so body size bounds it
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
+        glm::fvec3 center{bodyTransforms[i][3]};
+        bodyTree.move(i, center - planets[i].size, center + planets[i].size);
+    }
+    bodyTree.refit();
+}
+
+//print the body in the middle of the view, the cursor is captured for looking around
+void ApplicationSolar::pickBody() const {
     
-    upload_quad();
+    glm::fvec3 origin{m_view_transform[3]};
+    glm::fvec3 direction = -glm::normalize(glm::fvec3{m_view_transform[2]});
+    std::vector<ray_hit> hits;
+    bodyTree.query(ray{origin, direction, PICK_DISTANCE}, hits);
     
+    int picked = -1;
+    float nearest = PICK_DISTANCE;
+    for (ray_hit const& hit : hits) {
+        //a surface is never hit before its box
+        if (hit.distance > nearest) {
+            break;
+        }
+        //trace the sphere in body space, distances along the transformed ray stay the same
+        glm::fmat4 to_body = glm::inverse(bodyTransforms[hit.object]);
+        ray local{glm::fvec3{to_body * glm::fvec4{origin, 1.0f}}, glm::fvec3{to_body * glm::fvec4{direction, 0.0f}}, nearest};
+        mesh_hit surface{};
+        if (planetSurface.intersect(local, surface)) {
+            nearest = surface.distance;
+            picked = int(hit.object);
+        }
+    }
     
+    if (picked < 0) {
+        std::cout << "nothing picked" << std::endl;
+    }
+    else {
+        std::cout << "picked " << planets[picked].name << " at distance " << nearest << std::endl;
+    }
 }
 
-//upload screen quad for assignment 5
-void ApplicationSolar::upload_quad() const{
+//test bounding spheres of bodies and orbits against the view frustum
+void ApplicationSolar::cullScene() const {
     
-    glUseProgram(m_shaders.at("quad").handle);
-    glUniform1i(m_shaders.at("quad").u_locs.at("TexID"), drawBufferTexture);
-    glUniform1i(m_shaders.at("quad").u_locs.at("PP_FLAG"), Post_Processing_Flag);
+    frustum view{CameraBuffer.ProjectionMatrix * CameraBuffer.ViewMatrix};
     
-    glBindVertexArray(screenquad_object.vertex_AO);
-    glDrawArrays(screenquad_object.draw_mode, 0, screenquad_object.num_elements);
- 
+    bodyBounds.clear();
+    orbitBounds.clear();
+    
+    for (unsigned i = 0; i < NUM_SPHERES; i++) {
+        
+        planet const& body = planets[i];
+        
+        //sphere model has unit radius, so body size is its bound
+        glm::fvec3 center{bodyTransforms[i] * glm::fvec4{0.0f, 0.0f, 0.0f, 1.0f}};
+        bodyBounds.add(center, body.size);
+        
+        //orbit loops around the origin of its frame, skew tilts it out of the plane
+        glm::fvec3 orbit_center{orbitTransforms[i][3]};
+        orbitBounds.add(orbit_center, body.distToOrigin * std::sqrt(1.0f + body.orbitSkew * body.orbitSkew));
+    }
+    
+    culling::cull(view, bodyBounds, visibleBodies);
+    culling::cull(view, orbitBounds, visibleOrbits);
 }
 
 //assignment 2 extension - draw planet's orbit(s)
 void ApplicationSolar::upload_Orbits() const{
     
+    //pick circle resolution of each visible orbit from its projected size
+    std::size_t num_levels = orbitCircles.segments.size();
+    orbitLevels.clear();
+    orbitLevelCounts.assign(num_levels, 0);
+    for (unsigned i : visibleOrbits) {
+        
+        //planet 0 (sun) doesnt need an orbit
+        if (i == 0) {
+            orbitLevels.push_back(0);
+            continue;
+        }
+        
+        unsigned level = orbit_geometry::select_lod(orbitCircles, orbitTransforms[i], CameraBuffer.ViewMatrix, CameraBuffer.ProjectionMatrix, viewportHeight, ORBIT_PIXELS_PER_SEGMENT);
+        orbitLevels.push_back(level);
+        ++orbitLevelCounts[level];
+    }
+    
+    //sort instance transforms by level so each level is one contiguous range
+    std::vector<GLsizei> level_offsets(num_levels, 0);
+    for (std::size_t level = 1; level < num_levels; ++level) {
+        level_offsets[level] = level_offsets[level - 1] + orbitLevelCounts[level - 1];
+    }
+    std::vector<GLsizei> write_offsets(level_offsets);
+    orbitInstances.resize(std::size_t(level_offsets.back() + orbitLevelCounts.back()));
+    for (std::size_t k = 0; k < visibleOrbits.size(); ++k) {
+        if (visibleOrbits[k] == 0) {
+            continue;
+        }
+        orbitInstances[std::size_t(write_offsets[orbitLevels[k]]++)] = orbitTransforms[visibleOrbits[k]];
+    }
+    
+    if (orbitInstances.empty()) {
+        return;
+    }
+    
+    //upload transforms, orphaning last frame's storage
+    glBindBuffer(GL_TEXTURE_BUFFER, orbitInstanceBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::fmat4) * orbitInstances.size(), orbitInstances.data(), GL_STREAM_DRAW);
     
     //bind shader and array
     glUseProgram(m_shaders.at("orbit").handle);
     glBindVertexArray(orbit_object.vertex_AO);
-    
-    //num of orbits = num of planets
-    int numOrbits = sizeof(planets) / sizeof(planets[0]);
-    
-    //cycle through array of planets from 1 - planet 0 (sun) doesnt need an orbit
-    for (int i = 1; i < numOrbits; i++) {
-        
-        //if planet is not a moon...
-        if (planets[i].isMoon == false) {
-            
-            //don't move shader model matrix - orbit is a static loop
-            glUniformMatrix4fv(m_shaders.at("orbit").u_locs.at("ModelMatrix"),
-                               1, GL_FALSE, glm::value_ptr(glm::fmat4{}));
-        
-            //draw orbit
-            glDrawArrays(orbit_object.draw_mode, i * orbit_object.num_elements, orbit_object.num_elements);
-            
-            //if this planet has a moon
-            if (planets[i].hasMoonAtIndex > 0) {
-                
-                planet earth = planets[i];
-                
-                //create rotated and translated matrix with planet information
-                glm::fmat4 m_earth;
-                
-                m_earth = glm::rotate(glm::fmat4{}, float(glfwGetTime() * earth.rotationSpeed), glm::fvec3{ 0.0f, 1.0f, 0.0f });
-                m_earth = glm::translate(m_earth, glm::fvec3{ 0.0f, 0.0f, earth.distToOrigin });
-                m_earth = glm::rotate(m_earth, float (M_PI / 2.f), glm::fvec3{ 0.0f, 0.0f, 1.0f });
-                glUniformMatrix4fv(m_shaders.at("orbit").u_locs.at("ModelMatrix"),
-                                   1, GL_FALSE, glm::value_ptr(m_earth));
-                
-                //draw orbit
-                glDrawArrays(orbit_object.draw_mode, earth.hasMoonAtIndex * 100, orbit_object.num_elements);
-                
-            }
+    glActiveTexture((GLenum)(GL_TEXTURE0 + ORBIT_INSTANCE_UNIT));
+    glBindTexture(GL_TEXTURE_BUFFER, orbitInstanceTexture);
+    glUniform1i(m_shaders.at("orbit").u_locs.at("InstanceTransforms"), ORBIT_INSTANCE_UNIT);
+    
+    //one instanced draw per resolution
+    for (std::size_t level = 0; level < num_levels; ++level) {
+        if (orbitLevelCounts[level] == 0) {
+            continue;
         }
+        glUniform1i(m_shaders.at("orbit").u_locs.at("InstanceOffset"), level_offsets[level]);
+        glDrawArraysInstanced(orbit_object.draw_mode, orbitCircles.first[level], orbitCircles.segments[level], orbitLevelCounts[level]);
     }
 }
 
 //function added assignment 2
 void ApplicationSolar::upload_stars() const{
     
-    // order from lecture 3, slide 15
+    //nothing to draw until the field was generated
+    if (!assets.resident(starMesh)) {
+        return;
+    }
+    
+    //find chunks in view and how many of their brightest stars to draw
+    frustum view{CameraBuffer.ProjectionMatrix * CameraBuffer.ViewMatrix};
+    culling::cull(view, starField.bounds, visibleChunks);
+    
+    starFirsts.clear();
+    starCounts.clear();
+    for (unsigned i : visibleChunks) {
+        star_chunk const& chunk = starField.chunks[i];
+        starFirsts.push_back(chunk.first);
+        starCounts.push_back(star_generator::lod_count(chunk, CameraBuffer.ViewMatrix, CameraBuffer.ProjectionMatrix, viewportHeight, STARS_PER_PIXEL));
+    }
+    
+    if (starFirsts.empty()) {
+        return;
+    }
     
     // bind shader to upload uniforms
     glUseProgram(m_shaders.at("star").handle);
     // bind the VAO to draw
-    glBindVertexArray(star_object.vertex_AO);
-    //draw all
-    glDrawArrays(GL_POINTS, 0, star_object.num_elements);
-    
-    // bind the VAO to draw
-    glBindVertexArray(planet_object.vertex_AO);
-    
-    // draw bound vertex array using bound shader
-    glDrawElements(planet_object.draw_mode, planet_object.num_elements, model::INDEX.type, NULL);
+    glBindVertexArray(assets.mesh_object(starMesh).vertex_AO);
+    //draw visible chunks in one call
+    glMultiDrawArrays(GL_POINTS, starFirsts.data(), starCounts.data(), GLsizei(starFirsts.size()));
     
 }
 
@@ -439,84 +788,128 @@ void ApplicationSolar::upload_skybox() const{
     glUniformMatrix4fv(m_shaders.at("skybox").u_locs.at("ModelMatrix"),
                        1, GL_FALSE, glm::value_ptr(model_matrix));
  
-    GLuint textureIndex = 10;
-    glUniform1i(m_shaders.at("skybox").u_locs.at("ColourTex"), textureIndex);
+    //bind the starscape, or black until it is loaded
+    glActiveTexture(GL_TEXTURE0 + SKYBOX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, assets.texture_name(skyboxTexture));
+    glUniform1i(m_shaders.at("skybox").u_locs.at("ColourTex"), SKYBOX_TEXTURE_UNIT);
     
     // bind the VAO to draw
-    glBindVertexArray(planet_object.vertex_AO);
+    model_object const& sphere = assets.mesh_object(planetMesh);
+    glBindVertexArray(sphere.vertex_AO);
     // draw bound vertex array using bound shader
-    glDrawElements(planet_object.draw_mode, planet_object.num_elements, model::INDEX.type, NULL);
+    glDrawElements(sphere.draw_mode, sphere.num_elements, model::INDEX.type, NULL);
     
     glDepthMask(1);
     
 }
 
-// added function assignment 1
-void ApplicationSolar::upload_planet_transforms(int planetIndex) const
-{
+//draw visible bodies, shaded right away or into the geometry buffer
+void ApplicationSolar::upload_planets(bool deferred) const{
     
-    planet planetToDisplay = planets[planetIndex];
-    
-    // use rotation speed and planet skew to create planet's orbit
-    glm::fmat4 model_matrix = glm::rotate(glm::fmat4{}, float(glfwGetTime() * planetToDisplay.rotationSpeed), glm::fvec3{ planetToDisplay.orbitSkew, 1.0f, 0.0f });
+    // bind the VAO to draw
+    glBindVertexArray(assets.mesh_object(planetMesh).vertex_AO);
+    if (lightsOn && !deferred) {
+        pointLights.bind(LIGHT_DATA_UNIT, CLUSTER_LIGHTS_UNIT);
+    }
     
-    // use planet.distToOrigin to translate planet away from origin
-    model_matrix = glm::translate(model_matrix, glm::fvec3{ 0.0f, 0.0f, planetToDisplay.distToOrigin });
+    // only draw bodies that intersect the view frustum, moons included
+    GLuint boundProgram = 0;
+    for (unsigned i : visibleBodies) {
+        //pick the shader variant compiled with this body's features
+        unsigned features = 0u;
+        if (planets[i].name == "earth") {
+            features |= PLANET_BUMP_MAP;
+        }
+        //lighting features only matter where the body is shaded
+        if (!deferred && shaderMode == 2) {
+            features |= PLANET_CEL_SHADING;
+        }
+        if (!deferred && lightsOn) {
+            features |= PLANET_POINT_LIGHTS;
+        }
+        shader_program const& program = getPermutation(deferred ? "gbuffer" : "planet", features);
+        // bind shader to upload uniforms
+        if (program.handle != boundProgram) {
+            glUseProgram(program.handle);
+            boundProgram = program.handle;
+            if (lightsOn && !deferred) {
+                upload_lights(program);
+            }
+        }
+        upload_planet_transforms(int(i), program);
+    }
+}
 
+//light the geometry buffer with the sun and the clustered point lights
+void ApplicationSolar::upload_deferred_lighting() const{
     
-    // if this planet has a moon, add a moon using planet's location as a starting point
-    if (planetToDisplay.hasMoonAtIndex > 0) {
-        
-        planet moon = planets[planetToDisplay.hasMoonAtIndex];
-        
-        //rotate at moon's speed
-        glm::fmat4 model_matrix2 = glm::rotate(model_matrix, float(glfwGetTime() * moon.rotationSpeed), glm::fvec3{ 1.0f, 0.0f, 0.0f });
-        
-        //translate by moon's orbit
-        model_matrix2 = glm::translate(model_matrix2, glm::fvec3{ 0.0f, 0.0f, moon.distToOrigin });
-        
-        // scale moon according to planet size
-        model_matrix2 = glm::scale(model_matrix2, glm::fvec3{ moon.size, moon.size, moon.size});
-        
-        glUniformMatrix4fv(m_shaders.at("planet").u_locs.at("ModelMatrix"),
-                           1, GL_FALSE, glm::value_ptr(model_matrix2));
-        
-        //extra matrix for normal transformation to keep them orthogonal to surface
-        glm::fmat4 normal_matrix2 = glm::inverseTranspose(glm::inverse(m_view_transform) * model_matrix2);
-        glUniformMatrix4fv(m_shaders.at("planet").u_locs.at("NormalMatrix"),
-                           1, GL_FALSE, glm::value_ptr(normal_matrix2));
-        
-        //texture------------
-        glActiveTexture((GLenum)(GL_TEXTURE0 + planetToDisplay.hasMoonAtIndex));
-        glUniform1i(m_shaders.at("planet").u_locs.at("ColourTex"), planetToDisplay.hasMoonAtIndex);
-        
-        // bind the VAO to draw
-        glBindVertexArray(planet_object.vertex_AO);
-        
-        // draw bound vertex array using bound shader
-        glDrawElements(planet_object.draw_mode, planet_object.num_elements, model::INDEX.type, NULL);
-        
+    unsigned features = shaderMode == 2 ? DEFERRED_CEL_SHADING : 0u;
+    if (lightsOn) {
+        features |= DEFERRED_POINT_LIGHTS;
+    }
+    shader_program const& program = getPermutation("deferred", features);
+    glUseProgram(program.handle);
+    
+    //albedo, normal and depth on consecutive units
+    gBuffer.bind_textures(GBUFFER_UNIT);
+    glUniform1i(program.u_locs.at("GAlbedo"), GBUFFER_UNIT);
+    glUniform1i(program.u_locs.at("GNormal"), GBUFFER_UNIT + 1);
+    glUniform1i(program.u_locs.at("GDepth"), GBUFFER_UNIT + 2);
+    
+    glm::fmat4 inverseProjection = glm::inverse(CameraBuffer.ProjectionMatrix);
+    glUniformMatrix4fv(program.u_locs.at("InverseProjection"), 1, GL_FALSE, glm::value_ptr(inverseProjection));
+    glm::fvec2 size{postProcessing.size("scene")};
+    glUniform2fv(program.u_locs.at("ViewportSize"), 1, glm::value_ptr(size));
+    glm::vec3 sunPos{CameraBuffer.ViewMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)};
+    glUniform3fv(program.u_locs.at("SunPosition"), 1, glm::value_ptr(sunPos));
+    
+    if (lightsOn) {
+        pointLights.bind(LIGHT_DATA_UNIT, CLUSTER_LIGHTS_UNIT);
+        upload_lights(program);
     }
     
-    // scale planet according to planet size
-    model_matrix = glm::scale(model_matrix, glm::fvec3{ planetToDisplay.size, planetToDisplay.size, planetToDisplay.size });
-    //add planet rotation on it's axis - const for all
-    model_matrix = glm::rotate(model_matrix, float(glfwGetTime() * M_PI / 10), glm::fvec3{ 0.0f, 1.0f, 0.0f });
+    gBuffer.draw_fullscreen();
+}
+
+//cluster lookup of the point lights, the same for every planet
+void ApplicationSolar::upload_lights(shader_program const& program) const{
+    
+    cluster_grid const& grid = pointLights.grid();
+    glUniform1i(program.u_locs.at("LightData"), LIGHT_DATA_UNIT);
+    glUniform1i(program.u_locs.at("ClusterLights"), CLUSTER_LIGHTS_UNIT);
+    glUniform3i(program.u_locs.at("ClusterGrid"), GLint(grid.tiles_x), GLint(grid.tiles_y), GLint(grid.slices));
+    //fragment coordinates to tiles and view depth to slices
+    glm::fvec2 tileScale = pointLights.tile_scale();
+    glm::fvec2 sliceMapping = grid.slice_mapping();
+    glUniform2fv(program.u_locs.at("TileScale"), 1, glm::value_ptr(tileScale));
+    glUniform2fv(program.u_locs.at("SliceMapping"), 1, glm::value_ptr(sliceMapping));
+    
+}
+
+// added function assignment 1
+void ApplicationSolar::upload_planet_transforms(int planetIndex, shader_program const& program) const
+{
+    
+    planet planetToDisplay = planets[planetIndex];
     
-    glUniformMatrix4fv(m_shaders.at("planet").u_locs.at("ModelMatrix"),
+    //model matrix was computed for this frame in updateBodyTransforms
+    glm::fmat4 const& model_matrix = bodyTransforms[planetIndex];
+    
+    glUniformMatrix4fv(program.u_locs.at("ModelMatrix"),
                        1, GL_FALSE, glm::value_ptr(model_matrix));
     
-    //extra matrix for normal transformation to keep them orthogonal to surface
-    glm::fmat4 normal_matrix = glm::inverseTranspose(glm::inverse(m_view_transform) * model_matrix);
-    glUniformMatrix4fv(m_shaders.at("planet").u_locs.at("NormalMatrix"),
-                       1, GL_FALSE, glm::value_ptr(normal_matrix));
+    //extra matrix for normal transformation to keep them orthogonal to surface, batched in updateBodyTransforms
+    glUniformMatrix4fv(program.u_locs.at("NormalMatrix"),
+                       1, GL_FALSE, glm::value_ptr(bodyNormalMatrices[planetIndex]));
     
     //upload diffuse colour to shader (assignment 3)
     glm::vec3 planetColour = planetToDisplay.RGBColour;
-    glUniform3fv(m_shaders.at("planet").u_locs.at("DiffuseColour"), 1, glm::value_ptr(planetColour));
+    glUniform3fv(program.u_locs.at("DiffuseColour"), 1, glm::value_ptr(planetColour));
+    //the deferred pass needs to know which surfaces are lit from the camera
+    glUniform1f(program.u_locs.at("Material"), planetToDisplay.name == "sun" ? 1.0f : 0.0f);
     
     //this is to make the sun 'shine' - upload origin with 0.0 as w co-ord
-    glm::fmat4 view_matrix = glm::inverse(m_view_transform);
+    glm::fmat4 const& view_matrix = CameraBuffer.ViewMatrix;
     glm::vec4 origin;
     if (planetToDisplay.name == "sun" ) {
         
@@ -533,34 +926,32 @@ void ApplicationSolar::upload_planet_transforms(int planetIndex) const
     glm::vec3 sunPos(view_matrix * origin);
     //upload vec3 to planet shader
     
-    glUniform3fv(m_shaders.at("planet").u_locs.at("SunPosition"), 1, glm::value_ptr(sunPos));
+    glUniform3fv(program.u_locs.at("SunPosition"), 1, glm::value_ptr(sunPos));
 
     
     //textures========================================================
 
     
-    //get location of sampler uniform
+    //bind the planet texture, or the planet colour until it is loaded
     glActiveTexture(GL_TEXTURE0 + planetIndex);
-    glUniform1i(m_shaders.at("planet").u_locs.at("ColourTex"), planetIndex);
+    glBindTexture(GL_TEXTURE_2D, assets.texture_name(planetTextures[planetIndex]));
+    glUniform1i(program.u_locs.at("ColourTex"), planetIndex);
     
     //normal map
-    glUniform1i(m_shaders.at("planet").u_locs.at("NormalMapIndex"), (int)texBufferIDs[11]);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D, assets.texture_name(normalMap));
+    glUniform1i(program.u_locs.at("NormalMapIndex"), NORMAL_MAP_UNIT);
     
-    if (planetToDisplay.name == "earth") {
-        glUniform1b(m_shaders.at("planet").u_locs.at("UseBumpMap"), true);
-    }
-    else {
-        glUniform1b(m_shaders.at("planet").u_locs.at("UseBumpMap"), false);
-    }
     
     
     //end textures====================================================
     
     // bind the VAO to draw
-    glBindVertexArray(planet_object.vertex_AO);
+    model_object const& sphere = assets.mesh_object(planetMesh);
+    glBindVertexArray(sphere.vertex_AO);
     
     // draw bound vertex array using bound shader
-    glDrawElements(planet_object.draw_mode, planet_object.num_elements, model::INDEX.type, NULL);
+    glDrawElements(sphere.draw_mode, sphere.num_elements, model::INDEX.type, NULL);
 }
 
 void ApplicationSolar::updateView() {
@@ -604,14 +995,13 @@ void ApplicationSolar::updateProjection() {
     
     
     
-    //update render buffer size
-    glBindRenderbuffer(GL_RENDERBUFFER, rb_handle);
     //get screen size
     GLint viewportData[4];
     glGetIntegerv(GL_VIEWPORT, viewportData);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, viewportData[2], viewportData[3]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, viewportData[2], viewportData[3], 0,
-                 GL_RGB, GL_FLOAT, 0);
+    viewportHeight = float(viewportData[3]);
+    viewportSize = glm::uvec2{unsigned(viewportData[2]), unsigned(viewportData[3])};
+    //post processing targets follow once the size stops changing
+    postProcessing.resize(unsigned(viewportData[2]), unsigned(viewportData[3]));
 
 }
 
@@ -620,30 +1010,30 @@ void ApplicationSolar::uploadUniforms() {
   updateUniformLocations();
     
     //assignment 6 - camera buffer creation
-    //query location of planet shader
-    GLuint location = glGetUniformBlockIndex(m_shaders.at("planet").handle, "CameraBlock");
-    //bind block to planet shader
-    glUniformBlockBinding(m_shaders.at("planet").handle, location, 4);
-    
-    //query location of star shader
-    location = glGetUniformBlockIndex(m_shaders.at("star").handle, "CameraBlock");
-    //bind block to star shader
-    glUniformBlockBinding(m_shaders.at("star").handle, location, 4);
-    
-    //query location of orbit shader
-    location = glGetUniformBlockIndex(m_shaders.at("orbit").handle, "CameraBlock");
-    //bind block to orbit shader
-    glUniformBlockBinding(m_shaders.at("orbit").handle, location, 4);
-    
-    //query location of skybox shader
-    location = glGetUniformBlockIndex(m_shaders.at("skybox").handle, "CameraBlock");
-    //bind block to orbit shader
-    glUniformBlockBinding(m_shaders.at("skybox").handle, location, 4);
+    //bind block of every shader using it, permutations included
+    for (auto const& pair : m_shaders) {
+        GLuint location = glGetUniformBlockIndex(pair.second.handle, "CameraBlock");
+        if (location != GL_INVALID_INDEX) {
+            glUniformBlockBinding(pair.second.handle, location, 4);
+        }
+    }
   
   updateView();
   updateProjection();
 }
 
+// update uniform locations of a program rebuilt in the background
+void ApplicationSolar::uploadProgramUniforms(std::string const& name) {
+    shader_program& program = m_shaders.at(name);
+    updateUniformLocations(program);
+    
+    //rebind camera block, other uniforms are uploaded every frame
+    GLuint location = glGetUniformBlockIndex(program.handle, "CameraBlock");
+    if (location != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program.handle, location, 4);
+    }
+}
+
 // handle key input
 void ApplicationSolar::keyCallback(int key, int scancode, int action, int mods) {
 	//move scene toward camera
@@ -670,14 +1060,12 @@ void ApplicationSolar::keyCallback(int key, int scancode, int action, int mods)
     //switch between shading modes - mode 1
     else if (key == GLFW_KEY_1 && action != GLFW_PRESS) {
         
-        glUseProgram(m_shaders.at("planet").handle);
-        glUniform1i(m_shaders.at("planet").u_locs.at("ShaderMode"), 1);
+        shaderMode = 1;
         
     }
     //switch between shading modes - mode 2
     else if (key == GLFW_KEY_2 && action != GLFW_PRESS) {
-        glUseProgram(m_shaders.at("planet").handle);
-        glUniform1i(m_shaders.at("planet").u_locs.at("ShaderMode"), 2);
+        shaderMode = 2;
         
     }
     else if (key == GLFW_KEY_O && action != GLFW_PRESS) {
@@ -688,6 +1076,19 @@ void ApplicationSolar::keyCallback(int key, int scancode, int action, int mods)
         
         starsOn = !starsOn;
     }
+    else if (key == GLFW_KEY_K && action != GLFW_PRESS) {
+        
+        lightsOn = !lightsOn;
+    }
+    //switch between forward and deferred shading of the planets
+    else if (key == GLFW_KEY_G && action != GLFW_PRESS) {
+        
+        deferredOn = !deferredOn;
+    }
+    else if (key == GLFW_KEY_I && action != GLFW_PRESS) {
+        
+        pickBody();
+    }
     //asssignment 5 - post-processing options
     //use binary flag to pass setting to shader
     //https://www.experts-exchange.com/articles/1842/Binary-Bit-Flags-Tutorial-and-Usage-Tips.html
@@ -703,6 +1104,11 @@ void ApplicationSolar::keyCallback(int key, int scancode, int action, int mods)
     }
     else if (key == GLFW_KEY_0 && action != GLFW_PRESS){
         Post_Processing_Flag ^= 1UL << 3;//blur
+        updatePostProcessing();
+    }
+    else if (key == GLFW_KEY_6 && action != GLFW_PRESS){
+        Post_Processing_Flag ^= 1UL << 4;//bloom
+        updatePostProcessing();
     }
     
 }
@@ -746,10 +1152,33 @@ void ApplicationSolar::initializeShaderPrograms() {
     m_shaders.at("planet").u_locs["ModelMatrix"] = -1;
     m_shaders.at("planet").u_locs["SunPosition"] = -1;
     m_shaders.at("planet").u_locs["DiffuseColour"] = -1;
-    m_shaders.at("planet").u_locs["ShaderMode"] = -1;
     m_shaders.at("planet").u_locs["ColourTex"] = -1;
     m_shaders.at("planet").u_locs["NormalMapIndex"] = -1;
-    m_shaders.at("planet").u_locs["UseBumpMap"] = -1;
+    m_shaders.at("planet").u_locs["LightData"] = -1;
+    m_shaders.at("planet").u_locs["ClusterLights"] = -1;
+    m_shaders.at("planet").u_locs["ClusterGrid"] = -1;
+    m_shaders.at("planet").u_locs["TileScale"] = -1;
+    m_shaders.at("planet").u_locs["SliceMapping"] = -1;
+    m_shaders.at("planet").u_locs["Material"] = -1;
+    //one variant per feature combination instead of branching on uniforms
+    addPermutations("planet", {"BUMP_MAP", "CEL_SHADING", "POINT_LIGHTS"});
+    
+    //geometry pass of deferred shading, takes the same per body uniforms
+    m_shaders.emplace("gbuffer", shader_program{m_resource_path + "shaders/simple.vert",
+                                            m_resource_path + "shaders/gbuffer.frag"});
+    for (char const* uniform : {"NormalMatrix", "ModelMatrix", "SunPosition", "DiffuseColour", "ColourTex", "NormalMapIndex", "Material"}) {
+        m_shaders.at("gbuffer").u_locs[uniform] = -1;
+    }
+    addPermutations("gbuffer", {"BUMP_MAP"});
+    
+    //lighting pass of deferred shading
+    m_shaders.emplace("deferred", shader_program{m_resource_path + "shaders/fullscreen.vert",
+                                             m_resource_path + "shaders/deferred.frag"});
+    for (char const* uniform : {"GAlbedo", "GNormal", "GDepth", "InverseProjection", "ViewportSize", "SunPosition",
+                                       "LightData", "ClusterLights", "ClusterGrid", "TileScale", "SliceMapping"}) {
+        m_shaders.at("deferred").u_locs[uniform] = -1;
+    }
+    addPermutations("deferred", {"CEL_SHADING", "POINT_LIGHTS"});
     
     
     // add star shader here
@@ -760,13 +1189,33 @@ void ApplicationSolar::initializeShaderPrograms() {
     m_shaders.emplace("orbit", shader_program{m_resource_path + "shaders/orbit.vert",
         m_resource_path + "shaders/orbit.frag"});
     // request uniform locations for shader program
-    m_shaders.at("orbit").u_locs["ModelMatrix"] = -1;
+    m_shaders.at("orbit").u_locs["InstanceTransforms"] = -1;
+    m_shaders.at("orbit").u_locs["InstanceOffset"] = -1;
     
     //add screen quad shader
-    m_shaders.emplace("quad", shader_program{m_resource_path + "shaders/quad.vert",
+    m_shaders.emplace("quad", shader_program{m_resource_path + "shaders/fullscreen.vert",
         m_resource_path + "shaders/quad.frag"});
     m_shaders.at("quad").u_locs["TexID"] = -1;
-    m_shaders.at("quad").u_locs["PP_FLAG"] = -1;
+    m_shaders.at("quad").u_locs["BloomTex"] = -1;
+    //first bits match Post_Processing_Flag
+    addPermutations("quad", {"GREYSCALE", "H_MIRRORED", "V_MIRRORED", "BLOOM"});
+    
+    //post processing pass shaders
+    m_shaders.emplace("downsample", shader_program{m_resource_path + "shaders/fullscreen.vert",
+        m_resource_path + "shaders/downsample.frag"});
+    m_shaders.at("downsample").u_locs["ColourTex"] = -1;
+    m_shaders.at("downsample").u_locs["TexelSize"] = -1;
+    addPermutations("downsample", {"BRIGHT_PASS"});
+    
+    m_shaders.emplace("blur", shader_program{m_resource_path + "shaders/fullscreen.vert",
+        m_resource_path + "shaders/blur.frag"});
+    m_shaders.at("blur").u_locs["ColourTex"] = -1;
+    m_shaders.at("blur").u_locs["Direction"] = -1;
+    
+    m_shaders.emplace("upsample", shader_program{m_resource_path + "shaders/fullscreen.vert",
+        m_resource_path + "shaders/upsample.frag"});
+    m_shaders.at("upsample").u_locs["ColourTex"] = -1;
+    m_shaders.at("upsample").u_locs["TexelSize"] = -1;
     
     //add skybox shader
     m_shaders.emplace("skybox", shader_program{m_resource_path + "shaders/skybox.vert",
@@ -781,90 +1230,6 @@ void ApplicationSolar::initializeShaderPrograms() {
 // load models
 void ApplicationSolar::initializeGeometry() {
     
-    //=================================================================
-    // planet initialisation
-    
-  model planet_model = model_loader::obj(m_resource_path + "models/sphere.obj", model::NORMAL);
-
-  // generate vertex array object
-  glGenVertexArrays(1, &planet_object.vertex_AO);
-  // bind the array for attaching buffers
-  glBindVertexArray(planet_object.vertex_AO);
-
-  // generate generic buffer
-  glGenBuffers(1, &planet_object.vertex_BO);
-  // bind this as an vertex array buffer containing all attributes
-  glBindBuffer(GL_ARRAY_BUFFER, planet_object.vertex_BO);
-  // configure currently bound array buffer
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * planet_model.data.size(), planet_model.data.data(), GL_STATIC_DRAW);
-
-  // activate first attribute on gpu
-  glEnableVertexAttribArray(0);
-  // first attribute is 3 floats with no offset & stride
-  glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::POSITION]);
-    
-  // activate second attribute on gpu
-  glEnableVertexAttribArray(1);
-  // second attribute is 3 floats with no offset & stride
-  glVertexAttribPointer(1, model::NORMAL.components, model::NORMAL.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::NORMAL]);
-
-    // activate third attribute on gpu - texture coordinates
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, model::TEXCOORD.components, model::TEXCOORD.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::TEXCOORD]);
-    
-    // activate fourth attribute on gpu - tangents
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, model::TANGENT.components, model::TANGENT.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::TANGENT]);
-    
-    
-
-   // generate generic buffer
-  glGenBuffers(1, &planet_object.element_BO);
-  // bind this as an vertex array buffer containing all attributes
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planet_object.element_BO);
-  // configure currently bound array buffer
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, model::INDEX.size * planet_model.indices.size(), planet_model.indices.data(), GL_STATIC_DRAW);
-
-  // store type of primitive to draw
-  planet_object.draw_mode = GL_TRIANGLES;
-  // transfer number of indices to model object 
-  planet_object.num_elements = GLsizei(planet_model.indices.size());
-    
-    
-  //======================================================================
-  // star initialisation - lecture 4 slide 8
-    
-    
-    //generate vertex array object
-    glGenVertexArrays(1, &star_object.vertex_AO);
-    // bind the array for attaching buffers
-    glBindVertexArray(star_object.vertex_AO);
-    
-    // generate generic buffer
-    glGenBuffers(1, &star_object.vertex_BO);
-    // bind this as an vertex array buffer containing all attributes
-    glBindBuffer(GL_ARRAY_BUFFER, star_object.vertex_BO);
-    // configure currently bound array buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * star_model.data.size(), star_model.data.data(), GL_STATIC_DRAW);
-    
-    
-    
-    // activate first attribute on gpu - position
-    glEnableVertexAttribArray(0);
-    // first attribute is 3 floats with no offset & stride
-    
-    //reinstate
-    glVertexAttribPointer(0, star_model.POSITION.components, star_model.POSITION.type, GL_FALSE, star_model.vertex_bytes, star_model.offsets[model::POSITION]);
-
-    
-    // activate second attribute on gpu - colour
-    glEnableVertexAttribArray(1);
-    // second attribute is 3 floats with offset & stride of 3 floats
-    
-    glVertexAttribPointer(1, star_model.NORMAL.components, star_model.NORMAL.type, GL_FALSE, star_model.vertex_bytes, star_model.offsets[model::NORMAL]);
-    
-    
-    // end star initialisation
   //======================================================================
     //orbit initialisation
     
@@ -879,101 +1244,60 @@ void ApplicationSolar::initializeGeometry() {
     // bind this as an vertex array buffer containing all attributes
     glBindBuffer(GL_ARRAY_BUFFER, orbit_object.vertex_BO);
     // configure currently bound array buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * orbit_model.data.size(), orbit_model.data.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * orbitCircles.vertices.data.size(), orbitCircles.vertices.data.data(), GL_STATIC_DRAW);
+    memory_accounting::track_buffer(orbit_object.vertex_BO, memory_accounting::GEOMETRY, sizeof(float) * orbitCircles.vertices.data.size(), "orbit vertices");
     
     // activate first attribute on gpu
     glEnableVertexAttribArray(0);
     // first attribute is 3 floats with no offset & stride
     
-    glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, orbit_model.vertex_bytes, orbit_model.offsets[model::POSITION]);
+    glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, orbitCircles.vertices.vertex_bytes, orbitCircles.vertices.offsets[model::POSITION]);
 
     // store type of primitive to draw
     orbit_object.draw_mode = GL_LINE_LOOP;
     
+    //per instance orbit transforms, read as rgba32f texels by the orbit shader
+    glGenBuffers(1, &orbitInstanceBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, orbitInstanceBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::fmat4) * NUM_SPHERES, NULL, GL_STREAM_DRAW);
+    //frames upload at most this much
+    memory_accounting::track_buffer(orbitInstanceBuffer, memory_accounting::INSTANCES, sizeof(glm::fmat4) * NUM_SPHERES, "orbit instances");
+    glGenTextures(1, &orbitInstanceTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, orbitInstanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, orbitInstanceBuffer);
     
     
-    //======================================================================
-    //screen quad
-    
-    // generate vertex array object
-    glGenVertexArrays(1, &screenquad_object.vertex_AO);
-    // bind the array for attaching buffers
-    glBindVertexArray(screenquad_object.vertex_AO);
-    
-    // generate generic buffer
-    glGenBuffers(1, &screenquad_object.vertex_BO);
-    // bind this as an vertex array buffer containing all attributes
-    glBindBuffer(GL_ARRAY_BUFFER, screenquad_object.vertex_BO);
-    // configure currently bound array buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * screenquad_model.data.size(), screenquad_model.data.data(), GL_STATIC_DRAW);
-    
-    // activate first attribute on gpu
-    glEnableVertexAttribArray(0);
-    // first attribute is 3 floats with no offset & stride
-    glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, screenquad_model.vertex_bytes, screenquad_model.offsets[model::POSITION]);
-    
     
-    // transfer number of indices to model object
-    screenquad_object.num_elements = GLsizei(screenquad_model.data.size());
-    screenquad_object.draw_mode = GL_TRIANGLE_STRIP;
     
 
     
 }
 
 
-//returns a position float, up to specified max value
-//assigns random sign to value (-/+)
-float ApplicationSolar::randPos(){
-    
-    float maxDistFromCentre = 80.0;
-    
-    //multiply and divide by factor of 10 to give more precision
-    int range = int (maxDistFromCentre * 10);
-    
-    float out = float(rand() % range) / 10.f;
-    
-    //assign random sign - make value negative if rand num is even
-    if (rand() % 2 == 0){
-        out = -out;
-    }
-    
-    return out;
-}
-
-//returns a colour between 0.0 and 1.0;
-float ApplicationSolar::randCol(){
-    float out = float(rand() % 100) / 100.0f;
-    return out;
-}
-
-
-
-
-
 ApplicationSolar::~ApplicationSolar() {
     
-    //delete planet buffers
-    glDeleteBuffers(1, &planet_object.vertex_BO);
-    glDeleteBuffers(1, &planet_object.element_BO);
-    glDeleteVertexArrays(1, &planet_object.vertex_AO);
-
-    //delete star buffers
-    glDeleteBuffers(1, &star_object.vertex_BO);
-    glDeleteVertexArrays(1, &star_object.vertex_AO);
+    //stop simulation before anything it reads is destroyed
+    simulation.stop();
+    
+    //planet, star and texture assets are freed by their owner
     
     //delete orbit buffers
     glDeleteBuffers(1, &orbit_object.vertex_BO);
     glDeleteVertexArrays(1, &orbit_object.vertex_AO);
+    glDeleteTextures(1, &orbitInstanceTexture);
+    glDeleteBuffers(1, &orbitInstanceBuffer);
     
-    //delete quad buffers
-    glDeleteBuffers(1, &screenquad_object.vertex_BO);
-    glDeleteVertexArrays(1, &screenquad_object.vertex_AO);
+    //delete the camera buffer
+    glDeleteBuffers(1, &ubo_handle);
     
-    //delete render buffer
-    glDeleteRenderbuffers(1, &rb_handle);
-    //delete framebuffer
-    glDeleteFramebuffers(1, &fbo_handle);
+    //post processing targets are freed by their owner
+    
+    for (GLuint buffer : {orbit_object.vertex_BO, orbitInstanceBuffer, ubo_handle}) {
+        memory_accounting::release(memory_accounting::BUFFER, buffer);
+    }
+    memory_accounting::release_host(&starField);
+    memory_accounting::release_host(&orbitCircles);
+    memory_accounting::release_host(&softwareTextures);
     
     
     
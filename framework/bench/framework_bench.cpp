@@ -0,0 +1,428 @@
+// cpu cost of the framework's loading and per frame math, written as json
+// so runs of different commits can be compared
+#include "harness.hpp"
+
+#include "aabb_tree.hpp"
+#include "light_clustering.hpp"
+#include "mesh_bvh.hpp"
+#include "model.hpp"
+#include "model_loader.hpp"
+#include "sphere_geometry.hpp"
+#include "texture_loader.hpp"
+#include "transform.hpp"
+#include "utils.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct workload {
+  std::string name;
+  std::function<void()> run;
+  // slow workloads are repeated a third as often
+  bool heavy;
+  // builds inputs only needed by this workload, so filtered runs skip them
+  std::function<void()> prepare;
+};
+
+// uv sphere with positions and texcoords but no normals, so loading generates them
+static std::size_t write_sphere_obj(std::string const& path, unsigned rings, unsigned segments) {
+  std::ofstream file{path, std::ios::binary};
+  if (!file) {
+    std::cerr << "File \'" << path << "\' could not be written" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  std::string text{};
+  char line[96];
+  for (unsigned r = 0; r <= rings; ++r) {
+    float theta = glm::pi<float>() * float(r) / float(rings);
+    for (unsigned s = 0; s <= segments; ++s) {
+      float phi = 2.0f * glm::pi<float>() * float(s) / float(segments);
+      std::snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\n",
+                    std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi),
+                    float(s) / float(segments), 1.0f - float(r) / float(rings));
+      text += line;
+    }
+    file << text;
+    text.clear();
+  }
+  std::size_t triangles = 0;
+  for (unsigned r = 0; r < rings; ++r) {
+    for (unsigned s = 0; s < segments; ++s) {
+      // obj indices start at 1
+      unsigned a = r * (segments + 1) + s + 1;
+      unsigned b = a + segments + 1;
+      std::snprintf(line, sizeof(line), "f %u/%u %u/%u %u/%u\nf %u/%u %u/%u %u/%u\n",
+                    a, a, b, b, a + 1, a + 1, a + 1, a + 1, b, b, b + 1, b + 1);
+      text += line;
+      triangles += 2;
+    }
+    file << text;
+    text.clear();
+  }
+  return triangles;
+}
+
+static tinyobj::mesh_t load_mesh(std::string const& path) {
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err = tinyobj::LoadObj(shapes, materials, path.c_str());
+  if (!err.empty() || shapes.empty()) {
+    throw std::logic_error("tinyobjloader: " + err);
+  }
+  return shapes.front().mesh;
+}
+
+static std::string default_resource_path(char const* exe) {
+  std::string exe_path{exe};
+  return exe_path.substr(0, exe_path.find_last_of("/\\")) + "/../../resources/";
+}
+
+int main(int argc, char* argv[]) {
+  std::string resource_path = default_resource_path(argv[0]);
+  std::string json_path{"framework_bench.json"};
+  std::string filter{};
+  unsigned repeats = 15;
+  unsigned warmup = 2;
+  unsigned large_triangles = 2000000;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg{argv[i]};
+    bool has_value = i + 1 < argc;
+    if (arg == "--resources" && has_value) {
+      resource_path = argv[++i];
+    }
+    else if (arg == "--json" && has_value) {
+      json_path = argv[++i];
+    }
+    else if (arg == "--filter" && has_value) {
+      filter = argv[++i];
+    }
+    else if (arg == "--repeat" && has_value) {
+      repeats = unsigned(std::max(1, std::atoi(argv[++i])));
+    }
+    else if (arg == "--warmup" && has_value) {
+      warmup = unsigned(std::max(0, std::atoi(argv[++i])));
+    }
+    else if (arg == "--large-triangles" && has_value) {
+      large_triangles = unsigned(std::max(8, std::atoi(argv[++i])));
+    }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--resources DIR] [--json FILE] [--filter TEXT] [--repeat N] [--warmup N]"
+                << " [--large-triangles N]" << std::endl;
+      return 1;
+    }
+  }
+
+  // inputs, synthetic meshes are removed again at the end
+  std::string small_obj = resource_path + "models/sphere.obj";
+  std::string medium_obj{"framework_bench_medium.obj"};
+  std::string large_obj{"framework_bench_large.obj"};
+  std::size_t medium_triangles = write_sphere_obj(medium_obj, 256, 256);
+  unsigned large_rings = unsigned(std::max(2.0, std::sqrt(double(large_triangles) / 4.0)));
+  large_triangles = unsigned(write_sphere_obj(large_obj, large_rings, large_rings * 2));
+
+  tinyobj::mesh_t medium_mesh = load_mesh(medium_obj);
+  tinyobj::mesh_t large_mesh = load_mesh(large_obj);
+  model_loader::generate_normals(medium_mesh);
+  model_loader::generate_normals(large_mesh);
+
+  model::attrib_flag_t all_attribs = model::NORMAL | model::TEXCOORD | model::TANGENT;
+  model medium_model = model_loader::obj(medium_obj, all_attribs);
+  model large_model = model_loader::obj(large_obj, all_attribs);
+
+  // transforms of bodies spread around the origin, one camera
+  std::vector<glm::fmat4> bodies(1 << 16);
+  for (std::size_t i = 0; i < bodies.size(); ++i) {
+    float angle = float(i) * 0.01f;
+    bodies[i] = glm::scale(glm::rotate(glm::translate(glm::fmat4{}, glm::fvec3{std::cos(angle), 0.0f, std::sin(angle)} * float(i % 100)),
+                                       angle, glm::fvec3{0.0f, 1.0f, 0.0f}), glm::fvec3{0.5f});
+  }
+  glm::fmat4 view_transform = glm::rotate(glm::translate(glm::fmat4{}, glm::fvec3{0.0f, 0.0f, 10.0f}), glm::radians(-10.0f), glm::fvec3{1.0f, 0.0f, 0.0f});
+  std::vector<glm::fmat4> normal_matrices(bodies.size());
+  std::vector<glm::fvec3> sun_positions(bodies.size());
+
+  // local transforms of a flat scene under one parent, composed per frame
+  transform_set locals{};
+  for (std::size_t i = 0; i < 100000; ++i) {
+    float angle = float(i) * 0.01f;
+    locals.add(transform_state{glm::fvec3{std::cos(angle), 0.0f, std::sin(angle)} * float(i % 100),
+                               glm::angleAxis(angle, glm::fvec3{0.0f, 1.0f, 0.0f}), glm::fvec3{0.5f}});
+  }
+  glm::fmat4 view_matrix = glm::inverse(view_transform);
+  std::vector<glm::fmat4> worlds{};
+  std::vector<glm::fmat4> model_views{};
+  std::vector<glm::fmat4> normals{};
+
+  // point lights in view space filling the frustum, binned with the app's grid
+  cluster_grid grid{16, 9, 24, 0.1f, 100.0f};
+  cluster_volumes volumes = clustering::volumes(grid, glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f));
+  sphere_set lights{};
+  for (std::size_t i = 0; i < 10000; ++i) {
+    float t = float(i) * 0.618034f;
+    glm::fvec3 center{(t - std::floor(t)) * 80.0f - 40.0f, std::sin(float(i)) * 20.0f, -float(i % 97) * 0.5f - 1.0f};
+    lights.add(center, 1.0f + float(i % 5) * 0.5f);
+  }
+  light_clusters clusters{};
+
+  // unit boxes scattered through a cube holding about one per 1000 units of volume,
+  // queried from the center by rays, spheres and a frustum; trees hold the first
+  // boxes and are built when a workload using them is prepared
+  std::vector<glm::fvec3> scattered(1 << 20);
+  for (std::size_t i = 0; i < scattered.size(); ++i) {
+    float a = float(i) * 0.618034f;
+    float b = float(i) * 0.754878f;
+    float c = float(i) * 0.569840f;
+    scattered[i] = glm::fvec3{a - std::floor(a), b - std::floor(b), c - std::floor(c)} * 1000.0f - 500.0f;
+  }
+  std::vector<std::pair<std::string, std::size_t>> tree_sizes{{"1K", 1000}, {"10K", 10000}, {"100K", 100000}, {"1M", scattered.size()}};
+  std::vector<std::unique_ptr<aabb_tree>> trees(tree_sizes.size());
+  auto tree = [&](std::size_t t) -> aabb_tree& {
+    if (!trees[t]) {
+      trees[t].reset(new aabb_tree{0.1f});
+      for (std::size_t i = 0; i < tree_sizes[t].second; ++i) {
+        trees[t]->add(scattered[i] - 0.5f, scattered[i] + 0.5f);
+      }
+      trees[t]->build();
+    }
+    return *trees[t];
+  };
+  std::vector<ray> rays{};
+  for (std::size_t i = 0; i < 1000; ++i) {
+    float angle = float(i) * 2.399963f;
+    float height = float(i) / 500.0f - 1.0f;
+    float ring = std::sqrt(1.0f - height * height);
+    rays.push_back(ray{glm::fvec3{0.0f}, glm::fvec3{ring * std::cos(angle), height, ring * std::sin(angle)}, 1000.0f});
+  }
+  frustum tree_view{glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f)};
+  std::vector<aabb_tree::object> found{};
+  std::vector<ray_hit> ray_hits{};
+  float drift = 0.0f;
+
+  // rays from a shell around the large sphere towards points near its center, nearly all hit
+  mesh_bvh large_bvh{large_model};
+  std::vector<ray> mesh_rays(1 << 20);
+  for (std::size_t i = 0; i < mesh_rays.size(); ++i) {
+    float angle = float(i) * 2.399963f;
+    float height = float(i) / float(mesh_rays.size() / 2) - 1.0f;
+    float ring = std::sqrt(1.0f - height * height);
+    glm::fvec3 origin = glm::fvec3{ring * std::cos(angle), height, ring * std::sin(angle)} * 3.0f;
+    float a = float(i) * 0.754878f;
+    float b = float(i) * 0.569840f;
+    glm::fvec3 target{a - std::floor(a) - 0.5f, b - std::floor(b) - 0.5f, 0.0f};
+    mesh_rays[i] = ray{origin, target - origin, std::numeric_limits<float>::infinity()};
+  }
+  std::vector<ray> mesh_rays_64k{mesh_rays.begin(), mesh_rays.begin() + (1 << 16)};
+  // rays through the pixels of a 256x256 view onto the sphere, neighbours take similar paths
+  std::vector<ray> camera_rays{};
+  for (unsigned y = 0; y < 256; ++y) {
+    for (unsigned x = 0; x < 256; ++x) {
+      glm::fvec3 direction{float(x) / 256.0f - 0.5f, float(y) / 256.0f - 0.5f, -1.0f};
+      camera_rays.push_back(ray{glm::fvec3{0.0f, 0.0f, 3.0f}, direction, std::numeric_limits<float>::infinity()});
+    }
+  }
+  std::vector<mesh_hit> mesh_hits{};
+
+  std::string medium = " (" + std::to_string(medium_triangles / 1000) + "K tris)";
+  std::string large = " (" + std::to_string(large_triangles / 1000) + "K tris)";
+  std::vector<workload> workloads{
+    {"model_loader::obj small (sphere.obj)", [&]() {
+      model m = model_loader::obj(small_obj, all_attribs);
+      bench::consume(m.data.data());
+    }, false},
+    {"model_loader::obj medium" + medium, [&]() {
+      model m = model_loader::obj(medium_obj, all_attribs);
+      bench::consume(m.data.data());
+    }, true},
+    {"model_loader::obj large" + large, [&]() {
+      model m = model_loader::obj(large_obj, all_attribs);
+      bench::consume(m.data.data());
+    }, true},
+    // the planet sphere, generated instead of loaded
+    {"sphere_geometry::uv_sphere 32x64 (4K tris)", [&]() {
+      model m = sphere_geometry::uv_sphere(32, 64, all_attribs);
+      bench::consume(m.data.data());
+    }, false},
+    {"sphere_geometry::uv_sphere 256x512 (261K tris)", [&]() {
+      model m = sphere_geometry::uv_sphere(256, 512, all_attribs);
+      bench::consume(m.data.data());
+    }, true},
+    {"sphere_geometry::icosphere level 4 (5K tris)", [&]() {
+      model m = sphere_geometry::icosphere(4, all_attribs);
+      bench::consume(m.data.data());
+    }, false},
+    {"optimize_vertex_cache medium" + medium, [&]() {
+      std::vector<GLuint> indices = medium_model.indices;
+      sphere_geometry::optimize_vertex_cache(indices, medium_model.vertex_num);
+      bench::consume(indices.data());
+    }, true},
+    {"generate_normals medium" + medium, [&]() {
+      model_loader::generate_normals(medium_mesh);
+      bench::consume(medium_mesh.normals.data());
+    }, false},
+    {"generate_normals large" + large, [&]() {
+      model_loader::generate_normals(large_mesh);
+      bench::consume(large_mesh.normals.data());
+    }, true},
+    {"generate_tangents medium" + medium, [&]() {
+      std::vector<glm::fvec3> tangents = model_loader::generate_tangents(medium_mesh);
+      bench::consume(tangents.data());
+    }, false},
+    {"generate_tangents large" + large, [&]() {
+      std::vector<glm::fvec3> tangents = model_loader::generate_tangents(large_mesh);
+      bench::consume(tangents.data());
+    }, true},
+    {"model constructor large" + large, [&]() {
+      model m{large_model.data, all_attribs, large_model.indices};
+      bench::consume(m.data.data());
+    }, false},
+    {"texture_loader::file earth.png", [&]() {
+      pixel_data texture = texture_loader::file(resource_path + "textures/earth.png");
+      bench::consume(texture.ptr());
+    }, false},
+    {"texture_loader::file stars.png", [&]() {
+      pixel_data texture = texture_loader::file(resource_path + "textures/stars.png");
+      bench::consume(texture.ptr());
+    }, true},
+    {"utils::read_file sphere.obj", [&]() {
+      std::string text = utils::read_file(small_obj);
+      bench::consume(text.data());
+    }, false},
+    {"utils::read_file large" + large, [&]() {
+      std::string text = utils::read_file(large_obj);
+      bench::consume(text.data());
+    }, false},
+    {"clustering::assign (10K lights, 16x9x24 clusters)", [&]() {
+      clustering::assign(grid, volumes, lights, clusters);
+      bench::consume(clusters.indices.data());
+    }, false},
+    {"mesh_bvh build large" + large, [&]() {
+      mesh_bvh bvh{large_model};
+      bench::consume(&bvh);
+    }, true},
+    // traced as jobs on all cores
+    {"mesh_bvh::intersect 1M rays large" + large, [&]() {
+      std::size_t hit = large_bvh.intersect(mesh_rays, mesh_hits);
+      bench::consume(&hit);
+    }, true},
+    {"mesh_bvh::intersect 64K rays one thread large" + large, [&]() {
+      mesh_hits.resize(mesh_rays_64k.size());
+      for (std::size_t i = 0; i < mesh_rays_64k.size(); ++i) {
+        large_bvh.intersect(mesh_rays_64k[i], mesh_hits[i]);
+      }
+      bench::consume(mesh_hits.data());
+    }, false},
+    {"mesh_bvh::intersect 256x256 camera rays one thread large" + large, [&]() {
+      mesh_hits.resize(camera_rays.size());
+      for (std::size_t i = 0; i < camera_rays.size(); ++i) {
+        large_bvh.intersect(camera_rays[i], mesh_hits[i]);
+      }
+      bench::consume(mesh_hits.data());
+    }, false},
+    {"mesh_bvh::occluded 64K rays one thread large" + large, [&]() {
+      std::size_t blocked = 0;
+      for (ray const& r : mesh_rays_64k) {
+        blocked += large_bvh.occluded(r) ? 1 : 0;
+      }
+      bench::consume(&blocked);
+    }, false},
+    // as upload_planet_transforms computes them for every drawn body
+    {"planet matrices (64K bodies)", [&]() {
+      for (std::size_t i = 0; i < bodies.size(); ++i) {
+        normal_matrices[i] = glm::inverseTranspose(glm::inverse(view_transform) * bodies[i]);
+        // recomputed per body like the app does, instead of the outer view_matrix
+        glm::fmat4 body_view_matrix = glm::inverse(view_transform);
+        sun_positions[i] = glm::fvec3{body_view_matrix * glm::fvec4{0.0f, 0.0f, 0.0f, 1.0f}};
+      }
+      bench::consume(normal_matrices.data());
+    }, false},
+    {"transforms::view_matrices (64K bodies)", [&]() {
+      transforms::view_matrices(view_matrix, bodies.data(), bodies.size(), nullptr, normal_matrices.data());
+      bench::consume(normal_matrices.data());
+    }, false},
+    {"transforms::compose (100K objects)", [&]() {
+      transforms::compose(locals, glm::fmat4{}, view_matrix, worlds, model_views, normals);
+      bench::consume(normals.data());
+    }, false},
+  };
+  // every tree workload at every object count
+  for (std::size_t t = 0; t < tree_sizes.size(); ++t) {
+    std::string count = " (" + tree_sizes[t].first + " objects)";
+    bool heavy = tree_sizes[t].second >= scattered.size();
+    std::function<void()> prepare = [&tree, t]() {
+      tree(t);
+    };
+    workloads.push_back(workload{"aabb_tree::build" + count, [&tree, t]() {
+      aabb_tree& boxes = tree(t);
+      boxes.build();
+      bench::consume(&boxes);
+    }, heavy, prepare});
+    // every object moves a little, some leave their enlarged boxes
+    workloads.push_back(workload{"aabb_tree::move and refit" + count, [&, t]() {
+      aabb_tree& boxes = tree(t);
+      drift = drift > 0.0f ? -0.15f : 0.15f;
+      for (aabb_tree::object o = 0; o < tree_sizes[t].second; ++o) {
+        glm::fvec3 offset{(o & 1) ? drift : 0.0f, 0.0f, 0.0f};
+        boxes.move(o, scattered[o] - 0.5f + offset, scattered[o] + 0.5f + offset);
+      }
+      std::size_t refit = boxes.refit();
+      bench::consume(&refit);
+    }, heavy, prepare});
+    workloads.push_back(workload{"aabb_tree::query 1K rays" + count, [&, t]() {
+      aabb_tree const& boxes = tree(t);
+      for (ray const& r : rays) {
+        boxes.query(r, ray_hits);
+      }
+      bench::consume(ray_hits.data());
+    }, false, prepare});
+    workloads.push_back(workload{"aabb_tree::query 1K spheres r=20" + count, [&, t]() {
+      aabb_tree const& boxes = tree(t);
+      for (ray const& r : rays) {
+        boxes.query(r.direction * 200.0f, 20.0f, found);
+      }
+      bench::consume(found.data());
+    }, false, prepare});
+    workloads.push_back(workload{"aabb_tree::query frustum" + count, [&, t]() {
+      tree(t).query(tree_view, found);
+      bench::consume(found.data());
+    }, false, prepare});
+  }
+
+  std::vector<bench::result> results{};
+  for (workload const& w : workloads) {
+    if (!filter.empty() && w.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (w.prepare) {
+      w.prepare();
+    }
+    unsigned reps = w.heavy ? std::max(1u, repeats / 3) : repeats;
+    results.push_back(bench::measure(w.name, w.run, w.heavy ? std::min(warmup, 1u) : warmup, reps));
+    bench::print(results.back());
+  }
+
+  std::remove(medium_obj.c_str());
+  std::remove(large_obj.c_str());
+
+  std::vector<std::pair<std::string, std::string>> context{
+    {"resources", resource_path},
+    {"repeat", std::to_string(repeats)},
+    {"warmup", std::to_string(warmup)},
+    {"large_triangles", std::to_string(large_triangles)},
+  };
+  bench::write_json(json_path, context, results);
+  std::cout << "Wrote " << results.size() << " results to " << json_path << std::endl;
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "harness.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+static std::atomic<std::size_t> s_allocations{0};
+static std::atomic<std::size_t> s_allocated_bytes{0};
+static void const* volatile s_sink = nullptr;
+
+// replacing the global allocation functions counts every allocation of the
+// executable, including those inside the standard library
+void* operator new(std::size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size > 0 ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+
+namespace bench {
+
+std::size_t allocation_count() {
+  return s_allocations.load(std::memory_order_relaxed);
+}
+
+std::size_t allocated_bytes() {
+  return s_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+result measure(std::string const& name, std::function<void()> const& fn, unsigned warmup, unsigned repetitions) {
+  repetitions = std::max(1u, repetitions);
+  for (unsigned i = 0; i < warmup; ++i) {
+    fn();
+  }
+
+  std::vector<double> times{};
+  times.reserve(repetitions);
+  std::size_t allocations = allocation_count();
+  std::size_t bytes = allocated_bytes();
+  for (unsigned i = 0; i < repetitions; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  // the time vector was reserved, so only fn allocated
+  allocations = allocation_count() - allocations;
+  bytes = allocated_bytes() - bytes;
+
+  std::sort(times.begin(), times.end());
+  double sum = 0.0;
+  for (double time : times) {
+    sum += time;
+  }
+
+  result r{};
+  r.name = name;
+  r.repetitions = repetitions;
+  r.min_ms = times.front();
+  r.median_ms = utils::percentile(times, 0.5);
+  r.p99_ms = utils::percentile(times, 0.99);
+  r.mean_ms = sum / double(times.size());
+  r.allocations = double(allocations) / double(repetitions);
+  r.allocated_bytes = double(bytes) / double(repetitions);
+  return r;
+}
+
+void consume(void const* value) {
+  s_sink = value;
+}
+
+void print(result const& r) {
+  std::cout << std::left << std::setw(44) << r.name << std::right << std::fixed << std::setprecision(3)
+            << " median " << std::setw(10) << r.median_ms << " ms"
+            << "  p99 " << std::setw(10) << r.p99_ms << " ms"
+            << std::setprecision(0) << "  allocs " << std::setw(9) << r.allocations
+            << "  bytes " << std::setw(11) << r.allocated_bytes << std::endl;
+}
+
+void write_json(std::string const& path, std::vector<std::pair<std::string, std::string>> const& context, std::vector<result> const& results) {
+  std::ofstream file{path};
+  if (!file) {
+    std::cerr << "File \'" << path << "\' could not be written" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  file << std::fixed << std::setprecision(4) << "{\n  \"context\": {";
+  for (std::size_t i = 0; i < context.size(); ++i) {
+    file << (i > 0 ? "," : "") << "\n    " << utils::json_quoted(context[i].first) << ": " << utils::json_quoted(context[i].second);
+  }
+  file << "\n  },\n  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    result const& r = results[i];
+    file << (i > 0 ? "," : "") << "\n    {\"name\": " << utils::json_quoted(r.name)
+         << ", \"repetitions\": " << r.repetitions
+         << ", \"min_ms\": " << r.min_ms
+         << ", \"median_ms\": " << r.median_ms
+         << ", \"p99_ms\": " << r.p99_ms
+         << ", \"mean_ms\": " << r.mean_ms
+         << ", \"allocations\": " << r.allocations
+         << ", \"allocated_bytes\": " << r.allocated_bytes << "}";
+  }
+  file << "\n  ]\n}\n";
+}
+
+};
@@ -0,0 +1,39 @@
+#ifndef BENCH_HARNESS_HPP
+#define BENCH_HARNESS_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// minimal benchmark harness: runs a function after warmup calls, times every
+// repetition and counts heap allocations through the global operator new
+namespace bench {
+  struct result {
+    std::string name;
+    unsigned repetitions;
+    double min_ms;
+    double median_ms;
+    double p99_ms;
+    double mean_ms;
+    // per repetition
+    double allocations;
+    double allocated_bytes;
+  };
+
+  // allocations since program start, counted on all threads
+  std::size_t allocation_count();
+  std::size_t allocated_bytes();
+
+  result measure(std::string const& name, std::function<void()> const& fn, unsigned warmup, unsigned repetitions);
+
+  // keep a computed value alive so the work producing it is not optimized away
+  void consume(void const* value);
+
+  // one line per result
+  void print(result const& r);
+  // array of results with the given context fields, throws if the file cannot be written
+  void write_json(std::string const& path, std::vector<std::pair<std::string, std::string>> const& context, std::vector<result> const& results);
+}
+
+#endif
@@ -0,0 +1,157 @@
+// scaling of the job system and the framework systems built on it,
+// every workload runs with 1 to N threads and reports the median time
+#include "jobs.hpp"
+#include "scene_graph.hpp"
+#include "star_field.hpp"
+#include "frustum_culling.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct workload {
+  std::string name;
+  std::function<void()> run;
+};
+
+static double median_ms(std::function<void()> const& fn, unsigned repeats) {
+  std::vector<double> times{};
+  for (unsigned i = 0; i < repeats; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+// arithmetic heavy enough per element that scaling is not memory bound
+static float kernel(std::size_t i) {
+  float x = float(i % 1024) * 0.001f;
+  for (unsigned k = 0; k < 8; ++k) {
+    x = std::sin(x) * 0.5f + std::cos(x * 1.5f);
+  }
+  return x;
+}
+
+int main(int argc, char* argv[]) {
+  unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+  unsigned repeats = 7;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg{argv[i]};
+    if (arg == "--threads" && i + 1 < argc) {
+      max_threads = unsigned(std::max(1, std::atoi(argv[++i])));
+    }
+    else if (arg == "--repeat" && i + 1 < argc) {
+      repeats = unsigned(std::max(1, std::atoi(argv[++i])));
+    }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--threads N] [--repeat N]" << std::endl;
+      return 1;
+    }
+  }
+
+  // shared inputs, built once
+  std::vector<float> values(1 << 20);
+
+  scene_graph graph{};
+  std::vector<scene_graph::node> roots{};
+  for (unsigned r = 0; r < 256; ++r) {
+    scene_graph::node root = graph.add(scene_graph::NONE);
+    roots.push_back(root);
+    for (unsigned c = 0; c < 255; ++c) {
+      scene_graph::node child = graph.add(root);
+      graph.set_translation(child, glm::fvec3{float(c), 0.0f, 0.0f});
+    }
+  }
+  graph.update(1);
+
+  sphere_set spheres{};
+  for (std::size_t i = 0; i < (1 << 21); ++i) {
+    spheres.add(glm::fvec3{float(i % 1000) - 500.0f, float(i / 1000 % 1000) - 500.0f, float(i / 1000000) * 10.0f}, 1.0f);
+  }
+  frustum view{glm::perspective(1.0f, 1.5f, 0.1f, 800.0f)};
+  std::vector<unsigned> visible{};
+
+  std::vector<workload> workloads{
+    {"parallel_for coarse (1M, grain 16K)", [&]() {
+      jobs::parallel_for(0, values.size(), 1 << 14, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          values[i] = kernel(i);
+        }
+      });
+    }},
+    {"parallel_for fine (1M, grain 64)", [&]() {
+      jobs::parallel_for(0, std::size_t(1) << 20, 64, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          values[i] = float(i) * 0.5f;
+        }
+      });
+    }},
+    {"dependency fan-out/in (64 x 256 jobs)", [&]() {
+      // every stage runs after the previous one finished
+      std::vector<jobs::counter> stages(64);
+      std::atomic<unsigned> sum{0};
+      for (std::size_t s = 0; s < stages.size(); ++s) {
+        for (unsigned j = 0; j < 256; ++j) {
+          auto fn = [&sum, j]() {
+            float x = kernel(j);
+            sum.fetch_add(x > 0.0f ? 1u : 0u, std::memory_order_relaxed);
+          };
+          if (s == 0) {
+            jobs::run(fn, &stages[s]);
+          }
+          else {
+            jobs::run_after(stages[s - 1], fn, &stages[s]);
+          }
+        }
+      }
+      // earlier counters are referenced until their dependents were queued
+      for (auto& stage : stages) {
+        jobs::wait(stage);
+      }
+    }},
+    {"star_generator (1M stars)", [&]() {
+      star_generator::generate(1 << 20, 7, 100.0f, 16);
+    }},
+    {"scene_graph update (64K nodes)", [&]() {
+      for (scene_graph::node root : roots) {
+        graph.set_translation(root, glm::fvec3{1.0f, 2.0f, 3.0f});
+      }
+      graph.update();
+    }},
+    {"frustum cull (2M spheres)", [&]() {
+      culling::cull(view, spheres, visible);
+    }},
+  };
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::vector<double> single(workloads.size(), 0.0);
+  for (unsigned threads = 1; threads <= max_threads; ++threads) {
+    jobs::start(threads);
+    std::cout << "threads " << threads << std::endl;
+    for (std::size_t w = 0; w < workloads.size(); ++w) {
+      // warm caches and wake workers
+      workloads[w].run();
+      double ms = median_ms(workloads[w].run, repeats);
+      if (threads == 1) {
+        single[w] = ms;
+      }
+      std::cout << "  " << std::left << std::setw(40) << workloads[w].name << std::right
+                << std::setw(10) << ms << " ms" << std::setw(8) << single[w] / ms << "x" << std::endl;
+    }
+  }
+  jobs::stop();
+  return 0;
+}
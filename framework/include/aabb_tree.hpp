@@ -0,0 +1,119 @@
+#ifndef AABB_TREE_HPP
+#define AABB_TREE_HPP
+
+#include "frustum_culling.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// half line from origin, direction need not be normalized, distances are in its units
+struct ray {
+  ray();
+  ray(glm::fvec3 const& origin, glm::fvec3 const& direction, float max_distance);
+
+  glm::fvec3 origin;
+  glm::fvec3 direction;
+  float max_distance;
+};
+
+// object whose box a ray enters, at the distance it enters
+struct ray_hit {
+  unsigned object;
+  float distance;
+};
+
+// dynamic bounding volume hierarchy over axis aligned boxes of moving objects;
+// nodes have up to eight children stored in structure-of-arrays layout, so one
+// traversal step tests all child boxes at once with avx, two sse halves or scalar code.
+// objects sit directly in the child slots of nodes, their slot box is enlarged by
+// a margin so small movements leave the tree untouched; moving further grows the
+// ancestors right away, refit() shrinks them again and build() rebuilds the tree
+// once many insertions have made it deep
+class aabb_tree {
+ public:
+  // stable object handle, handles of removed objects are reused
+  typedef unsigned object;
+  static const object NONE = ~0u;
+  // children per node
+  static const unsigned WIDTH = 8;
+
+  explicit aabb_tree(float margin = 0.0f);
+
+  // insert object below the node whose boxes grow least
+  object add(glm::fvec3 const& min, glm::fvec3 const& max);
+  void remove(object o);
+  // update bounds, ancestors are grown at once so queries stay correct
+  void move(object o, glm::fvec3 const& min, glm::fvec3 const& max);
+  // shrink boxes of nodes above moved and removed objects, returns refit node count
+  std::size_t refit();
+  // rebuild all nodes top-down from the current objects
+  void build();
+  void clear();
+
+  glm::fvec3 const& min(object o) const;
+  glm::fvec3 const& max(object o) const;
+  std::size_t size() const;
+  std::size_t nodes() const;
+  // levels below the root down to the deepest node
+  std::size_t depth() const;
+
+  // write objects whose boxes intersect the query to out, return count; order follows the tree
+  std::size_t query(glm::fvec3 const& center, float radius, std::vector<object>& out) const;
+  std::size_t query(frustum const& view, std::vector<object>& out) const;
+  // objects whose boxes the ray enters within its max distance, nearest entry first
+  std::size_t query(ray const& r, std::vector<ray_hit>& out) const;
+
+ private:
+  // child slots in structure-of-arrays layout, empty slots are not in the used mask
+  struct node {
+    // min x, y, z then max x, y, z of every slot
+    float bounds[6][WIDTH];
+    // node index or object handle with LEAF set
+    unsigned children[WIDTH];
+    unsigned parent;
+    unsigned parent_slot;
+    std::uint8_t used;
+    // a descendant needs refitting
+    std::uint8_t dirty;
+  };
+  static const unsigned LEAF = 1u << 31;
+
+  unsigned allocate_node(unsigned parent, unsigned parent_slot);
+  void set_slot(unsigned n, unsigned slot, glm::fvec3 const& min, glm::fvec3 const& max, unsigned child);
+  void clear_slot(unsigned n, unsigned slot);
+  // union of a node's used slots
+  void bounds(unsigned n, glm::fvec3& min, glm::fvec3& max) const;
+  // grow slot boxes on the path to the root until one already contains the box
+  void grow_ancestors(unsigned n, glm::fvec3 const& min, glm::fvec3 const& max);
+  void mark_dirty(unsigned n);
+  // refit dirty subtree below n
+  std::size_t refit_node(unsigned n);
+  // node over objects [begin, end) of m_build_objects
+  unsigned build_node(unsigned parent, unsigned parent_slot, std::size_t begin, std::size_t end);
+
+  float m_margin;
+  std::vector<node> m_nodes;
+  std::vector<unsigned> m_free_nodes;
+  unsigned m_root;
+
+  // per object handle
+  std::vector<glm::fvec3> m_mins;
+  std::vector<glm::fvec3> m_maxs;
+  // node and slot holding the object, NONE for free handles
+  std::vector<unsigned> m_nodes_of;
+  std::vector<unsigned> m_slots_of;
+  std::vector<object> m_free_objects;
+  std::size_t m_size;
+
+  // scratch for building, centers are kept next to handles so splitting stays in cache
+  struct build_entry {
+    glm::fvec3 center;
+    object handle;
+  };
+  std::vector<build_entry> m_build_objects;
+};
+
+#endif
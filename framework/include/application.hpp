@@ -6,6 +6,10 @@
 #include <glm/gtc/type_precision.hpp>
 
 #include <map>
+#include <string>
+#include <vector>
+
+class SoftwareRasterizer;
 
 // gpu representation of model
 class Application {
@@ -17,9 +21,17 @@ class Application {
 
   // update uniform locations and values
   inline virtual void uploadUniforms() {};
+  // update uniforms of a single program after it was rebuilt in the background,
+  // uploads everything by default
+  virtual void uploadProgramUniforms(std::string const& name);
   // update projection matrix
   void setProjection(glm::fmat4 const& projection_mat);
   virtual void updateProjection() = 0;
+  // replace camera transform, used for scripted camera paths
+  void setView(glm::fmat4 const& view_transform);
+  glm::fmat4 const& getViewTransform() const;
+  // react to changed camera transform
+  inline virtual void updateView() {};
   // react to key input
   inline virtual void keyCallback(int key, int scancode, int action, int mods) {};
   //handle delta mouse movement input
@@ -27,11 +39,22 @@ class Application {
 
   // give shader programs to launcher
   virtual std::map<std::string, shader_program>& getShaderPrograms();
+  // variant of a program with the features of mask enabled
+  shader_program const& getPermutation(std::string const& name, unsigned mask) const;
   // draw all objects
   virtual void render() const = 0;
+  // draw the frame last rendered with gl on the cpu, for reference images;
+  // draws nothing unless the application supports it
+  inline virtual void renderSoftware(SoftwareRasterizer& target) const {};
+  // block until assets requested by the last frame are loaded, for reproducible images
+  inline virtual void finishLoading() {};
 
  protected:
   void updateUniformLocations();
+  void updateUniformLocations(shader_program& program);
+  // add a variant of program name for every combination of flags, bit i of a
+  // mask sets flags[i] to 1; must be called before the programs are built
+  void addPermutations(std::string const& name, std::vector<std::string> const& flags);
 
   std::string m_resource_path; 
 
@@ -40,6 +63,8 @@ class Application {
 
   // container for the shader programs
   std::map<std::string, shader_program> m_shaders{};
+  // variants of programs with permutations, indexed by feature mask
+  std::map<std::string, std::vector<shader_program*>> m_permutations{};
 };
 
 #endif
\ No newline at end of file
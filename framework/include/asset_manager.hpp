@@ -0,0 +1,144 @@
+#ifndef ASSET_MANAGER_HPP
+#define ASSET_MANAGER_HPP
+
+#include "model.hpp"
+#include "pixel_data.hpp"
+#include "structs.hpp"
+
+#include "jobs.hpp"
+
+#include <glbinding/gl/types.h>
+#include <glbinding/gl/enum.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// textures and meshes loaded on demand; assets are registered up front and
+// requested every frame they are needed with a priority, e.g. their size on
+// screen. update starts loading the most important requests as jobs and
+// uploads finished ones, until then a placeholder is drawn. resident assets
+// that were not requested recently or matter less are evicted to stay within
+// the gpu budget of memory_accounting and the manager's own budget.
+// all functions must be called on the gl thread
+class AssetManager {
+ public:
+  typedef unsigned handle;
+  static const handle NONE = 0xffffffffu;
+
+  // budget of streamed assets in bytes, 0 for none;
+  // at most uploads_per_frame finished loads are uploaded per update
+  explicit AssetManager(std::size_t budget = 0, unsigned uploads_per_frame = 2);
+  // waits for loads in flight
+  ~AssetManager();
+
+  // rgb image file, a 1x1 texture of the colour is bound until it is resident
+  handle texture(std::string const& path, glm::fvec3 const& placeholder_colour, std::string const& name);
+  // mesh uploaded right away and never evicted, for placeholders
+  handle mesh(model const& data, GLenum draw_mode, std::string const& name);
+  // mesh created by load on a job, the placeholder mesh is drawn until it is resident, or nothing for NONE
+  handle mesh(std::function<model()> const& load, handle placeholder, GLenum draw_mode, std::string const& name);
+
+  // asset is needed for the next frame, the highest priority of a frame counts
+  void request(handle asset, float priority);
+  // upload finished loads, evict and start loading the requests of this frame by priority
+  void update();
+  // load and upload every asset requested before the last update that fits the budget
+  void finish();
+
+  void set_budget(std::size_t bytes);
+  std::size_t budget() const;
+  // gpu memory of resident streamed assets
+  std::size_t resident_bytes() const;
+
+  bool resident(handle asset) const;
+  // the texture or its placeholder
+  GLuint texture_name(handle asset) const;
+  // the mesh or its placeholder, num_elements is 0 if neither is resident;
+  // indexed meshes are drawn with glDrawElements, others with glDrawArrays
+  model_object const& mesh_object(handle asset) const;
+  // cpu copy of the vertices drawn by mesh_object
+  model const& mesh_data(handle asset) const;
+
+ private:
+  AssetManager(AssetManager const&);
+  AssetManager& operator=(AssetManager const&);
+
+  enum asset_type {
+    TEXTURE,
+    MESH
+  };
+
+  enum asset_state {
+    UNLOADED,
+    LOADING,
+    // loaded on the cpu, waiting for upload
+    LOADED,
+    RESIDENT,
+    FAILED
+  };
+
+  struct asset {
+    asset_type type;
+    std::string name;
+    std::string path;
+    std::function<model()> load;
+    handle placeholder;
+    GLuint placeholder_texture;
+    GLenum draw_mode;
+    // uploaded at registration and never evicted
+    bool pinned;
+
+    asset_state state;
+    // written by the loading job
+    pixel_data pixels;
+    model data;
+
+    GLuint texture;
+    model_object object;
+    // gpu memory when resident, 0 until first uploaded
+    std::size_t bytes;
+    float priority;
+    std::uint64_t last_request;
+  };
+
+  // order for loading and eviction, recently requested and higher priority first
+  bool more_important(asset const& a, asset const& b) const;
+  // load on the calling thread, also used by jobs
+  void load(asset& a, handle h);
+  void upload(handle h);
+  // evict less important assets until bytes fit, false if impossible
+  bool make_room(handle h, std::size_t bytes, bool check_only);
+  void evict(handle h);
+  // finished jobs to loaded state
+  void collect();
+  void upload_mesh(asset& a);
+  bool requested(asset const& a) const;
+
+  std::deque<asset> m_assets;
+  std::size_t m_budget;
+  std::size_t m_resident_bytes;
+  unsigned m_uploads_per_frame;
+  // requests since the last update belong to this frame
+  std::uint64_t m_frame;
+
+  // loads in flight and their results, filled by the jobs
+  jobs::counter m_jobs;
+  std::mutex m_mutex;
+  std::vector<std::pair<handle, bool>> m_finished;
+  unsigned m_in_flight;
+
+  model_object m_empty_object;
+  model m_empty_model;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CLUSTERED_LIGHTING_HPP
+#define CLUSTERED_LIGHTING_HPP
+
+#include "light_clustering.hpp"
+#include "frustum_culling.hpp"
+
+#include <glbinding/gl/types.h>
+#include <glbinding/gl/enum.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// point lights for clustered forward shading; every frame the lights in view
+// are binned into the froxels of a cluster_grid and uploaded to texture buffers,
+// so fragments only shade the lights of their own cluster:
+// - light data, two rgba32f texels per light: view position and radius, colour
+// - cluster lights, r32ui: first index and count per cluster, then the indices
+//   relative to the start of the buffer
+class ClusteredLighting {
+ public:
+  // needs current context
+  explicit ClusteredLighting(cluster_grid const& grid);
+  ~ClusteredLighting();
+
+  // cull and bin lights for the camera and upload the buffers
+  void update(std::vector<point_light> const& lights, glm::fmat4 const& view, glm::fmat4 const& projection, glm::uvec2 const& viewport);
+  // bind the light data and cluster lights texture buffers
+  void bind(unsigned light_unit, unsigned cluster_unit) const;
+
+  cluster_grid const& grid() const;
+  // tiles per pixel of the viewport last updated with
+  glm::fvec2 tile_scale() const;
+  // binning of the last update, light indices refer to the lights in view
+  light_clusters const& clusters() const;
+  std::size_t visible_lights() const;
+
+ private:
+  ClusteredLighting(ClusteredLighting const&);
+  ClusteredLighting& operator=(ClusteredLighting const&);
+
+  cluster_grid m_grid;
+  glm::fmat4 m_projection;
+  cluster_volumes m_volumes;
+  glm::fvec2 m_tile_scale;
+
+  // view space spheres of all lights, then of those in view
+  sphere_set m_view_lights;
+  sphere_set m_visible;
+  std::vector<unsigned> m_visible_ids;
+  light_clusters m_clusters;
+  // contents of the buffers
+  std::vector<glm::fvec4> m_light_data;
+  std::vector<unsigned> m_cluster_data;
+
+  GLuint m_light_buffer;
+  GLuint m_light_texture;
+  GLuint m_cluster_buffer;
+  GLuint m_cluster_texture;
+  std::size_t m_light_capacity;
+  std::size_t m_cluster_capacity;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// reports modified files without blocking, uses inotify on linux and
+// compares modification times elsewhere; directories are watched instead of
+// the files themselves so editors that save by replacing the file are seen
+class FileWatcher {
+ public:
+  FileWatcher();
+  ~FileWatcher();
+
+  // start watching a file, it does not need to exist yet
+  void watch(std::string const& path);
+  // watched files changed since the last call, each reported once
+  std::vector<std::string> poll();
+
+ private:
+  FileWatcher(FileWatcher const&);
+  FileWatcher& operator=(FileWatcher const&);
+
+  std::set<std::string> m_files;
+#ifdef __linux__
+  // inotify instance, -1 if unavailable
+  int m_fd;
+  // watched directory of every watch descriptor
+  std::map<int, std::string> m_directories;
+#else
+  // last seen modification time of every file
+  std::map<std::string, long long> m_times;
+  double m_last_check;
+#endif
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef FRUSTUM_CULLING_HPP
+#define FRUSTUM_CULLING_HPP
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// view frustum as six inward facing, normalized planes
+struct frustum {
+  frustum();
+  // extract planes from combined projection * view matrix
+  explicit frustum(glm::fmat4 const& view_projection);
+
+  // plane normal in xyz, signed distance in w
+  glm::fvec4 planes[6];
+};
+
+// bounding spheres in structure-of-arrays layout for simd testing
+struct sphere_set {
+  // append sphere, returns its index
+  std::size_t add(glm::fvec3 const& center, float radius);
+  // overwrite existing sphere
+  void set(std::size_t index, glm::fvec3 const& center, float radius);
+  void clear();
+  std::size_t size() const;
+
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> radius;
+};
+
+// axis aligned boxes in structure-of-arrays layout for simd testing
+struct box_set {
+  // append box, returns its index
+  std::size_t add(glm::fvec3 const& min, glm::fvec3 const& max);
+  // overwrite existing box
+  void set(std::size_t index, glm::fvec3 const& min, glm::fvec3 const& max);
+  void clear();
+  std::size_t size() const;
+
+  std::vector<float> min_x;
+  std::vector<float> min_y;
+  std::vector<float> min_z;
+  std::vector<float> max_x;
+  std::vector<float> max_y;
+  std::vector<float> max_z;
+};
+
+namespace culling {
+  // write indices of spheres intersecting the frustum to visible in ascending order, returns count
+  std::size_t cull(frustum const& view, sphere_set const& spheres, std::vector<unsigned>& visible);
+  // write indices of boxes intersecting the frustum to visible in ascending order, returns count
+  std::size_t cull(frustum const& view, box_set const& boxes, std::vector<unsigned>& visible);
+
+  // single volume tests for small object counts
+  bool intersects(frustum const& view, glm::fvec3 const& center, float radius);
+  bool intersects(frustum const& view, glm::fvec3 const& min, glm::fvec3 const& max);
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef GBUFFER_HPP
+#define GBUFFER_HPP
+
+#include "render_target_pool.hpp"
+
+#include <glbinding/gl/types.h>
+#include <glbinding/gl/enum.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+
+// geometry buffer for deferred shading, written once by the geometry pass and
+// read once by the lighting pass; per pixel it holds
+// - albedo in rgb and a material id in alpha, rgba8
+// - the octahedral encoded normal, each of its two coordinates stored with
+//   16 bits across two channels of an rgba8 texture
+// - depth, shared with the target drawn to afterwards, positions are
+//   reconstructed from it instead of being stored
+// colour attachments come from the pool each frame
+class GBuffer {
+ public:
+  // written per pixel by the geometry pass including depth
+  static const std::size_t MAX_BYTES_PER_PIXEL = 12;
+
+  // needs current context
+  explicit GBuffer(RenderTargetPool& pool);
+  ~GBuffer();
+
+  // acquire colour attachments of size and bind them with depth for the geometry pass
+  void bind(glm::uvec2 const& size, GLuint depth);
+  // bind albedo, normal and depth for sampling to unit and the two units after it
+  void bind_textures(unsigned unit) const;
+  // fullscreen triangle for the bound lighting program, generated from vertex ids
+  void draw_fullscreen() const;
+  // return colour attachments to the pool once lighting is done
+  void release();
+
+  // memory traffic of writing one pixel
+  static std::size_t bytes_per_pixel();
+
+ private:
+  GBuffer(GBuffer const&);
+  GBuffer& operator=(GBuffer const&);
+
+  RenderTargetPool& m_pool;
+  GLuint m_albedo;
+  GLuint m_normal;
+  GLuint m_depth;
+  GLuint m_vertex_array;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef GL_CAPTURE_HPP
+#define GL_CAPTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// records the gl calls of the rendering thread through glbinding callbacks into
+// a binary trace: every call with its parameters, the client memory it reads
+// (buffer and texture data, uniform values, shader sources) and frame markers;
+// the calls before end_setup create resources, the following ones are frames
+namespace gl_capture {
+  // start recording with the context current, replaces all glbinding callbacks
+  // until stop; throws if the file cannot be written
+  void start(std::string const& path, unsigned frames, unsigned width, unsigned height);
+  // separate resource creation from the first frame
+  void end_setup();
+  // called after each frame, stops after the requested number of frames
+  void end_frame();
+  // write remaining calls and restore the callback masks and after callback found
+  // by start, e.g. per call error checks; does nothing if inactive
+  void stop();
+  bool active();
+
+  // replays a trace against the current context as fast as possible;
+  // object names, uniform locations and mapped pointers are translated to the
+  // ones of the replaying driver, calls outside the recorded set are skipped
+  class player {
+   public:
+    // throws if the file cannot be read or is not a trace
+    explicit player(std::string const& path);
+
+    // dimensions of the capturing framebuffer
+    unsigned width() const;
+    unsigned height() const;
+    std::size_t num_frames() const;
+    std::size_t num_calls(std::size_t frame) const;
+
+    // replay resource creation once, before the first frame
+    void play_setup();
+    void play_frame(std::size_t frame);
+
+    // time spent per function, slowest first, and skipped calls
+    void print_calls(std::ostream& stream) const;
+
+   private:
+    struct call {
+      // function table index, or UNKNOWN with the index of the name
+      std::uint32_t function;
+      std::uint32_t name;
+      // offsets of the recorded values and data blocks
+      std::uint32_t arguments;
+      std::uint32_t blobs;
+    };
+    struct blob {
+      std::size_t offset;
+      std::size_t size;
+    };
+    struct timing {
+      std::uint64_t calls;
+      double milliseconds;
+    };
+    static const std::uint32_t UNKNOWN = 0xffffffffu;
+
+    void play(std::size_t begin, std::size_t end);
+    void play(call const& c);
+    std::uint32_t translate(char kind, std::int64_t name) const;
+
+    std::string m_data;
+    unsigned m_width;
+    unsigned m_height;
+
+    std::vector<call> m_calls;
+    std::vector<std::int64_t> m_arguments;
+    std::vector<blob> m_blobs;
+    // end of setup and of each frame in m_calls
+    std::size_t m_setup_end;
+    std::vector<std::size_t> m_frame_ends;
+    std::vector<std::string> m_unknown_names;
+
+    // recorded to replayed names per object kind
+    std::vector<std::unordered_map<std::uint32_t, std::uint32_t>> m_names;
+    // keyed by recorded program and recorded location or index
+    std::unordered_map<std::uint64_t, std::int64_t> m_locations;
+    std::unordered_map<std::uint64_t, std::int64_t> m_block_indices;
+    // replayed pointer per buffer target
+    std::unordered_map<std::int64_t, void*> m_mapped;
+    std::uint32_t m_current_program;
+    // output parameters and pointer arrays of the call in flight
+    std::vector<std::uint8_t> m_scratch;
+    std::vector<char const*> m_strings;
+
+    std::vector<timing> m_timings;
+    std::vector<std::uint64_t> m_skipped;
+  };
+}
+
+#endif
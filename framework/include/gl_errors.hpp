@@ -0,0 +1,31 @@
+#ifndef GL_ERRORS_HPP
+#define GL_ERRORS_HPP
+
+#include <string>
+
+// detection of opengl errors at selectable cost
+namespace gl_errors {
+  enum level {
+    // no checks
+    OFF,
+    // driver reports errors asynchronously through KHR_debug, close to free
+    DEBUG_OUTPUT,
+    // glGetError after every call, names the failing call and throws
+    PER_CALL
+  };
+
+  // parse "off", "debug" or "full", throws std::invalid_argument otherwise
+  level parse(std::string const& name);
+  std::string name(level check_level);
+  // level selected at build time with FRAMEWORK_GL_ERRORS
+  level default_level();
+
+  // install checks for the current context, debug output needs a debug context
+  // and falls back to no checks without KHR_debug; returns the active level
+  level watch(level check_level);
+
+  // time a cheap gl call under every level and print the cost per call
+  void benchmark(unsigned calls);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// work-stealing job system, one worker per core besides the thread that waits;
+// workers keep their jobs in chase-lev deques, pushing and popping at the bottom
+// while idle workers steal the oldest jobs from the top. jobs must not make gl
+// calls, the gl thread only hands out work and helps with its own while it waits
+namespace jobs {
+  typedef std::function<void()> job;
+
+  // number of unfinished jobs signalling it, jobs depending on it are
+  // scheduled once it drops to zero; must outlive the jobs referencing it
+  class counter {
+   public:
+    counter();
+
+    bool done() const;
+
+   private:
+    counter(counter const&);
+    counter& operator=(counter const&);
+
+    friend void add(counter& c);
+    friend void finish(counter& c);
+    friend void run_after(counter& dependency, job const& fn, counter* signal);
+    friend void wait(counter& c);
+
+    std::atomic<unsigned> m_pending;
+    // guards the dependent jobs and the transition to zero
+    std::mutex m_mutex;
+    std::vector<std::pair<job, counter*>> m_dependents;
+  };
+
+  // (re)start with the given number of threads including the waiting one,
+  // 0 uses all cores; must not be called while jobs are in flight.
+  // the first submitted job starts the system with all cores otherwise
+  void start(unsigned threads = 0);
+  // join the workers, jobs still queued are dropped
+  void stop();
+  // threads executing jobs, including the waiting one
+  unsigned concurrency();
+
+  // queue a job, signal is decremented once it finished
+  void run(job const& fn, counter* signal = nullptr);
+  // queue a job once the dependency reached zero
+  void run_after(counter& dependency, job const& fn, counter* signal = nullptr);
+  // execute queued jobs until the counter reached zero; outside of workers only
+  // jobs submitted from there that signal c are executed
+  void wait(counter& c);
+
+  // register and complete a unit of work on a counter by hand
+  void add(counter& c);
+  void finish(counter& c);
+
+  namespace detail {
+    struct for_state {
+      counter done;
+      std::mutex mutex;
+      std::exception_ptr error;
+    };
+
+    template<typename F>
+    void call(std::size_t begin, std::size_t end, F const& fn, for_state& state) {
+      try {
+        fn(begin, end);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock{state.mutex};
+        if (!state.error) {
+          state.error = std::current_exception();
+        }
+      }
+    }
+
+    // hand off the upper half until the range is small enough, so thieves
+    // take large ranges and split them further themselves
+    template<typename F>
+    void split(std::size_t begin, std::size_t end, std::size_t grain, F const& fn, for_state& state) {
+      while (end - begin > grain) {
+        std::size_t middle = begin + (end - begin) / 2;
+        run([middle, end, grain, &fn, &state]() {
+          split(middle, end, grain, fn, state);
+        }, &state.done);
+        end = middle;
+      }
+      call(begin, end, fn, state);
+    }
+  }
+
+  // call fn(begin, end) on disjoint subranges of [begin, end) with at most grain
+  // indices each and return once all finished, rethrowing the first exception
+  template<typename F>
+  void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F const& fn) {
+    if (end <= begin) {
+      return;
+    }
+    grain = grain > 0 ? grain : 1;
+    if (end - begin <= grain || concurrency() < 2) {
+      fn(begin, end);
+      return;
+    }
+    detail::for_state state;
+    detail::split(begin, end, grain, fn, state);
+    wait(state.done);
+    if (state.error) {
+      std::rethrow_exception(state.error);
+    }
+  }
+}
+
+#endif
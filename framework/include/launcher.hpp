@@ -2,8 +2,14 @@
 #define LAUNCHER_HPP
 
 #include "application.hpp"
+#include "file_watcher.hpp"
+#include "gl_capture.hpp"
+#include "gl_errors.hpp"
+#include "program_cache.hpp"
 
+#include <chrono>
 #include <string>
+#include <vector>
 
 // forward declarations
 class Application;
@@ -16,6 +22,8 @@ class Launcher {
     Launcher launcher{argc, argv};
     launcher.run<T>();
   }
+  // replay a trace written with --capture, the trace path is the first argument
+  static void replay(int argc, char* argv[]);
 
  private:
 
@@ -25,19 +33,48 @@ class Launcher {
   void run(){
     initialize();
 
+    if (m_benchmark_gl_errors) {
+      gl_errors::benchmark(1000000);
+      quit(EXIT_SUCCESS);
+    }
+
+    // record from the first call of the application on
+    if (!m_capture_path.empty()) {
+      gl_capture::start(m_capture_path, m_capture_frames, m_window_width, m_window_height);
+    }
+
     m_application = new T{m_resource_path};
 
-    mainLoop();
+    if (m_headless) {
+      benchmarkLoop();
+    }
+    else {
+      mainLoop();
+    }
   }
   
   // create window and set callbacks
   void initialize();
+  // create offscreen context without window or input
+  void initialize_headless();
+  // whether contexts are created with the debug flag
+  bool debug_context() const;
   // start main loop
   void mainLoop();
+  // render fixed number of frames along camera path, print frame times and quit
+  void benchmarkLoop();
+  // write gl and software images of the start view, then time software frames
+  void referenceLoop(glm::fmat4 const& start_view);
+  // replay setup and frames of a trace, print frame times and time per function
+  void replayLoop(gl_capture::player& player);
   // update viewport and field of view
-  void update_projection(GLFWwindow* window, int width, int height);
+  void update_projection(int width, int height);
   // load shader programs and update uniform locations
   void update_shader_programs(bool throwing);
+  // start rebuilding programs whose files changed and swap in finished ones
+  void reload_changed_shaders();
+  // watch the files of all shader programs
+  void watch_shader_files();
   // handle key input
   void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
   //handle mouse movement input
@@ -45,24 +82,58 @@ class Launcher {
 
   // calculate fps and show in window title
   void show_fps();
+  // print the time from start until the first frame was presented
+  void print_first_frame_time() const;
   // free resources
   void quit(int status);
 
   // vertical field of view of camera
   const float m_camera_fov;
 
-  // initial window dimensions
-  const unsigned m_window_width;
-  const unsigned m_window_height;
-  // the rendering window
+  // initial window dimensions, offscreen size in headless mode
+  unsigned m_window_width;
+  unsigned m_window_height;
+  // the rendering window, null in headless mode with egl
   GLFWwindow* m_window;
 
+  // render offscreen without display, selected with --headless
+  bool m_headless;
+  // frames measured in headless mode and frames rendered before measuring
+  unsigned m_benchmark_frames;
+  unsigned m_warmup_frames;
+  // egl objects of headless context, opaque to keep egl out of this header
+  void* m_egl_display;
+  void* m_egl_surface;
+  void* m_egl_context;
+
+  // how gl errors are detected, selected with --gl-errors
+  gl_errors::level m_gl_errors;
+  // measure cost of the error levels and quit, selected with --bench-gl-errors
+  bool m_benchmark_gl_errors;
+
+  // launch time, for the time until the first frame
+  std::chrono::steady_clock::time_point m_start_time;
   // variables for fps computation
   double m_last_second_time;
   unsigned m_frames_per_second;
 
   // path to the resource folders
   std::string m_resource_path;
+  // profiler trace written on P or after a headless run, set with --trace
+  std::string m_trace_path;
+  // file prefix of reference images written after a headless run, set with --reference
+  std::string m_reference_prefix;
+  // gl call trace of the first frames, set with --capture and --capture-frames
+  std::string m_capture_path;
+  unsigned m_capture_frames;
+  // repetitions of the frames of a replayed trace, set with --loops
+  unsigned m_replay_loops;
+  // memory report written on M or after a headless run, set with --memory
+  std::string m_memory_path;
+  // builds shader programs, binaries are cached in ./shader_cache or --shader-cache
+  ProgramCache m_program_cache;
+  // shader files triggering background rebuilds
+  FileWatcher m_file_watcher;
 
   Application* m_application;
 };
@@ -0,0 +1,71 @@
+#ifndef LIGHT_CLUSTERING_HPP
+#define LIGHT_CLUSTERING_HPP
+
+#include "frustum_culling.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// point light with a finite sphere of influence, falling off to zero at the radius
+struct point_light {
+  glm::fvec3 position;
+  float radius;
+  // colour premultiplied by intensity
+  glm::fvec3 colour;
+};
+
+// froxel grid splitting the view frustum into screen tiles and depth slices;
+// slices are spaced exponentially so clusters keep a similar shape with depth
+struct cluster_grid {
+  cluster_grid();
+  cluster_grid(unsigned tiles_x, unsigned tiles_y, unsigned slices, float near, float far);
+
+  std::size_t size() const;
+  // tile x is fastest, then tile y, then slice
+  std::size_t index(unsigned x, unsigned y, unsigned slice) const;
+  // slice of a positive view depth, clamped to the grid
+  unsigned slice(float depth) const;
+  // view depth where a slice begins, slice == slices gives the far depth
+  float slice_depth(unsigned slice) const;
+  // slice of depth is log(depth) * x + y
+  glm::fvec2 slice_mapping() const;
+
+  unsigned tiles_x;
+  unsigned tiles_y;
+  unsigned slices;
+  float near;
+  float far;
+};
+
+// view space bounds of the clusters and of each row and slice of them,
+// lights are tested top down so most clusters only see a few candidates
+struct cluster_volumes {
+  // indexed like cluster_grid::index
+  box_set clusters;
+  // row y of slice s at y + tiles_y * s
+  box_set rows;
+  box_set slices;
+};
+
+// lights overlapping each cluster
+struct light_clusters {
+  // first entry in indices and number of lights, two values per cluster
+  std::vector<unsigned> ranges;
+  std::vector<unsigned> indices;
+  // most lights in one cluster
+  unsigned max_count;
+};
+
+namespace clustering {
+  // bounds of every cluster for a perspective projection
+  cluster_volumes volumes(cluster_grid const& grid, glm::fmat4 const& projection);
+  // bin spheres given in view space into clusters, slices are spread across cores
+  void assign(cluster_grid const& grid, cluster_volumes const& bounds, sphere_set const& lights, light_clusters& clusters);
+
+  // single test of a sphere against a box
+  bool intersects(glm::fvec3 const& center, float radius, glm::fvec3 const& min, glm::fvec3 const& max);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef MEMORY_ACCOUNTING_HPP
+#define MEMORY_ACCOUNTING_HPP
+
+#include <glbinding/gl/types.h>
+#include <glbinding/gl/enum.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// memory of gl objects and large cpu allocations by what they are used for;
+// owners report sizes when allocating and releasing, gpu sizes are estimated
+// from the requested formats since drivers do not report them.
+// all functions may be called from any thread
+namespace memory_accounting {
+  enum domain {
+    CPU,
+    GPU,
+    NUM_DOMAINS
+  };
+
+  enum category {
+    // vertex and index data
+    GEOMETRY,
+    // sampled images
+    TEXTURES,
+    // attachments, including the framebuffer of the software rasterizer
+    RENDER_TARGETS,
+    UNIFORMS,
+    // per instance data streamed every frame
+    INSTANCES,
+    NUM_CATEGORIES
+  };
+
+  // objects are identified by kind and gl name, cpu memory by its owner's address
+  enum resource_kind {
+    HOST_ALLOCATION,
+    BUFFER,
+    TEXTURE,
+    RENDERBUFFER
+  };
+
+  struct resource {
+    resource_kind kind;
+    std::uint64_t id;
+    category type;
+    std::size_t bytes;
+    std::string name;
+  };
+
+  struct totals {
+    std::size_t live_bytes;
+    // highest live bytes so far
+    std::size_t peak_bytes;
+    std::size_t resources;
+  };
+
+  // record an allocation, tracking the same object again replaces its size
+  void track(resource_kind kind, std::uint64_t id, category type, std::size_t bytes, std::string const& name);
+  void release(resource_kind kind, std::uint64_t id);
+
+  void track_buffer(gl::GLuint buffer, category type, std::size_t bytes, std::string const& name);
+  // all levels of a texture with the given size of level 0
+  void track_texture(gl::GLuint texture, category type, unsigned width, unsigned height, gl::GLenum internal_format,
+                     unsigned samples, bool mipmapped, std::string const& name);
+  void track_host(void const* owner, category type, std::size_t bytes, std::string const& name);
+  void release_host(void const* owner);
+
+  // bytes per texel of an internal format, 4 for unknown ones
+  std::size_t texel_bytes(gl::GLenum internal_format);
+
+  totals usage(domain where);
+  totals usage(domain where, category type);
+  // live resources, largest first
+  std::vector<resource> resources();
+
+  // exceeding a budget prints one warning, 0 disables the budget
+  void set_budget(domain where, std::size_t bytes);
+  std::size_t budget(domain where);
+  // whether the peak of every domain stayed within its budget
+  bool within_budget();
+
+  char const* name(domain where);
+  char const* name(category type);
+
+  // totals per domain and category and every live resource, throws if the file cannot be written
+  void write_json(std::string const& path);
+}
+
+#endif
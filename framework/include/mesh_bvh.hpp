@@ -0,0 +1,92 @@
+#ifndef MESH_BVH_HPP
+#define MESH_BVH_HPP
+
+#include "aabb_tree.hpp"
+#include "model.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// where a ray meets the surface of a mesh
+struct mesh_hit {
+  mesh_hit();
+
+  // triangle starting at index 3 * triangle of the model, mesh_bvh::NONE for misses
+  unsigned triangle;
+  // along the ray, in units of its direction
+  float distance;
+  // weights of the second and third vertex, the first has the rest
+  glm::fvec2 barycentric;
+};
+
+// bounding volume hierarchy over the triangles of a model for ray queries on the cpu.
+// built top-down with binned surface area heuristic splits, large ranges are binned
+// on all cores and their subtrees built as jobs; the binary tree is then collapsed
+// into nodes of four children stored depth first in structure-of-arrays layout, so
+// a traversal step tests all child boxes with one sse compare from two cache lines.
+// leaves are packets of up to eight triangles tested at once with moeller-trumbore
+// on avx, in two sse halves or in scalar code
+class mesh_bvh {
+ public:
+  static const unsigned NONE = ~0u;
+  // children per node
+  static const unsigned WIDTH = 4;
+  // triangles per leaf
+  static const unsigned PACKET = 8;
+
+  mesh_bvh();
+  explicit mesh_bvh(model const& m);
+
+  // rebuild over the positions of an indexed or non-indexed triangle model
+  void build(model const& m);
+  void clear();
+
+  // nearest hit within the ray's max distance, both sides of triangles count
+  bool intersect(ray const& r, mesh_hit& hit) const;
+  // whether anything is hit within max distance, stops at the first triangle found
+  bool occluded(ray const& r) const;
+  // nearest hits of many rays, traced as jobs; returns the number of rays hitting
+  std::size_t intersect(std::vector<ray> const& rays, std::vector<mesh_hit>& hits) const;
+
+  std::size_t triangles() const;
+  std::size_t nodes() const;
+  // levels of nodes below the root down to the deepest one
+  std::size_t depth() const;
+  glm::fvec3 min() const;
+  glm::fvec3 max() const;
+
+ private:
+  mesh_bvh(mesh_bvh const&);
+  mesh_bvh& operator=(mesh_bvh const&);
+
+  // two cache lines, empty slots are not in the used mask
+  struct node {
+    // min x, y, z then max x, y, z of every child
+    float bounds[6][WIDTH];
+    // node index or packet index with LEAF set
+    unsigned children[WIDTH];
+    unsigned used;
+    unsigned padding[3];
+  };
+  static const unsigned LEAF = 1u << 31;
+
+  // first vertex and the edges leaving it of every triangle, unused lanes are degenerate
+  struct packet {
+    float vertex[3][PACKET];
+    float edge1[3][PACKET];
+    float edge2[3][PACKET];
+    unsigned triangles[PACKET];
+  };
+  // nodes and packets live in one block aligned to cache lines
+  std::vector<unsigned char> m_storage;
+  node* m_nodes;
+  std::size_t m_num_nodes;
+  packet* m_packets;
+  std::size_t m_num_packets;
+  std::size_t m_triangles;
+  std::size_t m_depth;
+};
+
+#endif
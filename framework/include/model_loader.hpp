@@ -5,10 +5,19 @@
 
 #include "tiny_obj_loader.h"
 
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+
 namespace model_loader {
 
 model obj(std::string const& path, model::attrib_flag_t import_attribs = model::POSITION);
 
+// replace normals of mesh with the normalized sum of adjacent face normals
+void generate_normals(tinyobj::mesh_t& model);
+// per vertex tangents from texcoords, orthogonal to the mesh normals
+std::vector<glm::fvec3> generate_tangents(tinyobj::mesh_t const& model);
+
 }
 
 #endif
\ No newline at end of file
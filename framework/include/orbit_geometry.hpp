@@ -0,0 +1,31 @@
+#ifndef ORBIT_GEOMETRY_HPP
+#define ORBIT_GEOMETRY_HPP
+
+#include "model.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+
+// unit circles in the xz-plane at increasing resolution, packed into one vertex buffer
+struct circle_lods {
+  // positions of all levels, each level is one line loop
+  model vertices;
+  // first vertex of each level
+  std::vector<GLint> first;
+  // number of segments of each level
+  std::vector<GLsizei> segments;
+};
+
+namespace orbit_geometry {
+  // levels double their segment count from min_segments up to max_segments
+  circle_lods unit_circles(unsigned min_segments, unsigned max_segments);
+
+  // matrix mapping the unit circle onto an orbit with radius and skew inside the parent frame
+  glm::fmat4 orbit_transform(glm::fmat4 const& parent, float radius, float skew);
+
+  // coarsest level whose segments are at most pixels_per_segment long on screen
+  unsigned select_lod(circle_lods const& circles, glm::fmat4 const& orbit_transform, glm::fmat4 const& view, glm::fmat4 const& projection, float viewport_height, float pixels_per_segment);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef POST_PROCESSING_HPP
+#define POST_PROCESSING_HPP
+
+#include "render_target_pool.hpp"
+
+#include <glbinding/gl/types.h>
+#include <glbinding/gl/enum.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// chain of fullscreen passes over offscreen targets; targets can be scaled
+// down for cheap wide filters and passes of disabled effects are skipped.
+// target attachments come from a pool each frame and go back after their
+// last use, so targets with disjoint lifetimes share memory
+class PostProcessing {
+ public:
+  // binds program and uploads uniforms of a pass, inputs are bound to
+  // consecutive units from texture_unit(), gets texel size of the first input
+  typedef std::function<void(glm::fvec2 const& input_texel)> setup_function;
+
+  // targets wait for the screen size to settle this long before reallocating
+  static const std::chrono::milliseconds RESIZE_DELAY;
+
+  // inputs of passes are bound starting at texture_unit, needs current context
+  PostProcessing(RenderTargetPool& pool, unsigned texture_unit);
+  ~PostProcessing();
+
+  // colour target with 1 / 2^scale of the screen resolution, filtered linearly
+  void add_target(std::string const& name, unsigned scale, GLenum format, bool depth = false);
+  // pass of effect sampling inputs and drawing into output, empty output is the
+  // default framebuffer; returns index of the pass
+  std::size_t add_pass(std::string const& effect, std::vector<std::string> const& inputs, std::string const& output,
+                       setup_function const& setup, bool additive = false);
+  // change a sampled target of a pass
+  void set_input(std::size_t pass, std::size_t input, std::string const& target);
+
+  void set_enabled(std::string const& effect, bool enabled);
+  bool enabled(std::string const& effect) const;
+
+  // request new screen size, targets follow once it stayed unchanged for RESIZE_DELAY
+  void resize(unsigned width, unsigned height);
+  // bind framebuffer of a target for this frame and set the viewport to its size,
+  // without its depth attachment the depth can be sampled while drawing colour
+  void bind(std::string const& target, bool with_depth = true);
+  // depth attachment of a target for this frame, e.g. to share it with a geometry buffer
+  GLuint depth_texture(std::string const& target);
+  glm::uvec2 size(std::string const& target) const;
+  unsigned texture_unit() const;
+
+  // run passes of enabled effects in order without depth test, leaves the
+  // default framebuffer bound with a full screen viewport
+  void render();
+
+ private:
+  PostProcessing(PostProcessing const&);
+  PostProcessing& operator=(PostProcessing const&);
+
+  struct target {
+    unsigned scale;
+    GLenum format;
+    bool has_depth;
+    // attachments held during the current frame, 0 if not acquired
+    GLuint colour;
+    GLuint depth;
+  };
+
+  struct pass {
+    std::string effect;
+    std::vector<std::string> inputs;
+    std::string output;
+    setup_function setup;
+    bool additive;
+  };
+
+  // apply requested screen size once it settled
+  void update_size();
+  glm::uvec2 scaled_size(target const& target) const;
+  void acquire(target& target);
+  void release(target& target);
+
+  RenderTargetPool& m_pool;
+  unsigned m_texture_unit;
+  // fullscreen triangle is generated from vertex ids, core profile needs a vao anyway
+  GLuint m_vertex_array;
+  // size of the default framebuffer and size the targets are allocated for
+  glm::uvec2 m_screen_size;
+  glm::uvec2 m_size;
+  std::chrono::steady_clock::time_point m_resize_time;
+  std::map<std::string, target> m_targets;
+  std::vector<pass> m_passes;
+  std::set<std::string> m_disabled;
+  // pass after which each target is last used in this frame
+  std::map<std::string, std::size_t> m_last_use;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one timed interval of a frame, times in milliseconds since profiler start
+struct profile_event {
+  // must outlive the profiler, usually a string literal
+  const char* name;
+  double cpu_begin;
+  double cpu_end;
+  // gpu execution time, negative if not measured or not yet available
+  double gpu_duration;
+  // number of enclosing scopes
+  unsigned depth;
+};
+
+// all events recorded between begin_frame and end_frame
+struct profile_frame {
+  // scopes per frame, further ones are dropped
+  static const unsigned MAX_EVENTS = 64;
+
+  std::uint64_t index;
+  double cpu_begin;
+  double cpu_end;
+  unsigned num_events;
+  profile_event events[MAX_EVENTS];
+};
+
+// frame profiler with scoped cpu markers and gpu timer queries; frames are
+// kept in a ring of the last FRAME_HISTORY frames once their gpu times arrived
+namespace profiler {
+  const unsigned FRAME_HISTORY = 256;
+  // frames a timer query may stay in flight before its result is read
+  const unsigned QUERY_LATENCY = 4;
+
+  // called by the rendering thread around every frame, with the context current
+  void begin_frame();
+  void end_frame();
+  // delete timer queries while the context is still current
+  void shutdown();
+
+  // disabled profiler records nothing and scopes cost a branch
+  void set_enabled(bool enabled);
+  bool enabled();
+
+  // completed frames, oldest first, can be called from any thread
+  std::vector<profile_frame> frames();
+  // write completed frames as chrome trace event json, viewable in chrome://tracing
+  void export_chrome_trace(std::string const& path);
+
+  // measures cpu time from construction to destruction
+  class cpu_scope {
+   public:
+    explicit cpu_scope(const char* name);
+    ~cpu_scope();
+
+   private:
+    cpu_scope(cpu_scope const&);
+    cpu_scope& operator=(cpu_scope const&);
+
+    // index in current frame, -1 if not recorded
+    int m_event;
+  };
+
+  // measures cpu time and gpu time of the enclosed commands,
+  // gpu timing is skipped when nested inside another gpu scope
+  class gpu_scope {
+   public:
+    explicit gpu_scope(const char* name);
+    ~gpu_scope();
+
+   private:
+    gpu_scope(gpu_scope const&);
+    gpu_scope& operator=(gpu_scope const&);
+
+    int m_event;
+    bool m_timed;
+  };
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include "structs.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// builds shader programs, compiling in parallel where the driver allows and
+// storing linked binaries on disk, keyed by a hash of preprocessed sources and driver
+class ProgramCache {
+ public:
+  // binaries are kept in directory, an empty path disables the disk cache
+  explicit ProgramCache(std::string const& directory);
+
+  // rebuild programs whose sources changed since their last build, others keep
+  // their handle; failed programs keep their old handle and a std::logic_error
+  // naming them is thrown after all others are swapped in; returns rebuilt count
+  std::size_t build(std::map<std::string, shader_program>& programs);
+
+  // start rebuilding one program without waiting for the driver, does nothing
+  // if its sources are unchanged; replaces an earlier request still in flight
+  void request(std::string const& name, shader_program& program);
+  // swap in requested programs that finished building and return their names,
+  // with wait true blocks until all are done; failed programs keep their handle.
+  // without parallel compile support the link status query may block on the
+  // driver, so it is deferred to the poll after the request
+  std::vector<std::string> poll(bool wait);
+  // whether requested programs are still building
+  bool pending() const;
+  // names of programs that failed since the last call
+  std::vector<std::string> failed();
+
+  // results of the last build
+  unsigned cache_hits() const;
+  unsigned compiled() const;
+  double build_milliseconds() const;
+
+ private:
+  struct pending_build {
+    shader_program* program;
+    std::string name;
+    std::uint64_t key;
+    GLuint handle;
+    // zero if loaded from a binary
+    GLuint shaders[2];
+    // polls that left the build pending
+    unsigned polls;
+  };
+
+  // query driver capabilities, needs current context
+  void initialize();
+  // compile and link sources, returns without waiting when compiling in parallel
+  GLuint start_build(std::string const& vertex_source, std::string const& fragment_source, GLuint shaders[2]) const;
+  GLuint load_binary(std::uint64_t key) const;
+  void store_binary(std::uint64_t key, GLuint program) const;
+  std::string binary_path(std::uint64_t key) const;
+  // check link status and swap handle on success, returns success
+  bool finish(pending_build& build);
+  // delete objects of a build that is not swapped in
+  void discard(pending_build const& build) const;
+
+  std::string m_directory;
+  bool m_initialized;
+  // vendor, renderer and version, part of every key
+  std::string m_driver;
+  bool m_binaries_supported;
+  bool m_parallel_compile;
+
+  unsigned m_cache_hits;
+  unsigned m_compiled;
+  double m_build_milliseconds;
+
+  std::vector<pending_build> m_pending;
+  std::vector<std::string> m_failed;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RENDER_TARGET_POOL_HPP
+#define RENDER_TARGET_POOL_HPP
+
+#include <glbinding/gl/types.h>
+#include <glbinding/gl/enum.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+// hands out transient attachment textures keyed by size, format and sample
+// count; released textures are reused by later requests in the same or next
+// frames, so targets whose lifetimes do not overlap share memory
+class RenderTargetPool {
+ public:
+  // unused textures are deleted after this many frames
+  static const unsigned FRAMES_UNTIL_FREE = 8;
+
+  RenderTargetPool();
+  ~RenderTargetPool();
+
+  // texture with undefined content, multisampled if samples is above 0
+  GLuint acquire(glm::uvec2 const& size, GLenum format, unsigned samples = 0);
+  // return texture to the pool, it may be handed out again right away
+  void release(GLuint texture);
+  // cached framebuffer with colour and optional depth attachment
+  GLuint framebuffer(GLuint colour, GLuint depth = 0);
+  // cached framebuffer drawing to the colours in order, e.g. a geometry buffer
+  GLuint framebuffer(std::vector<GLuint> const& colours, GLuint depth);
+  // advance frame counter and delete textures that stayed unused
+  void collect();
+
+  // estimated memory of all pooled textures
+  std::size_t allocated_bytes() const;
+  std::size_t allocated_textures() const;
+
+ private:
+  RenderTargetPool(RenderTargetPool const&);
+  RenderTargetPool& operator=(RenderTargetPool const&);
+
+  struct description {
+    glm::uvec2 size;
+    GLenum format;
+    unsigned samples;
+
+    bool operator<(description const& other) const;
+  };
+
+  struct entry {
+    description desc;
+    bool in_use;
+    std::uint64_t last_used;
+  };
+
+  void destroy(GLuint texture);
+
+  std::map<GLuint, entry> m_textures;
+  std::multimap<description, GLuint> m_free;
+  // keyed by the colour attachments followed by the depth attachment
+  std::map<std::vector<GLuint>, GLuint> m_framebuffers;
+  std::uint64_t m_frame;
+};
+
+#endif
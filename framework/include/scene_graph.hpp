@@ -0,0 +1,75 @@
+#ifndef SCENE_GRAPH_HPP
+#define SCENE_GRAPH_HPP
+
+#include "transform.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// transform hierarchy in structure-of-arrays layout, nodes are kept in
+// depth-first order so parents precede children and every subtree is one
+// contiguous range; world transforms are updated in a single linear pass
+class scene_graph {
+ public:
+  // stable node handle, array positions move when nodes are inserted
+  typedef unsigned node;
+  static const node NONE = ~0u;
+
+  scene_graph();
+
+  // insert node as last child of parent or as new root
+  node add(node parent, transform_state const& local = transform_state{});
+
+  // changing the local transform marks the node and its subtree for update
+  void set_local(node n, transform_state const& local);
+  void set_translation(node n, glm::fvec3 const& translation);
+  void set_rotation(node n, glm::fquat const& rotation);
+  void set_scale(node n, glm::fvec3 const& scale);
+
+  transform_state local(node n) const;
+  glm::fmat4 const& world(node n) const;
+  node parent(node n) const;
+  // whether the world transform changed in the last update
+  bool changed(node n) const;
+  std::size_t size() const;
+
+  // recompute world transforms of dirty subtrees, independent subtrees are
+  // split into jobs for large graphs, 0 threads uses all job threads;
+  // returns number of recomputed nodes
+  std::size_t update(unsigned threads = 0);
+
+ private:
+  void mark_dirty(unsigned index);
+  // recompute subtree ranges whose roots have up to date parents
+  void update_range(unsigned begin, unsigned end);
+  // split dirty subtrees into ancestors updated first and ranges for threads
+  void build_partition(std::size_t grain);
+
+  // per node in depth-first order
+  std::vector<unsigned> m_parents;
+  std::vector<unsigned> m_subtree_sizes;
+  std::vector<glm::fvec3> m_translations;
+  std::vector<glm::fquat> m_rotations;
+  std::vector<glm::fvec3> m_scales;
+  // local matrices, rebuilt only for nodes whose local transform changed
+  std::vector<glm::fmat4> m_locals;
+  std::vector<glm::fmat4> m_worlds;
+  std::vector<std::uint8_t> m_dirty;
+  std::vector<std::uint8_t> m_changed;
+  std::vector<node> m_handles;
+  // array position of each handle
+  std::vector<unsigned> m_indices;
+
+  // nodes with changed local transform, handles stay valid across insertion
+  std::vector<node> m_dirty_nodes;
+  // disjoint subtrees recomputed in the last update, as begin/end pairs
+  std::vector<unsigned> m_changed_ranges;
+  // scratch for parallel updates
+  std::vector<unsigned> m_serial_nodes;
+  std::vector<unsigned> m_task_ranges;
+};
+
+#endif
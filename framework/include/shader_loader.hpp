@@ -1,18 +1,34 @@
-#ifndef SHADER_LOADER_HPP
-#define SHADER_LOADER_HPP
-
-#include <glbinding/gl/enum.h>
-using namespace gl;
-
-#include <string>
-
-namespace shader_loader {
-  // compile shader
-  unsigned shader(std::string const& file_path, GLenum shader_type);
-  // create program from vertex and fragment shader
-  unsigned program(std::string const& vertex_name, std::string const& fragment_name);
-  // create program from vertex, geometry and fragment shader
-  unsigned program(std::string const& vertex_path, std::string const& geometry_path, std::string const& fragment_path);
-};
-
-#endif
+#ifndef SHADER_LOADER_HPP
+#define SHADER_LOADER_HPP
+
+#include <glbinding/gl/enum.h>
+using namespace gl;
+
+#include <string>
+#include <vector>
+
+// shader text ready for compilation
+struct shader_source {
+  std::string text;
+  // the shader file followed by all included files, the index of a file
+  // is its source string number in #line directives and compile logs
+  std::vector<std::string> files;
+};
+
+namespace shader_loader {
+  // load shader file, replacing every #include "file" line with the content of
+  // file, found relative to the including file; each file is included once
+  // defines like "NAME" or "NAME VALUE" are inserted after the #version line
+  shader_source preprocess(std::string const& file_path, std::vector<std::string> const& defines = {});
+  // drop cached content of a changed file, files are also re-read when their
+  // modification time or size changes
+  void invalidate(std::string const& file_path);
+  // compile shader
+  unsigned shader(std::string const& file_path, GLenum shader_type);
+  // create program from vertex and fragment shader
+  unsigned program(std::string const& vertex_name, std::string const& fragment_name);
+  // create program from vertex, geometry and fragment shader
+  unsigned program(std::string const& vertex_path, std::string const& geometry_path, std::string const& fragment_path);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef SIMD_LANES_HPP
+#define SIMD_LANES_HPP
+
+#include <cstddef>
+
+// pick widest available instruction set, scalar code handles the rest
+#if defined(__AVX__)
+  #include <immintrin.h>
+  #define SIMD_LANES_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SIMD_LANES_SSE
+#endif
+
+namespace simd {
+  // append lane indices of set mask bits without branching,
+  // writes never pass the index of the current object
+  inline std::size_t compact(unsigned* out, std::size_t count, unsigned base, int mask, unsigned lanes) {
+    for (unsigned lane = 0; lane < lanes; ++lane) {
+      out[count] = base + lane;
+      count += std::size_t((mask >> lane) & 1);
+    }
+    return count;
+  }
+
+  // one float per object in every lane, so kernels can be written once as templates
+  // over the lane type and instantiated for each instruction set; min and max return
+  // the second argument if either is nan, as the sse instructions do
+  struct scalar {
+    typedef float type;
+    typedef bool mask;
+    static const std::size_t width = 1;
+
+    static type set1(float v) { return v; }
+    static type load(float const* p) { return *p; }
+    static void store(float* p, type v) { *p = v; }
+    static type min(type a, type b) { return a < b ? a : b; }
+    static type max(type a, type b) { return a > b ? a : b; }
+    static mask less_equal(type a, type b) { return a <= b; }
+    static mask both(mask a, mask b) { return a && b; }
+    // bit i set for lane i
+    static int bits(mask m) { return m ? 1 : 0; }
+  };
+
+#ifdef SIMD_LANES_SSE
+  struct sse_float {
+    __m128 v;
+  };
+  inline sse_float operator+(sse_float a, sse_float b) { return sse_float{_mm_add_ps(a.v, b.v)}; }
+  inline sse_float operator-(sse_float a, sse_float b) { return sse_float{_mm_sub_ps(a.v, b.v)}; }
+  inline sse_float operator*(sse_float a, sse_float b) { return sse_float{_mm_mul_ps(a.v, b.v)}; }
+  inline sse_float operator/(sse_float a, sse_float b) { return sse_float{_mm_div_ps(a.v, b.v)}; }
+
+  struct sse {
+    typedef sse_float type;
+    typedef sse_float mask;
+    static const std::size_t width = 4;
+
+    static type set1(float v) { return type{_mm_set1_ps(v)}; }
+    static type load(float const* p) { return type{_mm_loadu_ps(p)}; }
+    static void store(float* p, type v) { _mm_storeu_ps(p, v.v); }
+    static type min(type a, type b) { return type{_mm_min_ps(a.v, b.v)}; }
+    static type max(type a, type b) { return type{_mm_max_ps(a.v, b.v)}; }
+    static mask less_equal(type a, type b) { return mask{_mm_cmple_ps(a.v, b.v)}; }
+    static mask both(mask a, mask b) { return mask{_mm_and_ps(a.v, b.v)}; }
+    static int bits(mask m) { return _mm_movemask_ps(m.v); }
+  };
+#endif
+
+#ifdef SIMD_LANES_AVX
+  struct avx_float {
+    __m256 v;
+  };
+  inline avx_float operator+(avx_float a, avx_float b) { return avx_float{_mm256_add_ps(a.v, b.v)}; }
+  inline avx_float operator-(avx_float a, avx_float b) { return avx_float{_mm256_sub_ps(a.v, b.v)}; }
+  inline avx_float operator*(avx_float a, avx_float b) { return avx_float{_mm256_mul_ps(a.v, b.v)}; }
+  inline avx_float operator/(avx_float a, avx_float b) { return avx_float{_mm256_div_ps(a.v, b.v)}; }
+
+  struct avx {
+    typedef avx_float type;
+    typedef avx_float mask;
+    static const std::size_t width = 8;
+
+    static type set1(float v) { return type{_mm256_set1_ps(v)}; }
+    static type load(float const* p) { return type{_mm256_loadu_ps(p)}; }
+    static void store(float* p, type v) { _mm256_storeu_ps(p, v.v); }
+    static type min(type a, type b) { return type{_mm256_min_ps(a.v, b.v)}; }
+    static type max(type a, type b) { return type{_mm256_max_ps(a.v, b.v)}; }
+    static mask less_equal(type a, type b) { return mask{_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    static mask both(mask a, mask b) { return mask{_mm256_and_ps(a.v, b.v)}; }
+    static int bits(mask m) { return _mm256_movemask_ps(m.v); }
+  };
+#endif
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include "transform.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// transforms of all objects at two consecutive simulation steps
+struct simulation_snapshot {
+  // simulated time of the current states
+  double time;
+  std::vector<transform_state> previous;
+  std::vector<transform_state> current;
+};
+
+// advances a simulation at a fixed timestep on its own thread and publishes
+// snapshots through a lock-free triple buffer, the renderer interpolates the latest one
+class Simulation {
+ public:
+  // writes the transform of every object at the given simulated time
+  typedef std::function<void(double time, std::vector<glm::fmat4>& transforms)> step_function;
+
+  Simulation(step_function const& step, std::size_t num_objects, double timestep);
+  // stops the simulation thread
+  ~Simulation();
+
+  // compute the initial state and launch the thread
+  void start();
+  // join the thread, can be restarted
+  void stop();
+
+  // seconds since start, on the clock the simulation runs on
+  double time() const;
+  double timestep() const;
+
+  // write transforms one timestep behind the current time, blended between the
+  // two latest steps; must only be called from one thread
+  void interpolate(std::vector<glm::fmat4>& transforms);
+
+ private:
+  void run();
+  // make the written snapshot the latest one
+  void publish();
+
+  step_function m_step;
+  std::size_t m_num_objects;
+  double m_timestep;
+
+  // snapshot slots, one written by the simulation, one read by the renderer, one in between
+  simulation_snapshot m_snapshots[3];
+  // slot index being written, owned by simulation thread
+  unsigned m_write_slot;
+  // slot index being read, owned by reading thread
+  unsigned m_read_slot;
+  // slot index of latest complete snapshot, with flag set if not yet read
+  std::atomic<unsigned> m_latest_slot;
+
+  std::chrono::steady_clock::time_point m_start;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+  // scratch matrices filled by step function
+  std::vector<glm::fmat4> m_step_transforms;
+};
+
+#endif
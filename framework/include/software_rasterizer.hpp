@@ -0,0 +1,157 @@
+#ifndef SOFTWARE_RASTERIZER_HPP
+#define SOFTWARE_RASTERIZER_HPP
+
+#include "model.hpp"
+#include "pixel_data.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// shading of a triangle draw, lit materials follow the blinn-phong planet shader
+struct raster_material {
+  raster_material();
+
+  // 8 bit rgb or rgba image sampled bilinearly with repeat, null samples white
+  pixel_data const* texture;
+  // multiplies the texture colour
+  glm::fvec3 colour;
+  // texture lookup at texcoord * texcoord_scale + texcoord_offset
+  glm::fvec2 texcoord_scale;
+  glm::fvec2 texcoord_offset;
+  // unlit materials output the base colour
+  bool lit;
+  // light position in world space
+  glm::fvec3 light_position;
+  float ambient;
+  float diffuse;
+  float specular;
+  float glossiness;
+  // quantize to 4 levels and draw silhouettes in a flat colour
+  bool cel_shading;
+  bool depth_write;
+};
+
+// cpu reference renderer for the primitives of the demo: draws are transformed
+// and set up as they are queued, binned into screen tiles on flush and each tile
+// is rasterized as a job with simd edge functions and interpolation; follows gl
+// conventions for depth, fill rule and image orientation so results are comparable
+class SoftwareRasterizer {
+ public:
+  // edge length of a screen tile in pixels
+  static const unsigned TILE_SIZE = 64;
+
+  SoftwareRasterizer(unsigned width, unsigned height);
+  ~SoftwareRasterizer();
+
+  void resize(unsigned width, unsigned height);
+  unsigned width() const;
+  unsigned height() const;
+
+  // fill colour and reset depth to the far plane, drops queued primitives
+  void clear(glm::fvec3 const& colour = glm::fvec3{0.0f});
+  void set_camera(glm::fmat4 const& view, glm::fmat4 const& projection);
+
+  // queue indexed triangles of a model, texcoords are only read if present;
+  // the texture of the material must stay alive until flush
+  void draw_triangles(model const& m, glm::fmat4 const& transform, raster_material const& material);
+  // queue single pixel points, colour is read from the normal attribute
+  void draw_points(model const& m, GLint first, GLsizei count, glm::fmat4 const& transform);
+  // queue a closed loop through count vertices starting at first
+  void draw_line_loop(model const& m, GLint first, GLsizei count, glm::fmat4 const& transform, glm::fvec3 const& colour);
+
+  // rasterize the queued primitives in submission order
+  void flush();
+
+  // full screen pass computing every pixel from the flushed image,
+  // pixel coordinates start at the bottom left
+  typedef std::function<glm::fvec3(SoftwareRasterizer const& source, unsigned x, unsigned y)> post_function;
+  void post_process(post_function const& pass);
+
+  glm::fvec3 colour(unsigned x, unsigned y) const;
+  // 8 bit rgb image with the bottom row first, like glReadPixels
+  pixel_data image() const;
+
+  // primitives in the last flush and primitive references stored in tiles
+  std::size_t num_primitives() const;
+  std::size_t num_binned() const;
+
+  // primitives after vertex processing
+  struct draw_state {
+    raster_material material;
+  };
+  struct triangle {
+    // window x, y, depth and 1/w per vertex
+    glm::fvec4 window[3];
+    glm::fvec3 world[3];
+    glm::fvec3 normal[3];
+    glm::fvec2 texcoord[3];
+    // pixel bounds, inclusive
+    int min_x, min_y, max_x, max_y;
+    unsigned draw;
+  };
+  struct point {
+    int x, y;
+    float depth;
+    std::uint32_t colour;
+  };
+  struct line {
+    // window x, y and depth of both ends
+    glm::fvec3 window[2];
+    int min_x, min_y, max_x, max_y;
+    std::uint32_t colour;
+  };
+
+ private:
+  // reference to a queued primitive, kind in the top bits
+  typedef std::uint32_t primitive_code;
+
+  void bin();
+  void rasterize_tile(unsigned tile);
+  // report framebuffer memory to memory_accounting
+  void track_memory() const;
+
+  unsigned m_width;
+  unsigned m_height;
+  unsigned m_tiles_x;
+  unsigned m_tiles_y;
+
+  // packed rgba8, bottom row first
+  std::vector<std::uint32_t> m_colour;
+  // window space depth in [0, 1]
+  std::vector<float> m_depth;
+  std::vector<std::uint32_t> m_post_target;
+
+  glm::fmat4 m_view_projection;
+  glm::fvec3 m_camera_position;
+
+  std::vector<draw_state> m_draws;
+  std::vector<triangle> m_triangles;
+  std::vector<point> m_points;
+  std::vector<line> m_lines;
+  // all primitives in submission order
+  std::vector<primitive_code> m_primitives;
+  std::size_t m_num_flushed;
+  // primitives per tile, one set of bins per contiguous range of primitives
+  // so ranges are binned in parallel and tiles still see submission order
+  std::vector<std::vector<std::vector<primitive_code>>> m_bins;
+  std::size_t m_num_binned;
+
+  // vertex processing results of the current draw
+  std::vector<glm::fvec4> m_clip_positions;
+  std::vector<glm::fvec3> m_world_positions;
+  std::vector<glm::fvec3> m_world_normals;
+  std::vector<glm::fvec2> m_texcoords;
+  // primitives set up per block of input, appended in order
+  std::vector<std::vector<triangle>> m_triangle_blocks;
+  std::vector<std::vector<point>> m_point_blocks;
+  std::vector<std::vector<line>> m_line_blocks;
+};
+
+// write an 8 bit rgb or rgba image with the bottom row first as binary ppm
+void write_ppm(std::string const& path, pixel_data const& image);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SPHERE_GEOMETRY_HPP
+#define SPHERE_GEOMETRY_HPP
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// unit spheres generated at any tessellation, with analytic normals and tangents;
+// texcoords map longitude to u and latitude to v like an equirectangular image,
+// vertices on the seam are duplicated so no triangle wraps around it.
+// indices are ordered for the post-transform cache and vertices by first use
+namespace sphere_geometry {
+  // rings of latitude from pole to pole, each with segments quads of longitude
+  model uv_sphere(unsigned rings, unsigned segments, model::attrib_flag_t attributes = model::POSITION);
+  // regular icosahedron with each edge split in two subdivisions times
+  model icosphere(unsigned subdivisions, model::attrib_flag_t attributes = model::POSITION);
+
+  // reorder triangles for a post-transform vertex cache of unknown size
+  void optimize_vertex_cache(std::vector<GLuint>& indices, std::size_t num_vertices);
+  // reorder the vertices of an indexed model by first use in its indices
+  void optimize_vertex_fetch(model& mesh);
+  // transformed vertices per triangle with a fifo cache of the given size
+  float average_cache_miss_ratio(std::vector<GLuint> const& indices, std::size_t num_vertices, unsigned cache_size);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef STAR_FIELD_HPP
+#define STAR_FIELD_HPP
+
+#include "model.hpp"
+#include "frustum_culling.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// counter based random number generator (Salmon et al. 2011),
+// output depends only on counter and key, so any element can be generated independently
+struct philox4x32 {
+  philox4x32(std::uint64_t seed);
+
+  // 10 rounds of Philox4x32 for the given counter
+  void generate(std::uint32_t const counter[4], std::uint32_t result[4]) const;
+  // uniform float in [0, 1) from one output word
+  static float to_unit(std::uint32_t value);
+
+  std::uint32_t key[2];
+};
+
+// contiguous range of stars in one spatial cell
+struct star_chunk {
+  // first vertex of the chunk in the field
+  GLint first;
+  // number of stars in the chunk, sorted by decreasing brightness
+  GLsizei count;
+  // bounds of the contained stars
+  glm::fvec3 min;
+  glm::fvec3 max;
+};
+
+// star vertices binned into chunks, each chunk is brightness sorted so
+// any prefix of it is a lower level of detail
+struct star_field {
+  // position and colour per star, colour stored in the normal attribute
+  model vertices;
+  std::vector<star_chunk> chunks;
+  // chunk bounds for culling, same order as chunks
+  box_set bounds;
+};
+
+namespace star_generator {
+  // generate num_stars stars in the cube [-extent, extent]^3, binned into chunks_per_axis^3 chunks,
+  // result is identical for the same seed regardless of the number of threads (0 uses all job threads)
+  star_field generate(std::size_t num_stars, std::uint64_t seed, float extent, unsigned chunks_per_axis, unsigned threads = 0);
+
+  // number of stars of a chunk to draw so its density matches its projected size,
+  // stars_per_pixel is the density target at full screen coverage
+  GLsizei lod_count(star_chunk const& chunk, glm::fmat4 const& view, glm::fmat4 const& projection, float viewport_height, float stars_per_pixel);
+}
+
+#endif
@@ -2,7 +2,10 @@
 #define STRUCTS_HPP
 
 
+#include <cstdint>
 #include <map>
+#include <string>
+#include <vector>
 #include <glbinding/gl/gl.h>
 // use gl definitions from glbinding 
 using namespace gl;
@@ -39,13 +42,20 @@ struct shader_program {
    :vertex_path{vertex}
    ,fragment_path{fragment}
    ,handle{0}
+   ,build_key{0}
    {}
 
   // path to shader source
   std::string vertex_path; 
   std::string fragment_path;
+  // preprocessor symbols defined in both stages, "NAME" or "NAME VALUE"
+  std::vector<std::string> defines{};
   // object handle
   GLuint handle;
+  // hash of the sources the handle was built from, 0 if never built
+  std::uint64_t build_key;
+  // files read by the last build, watched for hot reloading
+  std::vector<std::string> dependencies{};
   // uniform locations mapped to name
   std::map<std::string, GLint> u_locs{};
 };
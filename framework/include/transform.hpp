@@ -0,0 +1,64 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include <glm/gtc/type_precision.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// translation, rotation and scale of one object, interpolatable
+struct transform_state {
+  transform_state();
+  // split matrix without shear into translation, rotation and scale
+  explicit transform_state(glm::fmat4 const& matrix);
+  transform_state(glm::fvec3 const& translation, glm::fquat const& rotation, glm::fvec3 const& scale);
+
+  glm::fmat4 matrix() const;
+
+  glm::fvec3 translation;
+  glm::fquat rotation;
+  glm::fvec3 scale;
+};
+
+// blend translation and scale linearly, rotation spherically
+transform_state interpolate(transform_state const& a, transform_state const& b, float alpha);
+
+// translations, rotations and scales in structure-of-arrays layout for simd composing
+struct transform_set {
+  // append transform, returns its index
+  std::size_t add(transform_state const& state);
+  // overwrite existing transform
+  void set(std::size_t index, transform_state const& state);
+  void clear();
+  std::size_t size() const;
+
+  std::vector<float> translation_x;
+  std::vector<float> translation_y;
+  std::vector<float> translation_z;
+  std::vector<float> rotation_x;
+  std::vector<float> rotation_y;
+  std::vector<float> rotation_z;
+  std::vector<float> rotation_w;
+  std::vector<float> scale_x;
+  std::vector<float> scale_y;
+  std::vector<float> scale_z;
+};
+
+// batched matrices of many objects, several at once per simd register and
+// split across cores for large counts; parent and view must be affine.
+// normal matrices are the inverse transpose of the model view, taken from the
+// inverse of its upper 3x3 instead of a full 4x4 inverse
+namespace transforms {
+  // world = parent * translation * rotation * scale, model view = view * world and normal matrix
+  // of every transform, outputs are resized to the transform count
+  void compose(transform_set const& locals, glm::fmat4 const& parent, glm::fmat4 const& view,
+               std::vector<glm::fmat4>& worlds, std::vector<glm::fmat4>& model_views, std::vector<glm::fmat4>& normals);
+  // model view and normal matrix of count world matrices, model_views may be null when only normals are needed
+  void view_matrices(glm::fmat4 const& view, glm::fmat4 const* worlds, std::size_t count, glm::fmat4* model_views, glm::fmat4* normals);
+
+  // single affine matrix, equal to glm::inverseTranspose up to rounding
+  glm::fmat4 normal_matrix(glm::fmat4 const& model_view);
+}
+
+#endif
@@ -5,6 +5,9 @@
 // use gl definitions from glbinding 
 using namespace gl;
 
+#include <string>
+#include <vector>
+
 struct pixel_data;
 struct texture_object;
 
@@ -29,6 +32,11 @@ namespace utils {
   void output_log(GLchar const* log_buffer, std::string const& prefix);
   // read file and write content to string
   std::string read_file(std::string const& name);
+
+  // nearest rank percentile of ascending, non-empty values
+  double percentile(std::vector<double> const& sorted, double p);
+  // text as json string, names are plain ascii, only quotes and backslashes are escaped
+  std::string json_quoted(std::string const& text);
 }
 
 #endif
\ No newline at end of file
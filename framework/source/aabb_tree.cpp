@@ -0,0 +1,624 @@
+#include "aabb_tree.hpp"
+#include "simd_lanes.hpp"
+
+#include <algorithm>
+#include <limits>
+
+const aabb_tree::object aabb_tree::NONE;
+const unsigned aabb_tree::WIDTH;
+const unsigned aabb_tree::LEAF;
+
+static const float INF = std::numeric_limits<float>::infinity();
+// traversal stack entries before it spills to the heap, a built tree of
+// a million objects needs less than a fifth of this
+static const std::size_t LOCAL_STACK = 256;
+
+// child boxes of a node are tested with the widest lanes, in several steps if narrower
+#if defined(SIMD_LANES_AVX)
+typedef simd::avx node_lanes;
+#elif defined(SIMD_LANES_SSE)
+typedef simd::sse node_lanes;
+#else
+typedef simd::scalar node_lanes;
+#endif
+
+typedef float const (&slot_bounds)[6][aabb_tree::WIDTH];
+
+///////////////////////////// ray ////////////////////////////////
+ray::ray()
+ :origin{0.0f}
+ ,direction{0.0f, 0.0f, -1.0f}
+ ,max_distance{INF}
+{}
+
+ray::ray(glm::fvec3 const& o, glm::fvec3 const& d, float m)
+ :origin{o}
+ ,direction{d}
+ ,max_distance{m}
+{}
+
+///////////////////////////// node tests ////////////////////////////////
+// bit per slot of [first, first + width) whose box is within radius of center
+template<typename L>
+static int sphere_lanes(slot_bounds b, unsigned first, glm::fvec3 const& center, float radius) {
+  typedef typename L::type T;
+  T zero = L::set1(0.0f);
+  T c[3] = {L::set1(center.x), L::set1(center.y), L::set1(center.z)};
+  T distance = zero;
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    // only one side can be positive
+    T d = L::max(L::load(&b[axis][first]) - c[axis], zero) + L::max(c[axis] - L::load(&b[axis + 3][first]), zero);
+    distance = distance + d * d;
+  }
+  return L::bits(L::less_equal(distance, L::set1(radius * radius)));
+}
+
+// bit per slot whose box is not entirely behind one of the planes
+template<typename L>
+static int frustum_lanes(slot_bounds b, unsigned first, frustum const& view) {
+  typedef typename L::type T;
+  T lo[3] = {L::load(&b[0][first]), L::load(&b[1][first]), L::load(&b[2][first])};
+  T hi[3] = {L::load(&b[3][first]), L::load(&b[4][first]), L::load(&b[5][first])};
+  typename L::mask inside = L::less_equal(L::set1(0.0f), L::set1(0.0f));
+  for (unsigned p = 0; p < 6; ++p) {
+    // corner furthest along the plane normal
+    T dist = L::set1(view.planes[p].w);
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      T n = L::set1(view.planes[p][axis]);
+      dist = dist + L::max(n * lo[axis], n * hi[axis]);
+    }
+    inside = L::both(inside, L::less_equal(L::set1(0.0f), dist));
+  }
+  return L::bits(inside);
+}
+
+// bit per slot whose box the ray enters before max distance, slab test where
+// nan from zero direction components drops out of min and max
+template<typename L>
+static int ray_lanes(slot_bounds b, unsigned first, ray const& r, glm::fvec3 const& inverse_direction) {
+  typedef typename L::type T;
+  T entry = L::set1(0.0f);
+  T exit = L::set1(r.max_distance);
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    T origin = L::set1(r.origin[axis]);
+    T inverse = L::set1(inverse_direction[axis]);
+    T t0 = (L::load(&b[axis][first]) - origin) * inverse;
+    T t1 = (L::load(&b[axis + 3][first]) - origin) * inverse;
+    entry = L::max(L::min(t0, t1), entry);
+    exit = L::min(L::max(t0, t1), exit);
+  }
+  return L::bits(L::less_equal(entry, exit));
+}
+
+static int sphere_mask(slot_bounds b, glm::fvec3 const& center, float radius) {
+  int mask = 0;
+  for (unsigned first = 0; first < aabb_tree::WIDTH; first += unsigned(node_lanes::width)) {
+    mask |= sphere_lanes<node_lanes>(b, first, center, radius) << first;
+  }
+  return mask;
+}
+
+static int frustum_mask(slot_bounds b, frustum const& view) {
+  int mask = 0;
+  for (unsigned first = 0; first < aabb_tree::WIDTH; first += unsigned(node_lanes::width)) {
+    mask |= frustum_lanes<node_lanes>(b, first, view) << first;
+  }
+  return mask;
+}
+
+static int ray_mask(slot_bounds b, ray const& r, glm::fvec3 const& inverse_direction) {
+  int mask = 0;
+  for (unsigned first = 0; first < aabb_tree::WIDTH; first += unsigned(node_lanes::width)) {
+    mask |= ray_lanes<node_lanes>(b, first, r, inverse_direction) << first;
+  }
+  return mask;
+}
+
+// exact tests of single object boxes
+static bool sphere_box(glm::fvec3 const& center, float radius, glm::fvec3 const& min, glm::fvec3 const& max) {
+  glm::fvec3 closest = glm::clamp(center, min, max) - center;
+  return closest.x * closest.x + closest.y * closest.y + closest.z * closest.z <= radius * radius;
+}
+
+static bool ray_box(ray const& r, glm::fvec3 const& inverse_direction, glm::fvec3 const& min, glm::fvec3 const& max, float& distance) {
+  float entry = 0.0f;
+  float exit = r.max_distance;
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    float t0 = (min[axis] - r.origin[axis]) * inverse_direction[axis];
+    float t1 = (max[axis] - r.origin[axis]) * inverse_direction[axis];
+    entry = simd::scalar::max(simd::scalar::min(t0, t1), entry);
+    exit = simd::scalar::min(simd::scalar::max(t0, t1), exit);
+  }
+  distance = entry;
+  return entry <= exit;
+}
+
+static float surface_area(glm::fvec3 const& min, glm::fvec3 const& max) {
+  glm::fvec3 size = max - min;
+  return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// node indices still to visit, allocates only for unusually deep trees
+class traversal_stack {
+ public:
+  traversal_stack()
+   :m_size{0}
+   ,m_heap{}
+  {}
+
+  void push(unsigned n) {
+    if (m_size < LOCAL_STACK) {
+      m_local[m_size] = n;
+    }
+    else {
+      m_heap.push_back(n);
+    }
+    ++m_size;
+  }
+  unsigned pop() {
+    --m_size;
+    if (m_size < LOCAL_STACK) {
+      return m_local[m_size];
+    }
+    unsigned n = m_heap.back();
+    m_heap.pop_back();
+    return n;
+  }
+  bool empty() const {
+    return m_size == 0;
+  }
+
+ private:
+  std::size_t m_size;
+  unsigned m_local[LOCAL_STACK];
+  std::vector<unsigned> m_heap;
+};
+
+///////////////////////////// aabb_tree ////////////////////////////////
+aabb_tree::aabb_tree(float margin)
+ :m_margin{margin}
+ ,m_nodes{}
+ ,m_free_nodes{}
+ ,m_root{NONE}
+ ,m_mins{}
+ ,m_maxs{}
+ ,m_nodes_of{}
+ ,m_slots_of{}
+ ,m_free_objects{}
+ ,m_size{0}
+ ,m_build_objects{}
+{}
+
+unsigned aabb_tree::allocate_node(unsigned parent, unsigned parent_slot) {
+  unsigned n = 0;
+  if (!m_free_nodes.empty()) {
+    n = m_free_nodes.back();
+    m_free_nodes.pop_back();
+  }
+  else {
+    n = unsigned(m_nodes.size());
+    m_nodes.push_back(node{});
+  }
+  node& created = m_nodes[n];
+  for (unsigned slot = 0; slot < WIDTH; ++slot) {
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      created.bounds[axis][slot] = INF;
+      created.bounds[axis + 3][slot] = -INF;
+    }
+    created.children[slot] = NONE;
+  }
+  created.parent = parent;
+  created.parent_slot = parent_slot;
+  created.used = 0;
+  created.dirty = 0;
+  return n;
+}
+
+void aabb_tree::set_slot(unsigned n, unsigned slot, glm::fvec3 const& min, glm::fvec3 const& max, unsigned child) {
+  node& target = m_nodes[n];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    target.bounds[axis][slot] = min[axis];
+    target.bounds[axis + 3][slot] = max[axis];
+  }
+  target.children[slot] = child;
+  target.used = std::uint8_t(target.used | (1u << slot));
+  if (child & LEAF) {
+    m_nodes_of[child & ~LEAF] = n;
+    m_slots_of[child & ~LEAF] = slot;
+  }
+  else {
+    m_nodes[child].parent = n;
+    m_nodes[child].parent_slot = slot;
+  }
+}
+
+void aabb_tree::clear_slot(unsigned n, unsigned slot) {
+  node& target = m_nodes[n];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    target.bounds[axis][slot] = INF;
+    target.bounds[axis + 3][slot] = -INF;
+  }
+  target.children[slot] = NONE;
+  target.used = std::uint8_t(target.used & ~(1u << slot));
+}
+
+void aabb_tree::bounds(unsigned n, glm::fvec3& min, glm::fvec3& max) const {
+  node const& source = m_nodes[n];
+  min = glm::fvec3{INF};
+  max = glm::fvec3{-INF};
+  for (unsigned slot = 0; slot < WIDTH; ++slot) {
+    if (source.used & (1u << slot)) {
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        min[axis] = std::min(min[axis], source.bounds[axis][slot]);
+        max[axis] = std::max(max[axis], source.bounds[axis + 3][slot]);
+      }
+    }
+  }
+}
+
+void aabb_tree::grow_ancestors(unsigned n, glm::fvec3 const& min, glm::fvec3 const& max) {
+  while (m_nodes[n].parent != NONE) {
+    unsigned slot = m_nodes[n].parent_slot;
+    n = m_nodes[n].parent;
+    node& ancestor = m_nodes[n];
+    bool grown = false;
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      if (min[axis] < ancestor.bounds[axis][slot]) {
+        ancestor.bounds[axis][slot] = min[axis];
+        grown = true;
+      }
+      if (max[axis] > ancestor.bounds[axis + 3][slot]) {
+        ancestor.bounds[axis + 3][slot] = max[axis];
+        grown = true;
+      }
+    }
+    // boxes further up contain this one already
+    if (!grown) {
+      return;
+    }
+  }
+}
+
+void aabb_tree::mark_dirty(unsigned n) {
+  while (n != NONE && !m_nodes[n].dirty) {
+    m_nodes[n].dirty = 1;
+    n = m_nodes[n].parent;
+  }
+}
+
+aabb_tree::object aabb_tree::add(glm::fvec3 const& min, glm::fvec3 const& max) {
+  object o = 0;
+  if (!m_free_objects.empty()) {
+    o = m_free_objects.back();
+    m_free_objects.pop_back();
+  }
+  else {
+    o = object(m_mins.size());
+    m_mins.push_back(min);
+    m_maxs.push_back(max);
+    m_nodes_of.push_back(NONE);
+    m_slots_of.push_back(NONE);
+  }
+  m_mins[o] = min;
+  m_maxs[o] = max;
+  ++m_size;
+
+  glm::fvec3 fat_min = min - glm::fvec3{m_margin};
+  glm::fvec3 fat_max = max + glm::fvec3{m_margin};
+  if (m_root == NONE) {
+    m_root = allocate_node(NONE, NONE);
+  }
+
+  // descend while the node is full, into the child whose box grows least;
+  // turning an object slot into a node costs the whole new box
+  unsigned n = m_root;
+  while (m_nodes[n].used == (1u << WIDTH) - 1) {
+    node const& current = m_nodes[n];
+    unsigned best = 0;
+    float best_cost = INF;
+    for (unsigned slot = 0; slot < WIDTH; ++slot) {
+      glm::fvec3 slot_min{current.bounds[0][slot], current.bounds[1][slot], current.bounds[2][slot]};
+      glm::fvec3 slot_max{current.bounds[3][slot], current.bounds[4][slot], current.bounds[5][slot]};
+      float cost = surface_area(glm::min(slot_min, fat_min), glm::max(slot_max, fat_max));
+      if (!(current.children[slot] & LEAF)) {
+        cost -= surface_area(slot_min, slot_max);
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = slot;
+      }
+    }
+    unsigned child = current.children[best];
+    if (!(child & LEAF)) {
+      n = child;
+      continue;
+    }
+    // push the object down into a new node shared with the inserted one
+    object other = child & ~LEAF;
+    glm::fvec3 other_min{current.bounds[0][best], current.bounds[1][best], current.bounds[2][best]};
+    glm::fvec3 other_max{current.bounds[3][best], current.bounds[4][best], current.bounds[5][best]};
+    unsigned split = allocate_node(n, best);
+    set_slot(split, 0, other_min, other_max, other | LEAF);
+    // grown with the ancestors below
+    set_slot(n, best, other_min, other_max, split);
+    n = split;
+  }
+
+  unsigned slot = 0;
+  while (m_nodes[n].used & (1u << slot)) {
+    ++slot;
+  }
+  set_slot(n, slot, fat_min, fat_max, o | LEAF);
+  grow_ancestors(n, fat_min, fat_max);
+  return o;
+}
+
+void aabb_tree::remove(object o) {
+  unsigned n = m_nodes_of[o];
+  clear_slot(n, m_slots_of[o]);
+  m_nodes_of[o] = NONE;
+  m_slots_of[o] = NONE;
+  m_free_objects.push_back(o);
+  --m_size;
+
+  // drop nodes left empty, the root stays
+  while (m_nodes[n].used == 0 && n != m_root) {
+    unsigned parent = m_nodes[n].parent;
+    clear_slot(parent, m_nodes[n].parent_slot);
+    m_free_nodes.push_back(n);
+    n = parent;
+  }
+  mark_dirty(m_nodes[n].parent);
+}
+
+void aabb_tree::move(object o, glm::fvec3 const& min, glm::fvec3 const& max) {
+  m_mins[o] = min;
+  m_maxs[o] = max;
+  unsigned n = m_nodes_of[o];
+  unsigned slot = m_slots_of[o];
+  node const& holder = m_nodes[n];
+  // still inside the enlarged box
+  if (min.x >= holder.bounds[0][slot] && min.y >= holder.bounds[1][slot] && min.z >= holder.bounds[2][slot] &&
+      max.x <= holder.bounds[3][slot] && max.y <= holder.bounds[4][slot] && max.z <= holder.bounds[5][slot]) {
+    return;
+  }
+  glm::fvec3 fat_min = min - glm::fvec3{m_margin};
+  glm::fvec3 fat_max = max + glm::fvec3{m_margin};
+  set_slot(n, slot, fat_min, fat_max, o | LEAF);
+  grow_ancestors(n, fat_min, fat_max);
+  mark_dirty(m_nodes[n].parent);
+}
+
+std::size_t aabb_tree::refit_node(unsigned n) {
+  node& current = m_nodes[n];
+  if (!current.dirty) {
+    return 0;
+  }
+  current.dirty = 0;
+  std::size_t count = 1;
+  for (unsigned slot = 0; slot < WIDTH; ++slot) {
+    unsigned child = m_nodes[n].children[slot];
+    if (!(m_nodes[n].used & (1u << slot)) || (child & LEAF)) {
+      continue;
+    }
+    count += refit_node(child);
+    glm::fvec3 min{};
+    glm::fvec3 max{};
+    bounds(child, min, max);
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      m_nodes[n].bounds[axis][slot] = min[axis];
+      m_nodes[n].bounds[axis + 3][slot] = max[axis];
+    }
+  }
+  return count;
+}
+
+std::size_t aabb_tree::refit() {
+  return m_root == NONE ? 0 : refit_node(m_root);
+}
+
+unsigned aabb_tree::build_node(unsigned parent, unsigned parent_slot, std::size_t begin, std::size_t end) {
+  unsigned n = allocate_node(parent, parent_slot);
+  glm::fvec3 margin{m_margin};
+  if (end - begin <= WIDTH) {
+    for (std::size_t i = begin; i < end; ++i) {
+      object o = m_build_objects[i].handle;
+      set_slot(n, unsigned(i - begin), m_mins[o] - margin, m_maxs[o] + margin, o | LEAF);
+    }
+    return n;
+  }
+
+  // halve ranges at the median of their longest centroid extent until there is one per slot
+  std::size_t splits[WIDTH + 1] = {begin, end};
+  std::size_t parts = 1;
+  while (parts < WIDTH) {
+    std::size_t halved[WIDTH + 1];
+    for (std::size_t p = 0; p < parts; ++p) {
+      std::size_t first = splits[p];
+      std::size_t last = splits[p + 1];
+      glm::fvec3 lo{INF};
+      glm::fvec3 hi{-INF};
+      for (std::size_t i = first; i < last; ++i) {
+        lo = glm::min(lo, m_build_objects[i].center);
+        hi = glm::max(hi, m_build_objects[i].center);
+      }
+      glm::fvec3 extent = hi - lo;
+      unsigned axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+      std::size_t middle = first + (last - first) / 2;
+      std::nth_element(m_build_objects.begin() + std::ptrdiff_t(first), m_build_objects.begin() + std::ptrdiff_t(middle),
+                       m_build_objects.begin() + std::ptrdiff_t(last), [axis](build_entry const& a, build_entry const& b) {
+        return a.center[axis] < b.center[axis];
+      });
+      halved[2 * p] = first;
+      halved[2 * p + 1] = middle;
+    }
+    halved[2 * parts] = end;
+    parts *= 2;
+    std::copy(halved, halved + parts + 1, splits);
+  }
+
+  for (unsigned slot = 0; slot < WIDTH; ++slot) {
+    std::size_t first = splits[slot];
+    std::size_t last = splits[slot + 1];
+    if (last - first == 1) {
+      object o = m_build_objects[first].handle;
+      set_slot(n, slot, m_mins[o] - margin, m_maxs[o] + margin, o | LEAF);
+      continue;
+    }
+    unsigned child = build_node(n, slot, first, last);
+    glm::fvec3 min{};
+    glm::fvec3 max{};
+    bounds(child, min, max);
+    set_slot(n, slot, min, max, child);
+  }
+  return n;
+}
+
+void aabb_tree::build() {
+  m_build_objects.clear();
+  for (object o = 0; o < m_nodes_of.size(); ++o) {
+    if (m_nodes_of[o] != NONE) {
+      m_build_objects.push_back(build_entry{(m_mins[o] + m_maxs[o]) * 0.5f, o});
+    }
+  }
+  m_nodes.clear();
+  m_free_nodes.clear();
+  m_root = NONE;
+  if (m_build_objects.empty()) {
+    return;
+  }
+  m_root = build_node(NONE, NONE, 0, m_build_objects.size());
+}
+
+void aabb_tree::clear() {
+  m_nodes.clear();
+  m_free_nodes.clear();
+  m_root = NONE;
+  m_mins.clear();
+  m_maxs.clear();
+  m_nodes_of.clear();
+  m_slots_of.clear();
+  m_free_objects.clear();
+  m_size = 0;
+}
+
+glm::fvec3 const& aabb_tree::min(object o) const {
+  return m_mins[o];
+}
+
+glm::fvec3 const& aabb_tree::max(object o) const {
+  return m_maxs[o];
+}
+
+std::size_t aabb_tree::size() const {
+  return m_size;
+}
+
+std::size_t aabb_tree::nodes() const {
+  return m_nodes.size() - m_free_nodes.size();
+}
+
+std::size_t aabb_tree::depth() const {
+  if (m_root == NONE) {
+    return 0;
+  }
+  // node and its level
+  std::vector<std::pair<unsigned, std::size_t>> stack{{m_root, 0}};
+  std::size_t deepest = 0;
+  while (!stack.empty()) {
+    std::pair<unsigned, std::size_t> current = stack.back();
+    stack.pop_back();
+    deepest = std::max(deepest, current.second);
+    node const& n = m_nodes[current.first];
+    for (unsigned slot = 0; slot < WIDTH; ++slot) {
+      if ((n.used & (1u << slot)) && !(n.children[slot] & LEAF)) {
+        stack.push_back(std::make_pair(n.children[slot], current.second + 1));
+      }
+    }
+  }
+  return deepest;
+}
+
+std::size_t aabb_tree::query(glm::fvec3 const& center, float radius, std::vector<object>& out) const {
+  out.clear();
+  if (m_root == NONE) {
+    return 0;
+  }
+  traversal_stack stack{};
+  stack.push(m_root);
+  while (!stack.empty()) {
+    node const& n = m_nodes[stack.pop()];
+    int hits = sphere_mask(n.bounds, center, radius) & n.used;
+    for (unsigned slot = 0; hits != 0; ++slot, hits >>= 1) {
+      if (!(hits & 1)) {
+        continue;
+      }
+      unsigned child = n.children[slot];
+      if (!(child & LEAF)) {
+        stack.push(child);
+      }
+      // slot boxes are enlarged, objects are tested with their own
+      else if (sphere_box(center, radius, m_mins[child & ~LEAF], m_maxs[child & ~LEAF])) {
+        out.push_back(child & ~LEAF);
+      }
+    }
+  }
+  return out.size();
+}
+
+std::size_t aabb_tree::query(frustum const& view, std::vector<object>& out) const {
+  out.clear();
+  if (m_root == NONE) {
+    return 0;
+  }
+  traversal_stack stack{};
+  stack.push(m_root);
+  while (!stack.empty()) {
+    node const& n = m_nodes[stack.pop()];
+    int hits = frustum_mask(n.bounds, view) & n.used;
+    for (unsigned slot = 0; hits != 0; ++slot, hits >>= 1) {
+      if (!(hits & 1)) {
+        continue;
+      }
+      unsigned child = n.children[slot];
+      if (!(child & LEAF)) {
+        stack.push(child);
+      }
+      else if (culling::intersects(view, m_mins[child & ~LEAF], m_maxs[child & ~LEAF])) {
+        out.push_back(child & ~LEAF);
+      }
+    }
+  }
+  return out.size();
+}
+
+std::size_t aabb_tree::query(ray const& r, std::vector<ray_hit>& out) const {
+  out.clear();
+  if (m_root == NONE) {
+    return 0;
+  }
+  glm::fvec3 inverse_direction = glm::fvec3{1.0f} / r.direction;
+  traversal_stack stack{};
+  stack.push(m_root);
+  while (!stack.empty()) {
+    node const& n = m_nodes[stack.pop()];
+    int hits = ray_mask(n.bounds, r, inverse_direction) & n.used;
+    for (unsigned slot = 0; hits != 0; ++slot, hits >>= 1) {
+      if (!(hits & 1)) {
+        continue;
+      }
+      unsigned child = n.children[slot];
+      float distance = 0.0f;
+      if (!(child & LEAF)) {
+        stack.push(child);
+      }
+      else if (ray_box(r, inverse_direction, m_mins[child & ~LEAF], m_maxs[child & ~LEAF], distance)) {
+        out.push_back(ray_hit{child & ~LEAF, distance});
+      }
+    }
+  }
+  std::sort(out.begin(), out.end(), [](ray_hit const& a, ray_hit const& b) {
+    return a.distance < b.distance;
+  });
+  return out.size();
+}
@@ -9,6 +9,10 @@ using namespace gl;
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include <iostream>
+#include <stdexcept>
+
+// permutations double with every flag
+static const std::size_t MAX_PERMUTATION_FLAGS = 6;
 
 Application::Application(std::string const& resource_path)
  :m_resource_path{resource_path}
@@ -29,16 +33,70 @@ void Application::setProjection(glm::fmat4 const& projection_mat) {
   updateProjection();
 }
 
+void Application::setView(glm::fmat4 const& view_transform) {
+  m_view_transform = view_transform;
+  updateView();
+}
+
+glm::fmat4 const& Application::getViewTransform() const {
+  return m_view_transform;
+}
+
 // update shader uniform locations
 void Application::updateUniformLocations() {
   for (auto& pair : m_shaders) {
-    for (auto& uniform : pair.second.u_locs) {
-      // store uniform location in map
-      uniform.second = utils::glGetUniformLocation(pair.second.handle, uniform.first.c_str());
+    updateUniformLocations(pair.second);
+  }
+}
+
+void Application::updateUniformLocations(shader_program& program) {
+  for (auto& uniform : program.u_locs) {
+    // store uniform location in map
+    if (program.defines.empty()) {
+      uniform.second = utils::glGetUniformLocation(program.handle, uniform.first.c_str());
+    }
+    else {
+      // features disabled in a permutation leave their uniforms inactive
+      uniform.second = glGetUniformLocation(program.handle, uniform.first.c_str());
+    }
+  }
+}
+
+void Application::addPermutations(std::string const& name, std::vector<std::string> const& flags) {
+  // every variant is built up front, keep the count manageable
+  if (flags.size() > MAX_PERMUTATION_FLAGS) {
+    std::cerr << "Program \'" << name << "\' has more than " << MAX_PERMUTATION_FLAGS << " permutation flags" << std::endl;
+    throw std::invalid_argument(name);
+  }
+  shader_program base = m_shaders.at(name);
+  std::vector<shader_program*>& variants = m_permutations[name];
+  variants.assign(std::size_t(1) << flags.size(), nullptr);
+
+  for (unsigned mask = 0; mask < variants.size(); ++mask) {
+    shader_program variant = base;
+    std::string variant_name = name;
+    for (unsigned i = 0; i < flags.size(); ++i) {
+      bool enabled = (mask >> i) & 1u;
+      variant.defines.push_back(flags[i] + (enabled ? " 1" : " 0"));
+      if (enabled) {
+        variant_name += "+" + flags[i];
+      }
     }
+    // mask 0 replaces the program itself
+    m_shaders.erase(variant_name);
+    variants[mask] = &m_shaders.emplace(variant_name, variant).first->second;
   }
 }
 
+shader_program const& Application::getPermutation(std::string const& name, unsigned mask) const {
+  return *m_permutations.at(name).at(mask);
+}
+
+void Application::uploadProgramUniforms(std::string const& name) {
+  uploadUniforms();
+  updateProjection();
+}
+
 std::map<std::string, shader_program>& Application::getShaderPrograms() {
   return m_shaders;
 }
\ No newline at end of file
@@ -0,0 +1,415 @@
+#include "asset_manager.hpp"
+
+#include "memory_accounting.hpp"
+#include "texture_loader.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+const AssetManager::handle AssetManager::NONE;
+
+static std::size_t texture_bytes(pixel_data const& pixels) {
+  return pixels.width * pixels.height * memory_accounting::texel_bytes(GL_RGB);
+}
+
+static std::size_t mesh_bytes(model const& data) {
+  return sizeof(GLfloat) * data.data.size() + std::size_t(model::INDEX.size) * data.indices.size();
+}
+
+AssetManager::AssetManager(std::size_t budget, unsigned uploads_per_frame)
+ :m_assets{}
+ ,m_budget{budget}
+ ,m_resident_bytes{0}
+ ,m_uploads_per_frame{std::max(1u, uploads_per_frame)}
+ ,m_frame{1}
+ ,m_jobs{}
+ ,m_mutex{}
+ ,m_finished{}
+ ,m_in_flight{0}
+ ,m_empty_object{}
+ ,m_empty_model{}
+{}
+
+AssetManager::~AssetManager() {
+  jobs::wait(m_jobs);
+  collect();
+  for (handle h = 0; h < m_assets.size(); ++h) {
+    if (m_assets[h].state == RESIDENT) {
+      evict(h);
+    }
+    if (m_assets[h].placeholder_texture != 0) {
+      memory_accounting::release(memory_accounting::TEXTURE, m_assets[h].placeholder_texture);
+      glDeleteTextures(1, &m_assets[h].placeholder_texture);
+    }
+  }
+}
+
+AssetManager::handle AssetManager::texture(std::string const& path, glm::fvec3 const& placeholder_colour, std::string const& name) {
+  asset a{};
+  a.type = TEXTURE;
+  a.name = name;
+  a.path = path;
+  a.placeholder = NONE;
+  a.state = UNLOADED;
+
+  // single texel, so row alignment does not matter
+  std::uint8_t texel[4] = {std::uint8_t(glm::clamp(placeholder_colour.r, 0.0f, 1.0f) * 255.0f + 0.5f),
+                           std::uint8_t(glm::clamp(placeholder_colour.g, 0.0f, 1.0f) * 255.0f + 0.5f),
+                           std::uint8_t(glm::clamp(placeholder_colour.b, 0.0f, 1.0f) * 255.0f + 0.5f), 255};
+  glGenTextures(1, &a.placeholder_texture);
+  glBindTexture(GL_TEXTURE_2D, a.placeholder_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+  memory_accounting::track_texture(a.placeholder_texture, memory_accounting::TEXTURES, 1, 1, GL_RGB8, 0, false, name + " placeholder");
+
+  m_assets.push_back(std::move(a));
+  return handle(m_assets.size() - 1);
+}
+
+AssetManager::handle AssetManager::mesh(model const& data, GLenum draw_mode, std::string const& name) {
+  asset a{};
+  a.type = MESH;
+  a.name = name;
+  a.placeholder = NONE;
+  a.draw_mode = draw_mode;
+  a.pinned = true;
+  a.state = LOADED;
+  a.data = data;
+  m_assets.push_back(std::move(a));
+  handle h = handle(m_assets.size() - 1);
+  upload(h);
+  return h;
+}
+
+AssetManager::handle AssetManager::mesh(std::function<model()> const& load, handle placeholder, GLenum draw_mode, std::string const& name) {
+  asset a{};
+  a.type = MESH;
+  a.name = name;
+  a.load = load;
+  a.placeholder = placeholder;
+  a.draw_mode = draw_mode;
+  a.state = UNLOADED;
+  m_assets.push_back(std::move(a));
+  return handle(m_assets.size() - 1);
+}
+
+void AssetManager::request(handle h, float priority) {
+  asset& a = m_assets.at(h);
+  if (a.last_request != m_frame) {
+    a.last_request = m_frame;
+    a.priority = priority;
+  }
+  else {
+    a.priority = std::max(a.priority, priority);
+  }
+}
+
+void AssetManager::update() {
+  collect();
+
+  std::vector<handle> wanted{};
+  for (handle h = 0; h < m_assets.size(); ++h) {
+    asset const& a = m_assets[h];
+    if (a.state == UNLOADED && a.last_request == m_frame) {
+      wanted.push_back(h);
+    }
+  }
+  std::sort(wanted.begin(), wanted.end(), [this](handle a, handle b) {
+    return more_important(m_assets[a], m_assets[b]);
+  });
+
+  // one load per job and core, without workers one load per frame runs right here
+  unsigned concurrency = jobs::concurrency();
+  for (handle h : wanted) {
+    asset& a = m_assets[h];
+    // the size is known after the first upload, assets that cannot fit are not loaded again
+    if (a.bytes > 0 && !make_room(h, a.bytes, true)) {
+      continue;
+    }
+    if (concurrency < 2) {
+      if (m_in_flight == 0) {
+        a.state = LOADING;
+        ++m_in_flight;
+        load(a, h);
+      }
+      break;
+    }
+    if (m_in_flight >= concurrency) {
+      break;
+    }
+    a.state = LOADING;
+    ++m_in_flight;
+    asset* target = &a;
+    jobs::run([this, target, h]() {
+      load(*target, h);
+    }, &m_jobs);
+  }
+  collect();
+
+  std::vector<handle> loaded{};
+  for (handle h = 0; h < m_assets.size(); ++h) {
+    if (m_assets[h].state == LOADED) {
+      loaded.push_back(h);
+    }
+  }
+  std::sort(loaded.begin(), loaded.end(), [this](handle a, handle b) {
+    return more_important(m_assets[a], m_assets[b]);
+  });
+  for (std::size_t i = 0; i < std::min(loaded.size(), std::size_t(m_uploads_per_frame)); ++i) {
+    upload(loaded[i]);
+  }
+
+  ++m_frame;
+}
+
+void AssetManager::finish() {
+  jobs::wait(m_jobs);
+  collect();
+
+  std::vector<handle> wanted{};
+  for (handle h = 0; h < m_assets.size(); ++h) {
+    asset const& a = m_assets[h];
+    if ((a.state == UNLOADED || a.state == LOADED) && requested(a)) {
+      wanted.push_back(h);
+    }
+  }
+  std::sort(wanted.begin(), wanted.end(), [this](handle a, handle b) {
+    return more_important(m_assets[a], m_assets[b]);
+  });
+
+  for (handle h : wanted) {
+    asset& a = m_assets[h];
+    if (a.state == UNLOADED) {
+      if (a.bytes > 0 && !make_room(h, a.bytes, true)) {
+        continue;
+      }
+      a.state = LOADING;
+      ++m_in_flight;
+      load(a, h);
+      collect();
+    }
+    if (a.state == LOADED) {
+      upload(h);
+    }
+  }
+}
+
+void AssetManager::set_budget(std::size_t bytes) {
+  m_budget = bytes;
+}
+
+std::size_t AssetManager::budget() const {
+  return m_budget;
+}
+
+std::size_t AssetManager::resident_bytes() const {
+  return m_resident_bytes;
+}
+
+bool AssetManager::resident(handle h) const {
+  return m_assets.at(h).state == RESIDENT;
+}
+
+GLuint AssetManager::texture_name(handle h) const {
+  asset const& a = m_assets.at(h);
+  return a.state == RESIDENT ? a.texture : a.placeholder_texture;
+}
+
+model_object const& AssetManager::mesh_object(handle h) const {
+  asset const& a = m_assets.at(h);
+  if (a.state == RESIDENT) {
+    return a.object;
+  }
+  return a.placeholder != NONE ? mesh_object(a.placeholder) : m_empty_object;
+}
+
+model const& AssetManager::mesh_data(handle h) const {
+  asset const& a = m_assets.at(h);
+  if (a.state == RESIDENT) {
+    return a.data;
+  }
+  return a.placeholder != NONE ? mesh_data(a.placeholder) : m_empty_model;
+}
+
+bool AssetManager::more_important(asset const& a, asset const& b) const {
+  if (a.last_request != b.last_request) {
+    return a.last_request > b.last_request;
+  }
+  return a.priority > b.priority;
+}
+
+bool AssetManager::requested(asset const& a) const {
+  // requests of the frame before the last update still count
+  return a.last_request > 0 && a.last_request + 1 >= m_frame;
+}
+
+void AssetManager::load(asset& a, handle h) {
+  bool success = true;
+  try {
+    if (a.type == TEXTURE) {
+      a.pixels = texture_loader::file(a.path);
+    }
+    else {
+      a.data = a.load();
+    }
+  }
+  catch (std::exception const& e) {
+    std::cerr << "Asset \'" << a.name << "\' could not be loaded - " << e.what() << std::endl;
+    success = false;
+  }
+  std::lock_guard<std::mutex> lock{m_mutex};
+  m_finished.emplace_back(h, success);
+}
+
+void AssetManager::collect() {
+  std::vector<std::pair<handle, bool>> finished{};
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    finished.swap(m_finished);
+  }
+  for (auto const& result : finished) {
+    asset& a = m_assets[result.first];
+    --m_in_flight;
+    a.state = result.second ? LOADED : FAILED;
+  }
+}
+
+void AssetManager::upload(handle h) {
+  asset& a = m_assets[h];
+  std::size_t bytes = a.type == TEXTURE ? texture_bytes(a.pixels) : mesh_bytes(a.data);
+  if (!a.pinned && !make_room(h, bytes, false)) {
+    // remember the size, so it is only loaded again once it fits
+    a.pixels = pixel_data{};
+    a.data = model{};
+    a.bytes = bytes;
+    a.state = UNLOADED;
+    return;
+  }
+
+  if (a.type == TEXTURE) {
+    glGenTextures(1, &a.texture);
+    glBindTexture(GL_TEXTURE_2D, a.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, GLsizei(a.pixels.width), GLsizei(a.pixels.height), 0, a.pixels.channels, a.pixels.channel_type, a.pixels.ptr());
+    memory_accounting::track_texture(a.texture, memory_accounting::TEXTURES, unsigned(a.pixels.width), unsigned(a.pixels.height), GL_RGB, 0, false, a.name);
+    // the image is uploaded again from the file after eviction
+    a.pixels = pixel_data{};
+  }
+  else {
+    upload_mesh(a);
+  }
+
+  a.bytes = bytes;
+  a.state = RESIDENT;
+  if (!a.pinned) {
+    m_resident_bytes += bytes;
+  }
+}
+
+void AssetManager::upload_mesh(asset& a) {
+  model const& data = a.data;
+  model_object& object = a.object;
+
+  glGenVertexArrays(1, &object.vertex_AO);
+  glBindVertexArray(object.vertex_AO);
+
+  glGenBuffers(1, &object.vertex_BO);
+  glBindBuffer(GL_ARRAY_BUFFER, object.vertex_BO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * data.data.size(), data.data.data(), GL_STATIC_DRAW);
+  memory_accounting::track_buffer(object.vertex_BO, memory_accounting::GEOMETRY, sizeof(GLfloat) * data.data.size(), a.name + " vertices");
+
+  // attribute locations follow the order of model::VERTEX_ATTRIBS
+  for (std::size_t i = 0; i < model::VERTEX_ATTRIBS.size(); ++i) {
+    model::attribute const& attribute = model::VERTEX_ATTRIBS[i];
+    auto offset = data.offsets.find(attribute.flag);
+    if (offset == data.offsets.end()) {
+      continue;
+    }
+    glEnableVertexAttribArray(GLuint(i));
+    glVertexAttribPointer(GLuint(i), attribute.components, attribute.type, GL_FALSE, data.vertex_bytes, offset->second);
+  }
+
+  if (!data.indices.empty()) {
+    glGenBuffers(1, &object.element_BO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.element_BO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, model::INDEX.size * data.indices.size(), data.indices.data(), GL_STATIC_DRAW);
+    memory_accounting::track_buffer(object.element_BO, memory_accounting::GEOMETRY, model::INDEX.size * data.indices.size(), a.name + " indices");
+    object.num_elements = GLsizei(data.indices.size());
+  }
+  else {
+    object.num_elements = GLsizei(data.vertex_num);
+  }
+  object.draw_mode = a.draw_mode;
+  glBindVertexArray(0);
+
+  // vertices stay on the cpu for culling and software rendering
+  memory_accounting::track_host(&a.data, memory_accounting::GEOMETRY, sizeof(GLfloat) * data.data.size() + model::INDEX.size * data.indices.size(), a.name);
+}
+
+bool AssetManager::make_room(handle h, std::size_t bytes, bool check_only) {
+  // least important resident assets first
+  std::vector<handle> victims{};
+  for (handle v = 0; v < m_assets.size(); ++v) {
+    asset const& candidate = m_assets[v];
+    if (v != h && candidate.state == RESIDENT && !candidate.pinned && more_important(m_assets[h], candidate)) {
+      victims.push_back(v);
+    }
+  }
+  std::sort(victims.begin(), victims.end(), [this](handle a, handle b) {
+    return more_important(m_assets[b], m_assets[a]);
+  });
+
+  std::size_t global_budget = memory_accounting::budget(memory_accounting::GPU);
+  std::size_t global_used = memory_accounting::usage(memory_accounting::GPU).live_bytes;
+  std::size_t freed = 0;
+  auto fits = [&]() {
+    return (m_budget == 0 || m_resident_bytes - freed + bytes <= m_budget) &&
+           (global_budget == 0 || global_used - freed + bytes <= global_budget);
+  };
+  std::size_t count = 0;
+  while (!fits() && count < victims.size()) {
+    freed += m_assets[victims[count++]].bytes;
+  }
+  if (!fits()) {
+    return false;
+  }
+  if (!check_only) {
+    for (std::size_t i = 0; i < count; ++i) {
+      evict(victims[i]);
+    }
+  }
+  return true;
+}
+
+void AssetManager::evict(handle h) {
+  asset& a = m_assets[h];
+  if (a.type == TEXTURE) {
+    memory_accounting::release(memory_accounting::TEXTURE, a.texture);
+    glDeleteTextures(1, &a.texture);
+    a.texture = 0;
+  }
+  else {
+    model_object& object = a.object;
+    memory_accounting::release(memory_accounting::BUFFER, object.vertex_BO);
+    glDeleteBuffers(1, &object.vertex_BO);
+    if (object.element_BO != 0) {
+      memory_accounting::release(memory_accounting::BUFFER, object.element_BO);
+      glDeleteBuffers(1, &object.element_BO);
+    }
+    glDeleteVertexArrays(1, &object.vertex_AO);
+    object = model_object{};
+    memory_accounting::release_host(&a.data);
+    a.data = model{};
+  }
+  if (!a.pinned) {
+    m_resident_bytes -= a.bytes;
+  }
+  a.state = UNLOADED;
+}
@@ -0,0 +1,133 @@
+#include "clustered_lighting.hpp"
+
+#include "memory_accounting.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+
+// write data to the start of a texture buffer, growing it geometrically so a
+// slowly rising light count does not reallocate every frame; when growing,
+// data is padded to the new capacity so the storage is allocated with it
+template <typename T>
+static void upload(GLuint buffer, std::size_t& capacity, std::vector<T>& data, char const* name) {
+  std::size_t bytes = sizeof(T) * data.size();
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  if (bytes > capacity) {
+    capacity = sizeof(T) * std::max(data.size(), (capacity + capacity / 2) / sizeof(T));
+    data.resize(capacity / sizeof(T));
+    glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(capacity), data.data(), GL_STREAM_DRAW);
+    memory_accounting::track_buffer(buffer, memory_accounting::INSTANCES, capacity, name);
+  }
+  else {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, GLsizeiptr(bytes), data.data());
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusteredLighting::ClusteredLighting(cluster_grid const& grid)
+ :m_grid{grid}
+ ,m_projection{0.0f}
+ ,m_volumes{}
+ ,m_tile_scale{0.0f}
+ ,m_view_lights{}
+ ,m_visible{}
+ ,m_visible_ids{}
+ ,m_clusters{}
+ ,m_light_data{}
+ ,m_cluster_data{}
+ ,m_light_buffer{0}
+ ,m_light_texture{0}
+ ,m_cluster_buffer{0}
+ ,m_cluster_texture{0}
+ ,m_light_capacity{0}
+ ,m_cluster_capacity{0}
+{
+  glGenBuffers(1, &m_light_buffer);
+  glGenBuffers(1, &m_cluster_buffer);
+  // start with room for one light and empty clusters, so the textures are never unbacked
+  m_light_data.resize(2);
+  m_cluster_data.resize(2 * m_grid.size());
+  upload(m_light_buffer, m_light_capacity, m_light_data, "cluster light data");
+  upload(m_cluster_buffer, m_cluster_capacity, m_cluster_data, "cluster light lists");
+
+  glGenTextures(1, &m_light_texture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_light_texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_light_buffer);
+  glGenTextures(1, &m_cluster_texture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_cluster_texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_cluster_buffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusteredLighting::~ClusteredLighting() {
+  glDeleteTextures(1, &m_light_texture);
+  glDeleteTextures(1, &m_cluster_texture);
+  for (GLuint buffer : {m_light_buffer, m_cluster_buffer}) {
+    memory_accounting::release(memory_accounting::BUFFER, buffer);
+  }
+  glDeleteBuffers(1, &m_light_buffer);
+  glDeleteBuffers(1, &m_cluster_buffer);
+}
+
+void ClusteredLighting::update(std::vector<point_light> const& lights, glm::fmat4 const& view, glm::fmat4 const& projection, glm::uvec2 const& viewport) {
+  if (projection != m_projection) {
+    m_projection = projection;
+    m_volumes = clustering::volumes(m_grid, projection);
+  }
+  m_tile_scale = glm::fvec2{float(m_grid.tiles_x) / float(std::max(viewport.x, 1u)), float(m_grid.tiles_y) / float(std::max(viewport.y, 1u))};
+
+  // lights to view space, then keep those intersecting the frustum
+  m_view_lights.clear();
+  for (point_light const& light : lights) {
+    m_view_lights.add(glm::fvec3{view * glm::fvec4{light.position, 1.0f}}, light.radius);
+  }
+  culling::cull(frustum{projection}, m_view_lights, m_visible_ids);
+  m_visible.clear();
+  m_light_data.clear();
+  for (unsigned i : m_visible_ids) {
+    glm::fvec3 center{m_view_lights.center_x[i], m_view_lights.center_y[i], m_view_lights.center_z[i]};
+    m_visible.add(center, m_view_lights.radius[i]);
+    m_light_data.push_back(glm::fvec4{center, lights[i].radius});
+    m_light_data.push_back(glm::fvec4{lights[i].colour, 0.0f});
+  }
+
+  clustering::assign(m_grid, m_volumes, m_visible, m_clusters);
+
+  // ranges point past themselves into the same buffer
+  unsigned first_index = unsigned(m_clusters.ranges.size());
+  m_cluster_data.resize(m_clusters.ranges.size() + m_clusters.indices.size());
+  for (std::size_t c = 0; c < m_clusters.ranges.size(); c += 2) {
+    m_cluster_data[c] = m_clusters.ranges[c] + first_index;
+    m_cluster_data[c + 1] = m_clusters.ranges[c + 1];
+  }
+  std::copy(m_clusters.indices.begin(), m_clusters.indices.end(), m_cluster_data.begin() + std::ptrdiff_t(first_index));
+
+  upload(m_light_buffer, m_light_capacity, m_light_data, "cluster light data");
+  upload(m_cluster_buffer, m_cluster_capacity, m_cluster_data, "cluster light lists");
+}
+
+void ClusteredLighting::bind(unsigned light_unit, unsigned cluster_unit) const {
+  glActiveTexture(GLenum(unsigned(GL_TEXTURE0) + light_unit));
+  glBindTexture(GL_TEXTURE_BUFFER, m_light_texture);
+  glActiveTexture(GLenum(unsigned(GL_TEXTURE0) + cluster_unit));
+  glBindTexture(GL_TEXTURE_BUFFER, m_cluster_texture);
+}
+
+cluster_grid const& ClusteredLighting::grid() const {
+  return m_grid;
+}
+
+glm::fvec2 ClusteredLighting::tile_scale() const {
+  return m_tile_scale;
+}
+
+light_clusters const& ClusteredLighting::clusters() const {
+  return m_clusters;
+}
+
+std::size_t ClusteredLighting::visible_lights() const {
+  return m_visible.size();
+}
@@ -0,0 +1,129 @@
+#include "file_watcher.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+  #include <sys/inotify.h>
+  #include <cerrno>
+  #include <unistd.h>
+#else
+  #include <sys/stat.h>
+  #include <sys/types.h>
+#endif
+
+#ifdef __linux__
+
+// directory part of path including the separator, empty for bare file names
+static std::string directory_of(std::string const& path) {
+  std::size_t separator = path.find_last_of("/\\");
+  return separator == std::string::npos ? std::string{} : path.substr(0, separator + 1);
+}
+
+FileWatcher::FileWatcher()
+ :m_files{}
+ ,m_fd{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}
+ ,m_directories{}
+{
+  if (m_fd < 0) {
+    std::cerr << "File watching unavailable, inotify failed with error " << errno << std::endl;
+  }
+}
+
+FileWatcher::~FileWatcher() {
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+void FileWatcher::watch(std::string const& path) {
+  if (!m_files.insert(path).second || m_fd < 0) {
+    return;
+  }
+  std::string directory = directory_of(path);
+  for (auto const& pair : m_directories) {
+    if (pair.second == directory) {
+      return;
+    }
+  }
+  // writes in place end with close, replacing saves end with a move
+  int descriptor = inotify_add_watch(m_fd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (descriptor < 0) {
+    std::cerr << "Directory \'" << directory << "\' could not be watched" << std::endl;
+    return;
+  }
+  m_directories[descriptor] = directory;
+}
+
+std::vector<std::string> FileWatcher::poll() {
+  std::set<std::string> changed{};
+  if (m_fd >= 0) {
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length = 0;
+    while ((length = read(m_fd, buffer, sizeof(buffer))) > 0) {
+      for (char* position = buffer; position < buffer + length; ) {
+        inotify_event const* event = reinterpret_cast<inotify_event const*>(position);
+        position += sizeof(inotify_event) + event->len;
+        auto directory = m_directories.find(event->wd);
+        if (event->len == 0 || directory == m_directories.end()) {
+          continue;
+        }
+        std::string path = directory->second + event->name;
+        if (m_files.count(path)) {
+          changed.insert(path);
+        }
+      }
+    }
+  }
+  return std::vector<std::string>{changed.begin(), changed.end()};
+}
+
+#else
+
+// stat calls are not free, check at most this often
+static const double CHECK_INTERVAL = 0.25;
+
+static long long modification_time(std::string const& path) {
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    return -1;
+  }
+  return static_cast<long long>(status.st_mtime);
+}
+
+static double seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FileWatcher::FileWatcher()
+ :m_files{}
+ ,m_times{}
+ ,m_last_check{0.0}
+{}
+
+FileWatcher::~FileWatcher() {}
+
+void FileWatcher::watch(std::string const& path) {
+  if (m_files.insert(path).second) {
+    m_times[path] = modification_time(path);
+  }
+}
+
+std::vector<std::string> FileWatcher::poll() {
+  std::vector<std::string> changed{};
+  double now = seconds();
+  if (now - m_last_check < CHECK_INTERVAL) {
+    return changed;
+  }
+  m_last_check = now;
+  for (auto& pair : m_times) {
+    long long time = modification_time(pair.first);
+    if (time != pair.second) {
+      pair.second = time;
+      changed.push_back(pair.first);
+    }
+  }
+  return changed;
+}
+
+#endif
@@ -0,0 +1,300 @@
+#include "frustum_culling.hpp"
+#include "jobs.hpp"
+#include "simd_lanes.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+// objects per thread before the test is split across cores
+static const std::size_t PARALLEL_GRAIN = 1 << 16;
+// below this count, handing out jobs costs more than it saves
+static const std::size_t PARALLEL_THRESHOLD = 1 << 18;
+
+///////////////////////////// frustum ////////////////////////////////
+frustum::frustum() {
+  for (unsigned i = 0; i < 6; ++i) {
+    planes[i] = glm::fvec4{0.0f};
+  }
+}
+
+// Gribb & Hartmann plane extraction, glm matrices are column major
+frustum::frustum(glm::fmat4 const& m) {
+  glm::fvec4 row0{m[0][0], m[1][0], m[2][0], m[3][0]};
+  glm::fvec4 row1{m[0][1], m[1][1], m[2][1], m[3][1]};
+  glm::fvec4 row2{m[0][2], m[1][2], m[2][2], m[3][2]};
+  glm::fvec4 row3{m[0][3], m[1][3], m[2][3], m[3][3]};
+  // left, right, bottom, top, near, far
+  planes[0] = row3 + row0;
+  planes[1] = row3 - row0;
+  planes[2] = row3 + row1;
+  planes[3] = row3 - row1;
+  planes[4] = row3 + row2;
+  planes[5] = row3 - row2;
+  // normalize so distances are euclidean and comparable to radii
+  for (unsigned i = 0; i < 6; ++i) {
+    planes[i] /= glm::length(glm::fvec3{planes[i]});
+  }
+}
+
+///////////////////////////// volume sets ////////////////////////////////
+std::size_t sphere_set::add(glm::fvec3 const& center, float r) {
+  center_x.push_back(center.x);
+  center_y.push_back(center.y);
+  center_z.push_back(center.z);
+  radius.push_back(r);
+  return radius.size() - 1;
+}
+
+void sphere_set::set(std::size_t i, glm::fvec3 const& center, float r) {
+  center_x[i] = center.x;
+  center_y[i] = center.y;
+  center_z[i] = center.z;
+  radius[i] = r;
+}
+
+void sphere_set::clear() {
+  center_x.clear();
+  center_y.clear();
+  center_z.clear();
+  radius.clear();
+}
+
+std::size_t sphere_set::size() const {
+  return radius.size();
+}
+
+std::size_t box_set::add(glm::fvec3 const& min, glm::fvec3 const& max) {
+  min_x.push_back(min.x);
+  min_y.push_back(min.y);
+  min_z.push_back(min.z);
+  max_x.push_back(max.x);
+  max_y.push_back(max.y);
+  max_z.push_back(max.z);
+  return min_x.size() - 1;
+}
+
+void box_set::set(std::size_t i, glm::fvec3 const& min, glm::fvec3 const& max) {
+  min_x[i] = min.x;
+  min_y[i] = min.y;
+  min_z[i] = min.z;
+  max_x[i] = max.x;
+  max_y[i] = max.y;
+  max_z[i] = max.z;
+}
+
+void box_set::clear() {
+  min_x.clear();
+  min_y.clear();
+  min_z.clear();
+  max_x.clear();
+  max_y.clear();
+  max_z.clear();
+}
+
+std::size_t box_set::size() const {
+  return min_x.size();
+}
+
+namespace culling {
+
+bool intersects(frustum const& view, glm::fvec3 const& center, float radius) {
+  for (unsigned p = 0; p < 6; ++p) {
+    glm::fvec4 const& plane = view.planes[p];
+    if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool intersects(frustum const& view, glm::fvec3 const& min, glm::fvec3 const& max) {
+  for (unsigned p = 0; p < 6; ++p) {
+    glm::fvec4 const& plane = view.planes[p];
+    // test corner furthest along the plane normal
+    float dist = std::max(plane.x * min.x, plane.x * max.x)
+               + std::max(plane.y * min.y, plane.y * max.y)
+               + std::max(plane.z * min.z, plane.z * max.z)
+               + plane.w;
+    if (dist < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// test spheres [begin, end), write visible indices to out, return count
+std::size_t cull_range(frustum const& view, sphere_set const& s, std::size_t begin, std::size_t end, unsigned* out) {
+  std::size_t count = 0;
+  std::size_t i = begin;
+#ifdef SIMD_LANES_AVX
+  // broadcast plane components once
+  __m256 wide_planes[6][4];
+  for (unsigned p = 0; p < 6; ++p) {
+    for (unsigned c = 0; c < 4; ++c) {
+      wide_planes[p][c] = _mm256_set1_ps(view.planes[p][c]);
+    }
+  }
+  for (; i + 8 <= end; i += 8) {
+    __m256 cx = _mm256_loadu_ps(&s.center_x[i]);
+    __m256 cy = _mm256_loadu_ps(&s.center_y[i]);
+    __m256 cz = _mm256_loadu_ps(&s.center_z[i]);
+    __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&s.radius[i]));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (unsigned p = 0; p < 6; ++p) {
+      __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(wide_planes[p][0], cx),
+                                                _mm256_mul_ps(wide_planes[p][1], cy)),
+                                  _mm256_add_ps(_mm256_mul_ps(wide_planes[p][2], cz),
+                                                wide_planes[p][3]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, neg_r, _CMP_GE_OQ));
+    }
+    count = simd::compact(out, count, unsigned(i), _mm256_movemask_ps(inside), 8);
+  }
+#endif
+#ifdef SIMD_LANES_SSE
+  // broadcast plane components once
+  __m128 planes[6][4];
+  for (unsigned p = 0; p < 6; ++p) {
+    for (unsigned c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(view.planes[p][c]);
+    }
+  }
+  for (; i + 4 <= end; i += 4) {
+    __m128 cx = _mm_loadu_ps(&s.center_x[i]);
+    __m128 cy = _mm_loadu_ps(&s.center_y[i]);
+    __m128 cz = _mm_loadu_ps(&s.center_z[i]);
+    __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&s.radius[i]));
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (unsigned p = 0; p < 6; ++p) {
+      __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], cx),
+                                          _mm_mul_ps(planes[p][1], cy)),
+                               _mm_add_ps(_mm_mul_ps(planes[p][2], cz),
+                                          planes[p][3]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, neg_r));
+    }
+    count = simd::compact(out, count, unsigned(i), _mm_movemask_ps(inside), 4);
+  }
+#endif
+  for (; i < end; ++i) {
+    glm::fvec3 center{s.center_x[i], s.center_y[i], s.center_z[i]};
+    count = simd::compact(out, count, unsigned(i), intersects(view, center, s.radius[i]) ? 1 : 0, 1);
+  }
+  return count;
+}
+
+// test boxes [begin, end), write visible indices to out, return count
+std::size_t cull_range(frustum const& view, box_set const& b, std::size_t begin, std::size_t end, unsigned* out) {
+  std::size_t count = 0;
+  std::size_t i = begin;
+#ifdef SIMD_LANES_AVX
+  __m256 wide_planes[6][4];
+  for (unsigned p = 0; p < 6; ++p) {
+    for (unsigned c = 0; c < 4; ++c) {
+      wide_planes[p][c] = _mm256_set1_ps(view.planes[p][c]);
+    }
+  }
+  for (; i + 8 <= end; i += 8) {
+    __m256 min_x = _mm256_loadu_ps(&b.min_x[i]);
+    __m256 min_y = _mm256_loadu_ps(&b.min_y[i]);
+    __m256 min_z = _mm256_loadu_ps(&b.min_z[i]);
+    __m256 max_x = _mm256_loadu_ps(&b.max_x[i]);
+    __m256 max_y = _mm256_loadu_ps(&b.max_y[i]);
+    __m256 max_z = _mm256_loadu_ps(&b.max_z[i]);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (unsigned p = 0; p < 6; ++p) {
+      __m256 const& nx = wide_planes[p][0];
+      __m256 const& ny = wide_planes[p][1];
+      __m256 const& nz = wide_planes[p][2];
+      __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_max_ps(_mm256_mul_ps(nx, min_x), _mm256_mul_ps(nx, max_x)),
+                                                _mm256_max_ps(_mm256_mul_ps(ny, min_y), _mm256_mul_ps(ny, max_y))),
+                                  _mm256_add_ps(_mm256_max_ps(_mm256_mul_ps(nz, min_z), _mm256_mul_ps(nz, max_z)),
+                                                wide_planes[p][3]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    count = simd::compact(out, count, unsigned(i), _mm256_movemask_ps(inside), 8);
+  }
+#endif
+#ifdef SIMD_LANES_SSE
+  __m128 planes[6][4];
+  for (unsigned p = 0; p < 6; ++p) {
+    for (unsigned c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(view.planes[p][c]);
+    }
+  }
+  for (; i + 4 <= end; i += 4) {
+    __m128 min_x = _mm_loadu_ps(&b.min_x[i]);
+    __m128 min_y = _mm_loadu_ps(&b.min_y[i]);
+    __m128 min_z = _mm_loadu_ps(&b.min_z[i]);
+    __m128 max_x = _mm_loadu_ps(&b.max_x[i]);
+    __m128 max_y = _mm_loadu_ps(&b.max_y[i]);
+    __m128 max_z = _mm_loadu_ps(&b.max_z[i]);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (unsigned p = 0; p < 6; ++p) {
+      __m128 const& nx = planes[p][0];
+      __m128 const& ny = planes[p][1];
+      __m128 const& nz = planes[p][2];
+      __m128 dist = _mm_add_ps(_mm_add_ps(_mm_max_ps(_mm_mul_ps(nx, min_x), _mm_mul_ps(nx, max_x)),
+                                          _mm_max_ps(_mm_mul_ps(ny, min_y), _mm_mul_ps(ny, max_y))),
+                               _mm_add_ps(_mm_max_ps(_mm_mul_ps(nz, min_z), _mm_mul_ps(nz, max_z)),
+                                          planes[p][3]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+    }
+    count = simd::compact(out, count, unsigned(i), _mm_movemask_ps(inside), 4);
+  }
+#endif
+  for (; i < end; ++i) {
+    glm::fvec3 min{b.min_x[i], b.min_y[i], b.min_z[i]};
+    glm::fvec3 max{b.max_x[i], b.max_y[i], b.max_z[i]};
+    count = simd::compact(out, count, unsigned(i), intersects(view, min, max) ? 1 : 0, 1);
+  }
+  return count;
+}
+
+// run test on one thread for small sets, otherwise split into contiguous
+// ranges, each writing into its own part of the output, then close the gaps
+template<typename T>
+std::size_t cull_set(frustum const& view, T const& set, std::vector<unsigned>& visible) {
+  std::size_t num = set.size();
+  visible.resize(num);
+  if (num == 0) {
+    return 0;
+  }
+
+  std::size_t threads = std::min(std::size_t(jobs::concurrency()), num / PARALLEL_GRAIN);
+  if (num < PARALLEL_THRESHOLD || threads < 2) {
+    std::size_t count = cull_range(view, set, 0, num, visible.data());
+    visible.resize(count);
+    return count;
+  }
+
+  // keep ranges a multiple of the simd width
+  std::size_t range = ((num / threads) + 7) & ~std::size_t(7);
+  std::vector<std::size_t> counts(threads, 0);
+  jobs::parallel_for(0, threads, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; ++t) {
+      std::size_t begin = std::min(num, t * range);
+      std::size_t end = (t + 1 == threads) ? num : std::min(num, begin + range);
+      counts[t] = cull_range(view, set, begin, end, visible.data() + begin);
+    }
+  });
+
+  std::size_t count = counts[0];
+  for (std::size_t t = 1; t < threads; ++t) {
+    std::size_t begin = std::min(num, t * range);
+    std::memmove(visible.data() + count, visible.data() + begin, counts[t] * sizeof(unsigned));
+    count += counts[t];
+  }
+  visible.resize(count);
+  return count;
+}
+
+std::size_t cull(frustum const& view, sphere_set const& spheres, std::vector<unsigned>& visible) {
+  return cull_set(view, spheres, visible);
+}
+
+std::size_t cull(frustum const& view, box_set const& boxes, std::vector<unsigned>& visible) {
+  return cull_set(view, boxes, visible);
+}
+
+};
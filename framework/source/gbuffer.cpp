@@ -0,0 +1,78 @@
+#include "gbuffer.hpp"
+
+#include "memory_accounting.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+const std::size_t GBuffer::MAX_BYTES_PER_PIXEL;
+
+// albedo and material, normal split into bytes
+static const GLenum ALBEDO_FORMAT = GL_RGBA8;
+static const GLenum NORMAL_FORMAT = GL_RGBA8;
+// as PostProcessing allocates depth attachments
+static const GLenum DEPTH_FORMAT = GL_DEPTH_COMPONENT24;
+
+GBuffer::GBuffer(RenderTargetPool& pool)
+ :m_pool(pool)
+ ,m_albedo{0}
+ ,m_normal{0}
+ ,m_depth{0}
+ ,m_vertex_array{0}
+{
+  // wider attachments would have to be paid for in every frame
+  if (bytes_per_pixel() > MAX_BYTES_PER_PIXEL) {
+    std::cerr << "Geometry buffer needs " << bytes_per_pixel() << " bytes per pixel, more than "
+              << MAX_BYTES_PER_PIXEL << std::endl;
+    throw std::logic_error("geometry buffer exceeds bandwidth budget");
+  }
+  glGenVertexArrays(1, &m_vertex_array);
+}
+
+GBuffer::~GBuffer() {
+  release();
+  glDeleteVertexArrays(1, &m_vertex_array);
+}
+
+void GBuffer::bind(glm::uvec2 const& size, GLuint depth) {
+  if (m_albedo == 0) {
+    m_albedo = m_pool.acquire(size, ALBEDO_FORMAT);
+    m_normal = m_pool.acquire(size, NORMAL_FORMAT);
+  }
+  m_depth = depth;
+  glBindFramebuffer(GL_FRAMEBUFFER, m_pool.framebuffer(std::vector<GLuint>{m_albedo, m_normal}, m_depth));
+  glViewport(0, 0, GLsizei(size.x), GLsizei(size.y));
+}
+
+void GBuffer::bind_textures(unsigned unit) const {
+  GLuint textures[3] = {m_albedo, m_normal, m_depth};
+  for (unsigned i = 0; i < 3; ++i) {
+    glActiveTexture(GLenum(unsigned(GL_TEXTURE0) + unit + i));
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+  }
+}
+
+void GBuffer::draw_fullscreen() const {
+  glBindVertexArray(m_vertex_array);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void GBuffer::release() {
+  if (m_albedo != 0) {
+    m_pool.release(m_albedo);
+    m_pool.release(m_normal);
+  }
+  m_albedo = 0;
+  m_normal = 0;
+  m_depth = 0;
+}
+
+std::size_t GBuffer::bytes_per_pixel() {
+  return memory_accounting::texel_bytes(ALBEDO_FORMAT) + memory_accounting::texel_bytes(NORMAL_FORMAT)
+       + memory_accounting::texel_bytes(DEPTH_FORMAT);
+}
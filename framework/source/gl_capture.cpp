@@ -0,0 +1,1080 @@
+#include "gl_capture.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+#include <glbinding/Binding.h>
+#include <glbinding/AbstractValue.h>
+#include <glbinding/FunctionCall.h>
+#include <glbinding/callbacks.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+// trace layout: header of magic, version and framebuffer size, followed by
+// records starting with a tag; integers are little endian base 128 varints,
+// signed ones zigzag encoded, data blocks are prefixed with their size
+static const char TRACE_MAGIC[8] = {'G', 'L', 'T', 'R', 'A', 'C', 'E', '\0'};
+static const std::uint64_t TRACE_VERSION = 1;
+enum record_tag : std::uint8_t {
+  // function index and name, before its first call
+  TAG_FUNCTION = 1,
+  // function index, parameters, return value and data blocks
+  TAG_CALL = 2,
+  // name and printed parameters of a call outside the function table
+  TAG_UNKNOWN = 3,
+  TAG_SETUP = 4,
+  TAG_FRAME = 5
+};
+
+// parameter kinds, one character per parameter of a function:
+//   -  value, replayed as recorded
+//   o  byte offset into a bound buffer, passed as pointer
+//   B T V F R P Q  name of a buffer, texture, vertex array, framebuffer,
+//      renderbuffer, program or shader, query
+//   b t v f r q  array of names of that kind, counted by the first parameter
+//   L  uniform location in the current program
+//   K  uniform block index in the program of the first parameter
+//   d  client data, size computed from the other parameters
+//   z  null terminated string
+//   s  shader source strings, counted by the second parameter
+//   w  output written by gl
+//   n  pointer replayed as null
+static const char NAME_KINDS[] = "BTVFRPQ";
+// what a call does besides its gl effect:
+//   -  nothing
+//   G  fills its name array with new names
+//   D  deletes its names
+//   C  returns a new program or shader
+//   L  returns a uniform location, K a uniform block index
+//   M  maps the buffer of the target in the first parameter, U unmaps it and
+//      records the contents written through the mapped pointer
+//   S  selects the current program
+//   X  not replayed
+static const std::size_t OUTPUT_SIZE = 256;
+
+// bytes read or written at parameter from the recorded values of all parameters
+typedef std::size_t (*data_size)(std::int64_t const* values, std::size_t parameter);
+
+struct function_entry {
+  glbinding::AbstractFunction* function;
+  char const* kinds;
+  char effect;
+  bool returns_value;
+  data_size size;
+  // set the typed glbinding callbacks recording calls and clear them again
+  void (*install)(function_entry const& entry);
+  void (*uninstall)(function_entry const& entry);
+  // call with replayed values, returns the result as value
+  std::int64_t (*replay)(function_entry const& entry, std::int64_t const* values);
+  std::uint32_t index;
+};
+
+static void record_call(function_entry const& entry, std::int64_t const* values);
+static void record_unmap(function_entry const& entry, std::int64_t const* values);
+
+///////////////////////////////////////////////////////////////////////////////
+// conversion of parameters and return values to and from 64 bit values
+
+template<typename T, typename Enable = void>
+struct value_codec;
+
+template<typename T>
+struct value_codec<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+  static std::int64_t encode(T value) {
+    return std::int64_t(value);
+  }
+  static T decode(std::int64_t value) {
+    return T(value);
+  }
+};
+
+template<typename T>
+struct value_codec<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  typedef typename std::underlying_type<T>::type underlying;
+  static std::int64_t encode(T value) {
+    return std::int64_t(static_cast<underlying>(value));
+  }
+  static T decode(std::int64_t value) {
+    return static_cast<T>(underlying(value));
+  }
+};
+
+template<typename T>
+struct value_codec<T, typename std::enable_if<std::is_pointer<T>::value>::type> {
+  static std::int64_t encode(T value) {
+    return std::int64_t(reinterpret_cast<std::intptr_t>(value));
+  }
+  static T decode(std::int64_t value) {
+    return reinterpret_cast<T>(std::intptr_t(value));
+  }
+};
+
+template<>
+struct value_codec<GLboolean> {
+  static std::int64_t encode(GLboolean value) {
+    return std::int64_t(static_cast<unsigned char>(value));
+  }
+  static GLboolean decode(std::int64_t value) {
+    return GLboolean(static_cast<unsigned char>(value));
+  }
+};
+
+// floating point values keep their bits
+template<>
+struct value_codec<float> {
+  static std::int64_t encode(float value) {
+    std::uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return std::int64_t(bits);
+  }
+  static float decode(std::int64_t value) {
+    std::uint32_t bits = std::uint32_t(value);
+    float result = 0.0f;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+};
+
+template<>
+struct value_codec<double> {
+  static std::int64_t encode(double value) {
+    std::int64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+  static double decode(std::int64_t value) {
+    double result = 0.0;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+  }
+};
+
+// parameter index sequence to expand the values of a call
+template<std::size_t... I>
+struct indices {};
+template<std::size_t N, std::size_t... I>
+struct make_indices : make_indices<N - 1, N - 1, I...> {};
+template<std::size_t... I>
+struct make_indices<0, I...> {
+  typedef indices<I...> type;
+};
+
+// records and replays calls of one function signature, values hold the
+// parameters followed by the return value
+template<typename R, typename... Args>
+struct function_codec {
+  typedef glbinding::Function<R, Args...> function_type;
+
+  static void install(function_entry const& entry) {
+    function_entry const* e = &entry;
+    function_type* function = static_cast<function_type*>(entry.function);
+    function->setAfterCallback([e](R result, Args... arguments) {
+      std::int64_t values[] = {value_codec<Args>::encode(arguments)..., value_codec<R>::encode(result)};
+      record_call(*e, values);
+    });
+  }
+  static void uninstall(function_entry const& entry) {
+    static_cast<function_type*>(entry.function)->clearAfterCallback();
+  }
+  static std::int64_t replay(function_entry const& entry, std::int64_t const* values) {
+    return value_codec<R>::encode(call(entry, values, typename make_indices<sizeof...(Args)>::type{}));
+  }
+  template<std::size_t... I>
+  static R call(function_entry const& entry, std::int64_t const* values, indices<I...>) {
+    return static_cast<function_type const*>(entry.function)->directCall(value_codec<Args>::decode(values[I])...);
+  }
+};
+
+template<typename... Args>
+struct function_codec<void, Args...> {
+  typedef glbinding::Function<void, Args...> function_type;
+
+  static void install(function_entry const& entry) {
+    function_entry const* e = &entry;
+    function_type* function = static_cast<function_type*>(entry.function);
+    function->setAfterCallback([e](Args... arguments) {
+      std::int64_t values[] = {value_codec<Args>::encode(arguments)..., 0};
+      record_call(*e, values);
+    });
+  }
+  static void uninstall(function_entry const& entry) {
+    static_cast<function_type*>(entry.function)->clearAfterCallback();
+  }
+  static std::int64_t replay(function_entry const& entry, std::int64_t const* values) {
+    call(entry, values, typename make_indices<sizeof...(Args)>::type{});
+    return 0;
+  }
+  template<std::size_t... I>
+  static void call(function_entry const& entry, std::int64_t const* values, indices<I...>) {
+    static_cast<function_type const*>(entry.function)->directCall(value_codec<Args>::decode(values[I])...);
+  }
+};
+
+// only glUnmapBuffer needs a callback before the call, while memory is mapped
+template<typename R, typename Arg>
+static void install_unmap(glbinding::Function<R, Arg>& function, function_entry const& entry) {
+  function_entry const* e = &entry;
+  function.setBeforeCallback([e](Arg argument) {
+    std::int64_t values[] = {value_codec<Arg>::encode(argument), 0};
+    record_unmap(*e, values);
+  });
+}
+
+template<typename R, typename... Args>
+static function_entry make_entry(glbinding::Function<R, Args...>& function, char const* kinds, char effect, data_size size) {
+  if (std::strlen(kinds) != sizeof...(Args)) {
+    throw std::logic_error(std::string{"parameter kinds of "} + function.name());
+  }
+  function_entry entry{};
+  entry.function = &function;
+  entry.kinds = kinds;
+  entry.effect = effect;
+  entry.returns_value = !std::is_void<R>::value;
+  entry.size = size;
+  entry.install = &function_codec<R, Args...>::install;
+  entry.uninstall = &function_codec<R, Args...>::uninstall;
+  entry.replay = &function_codec<R, Args...>::replay;
+  return entry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sizes of client data
+
+static std::size_t count(std::int64_t value) {
+  return value > 0 ? std::size_t(value) : 0;
+}
+
+static GLint pixel_store(GLenum parameter) {
+  GLint value = 4;
+  glbinding::Binding::GetIntegerv.directCall(parameter, &value);
+  return value;
+}
+
+// bytes of an image in client memory with the given row alignment
+static std::size_t image_bytes(std::int64_t width, std::int64_t height, std::int64_t format, std::int64_t type, GLint alignment) {
+  std::size_t components = 4;
+  switch (GLenum(format)) {
+    case GL_RED: case GL_GREEN: case GL_BLUE: case GL_ALPHA: case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: case GL_DEPTH_STENCIL:
+      components = 1; break;
+    case GL_RG: case GL_RG_INTEGER:
+      components = 2; break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER:
+      components = 3; break;
+    default:
+      break;
+  }
+  std::size_t pixel = components;
+  switch (GLenum(type)) {
+    case GL_UNSIGNED_BYTE: case GL_BYTE:
+      break;
+    case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+      pixel = components * 2; break;
+    case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_5_5_5_1:
+      pixel = 2; break;
+    // packed formats store a whole pixel in one int
+    case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+      pixel = 4; break;
+    default:
+      pixel = components * 4; break;
+  }
+  std::size_t row = count(width) * pixel;
+  std::size_t stride = (row + std::size_t(alignment) - 1) / std::size_t(alignment) * std::size_t(alignment);
+  return count(height) > 0 ? stride * (count(height) - 1) + row : 0;
+}
+
+static std::size_t tex_image_data(std::int64_t const* v, std::size_t) {
+  return image_bytes(v[3], v[4], v[6], v[7], pixel_store(GL_UNPACK_ALIGNMENT));
+}
+
+static std::size_t tex_sub_image_data(std::int64_t const* v, std::size_t) {
+  return image_bytes(v[4], v[5], v[6], v[7], pixel_store(GL_UNPACK_ALIGNMENT));
+}
+
+static std::size_t read_pixels_data(std::int64_t const* v, std::size_t) {
+  return image_bytes(v[2], v[3], v[4], v[5], pixel_store(GL_PACK_ALIGNMENT));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// recorded functions, the ones used by the framework and applications
+
+#define GL_CALL(function, kinds, effect, size) make_entry(glbinding::Binding::function, kinds, effect, size)
+
+static std::vector<function_entry> make_table() {
+  std::vector<function_entry> table{
+    // objects
+    GL_CALL(GenBuffers, "-b", 'G', nullptr),
+    GL_CALL(GenTextures, "-t", 'G', nullptr),
+    GL_CALL(GenVertexArrays, "-v", 'G', nullptr),
+    GL_CALL(GenFramebuffers, "-f", 'G', nullptr),
+    GL_CALL(GenRenderbuffers, "-r", 'G', nullptr),
+    GL_CALL(GenQueries, "-q", 'G', nullptr),
+    GL_CALL(DeleteBuffers, "-b", 'D', nullptr),
+    GL_CALL(DeleteTextures, "-t", 'D', nullptr),
+    GL_CALL(DeleteVertexArrays, "-v", 'D', nullptr),
+    GL_CALL(DeleteFramebuffers, "-f", 'D', nullptr),
+    GL_CALL(DeleteRenderbuffers, "-r", 'D', nullptr),
+    GL_CALL(DeleteQueries, "-q", 'D', nullptr),
+    GL_CALL(BindBuffer, "-B", '-', nullptr),
+    GL_CALL(BindBufferBase, "--B", '-', nullptr),
+    GL_CALL(BindBufferRange, "--B--", '-', nullptr),
+    GL_CALL(BindTexture, "-T", '-', nullptr),
+    GL_CALL(BindVertexArray, "V", '-', nullptr),
+    GL_CALL(BindFramebuffer, "-F", '-', nullptr),
+    GL_CALL(BindRenderbuffer, "-R", '-', nullptr),
+    // buffers
+    GL_CALL(BufferData, "--d-", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]); }),
+    GL_CALL(BufferSubData, "---d", '-', [](std::int64_t const* v, std::size_t) { return count(v[2]); }),
+    GL_CALL(MapBuffer, "--", 'M', nullptr),
+    GL_CALL(UnmapBuffer, "-", 'U', nullptr),
+    GL_CALL(TexBuffer, "--B", '-', nullptr),
+    // vertex input
+    GL_CALL(EnableVertexAttribArray, "-", '-', nullptr),
+    GL_CALL(DisableVertexAttribArray, "-", '-', nullptr),
+    GL_CALL(VertexAttribPointer, "-----o", '-', nullptr),
+    GL_CALL(VertexAttribIPointer, "----o", '-', nullptr),
+    GL_CALL(VertexAttribDivisor, "--", '-', nullptr),
+    // textures and framebuffers
+    GL_CALL(ActiveTexture, "-", '-', nullptr),
+    GL_CALL(TexImage2D, "--------d", '-', tex_image_data),
+    GL_CALL(TexSubImage2D, "--------d", '-', tex_sub_image_data),
+    GL_CALL(TexImage2DMultisample, "------", '-', nullptr),
+    GL_CALL(TexParameteri, "---", '-', nullptr),
+    GL_CALL(TexParameterf, "---", '-', nullptr),
+    GL_CALL(GenerateMipmap, "-", '-', nullptr),
+    GL_CALL(PixelStorei, "--", '-', nullptr),
+    GL_CALL(FramebufferTexture, "--T-", '-', nullptr),
+    GL_CALL(FramebufferTexture2D, "---T-", '-', nullptr),
+    GL_CALL(FramebufferRenderbuffer, "---R", '-', nullptr),
+    GL_CALL(RenderbufferStorage, "----", '-', nullptr),
+    GL_CALL(CheckFramebufferStatus, "-", '-', nullptr),
+    GL_CALL(DrawBuffers, "-d", '-', [](std::int64_t const* v, std::size_t) { return count(v[0]) * sizeof(GLenum); }),
+    GL_CALL(BlitFramebuffer, "----------", '-', nullptr),
+    GL_CALL(ReadPixels, "------w", '-', read_pixels_data),
+    // shaders and programs
+    GL_CALL(CreateShader, "-", 'C', nullptr),
+    GL_CALL(ShaderSource, "P-sn", '-', nullptr),
+    GL_CALL(CompileShader, "P", '-', nullptr),
+    GL_CALL(GetShaderiv, "P-w", '-', nullptr),
+    GL_CALL(GetShaderInfoLog, "P-ww", '-', [](std::int64_t const* v, std::size_t p) { return p == 3 ? count(v[1]) : sizeof(GLsizei); }),
+    GL_CALL(DeleteShader, "P", 'D', nullptr),
+    GL_CALL(CreateProgram, "", 'C', nullptr),
+    GL_CALL(AttachShader, "PP", '-', nullptr),
+    GL_CALL(DetachShader, "PP", '-', nullptr),
+    GL_CALL(BindAttribLocation, "P-z", '-', nullptr),
+    GL_CALL(BindFragDataLocation, "P-z", '-', nullptr),
+    GL_CALL(ProgramParameteri, "P--", '-', nullptr),
+    GL_CALL(LinkProgram, "P", '-', nullptr),
+    GL_CALL(ValidateProgram, "P", '-', nullptr),
+    GL_CALL(GetProgramiv, "P-w", '-', nullptr),
+    GL_CALL(GetProgramInfoLog, "P-ww", '-', [](std::int64_t const* v, std::size_t p) { return p == 3 ? count(v[1]) : sizeof(GLsizei); }),
+    GL_CALL(GetProgramBinary, "P-www", '-', [](std::int64_t const* v, std::size_t p) { return p == 4 ? count(v[1]) : sizeof(GLenum); }),
+    GL_CALL(ProgramBinary, "P-d-", '-', [](std::int64_t const* v, std::size_t) { return count(v[3]); }),
+    GL_CALL(MaxShaderCompilerThreadsARB, "-", '-', nullptr),
+    GL_CALL(DeleteProgram, "P", 'D', nullptr),
+    GL_CALL(UseProgram, "P", 'S', nullptr),
+    GL_CALL(GetUniformLocation, "Pz", 'L', nullptr),
+    GL_CALL(GetUniformBlockIndex, "Pz", 'K', nullptr),
+    GL_CALL(UniformBlockBinding, "PK-", '-', nullptr),
+    // uniforms
+    GL_CALL(Uniform1i, "L-", '-', nullptr),
+    GL_CALL(Uniform1f, "L-", '-', nullptr),
+    GL_CALL(Uniform2f, "L--", '-', nullptr),
+    GL_CALL(Uniform3f, "L---", '-', nullptr),
+    GL_CALL(Uniform3i, "L---", '-', nullptr),
+    GL_CALL(Uniform4f, "L----", '-', nullptr),
+    GL_CALL(Uniform1iv, "L-d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * sizeof(GLint); }),
+    GL_CALL(Uniform1fv, "L-d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * sizeof(GLfloat); }),
+    GL_CALL(Uniform2fv, "L-d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * 2 * sizeof(GLfloat); }),
+    GL_CALL(Uniform3fv, "L-d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * 3 * sizeof(GLfloat); }),
+    GL_CALL(Uniform4fv, "L-d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * 4 * sizeof(GLfloat); }),
+    GL_CALL(UniformMatrix3fv, "L--d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * 9 * sizeof(GLfloat); }),
+    GL_CALL(UniformMatrix4fv, "L--d", '-', [](std::int64_t const* v, std::size_t) { return count(v[1]) * 16 * sizeof(GLfloat); }),
+    // state
+    GL_CALL(Enable, "-", '-', nullptr),
+    GL_CALL(Disable, "-", '-', nullptr),
+    GL_CALL(IsEnabled, "-", '-', nullptr),
+    GL_CALL(DepthFunc, "-", '-', nullptr),
+    GL_CALL(DepthMask, "-", '-', nullptr),
+    GL_CALL(ColorMask, "----", '-', nullptr),
+    GL_CALL(BlendFunc, "--", '-', nullptr),
+    GL_CALL(BlendFuncSeparate, "----", '-', nullptr),
+    GL_CALL(BlendEquation, "-", '-', nullptr),
+    GL_CALL(CullFace, "-", '-', nullptr),
+    GL_CALL(FrontFace, "-", '-', nullptr),
+    GL_CALL(PolygonMode, "--", '-', nullptr),
+    GL_CALL(LineWidth, "-", '-', nullptr),
+    GL_CALL(PointSize, "-", '-', nullptr),
+    GL_CALL(Viewport, "----", '-', nullptr),
+    GL_CALL(Scissor, "----", '-', nullptr),
+    GL_CALL(ClearColor, "----", '-', nullptr),
+    GL_CALL(ClearDepth, "-", '-', nullptr),
+    GL_CALL(Clear, "-", '-', nullptr),
+    GL_CALL(GetIntegerv, "-w", '-', nullptr),
+    GL_CALL(GetString, "-", '-', nullptr),
+    GL_CALL(GetStringi, "--", '-', nullptr),
+    GL_CALL(GetError, "", '-', nullptr),
+    // drawing
+    GL_CALL(DrawArrays, "---", '-', nullptr),
+    GL_CALL(DrawArraysInstanced, "----", '-', nullptr),
+    GL_CALL(DrawElements, "---o", '-', nullptr),
+    GL_CALL(DrawElementsInstanced, "---o-", '-', nullptr),
+    GL_CALL(MultiDrawArrays, "-dd-", '-', [](std::int64_t const* v, std::size_t) { return count(v[3]) * sizeof(GLint); }),
+    GL_CALL(Flush, "", '-', nullptr),
+    GL_CALL(Finish, "", '-', nullptr),
+    // queries
+    GL_CALL(BeginQuery, "-Q", '-', nullptr),
+    GL_CALL(EndQuery, "-", '-', nullptr),
+    GL_CALL(QueryCounter, "Q-", '-', nullptr),
+    GL_CALL(GetQueryObjectiv, "Q-w", '-', nullptr),
+    GL_CALL(GetQueryObjectuiv, "Q-w", '-', nullptr),
+    GL_CALL(GetQueryObjectui64v, "Q-w", '-', nullptr),
+    // the callback lives in the capturing process
+    GL_CALL(DebugMessageCallback, "nn", 'X', nullptr),
+    GL_CALL(DebugMessageControl, "----d-", '-', [](std::int64_t const* v, std::size_t) { return count(v[3]) * sizeof(GLuint); }),
+  };
+  for (std::size_t i = 0; i < table.size(); ++i) {
+    table[i].index = std::uint32_t(i);
+  }
+  return table;
+}
+
+#undef GL_CALL
+
+static std::vector<function_entry> const& function_table() {
+  static const std::vector<function_entry> table = make_table();
+  return table;
+}
+
+static bool is_name_array(char kind) {
+  return kind >= 'a' && kind <= 'z' && std::strchr("btvfrq", kind) != nullptr;
+}
+
+static bool has_data(char kind) {
+  return kind == 'd' || kind == 'z' || kind == 's' || is_name_array(kind);
+}
+
+static bool is_pointer(char kind) {
+  return has_data(kind) || kind == 'w' || kind == 'n';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// trace encoding
+
+static void write_varint(std::string& buffer, std::uint64_t value) {
+  while (value >= 0x80) {
+    buffer += char((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  buffer += char(value);
+}
+
+static void write_signed(std::string& buffer, std::int64_t value) {
+  write_varint(buffer, (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63));
+}
+
+static void write_data(std::string& buffer, void const* data, std::size_t size) {
+  write_varint(buffer, size);
+  buffer.append(static_cast<char const*>(data), size);
+}
+
+// reads a trace loaded into memory, throws on truncated records
+struct trace_reader {
+  std::string const& data;
+  std::size_t position;
+
+  bool done() const {
+    return position >= data.size();
+  }
+  std::uint8_t byte() {
+    if (done()) {
+      throw std::logic_error("gl_capture: truncated trace");
+    }
+    return std::uint8_t(data[position++]);
+  }
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      std::uint8_t b = byte();
+      value |= std::uint64_t(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        break;
+      }
+    }
+    return value;
+  }
+  std::int64_t signed_varint() {
+    std::uint64_t value = varint();
+    return std::int64_t(value >> 1) ^ -std::int64_t(value & 1);
+  }
+  // offset of a size prefixed block
+  std::string string() {
+    std::size_t size = 0;
+    std::size_t offset = skip_data(size);
+    return data.substr(offset, size);
+  }
+  std::size_t skip_data(std::size_t& size) {
+    size = std::size_t(varint());
+    if (size > data.size() - position) {
+      throw std::logic_error("gl_capture: truncated trace");
+    }
+    position += size;
+    return position - size;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// capture
+
+struct capture_state {
+  bool active;
+  std::string path;
+  std::ofstream file;
+  // records since the last write
+  std::string buffer;
+  std::vector<bool> declared;
+  unsigned frames;
+  unsigned recorded_frames;
+  std::uint64_t calls;
+  std::uint64_t unknown_calls;
+  std::uint64_t bytes;
+  // contents of the buffer being unmapped
+  std::string unmapped;
+  // callbacks set before recording, e.g. by gl error checks, restored by stop
+  std::vector<glbinding::CallbackMask> masks;
+  glbinding::FunctionCallback after;
+};
+
+static capture_state s_capture{};
+
+static void declare(function_entry const& entry) {
+  if (s_capture.declared[entry.index]) {
+    return;
+  }
+  s_capture.declared[entry.index] = true;
+  s_capture.buffer += char(TAG_FUNCTION);
+  write_varint(s_capture.buffer, entry.index);
+  std::string name{entry.function->name()};
+  write_data(s_capture.buffer, name.data(), name.size());
+}
+
+static void write_buffer() {
+  s_capture.file.write(s_capture.buffer.data(), std::streamsize(s_capture.buffer.size()));
+  s_capture.bytes += s_capture.buffer.size();
+  s_capture.buffer.clear();
+}
+
+static void record_call(function_entry const& entry, std::int64_t const* values) {
+  if (!s_capture.active) {
+    return;
+  }
+  declare(entry);
+  std::string& buffer = s_capture.buffer;
+  buffer += char(TAG_CALL);
+  write_varint(buffer, entry.index);
+  // client pointers are only recorded as set or null
+  std::size_t num_parameters = std::strlen(entry.kinds);
+  for (std::size_t i = 0; i < num_parameters; ++i) {
+    write_signed(buffer, is_pointer(entry.kinds[i]) ? values[i] != 0 : values[i]);
+  }
+  if (entry.returns_value) {
+    write_signed(buffer, values[num_parameters]);
+  }
+
+  for (std::size_t i = 0; i < num_parameters; ++i) {
+    char kind = entry.kinds[i];
+    void const* pointer = reinterpret_cast<void const*>(std::intptr_t(values[i]));
+    if (kind == 'd') {
+      write_data(buffer, pointer, pointer ? entry.size(values, i) : 0);
+    }
+    else if (kind == 'z') {
+      write_data(buffer, pointer, pointer ? std::strlen(static_cast<char const*>(pointer)) + 1 : 0);
+    }
+    else if (is_name_array(kind)) {
+      write_data(buffer, pointer, pointer ? count(values[0]) * sizeof(GLuint) : 0);
+    }
+    else if (kind == 's') {
+      // sources are stored null terminated so replay passes no lengths
+      GLchar const* const* strings = static_cast<GLchar const* const*>(pointer);
+      GLint const* lengths = reinterpret_cast<GLint const*>(std::intptr_t(values[i + 1]));
+      std::size_t num_strings = strings ? count(values[i - 1]) : 0;
+      write_varint(buffer, num_strings);
+      for (std::size_t j = 0; j < num_strings; ++j) {
+        std::size_t length = lengths && lengths[j] >= 0 ? std::size_t(lengths[j]) : std::strlen(strings[j]);
+        write_varint(buffer, length + 1);
+        buffer.append(strings[j], length);
+        buffer += '\0';
+      }
+    }
+  }
+  if (entry.effect == 'U') {
+    write_data(buffer, s_capture.unmapped.data(), s_capture.unmapped.size());
+    s_capture.unmapped.clear();
+  }
+
+  ++s_capture.calls;
+  if (buffer.size() > (1u << 20)) {
+    write_buffer();
+  }
+}
+
+static void record_unmap(function_entry const& entry, std::int64_t const* values) {
+  if (!s_capture.active) {
+    return;
+  }
+  // whatever was written through the pointer, the whole mapping is recorded
+  GLenum target = value_codec<GLenum>::decode(values[0]);
+  void* pointer = nullptr;
+  GLint size = 0;
+  glbinding::Binding::GetBufferPointerv.directCall(target, GL_BUFFER_MAP_POINTER, &pointer);
+  glbinding::Binding::GetBufferParameteriv.directCall(target, GL_BUFFER_SIZE, &size);
+  if (pointer && size > 0) {
+    s_capture.unmapped.assign(static_cast<char const*>(pointer), std::size_t(size));
+  }
+  else {
+    s_capture.unmapped.clear();
+  }
+}
+
+// calls outside the table arrive with printed parameters
+static void record_unknown(glbinding::FunctionCall const& call) {
+  if (!s_capture.active || !call.function->isEnabled(glbinding::CallbackMask::Parameters)) {
+    return;
+  }
+  std::string parameters{};
+  for (std::size_t i = 0; i < call.parameters.size(); ++i) {
+    parameters += (i > 0 ? ", " : "") + call.parameters[i]->asString();
+  }
+  std::string name{call.function->name()};
+  s_capture.buffer += char(TAG_UNKNOWN);
+  write_data(s_capture.buffer, name.data(), name.size());
+  write_data(s_capture.buffer, parameters.data(), parameters.size());
+  ++s_capture.unknown_calls;
+}
+
+namespace gl_capture {
+
+void start(std::string const& path, unsigned frames, unsigned width, unsigned height) {
+  stop();
+  s_capture.file.open(path, std::ios::binary);
+  if (!s_capture.file) {
+    std::cerr << "File \'" << path << "\' could not be written" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  std::vector<function_entry> const& table = function_table();
+  s_capture.active = true;
+  s_capture.path = path;
+  s_capture.declared.assign(table.size(), false);
+  s_capture.frames = frames;
+  s_capture.recorded_frames = 0;
+  s_capture.calls = 0;
+  s_capture.unknown_calls = 0;
+  s_capture.bytes = 0;
+  s_capture.buffer.assign(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  write_varint(s_capture.buffer, TRACE_VERSION);
+  write_varint(s_capture.buffer, width);
+  write_varint(s_capture.buffer, height);
+
+  s_capture.masks.clear();
+  for (glbinding::AbstractFunction* function : glbinding::Binding::functions()) {
+    s_capture.masks.push_back(function->callbackMask());
+  }
+  s_capture.after = glbinding::afterCallback();
+
+  // table functions call their typed callbacks, all others the generic one
+  // with parameters converted for printing
+  for (glbinding::AbstractFunction* function : glbinding::Binding::functions()) {
+    function->setCallbackMask(glbinding::CallbackMask::After | glbinding::CallbackMask::Parameters);
+  }
+  glbinding::setAfterCallback(record_unknown);
+  for (function_entry const& entry : table) {
+    entry.install(entry);
+    entry.function->setCallbackMask(glbinding::CallbackMask::After);
+    if (entry.effect == 'U') {
+      install_unmap(glbinding::Binding::UnmapBuffer, entry);
+      entry.function->setCallbackMask(glbinding::CallbackMask::Before | glbinding::CallbackMask::After);
+    }
+  }
+}
+
+void end_setup() {
+  if (s_capture.active) {
+    s_capture.buffer += char(TAG_SETUP);
+  }
+}
+
+void end_frame() {
+  if (!s_capture.active) {
+    return;
+  }
+  s_capture.buffer += char(TAG_FRAME);
+  write_buffer();
+  if (++s_capture.recorded_frames >= s_capture.frames) {
+    stop();
+  }
+}
+
+void stop() {
+  if (!s_capture.active) {
+    return;
+  }
+  s_capture.active = false;
+  for (function_entry const& entry : function_table()) {
+    entry.uninstall(entry);
+  }
+  glbinding::Binding::UnmapBuffer.clearBeforeCallback();
+  std::size_t index = 0;
+  for (glbinding::AbstractFunction* function : glbinding::Binding::functions()) {
+    function->setCallbackMask(s_capture.masks[index++]);
+  }
+  glbinding::setAfterCallback(s_capture.after);
+  write_buffer();
+  s_capture.file.close();
+  std::cout << "Captured " << s_capture.recorded_frames << " frames, " << s_capture.calls << " calls ("
+            << s_capture.unknown_calls << " not replayable) in " << s_capture.bytes / 1024 << " KiB to "
+            << s_capture.path << std::endl;
+}
+
+bool active() {
+  return s_capture.active;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// replay
+
+const std::uint32_t player::UNKNOWN;
+
+player::player(std::string const& path)
+ :m_data{utils::read_file(path)}
+ ,m_width{0}
+ ,m_height{0}
+ ,m_calls{}
+ ,m_arguments{}
+ ,m_blobs{}
+ ,m_setup_end{0}
+ ,m_frame_ends{}
+ ,m_unknown_names{}
+ ,m_names(sizeof(NAME_KINDS) - 1)
+ ,m_locations{}
+ ,m_block_indices{}
+ ,m_mapped{}
+ ,m_current_program{0}
+ ,m_scratch{}
+ ,m_strings{}
+ ,m_timings{}
+ ,m_skipped{}
+{
+  if (m_data.compare(0, sizeof(TRACE_MAGIC), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+    std::cerr << "File \'" << path << "\' is not a gl trace" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  trace_reader reader{m_data, sizeof(TRACE_MAGIC)};
+  if (reader.varint() != TRACE_VERSION) {
+    std::cerr << "Trace \'" << path << "\' has an unsupported version" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  m_width = unsigned(reader.varint());
+  m_height = unsigned(reader.varint());
+
+  std::vector<function_entry> const& table = function_table();
+  m_timings.assign(table.size(), timing{0, 0.0});
+  // trace function indices to table indices, by name
+  std::vector<std::uint32_t> functions{};
+  while (!reader.done()) {
+    std::uint8_t tag = reader.byte();
+    if (tag == TAG_FUNCTION) {
+      std::size_t index = std::size_t(reader.varint());
+      std::string name = reader.string();
+      auto entry = std::find_if(table.begin(), table.end(), [&name](function_entry const& e) {
+        return name == e.function->name();
+      });
+      if (entry == table.end()) {
+        throw std::logic_error("gl_capture: trace contains unsupported function " + name);
+      }
+      functions.resize(std::max(functions.size(), index + 1), UNKNOWN);
+      functions[index] = entry->index;
+    }
+    else if (tag == TAG_CALL) {
+      std::size_t index = std::size_t(reader.varint());
+      if (index >= functions.size() || functions[index] == UNKNOWN) {
+        throw std::logic_error("gl_capture: call of undeclared function");
+      }
+      function_entry const& entry = table[functions[index]];
+      m_calls.push_back(call{entry.index, 0, std::uint32_t(m_arguments.size()), std::uint32_t(m_blobs.size())});
+      std::size_t num_parameters = std::strlen(entry.kinds);
+      for (std::size_t i = 0; i < num_parameters + (entry.returns_value ? 1 : 0); ++i) {
+        m_arguments.push_back(reader.signed_varint());
+      }
+      std::size_t size = 0;
+      for (std::size_t i = 0; i < num_parameters; ++i) {
+        char kind = entry.kinds[i];
+        if (kind == 's') {
+          // number of strings, followed by the strings
+          std::size_t num_strings = std::size_t(reader.varint());
+          m_blobs.push_back(blob{0, num_strings});
+          for (std::size_t j = 0; j < num_strings; ++j) {
+            std::size_t offset = reader.skip_data(size);
+            m_blobs.push_back(blob{offset, size});
+          }
+        }
+        else if (has_data(kind)) {
+          std::size_t offset = reader.skip_data(size);
+          m_blobs.push_back(blob{offset, size});
+        }
+      }
+      if (entry.effect == 'U') {
+        std::size_t offset = reader.skip_data(size);
+        m_blobs.push_back(blob{offset, size});
+      }
+    }
+    else if (tag == TAG_UNKNOWN) {
+      std::string name = reader.string();
+      // printed parameters are for reading the trace only
+      reader.string();
+      auto known = std::find(m_unknown_names.begin(), m_unknown_names.end(), name);
+      if (known == m_unknown_names.end()) {
+        known = m_unknown_names.insert(known, name);
+      }
+      m_calls.push_back(call{UNKNOWN, std::uint32_t(known - m_unknown_names.begin()), 0, 0});
+    }
+    else if (tag == TAG_SETUP) {
+      m_setup_end = m_calls.size();
+    }
+    else if (tag == TAG_FRAME) {
+      m_frame_ends.push_back(m_calls.size());
+    }
+    else {
+      throw std::logic_error("gl_capture: unknown record in trace");
+    }
+  }
+  m_skipped.assign(m_unknown_names.size(), 0);
+}
+
+unsigned player::width() const {
+  return m_width;
+}
+
+unsigned player::height() const {
+  return m_height;
+}
+
+std::size_t player::num_frames() const {
+  return m_frame_ends.size();
+}
+
+std::size_t player::num_calls(std::size_t frame) const {
+  return m_frame_ends[frame] - (frame > 0 ? m_frame_ends[frame - 1] : m_setup_end);
+}
+
+void player::play_setup() {
+  play(0, m_setup_end);
+}
+
+void player::play_frame(std::size_t frame) {
+  play(frame > 0 ? m_frame_ends[frame - 1] : m_setup_end, m_frame_ends[frame]);
+}
+
+void player::play(std::size_t begin, std::size_t end) {
+  for (std::size_t i = begin; i < end; ++i) {
+    play(m_calls[i]);
+  }
+}
+
+std::uint32_t player::translate(char kind, std::int64_t name) const {
+  std::size_t map = std::size_t(std::strchr(NAME_KINDS, std::toupper(kind)) - NAME_KINDS);
+  auto found = m_names[map].find(std::uint32_t(name));
+  // default objects and names created outside the trace keep their value
+  return found != m_names[map].end() ? found->second : std::uint32_t(name);
+}
+
+static std::uint64_t program_key(std::uint32_t program, std::int64_t value) {
+  return (std::uint64_t(program) << 32) | std::uint32_t(value);
+}
+
+void player::play(call const& c) {
+  if (c.function == UNKNOWN) {
+    ++m_skipped[c.name];
+    return;
+  }
+  function_entry const& entry = function_table()[c.function];
+  if (entry.effect == 'X') {
+    return;
+  }
+  std::int64_t const* recorded = m_arguments.data() + c.arguments;
+  std::size_t num_parameters = std::strlen(entry.kinds);
+
+  // outputs get their own range of scratch memory
+  std::size_t scratch_size = 0;
+  for (std::size_t i = 0; i < num_parameters; ++i) {
+    char kind = entry.kinds[i];
+    if (kind == 'w' && recorded[i]) {
+      scratch_size += entry.size ? entry.size(recorded, i) : OUTPUT_SIZE;
+    }
+    else if (is_name_array(kind)) {
+      scratch_size += count(recorded[0]) * sizeof(GLuint);
+    }
+    // keep outputs aligned for 64 bit values
+    scratch_size = (scratch_size + 7) & ~std::size_t(7);
+  }
+  m_scratch.resize(std::max(m_scratch.size(), scratch_size));
+
+  std::int64_t values[16] = {};
+  blob const* blobs = m_blobs.data() + c.blobs;
+  std::uint8_t* scratch = m_scratch.data();
+  m_strings.clear();
+  for (std::size_t i = 0; i < num_parameters; ++i) {
+    char kind = entry.kinds[i];
+    std::int64_t& value = values[i];
+    if (kind == '-' || kind == 'o') {
+      value = recorded[i];
+    }
+    else if (std::strchr(NAME_KINDS, kind)) {
+      value = translate(kind, recorded[i]);
+    }
+    else if (kind == 'L') {
+      auto found = m_locations.find(program_key(m_current_program, recorded[i]));
+      value = found != m_locations.end() ? found->second : recorded[i];
+    }
+    else if (kind == 'K') {
+      auto found = m_block_indices.find(program_key(std::uint32_t(recorded[0]), recorded[i]));
+      value = found != m_block_indices.end() ? found->second : recorded[i];
+    }
+    else if (kind == 'd' || kind == 'z') {
+      value = recorded[i] ? std::int64_t(reinterpret_cast<std::intptr_t>(m_data.data() + blobs->offset)) : 0;
+      ++blobs;
+    }
+    else if (kind == 's') {
+      std::size_t num_strings = blobs->size;
+      for (std::size_t j = 1; j <= num_strings; ++j) {
+        m_strings.push_back(m_data.data() + blobs[j].offset);
+      }
+      value = recorded[i] ? std::int64_t(reinterpret_cast<std::intptr_t>(m_strings.data())) : 0;
+      blobs += num_strings + 1;
+    }
+    else if (is_name_array(kind)) {
+      GLuint* names = reinterpret_cast<GLuint*>(scratch);
+      std::size_t num_names = count(recorded[0]);
+      scratch += (num_names * sizeof(GLuint) + 7) & ~std::size_t(7);
+      // generated names are written by gl, others are translated
+      if (entry.effect != 'G') {
+        std::memcpy(names, m_data.data() + blobs->offset, std::min(blobs->size, num_names * sizeof(GLuint)));
+        for (std::size_t j = 0; j < num_names; ++j) {
+          names[j] = translate(kind, names[j]);
+        }
+      }
+      value = recorded[i] ? std::int64_t(reinterpret_cast<std::intptr_t>(names)) : 0;
+      ++blobs;
+    }
+    else if (kind == 'w' && recorded[i]) {
+      value = std::int64_t(reinterpret_cast<std::intptr_t>(scratch));
+      scratch += ((entry.size ? entry.size(recorded, i) : OUTPUT_SIZE) + 7) & ~std::size_t(7);
+    }
+  }
+
+  if (entry.effect == 'U') {
+    auto mapped = m_mapped.find(recorded[0]);
+    if (mapped != m_mapped.end() && mapped->second) {
+      std::memcpy(mapped->second, m_data.data() + blobs->offset, blobs->size);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::int64_t result = entry.replay(entry, values);
+  timing& time = m_timings[entry.index];
+  time.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  ++time.calls;
+
+  std::int64_t recorded_result = entry.returns_value ? recorded[num_parameters] : 0;
+  switch (entry.effect) {
+    case 'G': {
+      // recorded names of the blob, replayed ones in scratch
+      char kind = entry.kinds[1];
+      std::size_t map = std::size_t(std::strchr(NAME_KINDS, std::toupper(kind)) - NAME_KINDS);
+      GLuint const* names = reinterpret_cast<GLuint const*>(values[1]);
+      blob const& generated = m_blobs[c.blobs];
+      for (std::size_t j = 0; j < count(recorded[0]) && (j + 1) * sizeof(GLuint) <= generated.size; ++j) {
+        GLuint name = 0;
+        std::memcpy(&name, m_data.data() + generated.offset + j * sizeof(GLuint), sizeof(name));
+        m_names[map][name] = names[j];
+      }
+      break;
+    }
+    case 'D': {
+      char kind = entry.kinds[num_parameters - 1];
+      std::size_t map = std::size_t(std::strchr(NAME_KINDS, std::toupper(kind)) - NAME_KINDS);
+      if (is_name_array(kind)) {
+        blob const& deleted = m_blobs[c.blobs];
+        for (std::size_t j = 0; (j + 1) * sizeof(GLuint) <= deleted.size; ++j) {
+          GLuint name = 0;
+          std::memcpy(&name, m_data.data() + deleted.offset + j * sizeof(GLuint), sizeof(name));
+          m_names[map].erase(name);
+        }
+      }
+      else {
+        m_names[map].erase(std::uint32_t(recorded[0]));
+      }
+      break;
+    }
+    case 'C':
+      m_names[std::size_t(std::strchr(NAME_KINDS, 'P') - NAME_KINDS)][std::uint32_t(recorded_result)] = std::uint32_t(result);
+      break;
+    case 'L':
+      m_locations[program_key(std::uint32_t(recorded[0]), recorded_result)] = result;
+      break;
+    case 'K':
+      m_block_indices[program_key(std::uint32_t(recorded[0]), recorded_result)] = result;
+      break;
+    case 'M':
+      m_mapped[recorded[0]] = reinterpret_cast<void*>(std::intptr_t(result));
+      break;
+    case 'U':
+      m_mapped.erase(recorded[0]);
+      break;
+    case 'S':
+      m_current_program = std::uint32_t(recorded[0]);
+      break;
+    default:
+      break;
+  }
+}
+
+void player::print_calls(std::ostream& stream) const {
+  std::vector<function_entry> const& table = function_table();
+  std::vector<std::size_t> order{};
+  double total = 0.0;
+  for (std::size_t i = 0; i < m_timings.size(); ++i) {
+    if (m_timings[i].calls > 0) {
+      order.push_back(i);
+      total += m_timings[i].milliseconds;
+    }
+  }
+  std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+    return m_timings[a].milliseconds > m_timings[b].milliseconds;
+  });
+
+  stream << std::left << std::setw(32) << "function" << std::right << std::setw(10) << "calls"
+         << std::setw(12) << "total ms" << std::setw(12) << "mean us" << std::setw(8) << "%" << std::endl;
+  for (std::size_t i : order) {
+    timing const& time = m_timings[i];
+    stream << std::left << std::setw(32) << table[i].function->name() << std::right << std::setw(10) << time.calls
+           << std::fixed << std::setprecision(3) << std::setw(12) << time.milliseconds
+           << std::setw(12) << 1000.0 * time.milliseconds / double(time.calls)
+           << std::setprecision(1) << std::setw(8) << 100.0 * time.milliseconds / total << std::endl;
+  }
+  for (std::size_t i = 0; i < m_unknown_names.size(); ++i) {
+    stream << "skipped " << m_skipped[i] << " calls of " << m_unknown_names[i] << std::endl;
+  }
+}
+
+};
@@ -0,0 +1,157 @@
+#include "gl_errors.hpp"
+
+#include <glbinding/gl/gl.h>
+#include <glbinding/Binding.h>
+#include <glbinding/ContextInfo.h>
+#include <glbinding/Meta.h>
+#include <glbinding/Version.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+// build time default, one of off, debug or full
+#ifndef FRAMEWORK_GL_ERRORS
+  #define FRAMEWORK_GL_ERRORS full
+#endif
+#define GL_ERRORS_STRING(level) #level
+#define GL_ERRORS_NAME(level) GL_ERRORS_STRING(level)
+
+// print driver messages, may be called from a driver thread so it must not throw
+static void GL_APIENTRY debug_message(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* user_param) {
+  std::cerr << "OpenGL Debug: " << glbinding::Meta::getString(type)
+            << " (" << glbinding::Meta::getString(severity) << ") - "
+            << std::string(message, std::size_t(length)) << std::endl;
+}
+
+static bool has_debug_output() {
+  return glbinding::ContextInfo::version() >= glbinding::Version(4, 3) ||
+         glbinding::ContextInfo::supported({GLextension::GL_KHR_debug});
+}
+
+static void watch_per_call(bool activate) {
+  if(activate) {
+    // add callback after each function call
+    glbinding::setCallbackMaskExcept(glbinding::CallbackMask::After | glbinding::CallbackMask::ParametersAndReturnValue, {"glGetError", "glBegin", "glVertex3f", "glColor3f"});
+    glbinding::setAfterCallback(
+      [](glbinding::FunctionCall const& call) {
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+          // print name
+          std::cerr <<  "OpenGL Error: " << call.function->name() << "(";
+          // parameters
+          for (unsigned i = 0; i < call.parameters.size(); ++i)
+          {
+            std::cerr << call.parameters[i]->asString();
+            if (i < call.parameters.size() - 1)
+              std::cerr << ", ";
+          }
+          std::cerr << ")";
+          // return value
+          if(call.returnValue) {
+            std::cerr << " -> " << call.returnValue->asString();
+          }
+          // error
+          std::cerr  << " - " << glbinding::Meta::getString(error) << std::endl;
+          // throw exception to allow for backtrace
+          throw std::runtime_error("Execution of " + std::string(call.function->name()));
+        }
+      }
+    );
+  }
+  else {
+    glbinding::setCallbackMask(glbinding::CallbackMask::None);
+  }
+}
+
+namespace gl_errors {
+
+level parse(std::string const& name) {
+  if (name == "off") {
+    return OFF;
+  }
+  else if (name == "debug") {
+    return DEBUG_OUTPUT;
+  }
+  else if (name == "full") {
+    return PER_CALL;
+  }
+  throw std::invalid_argument("Unknown gl error level '" + name + "', expected off, debug or full");
+}
+
+std::string name(level check_level) {
+  switch (check_level) {
+    case OFF: return "off";
+    case DEBUG_OUTPUT: return "debug";
+    default: return "full";
+  }
+}
+
+level default_level() {
+  return parse(GL_ERRORS_NAME(FRAMEWORK_GL_ERRORS));
+}
+
+level watch(level check_level) {
+  watch_per_call(check_level == PER_CALL);
+
+  bool debug_output = has_debug_output();
+  if (check_level == DEBUG_OUTPUT && !debug_output) {
+    std::cerr << "KHR_debug not supported, OpenGL errors are not checked" << std::endl;
+    check_level = OFF;
+  }
+  if (debug_output) {
+    if (check_level == DEBUG_OUTPUT) {
+      // asynchronous delivery, so the driver does not serialize on every call
+      glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+      glDebugMessageCallback(debug_message, nullptr);
+      // notifications report buffer placement and similar, not errors
+      glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+      glEnable(GL_DEBUG_OUTPUT);
+    }
+    else {
+      glDisable(GL_DEBUG_OUTPUT);
+      glDebugMessageCallback(nullptr, nullptr);
+    }
+  }
+  return check_level;
+}
+
+void benchmark(unsigned calls) {
+  GLuint buffer = 0;
+  glGenBuffers(1, &buffer);
+
+  // drivers may ignore debug output outside of debug contexts, so its timing would be that of no checks
+  GLint context_flags = 0;
+  glGetIntegerv(GL_CONTEXT_FLAGS, &context_flags);
+  bool debug_context = (context_flags & GLint(GL_CONTEXT_FLAG_DEBUG_BIT)) != 0;
+
+  std::cout << "gl error checking cost of " << calls << " glBindBuffer calls" << std::endl;
+  level levels[] = {OFF, DEBUG_OUTPUT, PER_CALL};
+  for (level check_level : levels) {
+    level active = watch(check_level);
+    glFinish();
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < calls; ++i) {
+      glBindBuffer(GL_ARRAY_BUFFER, (i & 1) ? buffer : 0);
+    }
+    glFinish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "  " << name(check_level);
+    if (active != check_level) {
+      std::cout << " (unsupported, ran as " << name(active) << ")";
+    }
+    else if (active == DEBUG_OUTPUT && !debug_context) {
+      std::cout << " (no debug context, messages may be dropped)";
+    }
+    std::cout << ": " << seconds * 1e9 / double(calls) << " ns per call" << std::endl;
+  }
+
+  watch(OFF);
+  glDeleteBuffers(1, &buffer);
+}
+
+};
@@ -0,0 +1,365 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+
+// jobs a worker deque holds, further jobs are executed right away
+static const std::int64_t DEQUE_CAPACITY = 1 << 12;
+// failed attempts to find work before an idle worker sleeps
+static const unsigned IDLE_SPINS = 64;
+
+struct queued_job {
+  jobs::job fn;
+  jobs::counter* signal;
+};
+
+// chase-lev deque with fixed capacity, after Le et al. "Correct and efficient
+// work-stealing for weak memory models"; the owner pushes and pops at the
+// bottom, other threads steal from the top
+class work_deque {
+ public:
+  work_deque()
+   :m_top{0}
+   ,m_bottom{0}
+  {
+    for (std::int64_t i = 0; i < DEQUE_CAPACITY; ++i) {
+      m_slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // owner only, false if full
+  bool push(queued_job* entry) {
+    std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    std::int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= DEQUE_CAPACITY) {
+      return false;
+    }
+    m_slots[bottom & (DEQUE_CAPACITY - 1)].store(entry, std::memory_order_relaxed);
+    // publishes the job to thieves reading bottom
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+  }
+
+  // owner only, newest job
+  queued_job* pop() {
+    std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t top = m_top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    queued_job* entry = m_slots[bottom & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // last job, race thieves for it
+      if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        entry = nullptr;
+      }
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return entry;
+  }
+
+  // any thread, oldest job
+  queued_job* steal() {
+    std::int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    queued_job* entry = m_slots[top & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return entry;
+  }
+
+ private:
+  work_deque(work_deque const&);
+  work_deque& operator=(work_deque const&);
+
+  std::atomic<std::int64_t> m_top;
+  std::atomic<std::int64_t> m_bottom;
+  std::atomic<queued_job*> m_slots[DEQUE_CAPACITY];
+};
+
+static std::vector<std::unique_ptr<work_deque>> s_deques{};
+static std::vector<std::thread> s_workers{};
+static unsigned s_threads = 1;
+static std::atomic<bool> s_started{false};
+static std::atomic<bool> s_running{false};
+static std::mutex s_start_mutex{};
+
+// jobs submitted by threads that are no workers, e.g. the gl thread
+static std::deque<queued_job*> s_injected{};
+static std::mutex s_injected_mutex{};
+static std::atomic<std::size_t> s_num_injected{0};
+
+// idle workers sleep until the epoch changes
+static std::atomic<unsigned> s_epoch{0};
+static std::atomic<unsigned> s_sleepers{0};
+static std::mutex s_sleep_mutex{};
+static std::condition_variable s_wake{};
+
+// deque index of the current thread, -1 outside of workers
+static thread_local int s_worker = -1;
+
+// oldest submitted job, or the oldest one decrementing signal if given
+static queued_job* take_injected(jobs::counter const* signal = nullptr) {
+  if (s_num_injected.load(std::memory_order_acquire) == 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock{s_injected_mutex};
+  auto found = s_injected.begin();
+  while (signal && found != s_injected.end() && (*found)->signal != signal) {
+    ++found;
+  }
+  if (found == s_injected.end()) {
+    return nullptr;
+  }
+  queued_job* entry = *found;
+  s_injected.erase(found);
+  s_num_injected.fetch_sub(1, std::memory_order_release);
+  return entry;
+}
+
+// own jobs first, then submitted ones, then steal round the other workers
+static queued_job* find_job() {
+  int self = s_worker;
+  if (self >= 0) {
+    if (queued_job* entry = s_deques[std::size_t(self)]->pop()) {
+      return entry;
+    }
+  }
+  if (queued_job* entry = take_injected()) {
+    return entry;
+  }
+  std::size_t num = s_deques.size();
+  std::size_t first = self >= 0 ? std::size_t(self) + 1 : 0;
+  for (std::size_t i = 0; i < num; ++i) {
+    std::size_t victim = (first + i) % num;
+    if (int(victim) == self) {
+      continue;
+    }
+    if (queued_job* entry = s_deques[victim]->steal()) {
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+static void execute(queued_job* entry) {
+  entry->fn();
+  if (entry->signal) {
+    jobs::finish(*entry->signal);
+  }
+  delete entry;
+}
+
+static void wake_worker() {
+  s_epoch.fetch_add(1);
+  if (s_sleepers.load() > 0) {
+    std::lock_guard<std::mutex> lock{s_sleep_mutex};
+    s_wake.notify_one();
+  }
+}
+
+static void submit(queued_job* entry) {
+  if (s_worker >= 0) {
+    if (!s_deques[std::size_t(s_worker)]->push(entry)) {
+      execute(entry);
+      return;
+    }
+  }
+  else {
+    std::lock_guard<std::mutex> lock{s_injected_mutex};
+    s_injected.push_back(entry);
+    s_num_injected.fetch_add(1, std::memory_order_release);
+  }
+  wake_worker();
+}
+
+static void work(int index) {
+  s_worker = index;
+  unsigned idle = 0;
+  while (s_running.load(std::memory_order_acquire)) {
+    unsigned epoch = s_epoch.load();
+    if (queued_job* entry = find_job()) {
+      execute(entry);
+      idle = 0;
+      continue;
+    }
+    if (++idle < IDLE_SPINS) {
+      std::this_thread::yield();
+      continue;
+    }
+    // sleep unless a job was submitted since the last search
+    std::unique_lock<std::mutex> lock{s_sleep_mutex};
+    s_sleepers.fetch_add(1);
+    s_wake.wait(lock, [epoch]() {
+      return s_epoch.load() != epoch || !s_running.load();
+    });
+    s_sleepers.fetch_sub(1);
+    idle = 0;
+  }
+  s_worker = -1;
+}
+
+// called with the start mutex held
+static void launch(unsigned threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (s_started.load() && threads == s_threads) {
+    return;
+  }
+  jobs::stop();
+  s_threads = threads;
+  s_deques.clear();
+  for (unsigned i = 0; i + 1 < threads; ++i) {
+    s_deques.emplace_back(new work_deque{});
+  }
+  s_running.store(true);
+  for (unsigned i = 0; i + 1 < threads; ++i) {
+    s_workers.emplace_back(work, int(i));
+  }
+  s_started.store(true, std::memory_order_release);
+}
+
+// keeps a configuration chosen with start
+static void ensure_started() {
+  if (!s_started.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock{s_start_mutex};
+    if (!s_started.load()) {
+      launch(0);
+    }
+  }
+}
+
+// joins the workers before the queues are destroyed at exit
+struct shutdown_guard {
+  ~shutdown_guard() {
+    jobs::stop();
+  }
+};
+static shutdown_guard s_shutdown_guard{};
+
+namespace jobs {
+
+counter::counter()
+ :m_pending{0}
+ ,m_mutex{}
+ ,m_dependents{}
+{}
+
+bool counter::done() const {
+  return m_pending.load(std::memory_order_acquire) == 0;
+}
+
+void add(counter& c) {
+  c.m_pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void finish(counter& c) {
+  std::vector<std::pair<job, counter*>> ready{};
+  {
+    // waiters take the lock before returning, so the counter stays alive until released
+    std::lock_guard<std::mutex> lock{c.m_mutex};
+    if (c.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      ready.swap(c.m_dependents);
+    }
+  }
+  // signals of dependent jobs were counted when they were added
+  for (auto& dependent : ready) {
+    ensure_started();
+    submit(new queued_job{dependent.first, dependent.second});
+  }
+}
+
+void start(unsigned threads) {
+  std::lock_guard<std::mutex> lock{s_start_mutex};
+  launch(threads);
+}
+
+void stop() {
+  if (!s_running.load()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock{s_sleep_mutex};
+    s_running.store(false);
+    s_wake.notify_all();
+  }
+  for (auto& worker : s_workers) {
+    worker.join();
+  }
+  s_workers.clear();
+  s_started.store(false, std::memory_order_release);
+  // drop jobs nobody waited for
+  for (auto& deque : s_deques) {
+    while (queued_job* entry = deque->steal()) {
+      delete entry;
+    }
+  }
+  std::lock_guard<std::mutex> lock{s_injected_mutex};
+  for (queued_job* entry : s_injected) {
+    delete entry;
+  }
+  s_injected.clear();
+  s_num_injected.store(0);
+}
+
+unsigned concurrency() {
+  ensure_started();
+  return s_threads;
+}
+
+void run(job const& fn, counter* signal) {
+  ensure_started();
+  if (signal) {
+    add(*signal);
+  }
+  submit(new queued_job{fn, signal});
+}
+
+void run_after(counter& dependency, job const& fn, counter* signal) {
+  if (signal) {
+    // counts from now on, not only once the job is queued
+    add(*signal);
+  }
+  {
+    std::lock_guard<std::mutex> lock{dependency.m_mutex};
+    if (!dependency.done()) {
+      dependency.m_dependents.emplace_back(fn, signal);
+      return;
+    }
+  }
+  ensure_started();
+  submit(new queued_job{fn, signal});
+}
+
+void wait(counter& c) {
+  ensure_started();
+  // other threads, e.g. the gl thread, only help with jobs they submitted for c,
+  // so a frame does not stall behind long unrelated jobs such as asset decoding;
+  // without workers nobody else would run the rest
+  bool help_all = s_worker >= 0 || s_deques.empty();
+  while (!c.done()) {
+    if (queued_job* entry = help_all ? find_job() : take_injected(&c)) {
+      execute(entry);
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+  // the finishing thread may still hold the lock
+  std::lock_guard<std::mutex> lock{c.m_mutex};
+}
+
+};
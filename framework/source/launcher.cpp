@@ -12,15 +12,31 @@
 
 #include <glm/gtc/type_precision.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#ifdef FRAMEWORK_EGL
+  #include <EGL/egl.h>
+  #include <EGL/eglext.h>
+#endif
 
 #include "application.hpp"
 
 #include "utils.hpp"
+#include "profiler.hpp"
+#include "gl_errors.hpp"
+#include "gl_capture.hpp"
+#include "memory_accounting.hpp"
 #include "shader_loader.hpp"
+#include "software_rasterizer.hpp"
+#include "jobs.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <stdexcept>
 
 // use gl definitions from glbinding 
 using namespace gl;
@@ -28,7 +44,9 @@ using namespace gl;
 // helper functions
 std::string resourcePath(int argc, char* argv[]);
 void glsl_error(int error, const char* description);
-void watch_gl_errors(bool activate = true);
+void set_context_hints();
+void print_frame_times(std::vector<double> frame_times);
+void print_memory_usage();
 
 Launcher::Launcher(int argc, char* argv[]) 
  :m_camera_fov{glm::radians(90.0f)}
@@ -37,16 +55,122 @@ Launcher::Launcher(int argc, char* argv[])
 	//, m_window_width{ 640u }
 	//, m_window_height{ 480u }
  ,m_window{nullptr}
+ ,m_headless{false}
+ ,m_benchmark_frames{1000u}
+ ,m_warmup_frames{10u}
+ ,m_egl_display{nullptr}
+ ,m_egl_surface{nullptr}
+ ,m_egl_context{nullptr}
+ ,m_gl_errors{gl_errors::default_level()}
+ ,m_benchmark_gl_errors{false}
+ ,m_start_time{std::chrono::steady_clock::now()}
  ,m_last_second_time{0.0}
  ,m_frames_per_second{0u}
  ,m_resource_path{resourcePath(argc, argv)}
+ ,m_trace_path{}
+ ,m_reference_prefix{}
+ ,m_capture_path{}
+ ,m_capture_frames{10u}
+ ,m_replay_loops{1u}
+ ,m_memory_path{}
+ ,m_program_cache{"shader_cache"}
+ ,m_file_watcher{}
  ,m_application{}
-{}
+{
+  // options follow the optional resource path
+  bool gl_errors_set = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string option{argv[i]};
+    bool has_value = i + 1 < argc;
+    // without FRAMEWORK_EGL the offscreen context comes from a hidden glfw window,
+    // which still needs a display server such as X or Xvfb
+    if (option == "--headless") {
+      m_headless = true;
+    }
+    else if (option == "--gl-errors" && has_value) {
+      try {
+        m_gl_errors = gl_errors::parse(argv[++i]);
+        gl_errors_set = true;
+      }
+      catch (std::invalid_argument& error) {
+        std::cerr << error.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    else if (option == "--bench-gl-errors") {
+      m_benchmark_gl_errors = true;
+    }
+    else if (option == "--frames" && has_value) {
+      m_benchmark_frames = unsigned(std::max(1, std::atoi(argv[++i])));
+    }
+    else if (option == "--warmup" && has_value) {
+      m_warmup_frames = unsigned(std::max(0, std::atoi(argv[++i])));
+    }
+    else if (option == "--shader-cache" && has_value) {
+      // empty path disables the binary cache
+      m_program_cache = ProgramCache{argv[++i]};
+    }
+    else if (option == "--trace" && has_value) {
+      m_trace_path = argv[++i];
+    }
+    else if (option == "--reference" && has_value) {
+      m_reference_prefix = argv[++i];
+    }
+    else if (option == "--capture" && has_value) {
+      m_capture_path = argv[++i];
+    }
+    else if (option == "--capture-frames" && has_value) {
+      m_capture_frames = unsigned(std::max(1, std::atoi(argv[++i])));
+    }
+    else if (option == "--loops" && has_value) {
+      m_replay_loops = unsigned(std::max(1, std::atoi(argv[++i])));
+    }
+    else if (option == "--memory" && has_value) {
+      m_memory_path = argv[++i];
+    }
+    else if ((option == "--cpu-budget" || option == "--gpu-budget") && has_value) {
+      // megabytes, a headless run exceeding a budget fails
+      std::size_t bytes = std::size_t(std::max(0.0, std::atof(argv[++i])) * 1024.0 * 1024.0);
+      memory_accounting::set_budget(option == "--cpu-budget" ? memory_accounting::CPU : memory_accounting::GPU, bytes);
+    }
+    else if (option == "--size" && has_value) {
+      std::string size{argv[++i]};
+      std::size_t separator = size.find('x');
+      int width = std::atoi(size.substr(0, separator).c_str());
+      int height = separator == std::string::npos ? 0 : std::atoi(size.substr(separator + 1).c_str());
+      if (width <= 0 || height <= 0) {
+        std::cerr << "Invalid size '" << size << "', expected WIDTHxHEIGHT" << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+      m_window_width = unsigned(width);
+      m_window_height = unsigned(height);
+    }
+    else if (option.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option '" << option << "'" << std::endl
+                << "usage: " << argv[0] << " [resource path] [--headless] [--frames N] [--warmup N] [--size WIDTHxHEIGHT] [--trace FILE] [--shader-cache DIR]"
+                << " [--gl-errors off|debug|full] [--bench-gl-errors] [--reference PREFIX] [--capture FILE] [--capture-frames N] [--loops N]"
+                << " [--memory FILE] [--cpu-budget MB] [--gpu-budget MB]" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  // per call checks would dominate benchmark frame times
+  if (m_headless && !gl_errors_set && m_gl_errors == gl_errors::PER_CALL) {
+    m_gl_errors = gl_errors::DEBUG_OUTPUT;
+  }
+  // capture owns the glbinding callbacks and the trace must contain shader
+  // sources, not driver specific binaries
+  if (!m_capture_path.empty()) {
+    if (m_gl_errors == gl_errors::PER_CALL) {
+      m_gl_errors = gl_errors::DEBUG_OUTPUT;
+    }
+    m_program_cache = ProgramCache{""};
+  }
+}
 
 std::string resourcePath(int argc, char* argv[]) {
   std::string resource_path{};
-  //first argument is resource path
-  if (argc > 1) {
+  //first argument is resource path, unless it is an option
+  if (argc > 1 && std::string{argv[1]}.compare(0, 2, "--") != 0) {
     resource_path = argv[1];
   }
   // no resource path specified, use default
@@ -59,14 +183,7 @@ std::string resourcePath(int argc, char* argv[]) {
   return resource_path;
 }
 
-void Launcher::initialize() {
-
-  glfwSetErrorCallback(glsl_error);
-
-  if (!glfwInit()) {
-    std::exit(EXIT_FAILURE);
-  }
-
+void set_context_hints() {
   // set OGL version explicitly 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
@@ -77,6 +194,24 @@ void Launcher::initialize() {
   #else
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
   #endif
+}
+
+void Launcher::initialize() {
+
+  if (m_headless) {
+    initialize_headless();
+    return;
+  }
+
+  glfwSetErrorCallback(glsl_error);
+
+  if (!glfwInit()) {
+    std::exit(EXIT_FAILURE);
+  }
+
+  set_context_hints();
+  // debug output is only guaranteed in debug contexts
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debug_context());
   // create m_window, if unsuccessfull, quit
   m_window = glfwCreateWindow(m_window_width, m_window_height, "OpenGL Framework", NULL, NULL);
   if (!m_window) {
@@ -104,15 +239,103 @@ void Launcher::initialize() {
   // allow free mouse movement
   // register resizing function
   auto resize_func = [](GLFWwindow* w, int a, int b) {
-        static_cast<Launcher*>(glfwGetWindowUserPointer(w))->update_projection(w, a, b);
+        static_cast<Launcher*>(glfwGetWindowUserPointer(w))->update_projection(a, b);
   };
   glfwSetFramebufferSizeCallback(m_window, resize_func);
 
   // initialize glindings in this context
   glbinding::Binding::initialize();
 
-  // activate error checking after each gl function call
-  watch_gl_errors();
+  // activate selected error checking
+  m_gl_errors = gl_errors::watch(m_gl_errors);
+}
+
+bool Launcher::debug_context() const {
+  // the error benchmark switches to debug output after the context exists
+  return m_gl_errors == gl_errors::DEBUG_OUTPUT || m_benchmark_gl_errors;
+}
+
+void Launcher::initialize_headless() {
+#ifdef FRAMEWORK_EGL
+  // pbuffer context needs no display server, mesa falls back to llvmpipe without gpu
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+    std::cerr << "EGL Error: could not initialize display" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  EGLint const config_attributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_NONE
+  };
+  EGLConfig config{};
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display, config_attributes, &config, 1, &num_configs) || num_configs < 1) {
+    std::cerr << "EGL Error: no pbuffer config with desktop OpenGL" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  EGLint const surface_attributes[] = {
+    EGL_WIDTH, EGLint(m_window_width),
+    EGL_HEIGHT, EGLint(m_window_height),
+    EGL_NONE
+  };
+  EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attributes);
+
+  // same version and profile as the windowed context
+  eglBindAPI(EGL_OPENGL_API);
+  EGLint const context_attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+    // debug output is only guaranteed in debug contexts
+    EGL_CONTEXT_FLAGS_KHR, debug_context() ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0,
+  #ifdef __APPLE__
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+  #else
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+  #endif
+    EGL_NONE
+  };
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+    std::cerr << "EGL Error: could not create OpenGL 3.2 pbuffer context" << std::endl;
+    eglTerminate(display);
+    std::exit(EXIT_FAILURE);
+  }
+
+  m_egl_display = display;
+  m_egl_surface = surface;
+  m_egl_context = context;
+#else
+  glfwSetErrorCallback(glsl_error);
+
+  if (!glfwInit()) {
+    std::exit(EXIT_FAILURE);
+  }
+
+  set_context_hints();
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debug_context());
+  // window is never shown, rendering goes to its back buffer
+  glfwWindowHint(GLFW_VISIBLE, false);
+  m_window = glfwCreateWindow(m_window_width, m_window_height, "OpenGL Framework", NULL, NULL);
+  if (!m_window) {
+    std::cerr << "headless mode without FRAMEWORK_EGL needs a display server, rebuild with -DFRAMEWORK_EGL=ON" << std::endl;
+    glfwTerminate();
+    std::exit(EXIT_FAILURE);
+  }
+
+  glfwMakeContextCurrent(m_window);
+  glfwSwapInterval(0);
+#endif
+
+  // initialize glindings in this context
+  glbinding::Binding::initialize();
+
+  // activate selected error checking, the benchmark loop also checks once per frame
+  m_gl_errors = gl_errors::watch(m_gl_errors);
 }
  
 void Launcher::mainLoop() {
@@ -123,18 +346,34 @@ void Launcher::mainLoop() {
   // enable depth testing
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LESS);
-    
+  gl_capture::end_setup();
 
   // rendering loop
+  bool first_frame = true;
   while (!glfwWindowShouldClose(m_window)) {
+    profiler::begin_frame();
     // query input
     glfwPollEvents();
+    // swap in edited shaders between frames
+    reload_changed_shaders();
     // clear buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     // draw geometry
-    m_application->render();
+    {
+      profiler::cpu_scope scope{"render"};
+      m_application->render();
+    }
     // swap draw buffer to front
-    glfwSwapBuffers(m_window);
+    {
+      profiler::cpu_scope scope{"swap"};
+      glfwSwapBuffers(m_window);
+    }
+    profiler::end_frame();
+    gl_capture::end_frame();
+    if (first_frame) {
+      print_first_frame_time();
+      first_frame = false;
+    }
     // display fps
     show_fps();
   }
@@ -142,9 +381,205 @@ void Launcher::mainLoop() {
   quit(EXIT_SUCCESS);
 }
 
+void Launcher::benchmarkLoop() {
+  // throw exception if shader compilation was unsuccessfull
+  update_shader_programs(true);
+
+  // enable depth testing
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  gl_capture::end_setup();
+
+  // camera circles the origin once around the y axis, starting at the application's view
+  glm::fmat4 start_view = m_application->getViewTransform();
+  unsigned num_frames = m_warmup_frames + m_benchmark_frames;
+
+  std::vector<double> frame_times{};
+  frame_times.reserve(m_benchmark_frames);
+  auto last_frame = std::chrono::steady_clock::now();
+
+  for (unsigned frame = 0; frame < num_frames; ++frame) {
+    float angle = 2.0f * glm::pi<float>() * float(frame) / float(num_frames);
+    m_application->setView(glm::rotate(glm::fmat4{}, angle, glm::fvec3{0.0f, 1.0f, 0.0f}) * start_view);
+    // assets stream in during warmup, measured frames draw them all
+    if (frame == m_warmup_frames && frame > 0) {
+      m_application->finishLoading();
+      last_frame = std::chrono::steady_clock::now();
+    }
+
+    profiler::begin_frame();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+      profiler::cpu_scope scope{"render"};
+      m_application->render();
+    }
+    if (m_window) {
+      glfwSwapBuffers(m_window);
+    }
+    // wait for the gpu, so frame times include rendering and not only submission
+    {
+      profiler::cpu_scope scope{"finish"};
+      glFinish();
+    }
+    profiler::end_frame();
+    gl_capture::end_frame();
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+      std::cerr << "OpenGL Error in frame " << frame << " - " << glbinding::Meta::getString(error) << std::endl;
+      quit(EXIT_FAILURE);
+    }
+
+    if (frame == 0) {
+      print_first_frame_time();
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (frame >= m_warmup_frames) {
+      frame_times.push_back(std::chrono::duration<double, std::milli>(now - last_frame).count());
+    }
+    last_frame = now;
+  }
+
+  std::cout << "Rendered " << m_benchmark_frames << " frames at " << m_window_width << "x" << m_window_height
+            << " on " << glGetString(GL_RENDERER) << std::endl;
+  print_frame_times(frame_times);
+  if (!m_trace_path.empty()) {
+    profiler::export_chrome_trace(m_trace_path);
+    std::cout << "Wrote trace of last " << profiler::frames().size() << " frames to " << m_trace_path << std::endl;
+  }
+  if (!m_reference_prefix.empty()) {
+    referenceLoop(start_view);
+  }
+
+  print_memory_usage();
+  if (!m_memory_path.empty()) {
+    memory_accounting::write_json(m_memory_path);
+    std::cout << "Wrote memory report to " << m_memory_path << std::endl;
+  }
+  if (!memory_accounting::within_budget()) {
+    std::cerr << "Memory usage exceeded the budget" << std::endl;
+    quit(EXIT_FAILURE);
+  }
+
+  quit(EXIT_SUCCESS);
+}
+
+void Launcher::referenceLoop(glm::fmat4 const& start_view) {
+  // gl image of the start view, rendered again once everything it needs is loaded
+  m_application->setView(start_view);
+  for (unsigned pass = 0; pass < 2; ++pass) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    m_application->render();
+    if (pass == 0) {
+      m_application->finishLoading();
+    }
+  }
+  glFinish();
+  std::vector<std::uint8_t> pixels(std::size_t(m_window_width) * m_window_height * 3);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, GLsizei(m_window_width), GLsizei(m_window_height), GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+  pixel_data gl_image{pixels, GL_RGB, GL_UNSIGNED_BYTE, m_window_width, m_window_height};
+
+  // same frame on the cpu
+  SoftwareRasterizer rasterizer{m_window_width, m_window_height};
+  m_application->renderSoftware(rasterizer);
+  pixel_data software_image = rasterizer.image();
+
+  write_ppm(m_reference_prefix + ".gl.ppm", gl_image);
+  write_ppm(m_reference_prefix + ".software.ppm", software_image);
+
+  // per channel differences in 8 bit steps
+  unsigned max_difference = 0;
+  double sum = 0.0;
+  std::size_t differing = 0;
+  for (std::size_t i = 0; i < pixels.size(); i += 3) {
+    unsigned pixel_max = 0;
+    for (std::size_t c = i; c < i + 3; ++c) {
+      unsigned difference = unsigned(std::abs(int(gl_image.pixels[c]) - int(software_image.pixels[c])));
+      pixel_max = std::max(pixel_max, difference);
+      sum += double(difference);
+    }
+    max_difference = std::max(max_difference, pixel_max);
+    // small differences come from rounding and filtering
+    if (pixel_max > 8) {
+      ++differing;
+    }
+  }
+  std::cout << "Wrote " << m_reference_prefix << ".gl.ppm and " << m_reference_prefix << ".software.ppm, "
+            << rasterizer.num_primitives() << " primitives, " << rasterizer.num_binned() << " binned" << std::endl
+            << "difference: mean " << sum / double(pixels.size()) << ", max " << max_difference << ", "
+            << 100.0 * double(differing) / double(pixels.size() / 3) << "% of pixels off by more than 8" << std::endl;
+
+  // software frames along the benchmark path
+  std::vector<double> frame_times{};
+  for (unsigned frame = 0; frame < m_benchmark_frames; ++frame) {
+    float angle = 2.0f * glm::pi<float>() * float(frame) / float(m_benchmark_frames);
+    m_application->setView(glm::rotate(glm::fmat4{}, angle, glm::fvec3{0.0f, 1.0f, 0.0f}) * start_view);
+    auto start = std::chrono::steady_clock::now();
+    m_application->renderSoftware(rasterizer);
+    frame_times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::cout << "Rendered " << m_benchmark_frames << " software frames at " << m_window_width << "x" << m_window_height
+            << " on " << jobs::concurrency() << " threads" << std::endl;
+  print_frame_times(frame_times);
+}
+
+void Launcher::replay(int argc, char* argv[]) {
+  if (argc < 2 || std::string{argv[1]}.compare(0, 2, "--") == 0) {
+    std::cerr << "usage: " << argv[0] << " TRACE [--loops N] [--gl-errors off|debug]" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  gl_capture::player player{argv[1]};
+  // remaining arguments are launcher options
+  Launcher launcher{argc - 1, argv + 1};
+  // offscreen context of the captured size, replay has no input
+  launcher.m_headless = true;
+  launcher.m_window_width = player.width();
+  launcher.m_window_height = player.height();
+  if (launcher.m_gl_errors == gl_errors::PER_CALL) {
+    launcher.m_gl_errors = gl_errors::DEBUG_OUTPUT;
+  }
+  launcher.initialize();
+  launcher.replayLoop(player);
+}
+
+void Launcher::replayLoop(gl_capture::player& player) {
+  auto start = std::chrono::steady_clock::now();
+  player.play_setup();
+  glFinish();
+  std::cout << "Replayed setup in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+            << " ms" << std::endl;
+
+  std::vector<double> frame_times{};
+  std::size_t errors = 0;
+  for (unsigned loop = 0; loop < m_replay_loops; ++loop) {
+    for (std::size_t frame = 0; frame < player.num_frames(); ++frame) {
+      start = std::chrono::steady_clock::now();
+      player.play_frame(frame);
+      if (m_window) {
+        glfwSwapBuffers(m_window);
+      }
+      // include gpu execution as the benchmark loop does
+      glFinish();
+      frame_times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      // the captured application may have caused errors itself, so only count them
+      if (glGetError() != GL_NO_ERROR) {
+        ++errors;
+      }
+    }
+  }
+
+  std::cout << "Replayed " << player.num_frames() << " frames " << m_replay_loops << " times at " << m_window_width << "x" << m_window_height
+            << " on " << glGetString(GL_RENDERER) << ", " << errors << " frames with errors" << std::endl;
+  print_frame_times(frame_times);
+  player.print_calls(std::cout);
+  quit(EXIT_SUCCESS);
+}
+
 ///////////////////////////// update functions ////////////////////////////////
 // update viewport and field of view
-void Launcher::update_projection(GLFWwindow* m_window, int width, int height) {
+void Launcher::update_projection(int width, int height) {
   // resize framebuffer
   glViewport(0, 0, width, height);
 
@@ -162,39 +597,75 @@ void Launcher::update_projection(GLFWwindow* m_window, int width, int height) {
 
 // load shader programs and update uniform locations
 void Launcher::update_shader_programs(bool throwing) {
-  // actual functionality in lambda to allow update with and without throwing
-  auto update_lambda = [&](){
-    // reload all shader programs
-    for (auto& pair : m_application->getShaderPrograms()) {
-      // throws exception when compiling was unsuccessfull
-      GLuint new_program = shader_loader::program(pair.second.vertex_path,
-                                                  pair.second.fragment_path);
-      // free old shader program
-      glDeleteProgram(pair.second.handle);
-      // save new shader program
-      pair.second.handle = new_program;
-    }
-  };
-
-  if (throwing) {
-    update_lambda();
+  std::size_t rebuilt = 0;
+  try {
+    // only programs with changed sources are rebuilt
+    rebuilt = m_program_cache.build(m_application->getShaderPrograms());
   }
-  else {
-    try {
-     update_lambda();
-    }
-    catch(std::exception&) {
-      // dont crash, allow another try
+  catch(std::exception&) {
+    // dont crash, allow another try
+    if (throwing) {
+      throw;
     }
   }
+  std::cout << "Built " << rebuilt << " shader programs in " << m_program_cache.build_milliseconds() << " ms ("
+            << m_program_cache.cache_hits() << " cached, " << m_program_cache.compiled() << " compiled)" << std::endl;
+  if (!m_headless) {
+    watch_shader_files();
+  }
+  if (rebuilt == 0) {
+    return;
+  }
 
   // after shader programs are recompiled, uniform locations may change
   m_application->uploadUniforms();
   
   // upload projection matrix to new shaders
-  int width, height;
-  glfwGetFramebufferSize(m_window, &width, &height);
-  update_projection(m_window, width, height);
+  int width = int(m_window_width);
+  int height = int(m_window_height);
+  if (!m_headless) {
+    glfwGetFramebufferSize(m_window, &width, &height);
+  }
+  update_projection(width, height);
+}
+
+void Launcher::reload_changed_shaders() {
+  std::vector<std::string> changed = m_file_watcher.poll();
+  std::map<std::string, shader_program>& programs = m_application->getShaderPrograms();
+  if (!changed.empty()) {
+    for (std::string const& path : changed) {
+      shader_loader::invalidate(path);
+    }
+    for (auto& pair : programs) {
+      std::vector<std::string> const& dependencies = pair.second.dependencies;
+      bool affected = std::find_first_of(dependencies.begin(), dependencies.end(), changed.begin(), changed.end()) != dependencies.end();
+      if (affected) {
+        m_program_cache.request(pair.first, pair.second);
+      }
+    }
+    // a program may read other files after the change
+    watch_shader_files();
+  }
+  if (!m_program_cache.pending() && changed.empty()) {
+    return;
+  }
+
+  // only programs that finished building are swapped, the others keep rendering
+  for (std::string const& name : m_program_cache.poll(false)) {
+    m_application->uploadProgramUniforms(name);
+    std::cout << "Reloaded shader program " << name << std::endl;
+  }
+  for (std::string const& name : m_program_cache.failed()) {
+    std::cerr << "Reloading shader program " << name << " failed, keeping previous version" << std::endl;
+  }
+}
+
+void Launcher::watch_shader_files() {
+  for (auto const& pair : m_application->getShaderPrograms()) {
+    for (std::string const& path : pair.second.dependencies) {
+      m_file_watcher.watch(path);
+    }
+  }
 }
 
 ///////////////////////////// misc functions ////////////////////////////////
@@ -206,6 +677,26 @@ void Launcher::key_callback(GLFWwindow* m_window, int key, int scancode, int act
   else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
     update_shader_programs(false);
   }
+  else if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+    std::string path = m_trace_path.empty() ? "profile.json" : m_trace_path;
+    try {
+      profiler::export_chrome_trace(path);
+      std::cout << "Wrote trace of last " << profiler::frames().size() << " frames to " << path << std::endl;
+    }
+    catch(std::exception&) {
+      // dont crash, allow another try
+    }
+  }
+  else if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+    std::string path = m_memory_path.empty() ? "memory.json" : m_memory_path;
+    try {
+      memory_accounting::write_json(path);
+      std::cout << "Wrote memory report to " << path << std::endl;
+    }
+    catch(std::exception&) {
+      // dont crash, allow another try
+    }
+  }
   m_application->keyCallback(key, scancode, action, mods);
 }
 
@@ -230,9 +721,27 @@ void Launcher::show_fps() {
   }
 }
 
+void Launcher::print_first_frame_time() const {
+  std::cout << "First frame after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start_time).count()
+            << " ms" << std::endl;
+}
+
 void Launcher::quit(int status) {
+  // write the trace of a capture ended early
+  gl_capture::stop();
   // free opengl resources
   delete m_application;
+  profiler::shutdown();
+#ifdef FRAMEWORK_EGL
+  if (m_egl_display) {
+    // free egl resources
+    eglMakeCurrent(m_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(m_egl_display, m_egl_context);
+    eglDestroySurface(m_egl_display, m_egl_surface);
+    eglTerminate(m_egl_display);
+    std::exit(status);
+  }
+#endif
   // free glfw resources
   glfwDestroyWindow(m_window);
   glfwTerminate();
@@ -240,43 +749,44 @@ void Launcher::quit(int status) {
   std::exit(status);
 }
 
+// print frame time distribution in milliseconds
+void print_frame_times(std::vector<double> frame_times) {
+  if (frame_times.empty()) {
+    return;
+  }
+  std::sort(frame_times.begin(), frame_times.end());
+  double sum = 0.0;
+  for (double time : frame_times) {
+    sum += time;
+  }
+  double mean = sum / double(frame_times.size());
+
+  std::cout << "frame time ms: min " << frame_times.front()
+            << ", mean " << mean
+            << ", median " << utils::percentile(frame_times, 0.5)
+            << ", p95 " << utils::percentile(frame_times, 0.95)
+            << ", p99 " << utils::percentile(frame_times, 0.99)
+            << ", max " << frame_times.back() << std::endl;
+  std::cout << "average fps: " << 1000.0 / mean << std::endl;
+}
+
 
 void glsl_error(int error, const char* description) {
   std::cerr << "GLSL Error " << error << " : "<< description << std::endl;
 }
 
-void watch_gl_errors(bool activate) {
-  if(activate) {
-    // add callback after each function call
-    glbinding::setCallbackMaskExcept(glbinding::CallbackMask::After | glbinding::CallbackMask::ParametersAndReturnValue, {"glGetError", "glBegin", "glVertex3f", "glColor3f"});
-    glbinding::setAfterCallback(
-      [](glbinding::FunctionCall const& call) {
-        GLenum error = glGetError();
-        if (error != GL_NO_ERROR) {
-          // print name
-          std::cerr <<  "OpenGL Error: " << call.function->name() << "(";
-          // parameters
-          for (unsigned i = 0; i < call.parameters.size(); ++i)
-          {
-            std::cerr << call.parameters[i]->asString();
-            if (i < call.parameters.size() - 1)
-              std::cerr << ", ";
-          }
-          std::cerr << ")";
-          // return value
-          if(call.returnValue) {
-            std::cerr << " -> " << call.returnValue->asString();
-          }
-          // error
-          std::cerr  << " - " << glbinding::Meta::getString(error) << std::endl;
-          // throw exception to allow for backtrace
-          throw std::runtime_error("Execution of " + std::string(call.function->name()));
-          exit(EXIT_FAILURE);
-        }
-      }
-    );
-  }
-  else {
-    glbinding::setCallbackMask(glbinding::CallbackMask::None);
+// live and peak megabytes per domain and category
+void print_memory_usage() {
+  for (unsigned d = 0; d < memory_accounting::NUM_DOMAINS; ++d) {
+    memory_accounting::domain where = memory_accounting::domain(d);
+    memory_accounting::totals total = memory_accounting::usage(where);
+    std::cout << memory_accounting::name(where) << " memory MB: live " << double(total.live_bytes) / 1048576.0
+              << ", peak " << double(total.peak_bytes) / 1048576.0 << " (";
+    for (unsigned c = 0; c < memory_accounting::NUM_CATEGORIES; ++c) {
+      memory_accounting::category type = memory_accounting::category(c);
+      std::cout << (c > 0 ? ", " : "") << memory_accounting::name(type) << " "
+                << double(memory_accounting::usage(where, type).live_bytes) / 1048576.0;
+    }
+    std::cout << ")" << std::endl;
   }
 }
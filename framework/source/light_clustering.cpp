@@ -0,0 +1,279 @@
+#include "light_clustering.hpp"
+#include "jobs.hpp"
+#include "simd_lanes.hpp"
+
+#include <glm/common.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+///////////////////////////// cluster_grid ////////////////////////////////
+cluster_grid::cluster_grid()
+ :tiles_x{1}
+ ,tiles_y{1}
+ ,slices{1}
+ ,near{0.1f}
+ ,far{100.0f}
+{}
+
+cluster_grid::cluster_grid(unsigned x, unsigned y, unsigned z, float n, float f)
+ :tiles_x{std::max(x, 1u)}
+ ,tiles_y{std::max(y, 1u)}
+ ,slices{std::max(z, 1u)}
+ ,near{n}
+ ,far{f}
+{}
+
+std::size_t cluster_grid::size() const {
+  return std::size_t(tiles_x) * tiles_y * slices;
+}
+
+std::size_t cluster_grid::index(unsigned x, unsigned y, unsigned slice) const {
+  return x + std::size_t(tiles_x) * (y + std::size_t(tiles_y) * slice);
+}
+
+unsigned cluster_grid::slice(float depth) const {
+  glm::fvec2 mapping = slice_mapping();
+  float s = std::log(std::max(depth, near)) * mapping.x + mapping.y;
+  return std::min(unsigned(std::max(s, 0.0f)), slices - 1);
+}
+
+float cluster_grid::slice_depth(unsigned slice) const {
+  return near * std::pow(far / near, float(slice) / float(slices));
+}
+
+glm::fvec2 cluster_grid::slice_mapping() const {
+  float scale = float(slices) / std::log(far / near);
+  return glm::fvec2{scale, -std::log(near) * scale};
+}
+
+///////////////////////////// binning ////////////////////////////////
+// lights passing one level of the hierarchy, gathered for contiguous loads
+struct candidates {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> radius;
+  // index into the binned lights
+  std::vector<unsigned> ids;
+  // positions of overlapping candidates, written by overlap
+  std::vector<unsigned> hits;
+};
+
+// write positions of the first num spheres overlapping the box to out, return count;
+// the squared distance from the centre to the box is compared against the squared radius
+static std::size_t overlap(glm::fvec3 const& min, glm::fvec3 const& max, float const* x, float const* y, float const* z,
+                           float const* r, std::size_t num, unsigned* out) {
+  std::size_t count = 0;
+  std::size_t i = 0;
+#ifdef SIMD_LANES_AVX
+  {
+    __m256 min_x = _mm256_set1_ps(min.x);
+    __m256 min_y = _mm256_set1_ps(min.y);
+    __m256 min_z = _mm256_set1_ps(min.z);
+    __m256 max_x = _mm256_set1_ps(max.x);
+    __m256 max_y = _mm256_set1_ps(max.y);
+    __m256 max_z = _mm256_set1_ps(max.z);
+    __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= num; i += 8) {
+      __m256 cx = _mm256_loadu_ps(x + i);
+      __m256 cy = _mm256_loadu_ps(y + i);
+      __m256 cz = _mm256_loadu_ps(z + i);
+      __m256 radius = _mm256_loadu_ps(r + i);
+      // one of the two differences is positive when the centre is outside
+      __m256 dx = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(min_x, cx), zero), _mm256_max_ps(_mm256_sub_ps(cx, max_x), zero));
+      __m256 dy = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(min_y, cy), zero), _mm256_max_ps(_mm256_sub_ps(cy, max_y), zero));
+      __m256 dz = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(min_z, cz), zero), _mm256_max_ps(_mm256_sub_ps(cz, max_z), zero));
+      __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+      __m256 inside = _mm256_cmp_ps(distance, _mm256_mul_ps(radius, radius), _CMP_LE_OQ);
+      count = simd::compact(out, count, unsigned(i), _mm256_movemask_ps(inside), 8);
+    }
+  }
+#endif
+#ifdef SIMD_LANES_SSE
+  {
+    __m128 min_x = _mm_set1_ps(min.x);
+    __m128 min_y = _mm_set1_ps(min.y);
+    __m128 min_z = _mm_set1_ps(min.z);
+    __m128 max_x = _mm_set1_ps(max.x);
+    __m128 max_y = _mm_set1_ps(max.y);
+    __m128 max_z = _mm_set1_ps(max.z);
+    __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= num; i += 4) {
+      __m128 cx = _mm_loadu_ps(x + i);
+      __m128 cy = _mm_loadu_ps(y + i);
+      __m128 cz = _mm_loadu_ps(z + i);
+      __m128 radius = _mm_loadu_ps(r + i);
+      __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_x, cx), zero), _mm_max_ps(_mm_sub_ps(cx, max_x), zero));
+      __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_y, cy), zero), _mm_max_ps(_mm_sub_ps(cy, max_y), zero));
+      __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_z, cz), zero), _mm_max_ps(_mm_sub_ps(cz, max_z), zero));
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+      __m128 inside = _mm_cmple_ps(distance, _mm_mul_ps(radius, radius));
+      count = simd::compact(out, count, unsigned(i), _mm_movemask_ps(inside), 4);
+    }
+  }
+#endif
+  for (; i < num; ++i) {
+    bool inside = clustering::intersects(glm::fvec3{x[i], y[i], z[i]}, r[i], min, max);
+    count = simd::compact(out, count, unsigned(i), inside ? 1 : 0, 1);
+  }
+  return count;
+}
+
+static void resize(candidates& c, std::size_t num) {
+  c.x.resize(num);
+  c.y.resize(num);
+  c.z.resize(num);
+  c.radius.resize(num);
+  c.ids.resize(num);
+}
+
+// gather the candidates overlapping the box into out
+static void filter(glm::fvec3 const& min, glm::fvec3 const& max, candidates& all, candidates& out) {
+  std::size_t num = all.ids.size();
+  all.hits.resize(num);
+  std::size_t count = overlap(min, max, all.x.data(), all.y.data(), all.z.data(), all.radius.data(), num, all.hits.data());
+  resize(out, count);
+  for (std::size_t k = 0; k < count; ++k) {
+    unsigned i = all.hits[k];
+    out.x[k] = all.x[i];
+    out.y[k] = all.y[i];
+    out.z[k] = all.z[i];
+    out.radius[k] = all.radius[i];
+    out.ids[k] = all.ids[i];
+  }
+}
+
+// bin lights into the clusters of one slice, ranges start at the slice's
+// own index list and are offset once all slices are done
+static void assign_slice(cluster_grid const& grid, cluster_volumes const& bounds, sphere_set const& lights, unsigned slice,
+                         candidates (&scratch)[2], std::vector<unsigned>& ranges, std::vector<unsigned>& indices) {
+  indices.clear();
+  box_set const& slices = bounds.slices;
+  glm::fvec3 slice_min{slices.min_x[slice], slices.min_y[slice], slices.min_z[slice]};
+  glm::fvec3 slice_max{slices.max_x[slice], slices.max_y[slice], slices.max_z[slice]};
+  candidates& in_slice = scratch[0];
+  std::size_t num = lights.size();
+  in_slice.hits.resize(num);
+  std::size_t count = overlap(slice_min, slice_max, lights.center_x.data(), lights.center_y.data(), lights.center_z.data(),
+                              lights.radius.data(), num, in_slice.hits.data());
+  resize(in_slice, count);
+  for (std::size_t k = 0; k < count; ++k) {
+    unsigned i = in_slice.hits[k];
+    in_slice.x[k] = lights.center_x[i];
+    in_slice.y[k] = lights.center_y[i];
+    in_slice.z[k] = lights.center_z[i];
+    in_slice.radius[k] = lights.radius[i];
+    in_slice.ids[k] = i;
+  }
+
+  candidates& in_row = scratch[1];
+  box_set const& rows = bounds.rows;
+  box_set const& clusters = bounds.clusters;
+  for (unsigned y = 0; y < grid.tiles_y; ++y) {
+    std::size_t row = y + std::size_t(grid.tiles_y) * slice;
+    filter(glm::fvec3{rows.min_x[row], rows.min_y[row], rows.min_z[row]},
+           glm::fvec3{rows.max_x[row], rows.max_y[row], rows.max_z[row]}, in_slice, in_row);
+    in_row.hits.resize(in_row.ids.size());
+    for (unsigned x = 0; x < grid.tiles_x; ++x) {
+      std::size_t c = grid.index(x, y, slice);
+      std::size_t hits = overlap(glm::fvec3{clusters.min_x[c], clusters.min_y[c], clusters.min_z[c]},
+                                 glm::fvec3{clusters.max_x[c], clusters.max_y[c], clusters.max_z[c]},
+                                 in_row.x.data(), in_row.y.data(), in_row.z.data(), in_row.radius.data(),
+                                 in_row.ids.size(), in_row.hits.data());
+      ranges[2 * c] = unsigned(indices.size());
+      ranges[2 * c + 1] = unsigned(hits);
+      for (std::size_t k = 0; k < hits; ++k) {
+        indices.push_back(in_row.ids[in_row.hits[k]]);
+      }
+    }
+  }
+}
+
+namespace clustering {
+
+bool intersects(glm::fvec3 const& center, float radius, glm::fvec3 const& min, glm::fvec3 const& max) {
+  glm::fvec3 closest = glm::clamp(center, min, max);
+  glm::fvec3 offset = center - closest;
+  return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z <= radius * radius;
+}
+
+cluster_volumes volumes(cluster_grid const& grid, glm::fmat4 const& projection) {
+  // direction through each tile corner, scaled to a view depth of one
+  glm::fmat4 inverse = glm::inverse(projection);
+  std::vector<glm::fvec3> corners{};
+  for (unsigned y = 0; y <= grid.tiles_y; ++y) {
+    for (unsigned x = 0; x <= grid.tiles_x; ++x) {
+      glm::fvec2 ndc{float(x) / float(grid.tiles_x) * 2.0f - 1.0f, float(y) / float(grid.tiles_y) * 2.0f - 1.0f};
+      glm::fvec4 point = inverse * glm::fvec4{ndc, -1.0f, 1.0f};
+      glm::fvec3 on_near = glm::fvec3{point} / point.w;
+      corners.push_back(on_near / -on_near.z);
+    }
+  }
+
+  float infinity = std::numeric_limits<float>::max();
+  cluster_volumes bounds{};
+  for (unsigned s = 0; s < grid.slices; ++s) {
+    float depths[2] = {grid.slice_depth(s), grid.slice_depth(s + 1)};
+    glm::fvec3 slice_min{infinity};
+    glm::fvec3 slice_max{-infinity};
+    for (unsigned y = 0; y < grid.tiles_y; ++y) {
+      glm::fvec3 row_min{infinity};
+      glm::fvec3 row_max{-infinity};
+      for (unsigned x = 0; x < grid.tiles_x; ++x) {
+        glm::fvec3 min{infinity};
+        glm::fvec3 max{-infinity};
+        // the tile's four corner rays at the near and far depth of the slice
+        for (unsigned corner = 0; corner < 4; ++corner) {
+          glm::fvec3 const& direction = corners[(y + corner / 2) * (grid.tiles_x + 1) + x + corner % 2];
+          for (float depth : depths) {
+            min = glm::min(min, direction * depth);
+            max = glm::max(max, direction * depth);
+          }
+        }
+        bounds.clusters.add(min, max);
+        row_min = glm::min(row_min, min);
+        row_max = glm::max(row_max, max);
+      }
+      bounds.rows.add(row_min, row_max);
+      slice_min = glm::min(slice_min, row_min);
+      slice_max = glm::max(slice_max, row_max);
+    }
+    bounds.slices.add(slice_min, slice_max);
+  }
+  return bounds;
+}
+
+void assign(cluster_grid const& grid, cluster_volumes const& bounds, sphere_set const& lights, light_clusters& clusters) {
+  clusters.ranges.assign(2 * grid.size(), 0);
+  clusters.indices.clear();
+  clusters.max_count = 0;
+
+  // each slice fills its own list, slices with many candidates are the expensive ones
+  std::vector<std::vector<unsigned>> slice_indices(grid.slices);
+  jobs::parallel_for(0, grid.slices, 1, [&](std::size_t first, std::size_t last) {
+    candidates scratch[2];
+    for (std::size_t s = first; s < last; ++s) {
+      assign_slice(grid, bounds, lights, unsigned(s), scratch, clusters.ranges, slice_indices[s]);
+    }
+  });
+
+  std::size_t total = 0;
+  for (std::vector<unsigned> const& list : slice_indices) {
+    total += list.size();
+  }
+  clusters.indices.reserve(total);
+  std::size_t per_slice = std::size_t(grid.tiles_x) * grid.tiles_y;
+  for (unsigned s = 0; s < grid.slices; ++s) {
+    unsigned offset = unsigned(clusters.indices.size());
+    for (std::size_t c = s * per_slice; c < (s + 1) * per_slice; ++c) {
+      clusters.ranges[2 * c] += offset;
+      clusters.max_count = std::max(clusters.max_count, clusters.ranges[2 * c + 1]);
+    }
+    clusters.indices.insert(clusters.indices.end(), slice_indices[s].begin(), slice_indices[s].end());
+  }
+}
+
+};
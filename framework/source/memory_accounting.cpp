@@ -0,0 +1,224 @@
+#include "memory_accounting.hpp"
+#include "utils.hpp"
+
+#include <glbinding/gl/enum.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+typedef std::pair<memory_accounting::resource_kind, std::uint64_t> resource_key;
+
+struct accounting_state {
+  std::mutex mutex;
+  std::map<resource_key, memory_accounting::resource> resources;
+  memory_accounting::totals domains[memory_accounting::NUM_DOMAINS];
+  memory_accounting::totals categories[memory_accounting::NUM_DOMAINS][memory_accounting::NUM_CATEGORIES];
+  std::size_t budgets[memory_accounting::NUM_DOMAINS];
+  // budget warnings are printed once
+  bool warned[memory_accounting::NUM_DOMAINS];
+};
+
+static accounting_state s_state{};
+
+static memory_accounting::domain domain_of(memory_accounting::resource_kind kind) {
+  return kind == memory_accounting::HOST_ALLOCATION ? memory_accounting::CPU : memory_accounting::GPU;
+}
+
+// apply a change of live bytes, the state mutex must be held
+static void account(memory_accounting::resource const& r, bool add) {
+  memory_accounting::domain where = domain_of(r.kind);
+  for (memory_accounting::totals* t : {&s_state.domains[where], &s_state.categories[where][r.type]}) {
+    if (add) {
+      t->live_bytes += r.bytes;
+      ++t->resources;
+      t->peak_bytes = std::max(t->peak_bytes, t->live_bytes);
+    }
+    else {
+      t->live_bytes -= r.bytes;
+      --t->resources;
+    }
+  }
+  std::size_t budget = s_state.budgets[where];
+  if (add && budget > 0 && s_state.domains[where].live_bytes > budget && !s_state.warned[where]) {
+    s_state.warned[where] = true;
+    std::cerr << "Memory Warning: " << memory_accounting::name(where) << " memory of " << s_state.domains[where].live_bytes
+              << " bytes exceeds budget of " << budget << " bytes after allocating '" << r.name << "'" << std::endl;
+  }
+}
+
+static char const* kind_name(memory_accounting::resource_kind kind) {
+  switch (kind) {
+    case memory_accounting::BUFFER: return "buffer";
+    case memory_accounting::TEXTURE: return "texture";
+    case memory_accounting::RENDERBUFFER: return "renderbuffer";
+    default: return "host";
+  }
+}
+
+static void write_totals(std::ostream& file, memory_accounting::totals const& t) {
+  file << "\"live_bytes\": " << t.live_bytes << ", \"peak_bytes\": " << t.peak_bytes << ", \"resources\": " << t.resources;
+}
+
+namespace memory_accounting {
+
+void track(resource_kind kind, std::uint64_t id, category type, std::size_t bytes, std::string const& name) {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  resource_key key{kind, id};
+  auto found = s_state.resources.find(key);
+  if (found != s_state.resources.end()) {
+    account(found->second, false);
+    s_state.resources.erase(found);
+  }
+  resource r{kind, id, type, bytes, name};
+  account(r, true);
+  s_state.resources.emplace(key, std::move(r));
+}
+
+void release(resource_kind kind, std::uint64_t id) {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  auto found = s_state.resources.find(resource_key{kind, id});
+  if (found != s_state.resources.end()) {
+    account(found->second, false);
+    s_state.resources.erase(found);
+  }
+}
+
+void track_buffer(GLuint buffer, category type, std::size_t bytes, std::string const& name) {
+  track(BUFFER, buffer, type, bytes, name);
+}
+
+void track_texture(GLuint texture, category type, unsigned width, unsigned height, GLenum internal_format,
+                   unsigned samples, bool mipmapped, std::string const& name) {
+  std::size_t bytes = std::size_t(width) * height * texel_bytes(internal_format) * std::max(1u, samples);
+  // a full mip chain adds a third
+  if (mipmapped) {
+    bytes += bytes / 3;
+  }
+  track(TEXTURE, texture, type, bytes, name);
+}
+
+void track_host(void const* owner, category type, std::size_t bytes, std::string const& name) {
+  track(HOST_ALLOCATION, std::uint64_t(reinterpret_cast<std::uintptr_t>(owner)), type, bytes, name);
+}
+
+void release_host(void const* owner) {
+  release(HOST_ALLOCATION, std::uint64_t(reinterpret_cast<std::uintptr_t>(owner)));
+}
+
+std::size_t texel_bytes(GLenum internal_format) {
+  switch (internal_format) {
+    case GL_R8:
+    case GL_RED: return 1;
+    case GL_RG8:
+    case GL_RG:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16: return 2;
+    // drivers pad rgb to four bytes
+    case GL_RGB8:
+    case GL_RGB: return 4;
+    case GL_RGBA16F:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGB32F: return 12;
+    case GL_RGBA32F: return 16;
+    default: return 4;
+  }
+}
+
+totals usage(domain where) {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  return s_state.domains[where];
+}
+
+totals usage(domain where, category type) {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  return s_state.categories[where][type];
+}
+
+std::vector<resource> resources() {
+  std::vector<resource> list{};
+  {
+    std::lock_guard<std::mutex> lock{s_state.mutex};
+    for (auto const& pair : s_state.resources) {
+      list.push_back(pair.second);
+    }
+  }
+  std::stable_sort(list.begin(), list.end(), [](resource const& a, resource const& b) {
+    return a.bytes > b.bytes;
+  });
+  return list;
+}
+
+void set_budget(domain where, std::size_t bytes) {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  s_state.budgets[where] = bytes;
+  s_state.warned[where] = false;
+}
+
+std::size_t budget(domain where) {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  return s_state.budgets[where];
+}
+
+bool within_budget() {
+  std::lock_guard<std::mutex> lock{s_state.mutex};
+  for (unsigned d = 0; d < NUM_DOMAINS; ++d) {
+    if (s_state.budgets[d] > 0 && s_state.domains[d].peak_bytes > s_state.budgets[d]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+char const* name(domain where) {
+  return where == CPU ? "cpu" : "gpu";
+}
+
+char const* name(category type) {
+  switch (type) {
+    case GEOMETRY: return "geometry";
+    case TEXTURES: return "textures";
+    case RENDER_TARGETS: return "render_targets";
+    case UNIFORMS: return "uniforms";
+    case INSTANCES: return "instances";
+    default: return "unknown";
+  }
+}
+
+void write_json(std::string const& path) {
+  std::ofstream file{path};
+  if (!file) {
+    std::cerr << "File \'" << path << "\' could not be written" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  std::vector<resource> list = resources();
+  file << "{\n  \"domains\": {";
+  for (unsigned d = 0; d < NUM_DOMAINS; ++d) {
+    domain where = domain(d);
+    file << (d > 0 ? "," : "") << "\n    \"" << name(where) << "\": {";
+    write_totals(file, usage(where));
+    file << ", \"budget_bytes\": " << budget(where) << ", \"categories\": {";
+    for (unsigned c = 0; c < NUM_CATEGORIES; ++c) {
+      file << (c > 0 ? ", " : "") << "\"" << name(category(c)) << "\": {";
+      write_totals(file, usage(where, category(c)));
+      file << "}";
+    }
+    file << "}}";
+  }
+  file << "\n  },\n  \"resources\": [";
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    resource const& r = list[i];
+    file << (i > 0 ? "," : "") << "\n    {\"kind\": \"" << kind_name(r.kind) << "\", \"id\": " << r.id
+         << ", \"category\": \"" << name(r.type) << "\", \"bytes\": " << r.bytes << ", \"name\": " << utils::json_quoted(r.name) << "}";
+  }
+  file << "\n  ]\n}\n";
+}
+
+};
@@ -0,0 +1,729 @@
+#include "mesh_bvh.hpp"
+#include "jobs.hpp"
+#include "simd_lanes.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+const unsigned mesh_bvh::NONE;
+const unsigned mesh_bvh::WIDTH;
+const unsigned mesh_bvh::PACKET;
+const unsigned mesh_bvh::LEAF;
+
+static const float INF = std::numeric_limits<float>::infinity();
+// split candidates per axis
+static const unsigned BINS = 16;
+// estimated cost of a step through the binary tree against testing one packet
+static const float TRAVERSAL_COST = 1.0f;
+static const float PACKET_COST = 1.0f;
+// ranges binned on all cores, subtrees handed to jobs and triangles per job from these sizes on
+static const std::size_t PARALLEL_BINNING = 1 << 16;
+static const std::size_t PARALLEL_SUBTREE = 1 << 12;
+static const std::size_t PARALLEL_GRAIN = 1 << 14;
+// rays per job of a batch
+static const std::size_t RAY_GRAIN = 1 << 10;
+// levels of the binary tree; from MEDIAN_DEPTH on ranges are split at their median,
+// which halves them every level, so not even 2^32 triangles make a deeper tree
+static const std::size_t MAX_DEPTH = 64;
+static const std::size_t MEDIAN_DEPTH = MAX_DEPTH - 32;
+// nodes still to visit, every level pushes at most all children of a node
+static const std::size_t STACK_SIZE = MAX_DEPTH * mesh_bvh::WIDTH;
+static const std::size_t CACHE_LINE = 64;
+
+// packets are tested with the widest lanes, in several steps if narrower,
+// the four child boxes of a node fit sse lanes
+#if defined(SIMD_LANES_AVX)
+typedef simd::avx packet_lanes;
+#elif defined(SIMD_LANES_SSE)
+typedef simd::sse packet_lanes;
+#else
+typedef simd::scalar packet_lanes;
+#endif
+#if defined(SIMD_LANES_SSE)
+typedef simd::sse node_lanes;
+#else
+typedef simd::scalar node_lanes;
+#endif
+
+typedef float const (&packet_rows)[3][mesh_bvh::PACKET];
+typedef float const (&child_bounds)[6][mesh_bvh::WIDTH];
+
+///////////////////////////// intersection tests ////////////////////////////////
+// moeller-trumbore for the triangles in [first, first + width) of a packet, bit per lane
+// hit between the ray origin and max distance; writes distances and barycentrics of all
+// lanes. parallel and degenerate triangles give nan or infinite weights and drop out
+template<typename L>
+static int triangle_lanes(packet_rows vertex, packet_rows edge1, packet_rows edge2, unsigned first,
+                          ray const& r, float max_distance, float* distances, float* us, float* vs) {
+  typedef typename L::type T;
+  T zero = L::set1(0.0f);
+  T one = L::set1(1.0f);
+  T d[3] = {L::set1(r.direction.x), L::set1(r.direction.y), L::set1(r.direction.z)};
+  T e1[3] = {L::load(&edge1[0][first]), L::load(&edge1[1][first]), L::load(&edge1[2][first])};
+  T e2[3] = {L::load(&edge2[0][first]), L::load(&edge2[1][first]), L::load(&edge2[2][first])};
+  // from the first vertex to the origin
+  T s[3] = {L::set1(r.origin.x) - L::load(&vertex[0][first]),
+            L::set1(r.origin.y) - L::load(&vertex[1][first]),
+            L::set1(r.origin.z) - L::load(&vertex[2][first])};
+
+  T p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+  T q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+  T inverse_determinant = one / (e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2]);
+  T u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse_determinant;
+  T v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse_determinant;
+  T t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse_determinant;
+  L::store(distances + first, t);
+  L::store(us + first, u);
+  L::store(vs + first, v);
+
+  typename L::mask inside = L::both(L::less_equal(zero, u), L::less_equal(zero, v));
+  inside = L::both(inside, L::less_equal(u + v, one));
+  inside = L::both(inside, L::both(L::less_equal(zero, t), L::less_equal(t, L::set1(max_distance))));
+  return L::bits(inside);
+}
+
+static int packet_mask(packet_rows vertex, packet_rows edge1, packet_rows edge2, ray const& r, float max_distance,
+                       float* distances, float* us, float* vs) {
+  int mask = 0;
+  for (unsigned first = 0; first < mesh_bvh::PACKET; first += unsigned(packet_lanes::width)) {
+    mask |= triangle_lanes<packet_lanes>(vertex, edge1, edge2, first, r, max_distance, distances, us, vs) << first;
+  }
+  return mask;
+}
+
+// ray origin and inverse direction as plain floats, glm checks every element access
+// unless NDEBUG is defined
+struct ray_slabs {
+  explicit ray_slabs(ray const& r)
+   :origin{r.origin.x, r.origin.y, r.origin.z}
+   ,inverse_direction{1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z}
+  {}
+
+  float origin[3];
+  float inverse_direction[3];
+};
+
+// bit per child box of [first, first + width) the ray enters before max distance, writes
+// the entry distances; slab test where nan from zero direction components drops out of min and max
+template<typename L>
+static int box_lanes(child_bounds b, unsigned first, ray_slabs const& r, float max_distance, float* entries) {
+  typedef typename L::type T;
+  T entry = L::set1(0.0f);
+  T exit = L::set1(max_distance);
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    T origin = L::set1(r.origin[axis]);
+    T inverse = L::set1(r.inverse_direction[axis]);
+    T t0 = (L::load(&b[axis][first]) - origin) * inverse;
+    T t1 = (L::load(&b[axis + 3][first]) - origin) * inverse;
+    entry = L::max(L::min(t0, t1), entry);
+    exit = L::min(L::max(t0, t1), exit);
+  }
+  L::store(entries + first, entry);
+  return L::bits(L::less_equal(entry, exit));
+}
+
+static int box_mask(child_bounds b, ray_slabs const& r, float max_distance, float* entries) {
+  int mask = 0;
+  for (unsigned first = 0; first < mesh_bvh::WIDTH; first += unsigned(node_lanes::width)) {
+    mask |= box_lanes<node_lanes>(b, first, r, max_distance, entries) << first;
+  }
+  return mask;
+}
+
+///////////////////////////// build helpers ////////////////////////////////
+// box of a triangle with its index, reordered while building
+struct triangle_bounds {
+  glm::fvec3 min;
+  unsigned triangle;
+  glm::fvec3 max;
+
+  glm::fvec3 center() const {
+    return (min + max) * 0.5f;
+  }
+};
+
+struct build_box {
+  build_box()
+   :min{INF}
+   ,max{-INF}
+  {}
+
+  void grow(glm::fvec3 const& lo, glm::fvec3 const& hi) {
+    min = glm::min(min, lo);
+    max = glm::max(max, hi);
+  }
+  // half the surface area, empty boxes have none
+  float area() const {
+    if (min.x > max.x) {
+      return 0.0f;
+    }
+    glm::fvec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+  }
+
+  glm::fvec3 min;
+  glm::fvec3 max;
+};
+
+struct split_bin {
+  split_bin()
+   :bounds{}
+   ,count{0}
+  {}
+
+  build_box bounds;
+  std::size_t count;
+};
+
+// split bins of all axes over a range
+struct split_bins {
+  void merge(split_bins const& other) {
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      for (unsigned b = 0; b < BINS; ++b) {
+        bins[axis][b].bounds.grow(other.bins[axis][b].bounds.min, other.bins[axis][b].bounds.max);
+        bins[axis][b].count += other.bins[axis][b].count;
+      }
+    }
+  }
+
+  split_bin bins[3][BINS];
+};
+
+static inline unsigned bin_of(float center, float min, float scale) {
+  return std::min(unsigned((center - min) * scale), BINS - 1);
+}
+
+// node of the binary tree built first
+struct build_node {
+  float min[3];
+  // first of the two children, first triangle of leaves
+  unsigned first;
+  float max[3];
+  // triangles of leaves, 0 for inner nodes
+  unsigned count;
+
+  float area() const {
+    float x = max[0] - min[0];
+    float y = max[1] - min[1];
+    float z = max[2] - min[2];
+    return x * y + y * z + z * x;
+  }
+};
+
+// packets needed for a number of triangles
+static inline float packets(std::size_t count) {
+  return float((count + mesh_bvh::PACKET - 1) / mesh_bvh::PACKET);
+}
+
+///////////////////////////// builder ////////////////////////////////
+// binary tree over the triangles of a model, shared by the jobs building it
+struct bvh_builder {
+  explicit bvh_builder(model const& m)
+   :positions{nullptr}
+   ,stride{std::size_t(m.vertex_bytes) / sizeof(GLfloat)}
+   ,indices{m.indices.empty() ? nullptr : m.indices.data()}
+   ,num_vertices{m.vertex_num}
+   ,primitives{}
+   ,nodes{}
+   ,next_node{1}
+   ,leaves{0}
+   ,subtrees{}
+  {
+    auto offset = m.offsets.find(model::POSITION);
+    if (offset == m.offsets.end()) {
+      std::cerr << "Model without positions can not be traced" << std::endl;
+      throw std::invalid_argument("model has no positions");
+    }
+    if (!m.data.empty()) {
+      positions = m.data.data() + reinterpret_cast<std::size_t>(offset->second) / sizeof(GLfloat);
+    }
+    std::size_t count = indices ? m.indices.size() / 3 : (positions ? num_vertices / 3 : 0);
+    primitives.resize(count);
+    // a binary tree has fewer nodes than twice its leaves, pages past the used ones are never touched
+    nodes.reset(new build_node[std::max(std::size_t(1), 2 * count)]);
+  }
+
+  glm::fvec3 vertex(std::size_t triangle, unsigned corner) const {
+    std::size_t index = indices ? std::size_t(indices[3 * triangle + corner]) : 3 * triangle + corner;
+    GLfloat const* position = positions + index * stride;
+    return glm::fvec3{position[0], position[1], position[2]};
+  }
+
+  void bound_triangles(std::size_t begin, std::size_t end) {
+    for (std::size_t t = begin; t < end; ++t) {
+      if (indices && (indices[3 * t] >= num_vertices || indices[3 * t + 1] >= num_vertices || indices[3 * t + 2] >= num_vertices)) {
+        std::cerr << "Triangle " << t << " indexes past the " << num_vertices << " vertices" << std::endl;
+        throw std::invalid_argument("triangle index out of range");
+      }
+      glm::fvec3 a = vertex(t, 0);
+      glm::fvec3 b = vertex(t, 1);
+      glm::fvec3 c = vertex(t, 2);
+      primitives[t] = triangle_bounds{glm::min(glm::min(a, b), c), unsigned(t), glm::max(glm::max(a, b), c)};
+    }
+  }
+
+  build_box measure(std::size_t begin, std::size_t end) {
+    build_box range{};
+    if (end - begin < PARALLEL_BINNING) {
+      for (std::size_t i = begin; i < end; ++i) {
+        range.grow(primitives[i].min, primitives[i].max);
+      }
+      return range;
+    }
+    std::mutex mutex{};
+    jobs::parallel_for(begin, end, PARALLEL_GRAIN, [&](std::size_t first, std::size_t last) {
+      build_box part{};
+      for (std::size_t i = first; i < last; ++i) {
+        part.grow(primitives[i].min, primitives[i].max);
+      }
+      std::lock_guard<std::mutex> lock{mutex};
+      range.grow(part.min, part.max);
+    });
+    return range;
+  }
+
+  void bin(std::size_t begin, std::size_t end, build_box const& bounds, glm::fvec3 const& scale, split_bins& result) {
+    auto fill = [&](std::size_t first, std::size_t last, split_bins& part) {
+      for (std::size_t i = first; i < last; ++i) {
+        triangle_bounds const& t = primitives[i];
+        glm::fvec3 center = t.center();
+        for (unsigned axis = 0; axis < 3; ++axis) {
+          split_bin& target = part.bins[axis][bin_of(center[axis], bounds.min[axis], scale[axis])];
+          target.bounds.grow(t.min, t.max);
+          ++target.count;
+        }
+      }
+    };
+    if (end - begin < PARALLEL_BINNING) {
+      fill(begin, end, result);
+      return;
+    }
+    std::mutex mutex{};
+    jobs::parallel_for(begin, end, PARALLEL_GRAIN, [&](std::size_t first, std::size_t last) {
+      split_bins part{};
+      fill(first, last, part);
+      std::lock_guard<std::mutex> lock{mutex};
+      result.merge(part);
+    });
+  }
+
+  // fill node n with the triangles in [begin, end) within bounds and build its subtree;
+  // centers are binned across the bounds of the triangles, so the boxes of both sides
+  // come from the bins and no extra pass over the triangles is needed
+  void subdivide(unsigned n, std::size_t begin, std::size_t end, std::size_t depth, build_box const& bounds) {
+    build_node& current = nodes[n];
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      current.min[axis] = bounds.min[axis];
+      current.max[axis] = bounds.max[axis];
+    }
+    std::size_t count = end - begin;
+    glm::fvec3 extent = bounds.max - bounds.min;
+    unsigned longest = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    // cheapest split between bins, none if all centers fall into one
+    unsigned best_axis = 0;
+    unsigned best_bin = 0;
+    float best_cost = INF;
+    if (count > 1 && depth < MEDIAN_DEPTH) {
+      glm::fvec3 scale{};
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        scale[axis] = extent[axis] > 0.0f ? float(BINS) / extent[axis] : 0.0f;
+      }
+      split_bins bins{};
+      bin(begin, end, bounds, scale, bins);
+
+      float inverse_area = 1.0f / bounds.area();
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        if (scale[axis] == 0.0f) {
+          continue;
+        }
+        split_bin const* row = bins.bins[axis];
+        // costs of everything right of each split, summed from the right
+        float right_costs[BINS] = {};
+        build_box right{};
+        std::size_t right_count = 0;
+        for (unsigned b = BINS - 1; b > 0; --b) {
+          right.grow(row[b].bounds.min, row[b].bounds.max);
+          right_count += row[b].count;
+          right_costs[b] = right.area() * packets(right_count);
+        }
+        build_box left{};
+        std::size_t left_count = 0;
+        for (unsigned b = 1; b < BINS; ++b) {
+          left.grow(row[b - 1].bounds.min, row[b - 1].bounds.max);
+          left_count += row[b - 1].count;
+          if (left_count == 0 || left_count == count) {
+            continue;
+          }
+          float cost = TRAVERSAL_COST + PACKET_COST * (left.area() * packets(left_count) + right_costs[b]) * inverse_area;
+          if (cost < best_cost) {
+            best_cost = cost;
+            best_axis = axis;
+            best_bin = b;
+          }
+        }
+      }
+
+      // a packet holding all triangles is cheaper
+      if (count <= mesh_bvh::PACKET && PACKET_COST <= best_cost) {
+        make_leaf(current, begin, count);
+        return;
+      }
+      if (best_cost < INF) {
+        build_box left{};
+        build_box right{};
+        for (unsigned b = 0; b < BINS; ++b) {
+          split_bin const& source = bins.bins[best_axis][b];
+          (b < best_bin ? left : right).grow(source.bounds.min, source.bounds.max);
+        }
+        float min = bounds.min[best_axis];
+        float scale_axis = scale[best_axis];
+        auto split = std::partition(primitives.begin() + std::ptrdiff_t(begin), primitives.begin() + std::ptrdiff_t(end),
+                                    [=](triangle_bounds const& t) {
+          return bin_of(t.center()[best_axis], min, scale_axis) < best_bin;
+        });
+        split_children(current, begin, std::size_t(split - primitives.begin()), end, depth, left, right);
+        return;
+      }
+    }
+    if (count <= mesh_bvh::PACKET) {
+      make_leaf(current, begin, count);
+      return;
+    }
+
+    // centers in one bin or deep down, halve at the median
+    std::size_t middle = begin + count / 2;
+    std::nth_element(primitives.begin() + std::ptrdiff_t(begin), primitives.begin() + std::ptrdiff_t(middle),
+                     primitives.begin() + std::ptrdiff_t(end), [longest](triangle_bounds const& a, triangle_bounds const& b) {
+      return a.center()[longest] < b.center()[longest];
+    });
+    split_children(current, begin, middle, end, depth, measure(begin, middle), measure(middle, end));
+  }
+
+  void split_children(build_node& current, std::size_t begin, std::size_t middle, std::size_t end, std::size_t depth,
+                      build_box const& left, build_box const& right) {
+    unsigned first = next_node.fetch_add(2);
+    current.first = first;
+    current.count = 0;
+    if (end - middle >= PARALLEL_SUBTREE) {
+      jobs::run([this, first, middle, end, depth, right]() {
+        subdivide(first + 1, middle, end, depth + 1, right);
+      }, &subtrees);
+    }
+    else {
+      subdivide(first + 1, middle, end, depth + 1, right);
+    }
+    subdivide(first, begin, middle, depth + 1, left);
+  }
+
+  void make_leaf(build_node& current, std::size_t begin, std::size_t count) {
+    current.first = unsigned(begin);
+    current.count = unsigned(count);
+    leaves.fetch_add(1);
+  }
+
+  GLfloat const* positions;
+  std::size_t stride;
+  GLuint const* indices;
+  std::size_t num_vertices;
+
+  std::vector<triangle_bounds> primitives;
+  // leaves point at their first triangle in primitives until the tree is laid out
+  std::unique_ptr<build_node[]> nodes;
+  std::atomic<unsigned> next_node;
+  std::atomic<unsigned> leaves;
+  jobs::counter subtrees;
+};
+
+///////////////////////////// mesh_bvh ////////////////////////////////
+mesh_hit::mesh_hit()
+ :triangle{mesh_bvh::NONE}
+ ,distance{INF}
+ ,barycentric{0.0f}
+{}
+
+mesh_bvh::mesh_bvh()
+ :m_storage{}
+ ,m_nodes{nullptr}
+ ,m_num_nodes{0}
+ ,m_packets{nullptr}
+ ,m_num_packets{0}
+ ,m_triangles{0}
+ ,m_depth{0}
+{}
+
+mesh_bvh::mesh_bvh(model const& m)
+ :mesh_bvh{}
+{
+  build(m);
+}
+
+void mesh_bvh::build(model const& m) {
+  clear();
+  bvh_builder state{m};
+  std::size_t count = state.primitives.size();
+  if (count == 0) {
+    return;
+  }
+  jobs::parallel_for(0, count, PARALLEL_GRAIN, [&state](std::size_t begin, std::size_t end) {
+    state.bound_triangles(begin, end);
+  });
+  state.subdivide(0, 0, count, 0, state.measure(0, count));
+  jobs::wait(state.subtrees);
+
+  // collapse the binary tree depth first, each node opens the inner nodes
+  // with the largest boxes among its descendants until its slots are full
+  struct entry {
+    unsigned built;
+    unsigned laid_out;
+    std::size_t depth;
+  };
+  std::vector<node> wide(1);
+  std::vector<entry> stack{entry{0, 0, 0}};
+  std::vector<unsigned> leaf_nodes{};
+  leaf_nodes.reserve(state.leaves.load());
+  while (!stack.empty()) {
+    entry current = stack.back();
+    stack.pop_back();
+    m_depth = std::max(m_depth, current.depth);
+    unsigned slots[WIDTH] = {current.built};
+    unsigned used = 1;
+    while (used < WIDTH) {
+      unsigned largest = WIDTH;
+      float largest_area = -1.0f;
+      for (unsigned slot = 0; slot < used; ++slot) {
+        build_node const& candidate = state.nodes[slots[slot]];
+        if (candidate.count == 0 && candidate.area() > largest_area) {
+          largest = slot;
+          largest_area = candidate.area();
+        }
+      }
+      if (largest == WIDTH) {
+        break;
+      }
+      unsigned first = state.nodes[slots[largest]].first;
+      slots[largest] = first;
+      slots[used++] = first + 1;
+    }
+
+    node target{};
+    for (unsigned slot = 0; slot < WIDTH; ++slot) {
+      build_node const& child = state.nodes[slots[slot]];
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        target.bounds[axis][slot] = slot < used ? child.min[axis] : INF;
+        target.bounds[axis + 3][slot] = slot < used ? child.max[axis] : -INF;
+      }
+      target.children[slot] = NONE;
+      if (slot >= used) {
+        continue;
+      }
+      if (child.count != 0) {
+        target.children[slot] = unsigned(leaf_nodes.size()) | LEAF;
+        leaf_nodes.push_back(slots[slot]);
+      }
+      else {
+        target.children[slot] = unsigned(wide.size());
+        wide.push_back(node{});
+        stack.push_back(entry{slots[slot], target.children[slot], current.depth + 1});
+      }
+    }
+    target.used = (1u << used) - 1;
+    wide[current.laid_out] = target;
+  }
+
+  // one block with nodes first, both starting on a cache line
+  m_num_nodes = wide.size();
+  m_num_packets = leaf_nodes.size();
+  std::size_t node_bytes = (m_num_nodes * sizeof(node) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+  m_storage.resize(CACHE_LINE - 1 + node_bytes + m_num_packets * sizeof(packet));
+  std::size_t offset = (CACHE_LINE - reinterpret_cast<std::uintptr_t>(m_storage.data()) % CACHE_LINE) % CACHE_LINE;
+  m_nodes = reinterpret_cast<node*>(m_storage.data() + offset);
+  m_packets = reinterpret_cast<packet*>(m_storage.data() + offset + node_bytes);
+  std::copy(wide.begin(), wide.end(), m_nodes);
+
+  jobs::parallel_for(0, m_num_packets, PARALLEL_GRAIN / PACKET, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t p = begin; p < end; ++p) {
+      build_node const& leaf = state.nodes[leaf_nodes[p]];
+      packet& target = m_packets[p];
+      for (unsigned lane = 0; lane < PACKET; ++lane) {
+        glm::fvec3 a{0.0f};
+        glm::fvec3 b{0.0f};
+        glm::fvec3 c{0.0f};
+        target.triangles[lane] = NONE;
+        if (lane < leaf.count) {
+          unsigned triangle = state.primitives[leaf.first + lane].triangle;
+          a = state.vertex(triangle, 0);
+          b = state.vertex(triangle, 1);
+          c = state.vertex(triangle, 2);
+          target.triangles[lane] = triangle;
+        }
+        for (unsigned axis = 0; axis < 3; ++axis) {
+          target.vertex[axis][lane] = a[axis];
+          target.edge1[axis][lane] = b[axis] - a[axis];
+          target.edge2[axis][lane] = c[axis] - a[axis];
+        }
+      }
+    }
+  });
+  m_triangles = count;
+}
+
+void mesh_bvh::clear() {
+  m_storage.clear();
+  m_storage.shrink_to_fit();
+  m_nodes = nullptr;
+  m_num_nodes = 0;
+  m_packets = nullptr;
+  m_num_packets = 0;
+  m_triangles = 0;
+  m_depth = 0;
+}
+
+bool mesh_bvh::intersect(ray const& r, mesh_hit& hit) const {
+  hit = mesh_hit{};
+  if (m_num_nodes == 0) {
+    return false;
+  }
+  ray_slabs slabs{r};
+  float nearest = r.max_distance;
+
+  // nodes still to visit with the distance the ray enters them at
+  struct pending {
+    unsigned node;
+    float distance;
+  };
+  pending stack[STACK_SIZE];
+  std::size_t size = 0;
+  float entries[WIDTH];
+  float distances[PACKET];
+  float us[PACKET];
+  float vs[PACKET];
+  unsigned n = 0;
+  while (true) {
+    node const& current = m_nodes[n];
+    int hits = box_mask(current.bounds, slabs, nearest, entries) & int(current.used);
+    // leaves are tested right away, child nodes pushed farthest first so the nearest is visited next
+    pending children[WIDTH];
+    unsigned num_children = 0;
+    for (unsigned slot = 0; hits != 0; ++slot, hits >>= 1) {
+      if (!(hits & 1)) {
+        continue;
+      }
+      unsigned child = current.children[slot];
+      if (child & LEAF) {
+        packet const& p = m_packets[child & ~LEAF];
+        int lanes = packet_mask(p.vertex, p.edge1, p.edge2, r, nearest, distances, us, vs);
+        for (unsigned lane = 0; lanes != 0; ++lane, lanes >>= 1) {
+          if ((lanes & 1) && distances[lane] <= nearest) {
+            nearest = distances[lane];
+            hit.triangle = p.triangles[lane];
+            hit.distance = distances[lane];
+            hit.barycentric = glm::fvec2{us[lane], vs[lane]};
+          }
+        }
+        continue;
+      }
+      unsigned i = num_children++;
+      while (i > 0 && children[i - 1].distance < entries[slot]) {
+        children[i] = children[i - 1];
+        --i;
+      }
+      children[i] = pending{child, entries[slot]};
+    }
+    for (unsigned i = 0; i < num_children; ++i) {
+      stack[size++] = children[i];
+    }
+    // skip nodes entered behind the nearest hit
+    while (size > 0 && stack[size - 1].distance > nearest) {
+      --size;
+    }
+    if (size == 0) {
+      break;
+    }
+    n = stack[--size].node;
+  }
+  return hit.triangle != NONE;
+}
+
+bool mesh_bvh::occluded(ray const& r) const {
+  if (m_num_nodes == 0) {
+    return false;
+  }
+  ray_slabs slabs{r};
+  unsigned stack[STACK_SIZE];
+  std::size_t size = 0;
+  float entries[WIDTH];
+  float distances[PACKET];
+  float us[PACKET];
+  float vs[PACKET];
+  unsigned n = 0;
+  while (true) {
+    node const& current = m_nodes[n];
+    int hits = box_mask(current.bounds, slabs, r.max_distance, entries) & int(current.used);
+    for (unsigned slot = 0; hits != 0; ++slot, hits >>= 1) {
+      if (!(hits & 1)) {
+        continue;
+      }
+      unsigned child = current.children[slot];
+      if (!(child & LEAF)) {
+        stack[size++] = child;
+        continue;
+      }
+      packet const& p = m_packets[child & ~LEAF];
+      if (packet_mask(p.vertex, p.edge1, p.edge2, r, r.max_distance, distances, us, vs) != 0) {
+        return true;
+      }
+    }
+    if (size == 0) {
+      return false;
+    }
+    n = stack[--size];
+  }
+}
+
+std::size_t mesh_bvh::intersect(std::vector<ray> const& rays, std::vector<mesh_hit>& hits) const {
+  hits.resize(rays.size());
+  std::atomic<std::size_t> count{0};
+  jobs::parallel_for(0, rays.size(), RAY_GRAIN, [&](std::size_t begin, std::size_t end) {
+    std::size_t found = 0;
+    for (std::size_t i = begin; i < end; ++i) {
+      found += intersect(rays[i], hits[i]) ? 1 : 0;
+    }
+    count.fetch_add(found);
+  });
+  return count.load();
+}
+
+std::size_t mesh_bvh::triangles() const {
+  return m_triangles;
+}
+
+std::size_t mesh_bvh::nodes() const {
+  return m_num_nodes;
+}
+
+std::size_t mesh_bvh::depth() const {
+  return m_depth;
+}
+
+glm::fvec3 mesh_bvh::min() const {
+  glm::fvec3 result{INF};
+  for (unsigned slot = 0; m_num_nodes != 0 && slot < WIDTH; ++slot) {
+    result = glm::min(result, glm::fvec3{m_nodes[0].bounds[0][slot], m_nodes[0].bounds[1][slot], m_nodes[0].bounds[2][slot]});
+  }
+  return result;
+}
+
+glm::fvec3 mesh_bvh::max() const {
+  glm::fvec3 result{-INF};
+  for (unsigned slot = 0; m_num_nodes != 0 && slot < WIDTH; ++slot) {
+    result = glm::max(result, glm::fvec3{m_nodes[0].bounds[3][slot], m_nodes[0].bounds[4][slot], m_nodes[0].bounds[5][slot]});
+  }
+  return result;
+}
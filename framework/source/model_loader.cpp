@@ -8,10 +8,6 @@
 
 namespace model_loader {
 
-void generate_normals(tinyobj::mesh_t& model);
-
-std::vector<glm::fvec3> generate_tangents(tinyobj::mesh_t const& model);
-
 model obj(std::string const& name, model::attrib_flag_t import_attribs){
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -118,7 +114,7 @@ void generate_normals(tinyobj::mesh_t& model) {
     normals[model.indices[i+2]] += normal;
   }
 
-  model.normals.reserve(model.positions.size());
+  model.normals.resize(model.positions.size());
   for (unsigned i = 0; i < normals.size(); ++i) {
     glm::fvec3 normal = glm::normalize(normals[i]);
     model.normals[i * 3] = normal[0];
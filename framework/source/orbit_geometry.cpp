@@ -0,0 +1,58 @@
+#include "orbit_geometry.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace orbit_geometry {
+
+circle_lods unit_circles(unsigned min_segments, unsigned max_segments) {
+  circle_lods circles{};
+  std::vector<GLfloat> positions{};
+
+  for (unsigned segments = std::max(3u, min_segments); segments <= max_segments; segments *= 2) {
+    circles.first.push_back(GLint(positions.size() / 3));
+    circles.segments.push_back(GLsizei(segments));
+    for (unsigned i = 0; i < segments; ++i) {
+      // compute each angle directly, accumulating increments drifts
+      double angle = 2.0 * 3.14159265358979323846 * double(i) / double(segments);
+      positions.push_back(float(std::cos(angle)));
+      positions.push_back(0.0f);
+      positions.push_back(float(std::sin(angle)));
+    }
+  }
+
+  circles.vertices = model{positions, model::POSITION};
+  return circles;
+}
+
+glm::fmat4 orbit_transform(glm::fmat4 const& parent, float radius, float skew) {
+  // x is scaled by radius and sheared into y by the skew, z is scaled by radius
+  glm::fmat4 orbit{};
+  orbit[0] = glm::fvec4{radius, -skew * radius, 0.0f, 0.0f};
+  orbit[2] = glm::fvec4{0.0f, 0.0f, radius, 0.0f};
+  return parent * orbit;
+}
+
+unsigned select_lod(circle_lods const& circles, glm::fmat4 const& orbit_transform, glm::fmat4 const& view, glm::fmat4 const& projection, float viewport_height, float pixels_per_segment) {
+  unsigned finest = unsigned(circles.segments.size()) - 1;
+  // largest radius of the transformed circle
+  float radius = std::max(glm::length(glm::fvec3{orbit_transform[0]}), glm::length(glm::fvec3{orbit_transform[2]}));
+  float distance = glm::length(glm::fvec3{view * orbit_transform[3]});
+  // camera inside orbit, parts of it are arbitrarily close
+  if (distance <= radius) {
+    return finest;
+  }
+  float pixel_radius = radius / distance * projection[1][1] * viewport_height * 0.5f;
+  float needed = 2.0f * 3.14159265f * pixel_radius / pixels_per_segment;
+
+  for (unsigned level = 0; level < finest; ++level) {
+    if (float(circles.segments[level]) >= needed) {
+      return level;
+    }
+  }
+  return finest;
+}
+
+};
@@ -0,0 +1,229 @@
+#include "post_processing.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+const std::chrono::milliseconds PostProcessing::RESIZE_DELAY{200};
+
+PostProcessing::PostProcessing(RenderTargetPool& pool, unsigned texture_unit)
+ :m_pool(pool)
+ ,m_texture_unit{texture_unit}
+ ,m_vertex_array{0}
+ ,m_screen_size{0, 0}
+ ,m_size{0, 0}
+ ,m_resize_time{}
+ ,m_targets{}
+ ,m_passes{}
+ ,m_disabled{}
+ ,m_last_use{}
+{
+  glGenVertexArrays(1, &m_vertex_array);
+}
+
+PostProcessing::~PostProcessing() {
+  for (auto& pair : m_targets) {
+    release(pair.second);
+  }
+  glDeleteVertexArrays(1, &m_vertex_array);
+}
+
+void PostProcessing::add_target(std::string const& name, unsigned scale, GLenum format, bool depth) {
+  target& added = m_targets[name];
+  release(added);
+  added = target{scale, format, depth, 0, 0};
+}
+
+std::size_t PostProcessing::add_pass(std::string const& effect, std::vector<std::string> const& inputs, std::string const& output,
+                                     setup_function const& setup, bool additive) {
+  for (std::string const& input : inputs) {
+    if (!m_targets.count(input)) {
+      std::cerr << "Post processing target \'" << input << "\' does not exist" << std::endl;
+      throw std::invalid_argument(input);
+    }
+  }
+  if (!output.empty() && !m_targets.count(output)) {
+    std::cerr << "Post processing target \'" << output << "\' does not exist" << std::endl;
+    throw std::invalid_argument(output);
+  }
+  m_passes.push_back(pass{effect, inputs, output, setup, additive});
+  return m_passes.size() - 1;
+}
+
+void PostProcessing::set_input(std::size_t pass, std::size_t input, std::string const& target) {
+  if (!m_targets.count(target)) {
+    std::cerr << "Post processing target \'" << target << "\' does not exist" << std::endl;
+    throw std::invalid_argument(target);
+  }
+  m_passes.at(pass).inputs.at(input) = target;
+}
+
+void PostProcessing::set_enabled(std::string const& effect, bool enabled) {
+  if (enabled) {
+    m_disabled.erase(effect);
+  }
+  else {
+    m_disabled.insert(effect);
+  }
+}
+
+bool PostProcessing::enabled(std::string const& effect) const {
+  return m_disabled.count(effect) == 0;
+}
+
+void PostProcessing::resize(unsigned width, unsigned height) {
+  glm::uvec2 size{width, height};
+  if (size == m_screen_size) {
+    return;
+  }
+  m_screen_size = size;
+  m_resize_time = std::chrono::steady_clock::now();
+  // nothing to stretch before the first allocation
+  if (m_size.x == 0 || m_size.y == 0) {
+    m_size = size;
+  }
+}
+
+void PostProcessing::update_size() {
+  if (m_size == m_screen_size || std::chrono::steady_clock::now() - m_resize_time < RESIZE_DELAY) {
+    return;
+  }
+  // only between frames, while no target holds attachments
+  for (auto const& pair : m_targets) {
+    if (pair.second.colour != 0) {
+      return;
+    }
+  }
+  // attachments of the old size are freed by the pool once unused
+  m_size = m_screen_size;
+}
+
+glm::uvec2 PostProcessing::scaled_size(target const& target) const {
+  // odd sizes round up, so no screen pixel is left without source texel
+  unsigned divisor = 1u << target.scale;
+  return glm::uvec2{std::max(1u, (m_size.x + divisor - 1) / divisor), std::max(1u, (m_size.y + divisor - 1) / divisor)};
+}
+
+void PostProcessing::acquire(target& target) {
+  if (target.colour != 0) {
+    return;
+  }
+  glm::uvec2 size = scaled_size(target);
+  target.colour = m_pool.acquire(size, target.format);
+  if (target.has_depth) {
+    target.depth = m_pool.acquire(size, GL_DEPTH_COMPONENT24);
+  }
+}
+
+void PostProcessing::release(target& target) {
+  if (target.colour != 0) {
+    m_pool.release(target.colour);
+  }
+  if (target.depth != 0) {
+    m_pool.release(target.depth);
+  }
+  target.colour = 0;
+  target.depth = 0;
+}
+
+void PostProcessing::bind(std::string const& name, bool with_depth) {
+  update_size();
+  target& bound = m_targets.at(name);
+  acquire(bound);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_pool.framebuffer(bound.colour, with_depth ? bound.depth : 0));
+  glm::uvec2 size = scaled_size(bound);
+  glViewport(0, 0, GLsizei(size.x), GLsizei(size.y));
+}
+
+GLuint PostProcessing::depth_texture(std::string const& name) {
+  update_size();
+  target& shared = m_targets.at(name);
+  acquire(shared);
+  return shared.depth;
+}
+
+glm::uvec2 PostProcessing::size(std::string const& target) const {
+  return scaled_size(m_targets.at(target));
+}
+
+unsigned PostProcessing::texture_unit() const {
+  return m_texture_unit;
+}
+
+void PostProcessing::render() {
+  update_size();
+  // lifetimes of the targets in this frame
+  m_last_use.clear();
+  for (std::size_t i = 0; i < m_passes.size(); ++i) {
+    if (m_disabled.count(m_passes[i].effect)) {
+      continue;
+    }
+    for (std::string const& input : m_passes[i].inputs) {
+      m_last_use[input] = i;
+    }
+    if (!m_passes[i].output.empty()) {
+      m_last_use[m_passes[i].output] = i;
+    }
+  }
+
+  bool depth_test = glIsEnabled(GL_DEPTH_TEST) == GL_TRUE;
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_vertex_array);
+
+  for (std::size_t i = 0; i < m_passes.size(); ++i) {
+    pass const& pass = m_passes[i];
+    if (m_disabled.count(pass.effect)) {
+      continue;
+    }
+    if (pass.output.empty()) {
+      // the chain may still have the previous size while the window is resized
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glViewport(0, 0, GLsizei(m_screen_size.x), GLsizei(m_screen_size.y));
+    }
+    else {
+      bind(pass.output);
+    }
+
+    glm::fvec2 input_texel{1.0f};
+    for (std::size_t j = 0; j < pass.inputs.size(); ++j) {
+      target const& input = m_targets.at(pass.inputs[j]);
+      // targets not written this frame are unbound instead of allocated
+      glActiveTexture(GLenum(unsigned(GL_TEXTURE0) + m_texture_unit + unsigned(j)));
+      glBindTexture(GL_TEXTURE_2D, input.colour);
+      if (j == 0) {
+        input_texel = 1.0f / glm::fvec2{scaled_size(input)};
+      }
+    }
+    pass.setup(input_texel);
+
+    if (pass.additive) {
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_ONE, GL_ONE);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (pass.additive) {
+      glDisable(GL_BLEND);
+    }
+
+    // later passes can reuse the memory of targets that are done
+    for (auto const& last_use : m_last_use) {
+      if (last_use.second == i) {
+        release(m_targets.at(last_use.first));
+      }
+    }
+  }
+
+  // targets written but never read again, like the scene without any pass
+  for (auto& pair : m_targets) {
+    release(pair.second);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, GLsizei(m_screen_size.x), GLsizei(m_screen_size.y));
+  if (depth_test) {
+    glEnable(GL_DEPTH_TEST);
+  }
+}
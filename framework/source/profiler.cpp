@@ -0,0 +1,280 @@
+#include "profiler.hpp"
+
+#include <glbinding/gl/gl.h>
+#include <glbinding/ContextInfo.h>
+#include <glbinding/Version.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// frame in the history ring, guarded by a sequence counter that is odd while written
+struct ring_slot {
+  std::atomic<std::uint64_t> sequence;
+  profile_frame frame;
+};
+
+static const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+static bool s_enabled = true;
+
+// frame being recorded, only touched by the frame thread
+static profile_frame s_current{};
+static bool s_in_frame = false;
+static unsigned s_depth = 0;
+static std::uint64_t s_next_frame = 0;
+static std::thread::id s_frame_thread{};
+
+// frames waiting for their timer queries, indexed by frame % QUERY_LATENCY
+static profile_frame s_pending[profiler::QUERY_LATENCY]{};
+static bool s_pending_used[profiler::QUERY_LATENCY]{};
+static GLuint s_queries[profiler::QUERY_LATENCY][profile_frame::MAX_EVENTS]{};
+// 0 unknown, 1 supported, 2 unsupported
+static int s_gpu_support = 0;
+static bool s_gpu_active = false;
+
+static ring_slot s_ring[profiler::FRAME_HISTORY]{};
+// number of frames published to the ring
+static std::atomic<std::uint64_t> s_published{0};
+
+static double now() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_start).count();
+}
+
+// scopes only record on the thread that drives the frames
+static bool recording() {
+  return s_enabled && s_in_frame && std::this_thread::get_id() == s_frame_thread;
+}
+
+static int add_event(const char* name) {
+  if (!recording() || s_current.num_events >= profile_frame::MAX_EVENTS) {
+    return -1;
+  }
+  profile_event& event = s_current.events[s_current.num_events];
+  event.name = name;
+  event.cpu_begin = now();
+  event.cpu_end = event.cpu_begin;
+  event.gpu_duration = -1.0;
+  event.depth = s_depth++;
+  return int(s_current.num_events++);
+}
+
+static void end_event(int index) {
+  if (index < 0 || !s_in_frame) {
+    return;
+  }
+  s_current.events[index].cpu_end = now();
+  --s_depth;
+}
+
+static void publish(profile_frame const& frame) {
+  ring_slot& slot = s_ring[frame.index % profiler::FRAME_HISTORY];
+  slot.sequence.store(2 * frame.index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&slot.frame, &frame, sizeof(profile_frame));
+  slot.sequence.store(2 * frame.index + 2, std::memory_order_release);
+  s_published.store(frame.index + 1, std::memory_order_release);
+}
+
+// read timer results of the frame that used this query slot, without waiting for the gpu
+static void resolve(unsigned slot) {
+  profile_frame& frame = s_pending[slot];
+  for (unsigned i = 0; i < frame.num_events; ++i) {
+    profile_event& event = frame.events[i];
+    // queries were only issued for events marked as timed
+    if (event.gpu_duration != 0.0) {
+      event.gpu_duration = -1.0;
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(s_queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(s_queries[slot][i], GL_QUERY_RESULT, &nanoseconds);
+      event.gpu_duration = double(nanoseconds) * 1e-6;
+    }
+    else {
+      event.gpu_duration = -1.0;
+    }
+  }
+  publish(frame);
+  s_pending_used[slot] = false;
+}
+
+namespace profiler {
+
+void begin_frame() {
+  if (!s_enabled) {
+    return;
+  }
+  if (s_gpu_support == 0) {
+    // timer queries are core in 3.3, the launcher requests 3.2
+    bool supported = glbinding::ContextInfo::version() >= glbinding::Version(3, 3) ||
+                     glbinding::ContextInfo::supported({GLextension::GL_ARB_timer_query});
+    s_gpu_support = supported ? 1 : 2;
+    if (supported) {
+      for (unsigned slot = 0; slot < QUERY_LATENCY; ++slot) {
+        glGenQueries(GLsizei(profile_frame::MAX_EVENTS), s_queries[slot]);
+      }
+    }
+  }
+
+  s_frame_thread = std::this_thread::get_id();
+  s_current.index = s_next_frame++;
+  s_current.cpu_begin = now();
+  s_current.cpu_end = s_current.cpu_begin;
+  s_current.num_events = 0;
+  s_depth = 0;
+  s_in_frame = true;
+
+  // queries of this slot are reused, so collect the frame that issued them
+  unsigned slot = unsigned(s_current.index % QUERY_LATENCY);
+  if (s_pending_used[slot]) {
+    resolve(slot);
+  }
+}
+
+void end_frame() {
+  if (!s_in_frame) {
+    return;
+  }
+  s_in_frame = false;
+  s_current.cpu_end = now();
+  unsigned slot = unsigned(s_current.index % QUERY_LATENCY);
+  std::memcpy(&s_pending[slot], &s_current, sizeof(profile_frame));
+  s_pending_used[slot] = true;
+}
+
+void shutdown() {
+  if (s_gpu_support == 1) {
+    for (unsigned slot = 0; slot < QUERY_LATENCY; ++slot) {
+      glDeleteQueries(GLsizei(profile_frame::MAX_EVENTS), s_queries[slot]);
+    }
+  }
+  s_gpu_support = 0;
+  s_in_frame = false;
+  for (unsigned slot = 0; slot < QUERY_LATENCY; ++slot) {
+    s_pending_used[slot] = false;
+  }
+}
+
+void set_enabled(bool enabled) {
+  s_enabled = enabled;
+  if (!enabled) {
+    s_in_frame = false;
+  }
+}
+
+bool enabled() {
+  return s_enabled;
+}
+
+std::vector<profile_frame> frames() {
+  std::vector<profile_frame> result{};
+  std::uint64_t published = s_published.load(std::memory_order_acquire);
+  std::uint64_t first = published > FRAME_HISTORY ? published - FRAME_HISTORY : 0;
+  result.reserve(std::size_t(published - first));
+
+  profile_frame frame{};
+  for (std::uint64_t index = first; index < published; ++index) {
+    ring_slot const& slot = s_ring[index % FRAME_HISTORY];
+    std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * index + 2) {
+      // overwritten by a newer frame or being written
+      continue;
+    }
+    std::memcpy(&frame, &slot.frame, sizeof(profile_frame));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      result.push_back(frame);
+    }
+  }
+  return result;
+}
+
+static std::string escape(const char* text) {
+  std::string result{};
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      result += '\\';
+    }
+    result += *c;
+  }
+  return result;
+}
+
+static void write_event(std::ofstream& file, bool& first, const char* name, int thread, double begin, double duration) {
+  file << (first ? "\n" : ",\n")
+       << "{\"name\":\"" << escape(name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+       << ",\"ts\":" << begin * 1000.0 << ",\"dur\":" << duration * 1000.0 << "}";
+  first = false;
+}
+
+void export_chrome_trace(std::string const& path) {
+  std::ofstream file{path};
+  if (!file) {
+    std::cerr << "File \'" << path << "\' could not be written" << std::endl;
+    throw std::invalid_argument(path);
+  }
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+       << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},"
+       << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+  bool first = false;
+
+  for (profile_frame const& frame : frames()) {
+    write_event(file, first, "frame", 1, frame.cpu_begin, frame.cpu_end - frame.cpu_begin);
+    // timer queries only give durations, gpu work is laid out in submission order
+    // starting no earlier than its submission on the cpu
+    double gpu_time = frame.cpu_begin;
+    for (unsigned i = 0; i < frame.num_events; ++i) {
+      profile_event const& event = frame.events[i];
+      write_event(file, first, event.name, 1, event.cpu_begin, event.cpu_end - event.cpu_begin);
+      if (event.gpu_duration >= 0.0) {
+        gpu_time = std::max(gpu_time, event.cpu_begin);
+        write_event(file, first, event.name, 2, gpu_time, event.gpu_duration);
+        gpu_time += event.gpu_duration;
+      }
+    }
+  }
+  file << "\n]}\n";
+}
+
+cpu_scope::cpu_scope(const char* name)
+ :m_event{add_event(name)}
+{}
+
+cpu_scope::~cpu_scope() {
+  end_event(m_event);
+}
+
+gpu_scope::gpu_scope(const char* name)
+ :m_event{add_event(name)}
+ ,m_timed{false}
+{
+  // time elapsed queries cannot nest
+  if (m_event >= 0 && s_gpu_support == 1 && !s_gpu_active) {
+    unsigned slot = unsigned(s_current.index % QUERY_LATENCY);
+    glBeginQuery(GL_TIME_ELAPSED, s_queries[slot][m_event]);
+    // zero marks an issued query until resolved
+    s_current.events[m_event].gpu_duration = 0.0;
+    s_gpu_active = true;
+    m_timed = true;
+  }
+}
+
+gpu_scope::~gpu_scope() {
+  if (m_timed) {
+    glEndQuery(GL_TIME_ELAPSED);
+    s_gpu_active = false;
+  }
+  end_event(m_event);
+}
+
+};
@@ -0,0 +1,368 @@
+#include "program_cache.hpp"
+#include "shader_loader.hpp"
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+#include <glbinding/ContextInfo.h>
+#include <glbinding/ProcAddress.h>
+#include <glbinding/Version.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+  #include <direct.h>
+#else
+  #include <sys/stat.h>
+#endif
+
+// identifies cache files written by this version
+static const std::uint32_t BINARY_MAGIC = 0x42504c47;
+// sleep between polls for parallel compilation
+static const std::chrono::microseconds POLL_INTERVAL{200};
+
+// 64 bit fnv-1a, the terminating zero separates consecutive strings
+static std::uint64_t hash(std::uint64_t value, std::string const& text) {
+  for (std::size_t i = 0; i <= text.size(); ++i) {
+    value ^= std::uint64_t((unsigned char)text.c_str()[i]);
+    value *= 0x100000001b3ull;
+  }
+  return value;
+}
+
+static void make_directory(std::string const& path) {
+#ifdef _WIN32
+  _mkdir(path.c_str());
+#else
+  mkdir(path.c_str(), 0755);
+#endif
+}
+
+// collect compile and link logs of a failed program
+static void output_errors(GLuint program, GLuint const shaders[2], std::string const& name) {
+  for (unsigned i = 0; i < 2; ++i) {
+    GLint success = 0;
+    glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+    if (success == 0) {
+      GLint log_size = 0;
+      glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &log_size);
+      std::vector<GLchar> log_buffer(std::size_t(log_size) + 1, 0);
+      glGetShaderInfoLog(shaders[i], log_size, &log_size, log_buffer.data());
+      utils::output_log(log_buffer.data(), name + (i == 0 ? " vertex" : " fragment"));
+    }
+  }
+  GLint log_size = 0;
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
+  std::vector<GLchar> log_buffer(std::size_t(log_size) + 1, 0);
+  glGetProgramInfoLog(program, log_size, &log_size, log_buffer.data());
+  utils::output_log(log_buffer.data(), name);
+}
+
+ProgramCache::ProgramCache(std::string const& directory)
+ :m_directory{directory}
+ ,m_initialized{false}
+ ,m_driver{}
+ ,m_binaries_supported{false}
+ ,m_parallel_compile{false}
+ ,m_cache_hits{0}
+ ,m_compiled{0}
+ ,m_build_milliseconds{0.0}
+ ,m_pending{}
+ ,m_failed{}
+{
+  if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\') {
+    m_directory += '/';
+  }
+}
+
+void ProgramCache::initialize() {
+  m_driver = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+  m_driver += reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+  m_driver += reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+  // binaries need at least one format to store them in
+  if (glbinding::ContextInfo::version() >= glbinding::Version(4, 1) ||
+      glbinding::ContextInfo::supported({GLextension::GL_ARB_get_program_binary})) {
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    m_binaries_supported = num_formats > 0 && !m_directory.empty();
+  }
+  if (m_binaries_supported) {
+    make_directory(m_directory);
+  }
+
+  // khr variant is not known to glbinding, both share the enums
+  std::set<std::string> unknown{};
+  std::set<GLextension> extensions = glbinding::ContextInfo::extensions(unknown);
+  if (extensions.count(GLextension::GL_ARB_parallel_shader_compile)) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    m_parallel_compile = true;
+  }
+  else if (unknown.count("GL_KHR_parallel_shader_compile")) {
+    typedef void (GL_APIENTRY *max_threads_function)(GLuint);
+    max_threads_function max_threads = reinterpret_cast<max_threads_function>(glbinding::getProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (max_threads) {
+      max_threads(0xFFFFFFFF);
+      m_parallel_compile = true;
+    }
+  }
+  m_initialized = true;
+}
+
+std::string ProgramCache::binary_path(std::uint64_t key) const {
+  std::ostringstream name{};
+  name << m_directory << std::hex << key << ".bin";
+  return name.str();
+}
+
+GLuint ProgramCache::load_binary(std::uint64_t key) const {
+  if (!m_binaries_supported) {
+    return 0;
+  }
+  std::ifstream file{binary_path(key), std::ios::binary};
+  if (!file) {
+    return 0;
+  }
+  std::uint32_t magic = 0;
+  GLenum format = GL_NONE;
+  std::uint64_t stored_key = 0;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char*>(&format), sizeof(format));
+  file.read(reinterpret_cast<char*>(&stored_key), sizeof(stored_key));
+  std::vector<char> binary{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  if (magic != BINARY_MAGIC || stored_key != key || binary.empty()) {
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, format, binary.data(), GLsizei(binary.size()));
+  // driver may reject binaries of other versions, then compile from source
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (success == 0) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::store_binary(std::uint64_t key, GLuint program) const {
+  if (!m_binaries_supported) {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(static_cast<std::size_t>(length));
+  GLenum format = GL_NONE;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  std::ofstream file{binary_path(key), std::ios::binary};
+  if (!file) {
+    std::cerr << "File \'" << binary_path(key) << "\' could not be written" << std::endl;
+    return;
+  }
+  file.write(reinterpret_cast<char const*>(&BINARY_MAGIC), sizeof(BINARY_MAGIC));
+  file.write(reinterpret_cast<char const*>(&format), sizeof(format));
+  file.write(reinterpret_cast<char const*>(&key), sizeof(key));
+  file.write(binary.data(), std::streamsize(length));
+}
+
+GLuint ProgramCache::start_build(std::string const& vertex_source, std::string const& fragment_source, GLuint shaders[2]) const {
+  GLuint program = glCreateProgram();
+  if (m_binaries_supported) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  std::string const* sources[2] = {&vertex_source, &fragment_source};
+  GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+  for (unsigned i = 0; i < 2; ++i) {
+    shaders[i] = glCreateShader(types[i]);
+    const char* source_chars = sources[i]->c_str();
+    glShaderSource(shaders[i], 1, &source_chars, 0);
+    // status is checked after linking, so compiles can overlap
+    glCompileShader(shaders[i]);
+    glAttachShader(program, shaders[i]);
+  }
+  glLinkProgram(program);
+  return program;
+}
+
+std::size_t ProgramCache::build(std::map<std::string, shader_program>& programs) {
+  auto start = std::chrono::steady_clock::now();
+  m_cache_hits = 0;
+  m_compiled = 0;
+  m_failed.clear();
+
+  // load cached binaries and issue all compiles before waiting for any
+  for (auto& pair : programs) {
+    request(pair.first, pair.second);
+  }
+  std::size_t rebuilt = poll(true).size();
+
+  m_build_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::string failed_names{};
+  for (std::string const& name : failed()) {
+    failed_names += " " + name;
+  }
+  if (!failed_names.empty()) {
+    throw std::logic_error("Building of program" + failed_names);
+  }
+  return rebuilt;
+}
+
+void ProgramCache::request(std::string const& name, shader_program& program) {
+  if (!m_initialized) {
+    initialize();
+  }
+  // newer request replaces a build still in flight
+  for (std::size_t i = 0; i < m_pending.size(); ++i) {
+    if (m_pending[i].program == &program) {
+      discard(m_pending[i]);
+      m_pending.erase(m_pending.begin() + std::ptrdiff_t(i));
+      break;
+    }
+  }
+
+  program.dependencies = {program.vertex_path, program.fragment_path};
+  shader_source vertex_source{};
+  shader_source fragment_source{};
+  try {
+    vertex_source = shader_loader::preprocess(program.vertex_path, program.defines);
+    fragment_source = shader_loader::preprocess(program.fragment_path, program.defines);
+  }
+  catch (std::exception&) {
+    m_failed.push_back(name);
+    return;
+  }
+  // included files trigger rebuilds as well
+  program.dependencies = vertex_source.files;
+  for (std::string const& file : fragment_source.files) {
+    if (std::find(program.dependencies.begin(), program.dependencies.end(), file) == program.dependencies.end()) {
+      program.dependencies.push_back(file);
+    }
+  }
+  // defines and includes are part of the assembled sources
+  std::uint64_t key = hash(hash(hash(0xcbf29ce484222325ull, m_driver), vertex_source.text), fragment_source.text);
+  // unchanged sources, nothing to do
+  if (key == program.build_key && program.handle != 0) {
+    return;
+  }
+
+  pending_build build{&program, name, key, load_binary(key), {0, 0}, 0};
+  if (build.handle != 0) {
+    ++m_cache_hits;
+  }
+  else {
+    build.handle = start_build(vertex_source.text, fragment_source.text, build.shaders);
+    ++m_compiled;
+  }
+  m_pending.push_back(build);
+}
+
+std::vector<std::string> ProgramCache::poll(bool wait) {
+  std::vector<std::string> swapped{};
+  std::vector<pending_build> unfinished{};
+  for (pending_build& build : m_pending) {
+    // driver compiles on its own threads, ask before blocking on the link status
+    if (m_parallel_compile && build.shaders[0] != 0) {
+      GLint complete = 0;
+      glGetProgramiv(build.handle, GL_COMPLETION_STATUS_ARB, &complete);
+      while (complete == 0 && wait) {
+        std::this_thread::sleep_for(POLL_INTERVAL);
+        glGetProgramiv(build.handle, GL_COMPLETION_STATUS_ARB, &complete);
+      }
+      if (complete == 0) {
+        ++build.polls;
+        unfinished.push_back(build);
+        continue;
+      }
+    }
+    // without completion status the query blocks until compile and link are done,
+    // which is synchronous on drivers that do not work ahead; waiting a frame lets
+    // those that do finish in the background and keeps the stall off the request frame
+    else if (!m_parallel_compile && build.shaders[0] != 0 && build.polls == 0 && !wait) {
+      ++build.polls;
+      unfinished.push_back(build);
+      continue;
+    }
+    if (finish(build)) {
+      swapped.push_back(build.name);
+    }
+  }
+  m_pending.swap(unfinished);
+  return swapped;
+}
+
+bool ProgramCache::finish(pending_build& build) {
+  GLint success = 0;
+  glGetProgramiv(build.handle, GL_LINK_STATUS, &success);
+  bool compiled = build.shaders[0] != 0;
+  if (compiled) {
+    if (success == 0) {
+      output_errors(build.handle, build.shaders, build.name);
+    }
+    else {
+      store_binary(build.key, build.handle);
+    }
+  }
+
+  if (success == 0) {
+    m_failed.push_back(build.name);
+    discard(build);
+    return false;
+  }
+  if (compiled) {
+    for (unsigned i = 0; i < 2; ++i) {
+      glDetachShader(build.handle, build.shaders[i]);
+      glDeleteShader(build.shaders[i]);
+    }
+  }
+  // swap in new program
+  glDeleteProgram(build.program->handle);
+  build.program->handle = build.handle;
+  build.program->build_key = build.key;
+  return true;
+}
+
+void ProgramCache::discard(pending_build const& build) const {
+  if (build.shaders[0] != 0) {
+    for (unsigned i = 0; i < 2; ++i) {
+      glDetachShader(build.handle, build.shaders[i]);
+      glDeleteShader(build.shaders[i]);
+    }
+  }
+  glDeleteProgram(build.handle);
+}
+
+bool ProgramCache::pending() const {
+  return !m_pending.empty();
+}
+
+std::vector<std::string> ProgramCache::failed() {
+  std::vector<std::string> failed{};
+  failed.swap(m_failed);
+  return failed;
+}
+
+unsigned ProgramCache::cache_hits() const {
+  return m_cache_hits;
+}
+
+unsigned ProgramCache::compiled() const {
+  return m_compiled;
+}
+
+double ProgramCache::build_milliseconds() const {
+  return m_build_milliseconds;
+}
@@ -0,0 +1,160 @@
+#include "render_target_pool.hpp"
+
+#include "memory_accounting.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <stdexcept>
+
+static bool is_depth(GLenum format) {
+  return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+         format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+bool RenderTargetPool::description::operator<(description const& other) const {
+  if (size.x != other.size.x) return size.x < other.size.x;
+  if (size.y != other.size.y) return size.y < other.size.y;
+  if (format != other.format) return format < other.format;
+  return samples < other.samples;
+}
+
+RenderTargetPool::RenderTargetPool()
+ :m_textures{}
+ ,m_free{}
+ ,m_framebuffers{}
+ ,m_frame{0}
+{}
+
+RenderTargetPool::~RenderTargetPool() {
+  while (!m_textures.empty()) {
+    destroy(m_textures.begin()->first);
+  }
+}
+
+GLuint RenderTargetPool::acquire(glm::uvec2 const& size, GLenum format, unsigned samples) {
+  description desc{size, format, samples};
+  auto available = m_free.find(desc);
+  if (available != m_free.end()) {
+    GLuint texture = available->second;
+    m_free.erase(available);
+    m_textures.at(texture).in_use = true;
+    return texture;
+  }
+
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  GLsizei width = GLsizei(size.x);
+  GLsizei height = GLsizei(size.y);
+  if (samples > 0) {
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, GLsizei(samples), format, width, height, GL_TRUE);
+  }
+  else {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // no data is uploaded, the client format only has to be valid for the internal one
+    GLenum client_format = is_depth(format) ? GL_DEPTH_COMPONENT : GL_RGBA;
+    GLenum client_type = is_depth(format) ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, client_format, client_type, nullptr);
+    // linear filtering does the up and downsampling between scales
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  m_textures[texture] = entry{desc, true, m_frame};
+  memory_accounting::track_texture(texture, memory_accounting::RENDER_TARGETS, size.x, size.y, format, samples, false,
+                                   "render target " + std::to_string(size.x) + "x" + std::to_string(size.y));
+  return texture;
+}
+
+void RenderTargetPool::release(GLuint texture) {
+  auto found = m_textures.find(texture);
+  if (found == m_textures.end() || !found->second.in_use) {
+    return;
+  }
+  found->second.in_use = false;
+  found->second.last_used = m_frame;
+  m_free.insert(std::make_pair(found->second.desc, texture));
+}
+
+GLuint RenderTargetPool::framebuffer(GLuint colour, GLuint depth) {
+  return framebuffer(std::vector<GLuint>{colour}, depth);
+}
+
+GLuint RenderTargetPool::framebuffer(std::vector<GLuint> const& colours, GLuint depth) {
+  std::vector<GLuint> key{colours};
+  key.push_back(depth);
+  auto cached = m_framebuffers.find(key);
+  if (cached != m_framebuffers.end()) {
+    return cached->second;
+  }
+
+  GLuint framebuffer = 0;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  std::vector<GLenum> draw_buffers{};
+  for (std::size_t i = 0; i < colours.size(); ++i) {
+    GLenum attachment = GLenum(unsigned(GL_COLOR_ATTACHMENT0) + unsigned(i));
+    glFramebufferTexture(GL_FRAMEBUFFER, attachment, colours[i], 0);
+    draw_buffers.push_back(attachment);
+  }
+  if (depth != 0) {
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth, 0);
+  }
+  glDrawBuffers(GLsizei(draw_buffers.size()), draw_buffers.data());
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    throw std::logic_error("framebuffer not correctly initialised");
+  }
+  m_framebuffers[key] = framebuffer;
+  return framebuffer;
+}
+
+void RenderTargetPool::collect() {
+  ++m_frame;
+  for (auto it = m_free.begin(); it != m_free.end(); ) {
+    if (m_frame - m_textures.at(it->second).last_used > FRAMES_UNTIL_FREE) {
+      GLuint texture = it->second;
+      it = m_free.erase(it);
+      destroy(texture);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+void RenderTargetPool::destroy(GLuint texture) {
+  // framebuffers using the texture become invalid
+  for (auto it = m_framebuffers.begin(); it != m_framebuffers.end(); ) {
+    if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end()) {
+      glDeleteFramebuffers(1, &it->second);
+      it = m_framebuffers.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  glDeleteTextures(1, &texture);
+  memory_accounting::release(memory_accounting::TEXTURE, texture);
+  m_textures.erase(texture);
+}
+
+std::size_t RenderTargetPool::allocated_bytes() const {
+  std::size_t bytes = 0;
+  for (auto const& pair : m_textures) {
+    description const& desc = pair.second.desc;
+    bytes += std::size_t(desc.size.x) * desc.size.y * memory_accounting::texel_bytes(desc.format) * std::max(1u, desc.samples);
+  }
+  return bytes;
+}
+
+std::size_t RenderTargetPool::allocated_textures() const {
+  return m_textures.size();
+}
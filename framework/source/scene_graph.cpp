@@ -0,0 +1,262 @@
+#include "scene_graph.hpp"
+#include "jobs.hpp"
+#include "simd_lanes.hpp"
+
+#include <algorithm>
+
+// below this many changed nodes, handing out jobs costs more than it saves
+static const std::size_t PARALLEL_THRESHOLD = 1 << 14;
+// ranges per thread, more than one evens out unbalanced hierarchies
+static const std::size_t RANGES_PER_THREAD = 4;
+
+const scene_graph::node scene_graph::NONE;
+
+// local = translation * rotation * scale, affine columns
+static inline glm::fmat4 compose_local(glm::fvec3 const& t, glm::fquat const& q, glm::fvec3 const& s) {
+  float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+  return glm::fmat4{(1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f,
+                    2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f,
+                    2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f,
+                    t.x, t.y, t.z, 1.0f};
+}
+
+#ifdef SIMD_LANES_SSE
+// world = parent * local with one column per register, local entries are broadcast;
+// both have a zero last row and a one in the translation, so the product is affine
+static inline void compose(glm::fmat4 const& parent, glm::fmat4 const& local, glm::fmat4& world) {
+  float const* p = &parent[0][0];
+  float const* l = &local[0][0];
+  float* w = &world[0][0];
+  __m128 p0 = _mm_loadu_ps(p);
+  __m128 p1 = _mm_loadu_ps(p + 4);
+  __m128 p2 = _mm_loadu_ps(p + 8);
+  __m128 p3 = _mm_loadu_ps(p + 12);
+  for (unsigned c = 0; c < 4; ++c) {
+    __m128 lc = _mm_loadu_ps(l + 4 * c);
+    __m128 wc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_shuffle_ps(lc, lc, 0x00)),
+                                      _mm_mul_ps(p1, _mm_shuffle_ps(lc, lc, 0x55))),
+                           _mm_add_ps(_mm_mul_ps(p2, _mm_shuffle_ps(lc, lc, 0xaa)),
+                                      _mm_mul_ps(p3, _mm_shuffle_ps(lc, lc, 0xff))));
+    _mm_storeu_ps(w + 4 * c, wc);
+  }
+}
+#else
+static inline void compose(glm::fmat4 const& parent, glm::fmat4 const& local, glm::fmat4& world) {
+  world = parent * local;
+}
+#endif
+
+scene_graph::scene_graph()
+ :m_parents{}
+ ,m_subtree_sizes{}
+ ,m_translations{}
+ ,m_rotations{}
+ ,m_scales{}
+ ,m_locals{}
+ ,m_worlds{}
+ ,m_dirty{}
+ ,m_changed{}
+ ,m_handles{}
+ ,m_indices{}
+ ,m_dirty_nodes{}
+ ,m_changed_ranges{}
+ ,m_serial_nodes{}
+ ,m_task_ranges{}
+{}
+
+scene_graph::node scene_graph::add(node parent, transform_state const& local) {
+  unsigned parent_index = (parent == NONE) ? NONE : m_indices[parent];
+  // behind the last node of the parent's subtree, appending when building depth-first
+  unsigned index = (parent == NONE) ? unsigned(m_parents.size()) : parent_index + m_subtree_sizes[parent_index];
+  node handle = node(m_indices.size());
+
+  // shift nodes behind the insertion point
+  for (unsigned i = index; i < m_parents.size(); ++i) {
+    ++m_indices[m_handles[i]];
+    if (m_parents[i] != NONE && m_parents[i] >= index) {
+      ++m_parents[i];
+    }
+  }
+
+  m_parents.insert(m_parents.begin() + index, parent_index);
+  m_subtree_sizes.insert(m_subtree_sizes.begin() + index, 1u);
+  m_translations.insert(m_translations.begin() + index, local.translation);
+  m_rotations.insert(m_rotations.begin() + index, local.rotation);
+  m_scales.insert(m_scales.begin() + index, local.scale);
+  m_locals.insert(m_locals.begin() + index, glm::fmat4{});
+  m_worlds.insert(m_worlds.begin() + index, glm::fmat4{});
+  m_dirty.insert(m_dirty.begin() + index, std::uint8_t(0));
+  m_changed.insert(m_changed.begin() + index, std::uint8_t(0));
+  m_handles.insert(m_handles.begin() + index, handle);
+  m_indices.push_back(index);
+
+  for (unsigned ancestor = parent_index; ancestor != NONE; ancestor = m_parents[ancestor]) {
+    ++m_subtree_sizes[ancestor];
+  }
+  // ranges of the last update no longer match the arrays
+  std::fill(m_changed.begin(), m_changed.end(), std::uint8_t(0));
+  m_changed_ranges.clear();
+
+  mark_dirty(index);
+  return handle;
+}
+
+void scene_graph::mark_dirty(unsigned index) {
+  if (!m_dirty[index]) {
+    m_dirty[index] = 1;
+    m_dirty_nodes.push_back(m_handles[index]);
+  }
+}
+
+void scene_graph::set_local(node n, transform_state const& local) {
+  unsigned index = m_indices[n];
+  m_translations[index] = local.translation;
+  m_rotations[index] = local.rotation;
+  m_scales[index] = local.scale;
+  mark_dirty(index);
+}
+
+void scene_graph::set_translation(node n, glm::fvec3 const& translation) {
+  m_translations[m_indices[n]] = translation;
+  mark_dirty(m_indices[n]);
+}
+
+void scene_graph::set_rotation(node n, glm::fquat const& rotation) {
+  m_rotations[m_indices[n]] = rotation;
+  mark_dirty(m_indices[n]);
+}
+
+void scene_graph::set_scale(node n, glm::fvec3 const& scale) {
+  m_scales[m_indices[n]] = scale;
+  mark_dirty(m_indices[n]);
+}
+
+transform_state scene_graph::local(node n) const {
+  unsigned index = m_indices[n];
+  return transform_state{m_translations[index], m_rotations[index], m_scales[index]};
+}
+
+glm::fmat4 const& scene_graph::world(node n) const {
+  return m_worlds[m_indices[n]];
+}
+
+scene_graph::node scene_graph::parent(node n) const {
+  unsigned parent_index = m_parents[m_indices[n]];
+  return (parent_index == NONE) ? NONE : m_handles[parent_index];
+}
+
+bool scene_graph::changed(node n) const {
+  return m_changed[m_indices[n]] != 0;
+}
+
+std::size_t scene_graph::size() const {
+  return m_parents.size();
+}
+
+void scene_graph::update_range(unsigned begin, unsigned end) {
+  // local pointers, stores to the worlds would otherwise reload the vectors
+  unsigned const* parents = m_parents.data();
+  glm::fmat4 const* locals = m_locals.data();
+  glm::fmat4* worlds = m_worlds.data();
+  // parents precede their children, so they are always final here
+  for (unsigned i = begin; i < end; ++i) {
+    unsigned parent = parents[i];
+    if (parent == NONE) {
+      worlds[i] = locals[i];
+    } else {
+      compose(worlds[parent], locals[i], worlds[i]);
+    }
+  }
+  std::fill(m_changed.begin() + begin, m_changed.begin() + end, std::uint8_t(1));
+}
+
+void scene_graph::build_partition(std::size_t grain) {
+  m_serial_nodes.clear();
+  m_task_ranges.clear();
+
+  // descend into subtrees until they are small enough, in depth-first order
+  std::vector<unsigned> stack{};
+  for (std::size_t r = m_changed_ranges.size(); r > 0; r -= 2) {
+    stack.push_back(m_changed_ranges[r - 2]);
+  }
+  while (!stack.empty()) {
+    unsigned index = stack.back();
+    stack.pop_back();
+    unsigned end = index + m_subtree_sizes[index];
+    if (m_subtree_sizes[index] <= grain) {
+      // siblings are adjacent, so small ranges can be merged
+      if (!m_task_ranges.empty() && m_task_ranges.back() == index &&
+          index - m_task_ranges[m_task_ranges.size() - 2] < grain) {
+        m_task_ranges.back() = end;
+      } else {
+        m_task_ranges.push_back(index);
+        m_task_ranges.push_back(end);
+      }
+      continue;
+    }
+    m_serial_nodes.push_back(index);
+    // children reversed, so they are popped in order
+    std::size_t first_child = stack.size();
+    for (unsigned child = index + 1; child < end; child += m_subtree_sizes[child]) {
+      stack.push_back(child);
+    }
+    std::reverse(stack.begin() + std::ptrdiff_t(first_child), stack.end());
+  }
+}
+
+std::size_t scene_graph::update(unsigned threads) {
+  // reset flags of the previous update
+  for (std::size_t r = 0; r < m_changed_ranges.size(); r += 2) {
+    std::fill(m_changed.begin() + m_changed_ranges[r], m_changed.begin() + m_changed_ranges[r + 1], std::uint8_t(0));
+  }
+  m_changed_ranges.clear();
+  if (m_dirty_nodes.empty()) {
+    return 0;
+  }
+
+  // dirty subtrees in array order, nested ones are covered by their ancestor
+  std::vector<unsigned> roots{};
+  roots.reserve(m_dirty_nodes.size());
+  for (node n : m_dirty_nodes) {
+    unsigned index = m_indices[n];
+    m_dirty[index] = 0;
+    m_locals[index] = compose_local(m_translations[index], m_rotations[index], m_scales[index]);
+    roots.push_back(index);
+  }
+  m_dirty_nodes.clear();
+  std::sort(roots.begin(), roots.end());
+  std::size_t count = 0;
+  for (unsigned index : roots) {
+    if (!m_changed_ranges.empty() && index < m_changed_ranges.back()) {
+      continue;
+    }
+    m_changed_ranges.push_back(index);
+    m_changed_ranges.push_back(index + m_subtree_sizes[index]);
+    count += m_subtree_sizes[index];
+  }
+
+  if (threads == 0) {
+    threads = jobs::concurrency();
+  }
+  if (count < PARALLEL_THRESHOLD || threads < 2) {
+    for (std::size_t r = 0; r < m_changed_ranges.size(); r += 2) {
+      update_range(m_changed_ranges[r], m_changed_ranges[r + 1]);
+    }
+    return count;
+  }
+
+  build_partition(count / (threads * RANGES_PER_THREAD) + 1);
+  for (unsigned index : m_serial_nodes) {
+    update_range(index, index + 1);
+  }
+
+  // ranges of roughly equal node count, idle threads steal whole ranges
+  jobs::parallel_for(0, m_task_ranges.size() / 2, 1, [this](std::size_t first, std::size_t last) {
+    for (std::size_t r = first; r < last; ++r) {
+      update_range(m_task_ranges[2 * r], m_task_ranges[2 * r + 1]);
+    }
+  });
+  return count;
+}
@@ -1,129 +1,284 @@
-#include "shader_loader.hpp"
-#include "utils.hpp"
-
-#include <glbinding/gl/functions.h>
-// use gl definitions from glbinding 
-using namespace gl;
-
-namespace shader_loader {
-
-GLuint shader(std::string const& file_path, GLenum shader_type) {
-  GLuint shader = 0;
-  shader = glCreateShader(shader_type);
-
-  std::string shader_source{utils::read_file(file_path)};
-  // glshadersource expects array of c-strings
-  const char* shader_chars = shader_source.c_str();
-  glShaderSource(shader, 1, &shader_chars, 0);
-
-  glCompileShader(shader);
-
-  // check if compilation was successfull
-  GLint success = 0;
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-  if(success == 0) {
-    // get log length
-    GLint log_size = 0;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_size);
-    // get log
-    GLchar* log_buffer = (GLchar*)malloc(sizeof(GLchar) * log_size);
-    glGetShaderInfoLog(shader, log_size, &log_size, log_buffer);
-    // output errors
-    utils::output_log(log_buffer, utils::file_name(file_path));
-    // free broken shader
-    glDeleteShader(shader);
-    free(log_buffer);
-
-    throw std::logic_error("Compilation of " + file_path);
-  }
-
-  return shader;
-}
-
-GLuint program(std::string const& vertex_path, std::string const& fragment_path) {
-  GLuint program = glCreateProgram();
-
-  // load and compile vert and frag shader
-  GLuint vertex_shader = shader(vertex_path, GL_VERTEX_SHADER);
-  GLuint fragment_shader = shader(fragment_path, GL_FRAGMENT_SHADER);
-
-  // attach the shaders to the program
-  glAttachShader(program, vertex_shader);
-  glAttachShader(program, fragment_shader);
-  // link shaders
-  glLinkProgram(program);
-
-  // check if linking was successfull
-  GLint success = 0;
-  glGetProgramiv(program, GL_LINK_STATUS, &success);
-  if(success == 0) {
-    // get log length
-    GLint log_size = 0;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
-    // get log
-    GLchar* log_buffer = (GLchar*)malloc(sizeof(GLchar) * log_size);
-    glGetProgramInfoLog(program, log_size, &log_size, log_buffer);
-    // output errors
-    utils::output_log(log_buffer, utils::file_name(vertex_path) + " & " + utils::file_name(fragment_path));
-    // free broken program
-    glDeleteProgram(program);
-    free(log_buffer);
-
-    throw std::logic_error("Linking of " + vertex_path + " & " + fragment_path);
-  }
-  // detach shaders
-  glDetachShader(program, vertex_shader);
-  glDetachShader(program, fragment_shader);
-  // and free them
-  glDeleteShader(vertex_shader);
-  glDeleteShader(fragment_shader);
-
-  return program;
-}
-
-GLuint program(std::string const& vertex_path, std::string const& geometry_path, std::string const& fragment_path) {
-  GLuint program = glCreateProgram();
-
-  // load and compile vert and frag shader
-  GLuint vertex_shader = shader(vertex_path, GL_VERTEX_SHADER);
-  GLuint geometry_shader = shader(geometry_path, GL_GEOMETRY_SHADER);
-  GLuint fragment_shader = shader(fragment_path, GL_FRAGMENT_SHADER);
-
-  // attach the shaders to the program
-  glAttachShader(program, vertex_shader);
-  glAttachShader(program, geometry_shader);
-  glAttachShader(program, fragment_shader);
-  // link shaders
-  glLinkProgram(program);
-
-  // check if linking was successfull
-  GLint success = 0;
-  glGetProgramiv(program, GL_LINK_STATUS, &success);
-  if(success == 0) {
-    // get log length
-    GLint log_size = 0;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
-    // get log
-    GLchar* log_buffer = (GLchar*)malloc(sizeof(GLchar) * log_size);
-    glGetProgramInfoLog(program, log_size, &log_size, log_buffer);
-    // output errors
-    utils::output_log(log_buffer, utils::file_name(vertex_path) + " & " + utils::file_name(geometry_path) + " & " + utils::file_name(fragment_path));
-    // free broken program
-    glDeleteProgram(program);
-    free(log_buffer);
-
-    throw std::logic_error("Linking of " + vertex_path + " & " + geometry_path + " & " + fragment_path);
-  }
-  // detach shaders
-  glDetachShader(program, vertex_shader);
-  glDetachShader(program, geometry_shader);
-  glDetachShader(program, fragment_shader);
-  // and free them
-  glDeleteShader(vertex_shader);
-  glDeleteShader(geometry_shader);
-  glDeleteShader(fragment_shader);
-
-  return program;
-}
-
+#include "shader_loader.hpp"
+#include "utils.hpp"
+
+#include <glbinding/gl/functions.h>
+// use gl definitions from glbinding 
+using namespace gl;
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+// identifies a version of a file
+struct file_stamp {
+  long long time;
+  long long size;
+
+  bool operator==(file_stamp const& other) const {
+    return time == other.time && size == other.size;
+  }
+  bool operator!=(file_stamp const& other) const {
+    return !(*this == other);
+  }
+};
+
+// file with includes resolved, shared by all define combinations
+struct assembled_source {
+  std::string text;
+  // offset behind the #version line and its line number
+  std::size_t version_end;
+  unsigned version_line;
+  std::vector<std::string> files;
+  std::vector<file_stamp> stamps;
+};
+
+// caches are only used from the thread owning the gl context
+static std::map<std::string, std::pair<file_stamp, std::string>> s_files{};
+static std::map<std::string, assembled_source> s_assembled{};
+
+static file_stamp stamp(std::string const& path) {
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    return file_stamp{-1, -1};
+  }
+#if defined(__linux__)
+  long long time = static_cast<long long>(status.st_mtim.tv_sec) * 1000000000ll + status.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+  long long time = static_cast<long long>(status.st_mtimespec.tv_sec) * 1000000000ll + status.st_mtimespec.tv_nsec;
+#else
+  long long time = static_cast<long long>(status.st_mtime);
+#endif
+  return file_stamp{time, static_cast<long long>(status.st_size)};
+}
+
+static std::string const& load(std::string const& path, file_stamp const& current) {
+  auto cached = s_files.find(path);
+  if (cached == s_files.end() || cached->second.first != current) {
+    std::string text = utils::read_file(path);
+    cached = s_files.insert(std::make_pair(path, std::make_pair(current, std::string{}))).first;
+    cached->second.first = current;
+    cached->second.second.swap(text);
+  }
+  return cached->second.second;
+}
+
+static std::string directory_of(std::string const& path) {
+  std::size_t separator = path.find_last_of("/\\");
+  return separator == std::string::npos ? std::string{} : path.substr(0, separator + 1);
+}
+
+// append content of file with index to result, recursing into includes
+static void assemble(std::size_t index, assembled_source& result) {
+  std::string path = result.files[index];
+  result.stamps.push_back(stamp(path));
+  std::string const& text = load(path, result.stamps.back());
+  bool root = index == 0;
+
+  std::istringstream lines{text};
+  std::string line{};
+  unsigned number = 0;
+  while (std::getline(lines, line)) {
+    ++number;
+    std::size_t start = line.find_first_not_of(" \t");
+    if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+      std::size_t open = line.find('"', start + 8);
+      std::size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+      if (close == std::string::npos) {
+        std::cerr << path << ":" << number << ": malformed #include" << std::endl;
+        throw std::logic_error("Preprocessing of " + path);
+      }
+      std::string included = directory_of(path) + line.substr(open + 1, close - open - 1);
+      bool seen = false;
+      for (std::string const& file : result.files) {
+        seen = seen || file == included;
+      }
+      if (!seen) {
+        result.files.push_back(included);
+        // #line gives the number of the line following it in glsl 1.50
+        std::size_t included_index = result.files.size() - 1;
+        result.text += "#line 0 " + std::to_string(included_index) + "\n";
+        assemble(included_index, result);
+        result.text += "#line " + std::to_string(number) + " " + std::to_string(index) + "\n";
+      }
+      else {
+        result.text += "\n";
+      }
+      continue;
+    }
+    result.text += line;
+    result.text += '\n';
+    if (root && result.version_end == 0 && start != std::string::npos && line.compare(start, 8, "#version") == 0) {
+      result.version_end = result.text.size();
+      result.version_line = number;
+    }
+  }
+}
+
+namespace shader_loader {
+
+shader_source preprocess(std::string const& file_path, std::vector<std::string> const& defines) {
+  auto cached = s_assembled.find(file_path);
+  bool valid = cached != s_assembled.end();
+  for (std::size_t i = 0; valid && i < cached->second.files.size(); ++i) {
+    valid = stamp(cached->second.files[i]) == cached->second.stamps[i];
+  }
+  if (!valid) {
+    assembled_source assembled{std::string{}, 0, 0, {file_path}, {}};
+    assemble(0, assembled);
+    cached = s_assembled.insert(std::make_pair(file_path, assembled_source{})).first;
+    cached->second = std::move(assembled);
+  }
+  assembled_source const& assembled = cached->second;
+
+  shader_source result{std::string{}, assembled.files};
+  if (defines.empty()) {
+    result.text = assembled.text;
+    return result;
+  }
+  std::string inserted{};
+  for (std::string const& define : defines) {
+    inserted += "#define " + define + "\n";
+  }
+  // keep line numbers of the file after the defines
+  inserted += "#line " + std::to_string(assembled.version_line) + " 0\n";
+  result.text.reserve(assembled.text.size() + inserted.size());
+  result.text.append(assembled.text, 0, assembled.version_end);
+  result.text += inserted;
+  result.text.append(assembled.text, assembled.version_end, std::string::npos);
+  return result;
+}
+
+void invalidate(std::string const& file_path) {
+  s_files.erase(file_path);
+  for (auto it = s_assembled.begin(); it != s_assembled.end(); ) {
+    bool uses = false;
+    for (std::string const& file : it->second.files) {
+      uses = uses || file == file_path;
+    }
+    it = uses ? s_assembled.erase(it) : std::next(it);
+  }
+}
+
+GLuint shader(std::string const& file_path, GLenum shader_type) {
+  GLuint shader = 0;
+  shader = glCreateShader(shader_type);
+
+  std::string shader_source{preprocess(file_path).text};
+  // glshadersource expects array of c-strings
+  const char* shader_chars = shader_source.c_str();
+  glShaderSource(shader, 1, &shader_chars, 0);
+
+  glCompileShader(shader);
+
+  // check if compilation was successfull
+  GLint success = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if(success == 0) {
+    // get log length
+    GLint log_size = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_size);
+    // get log
+    GLchar* log_buffer = (GLchar*)malloc(sizeof(GLchar) * log_size);
+    glGetShaderInfoLog(shader, log_size, &log_size, log_buffer);
+    // output errors
+    utils::output_log(log_buffer, utils::file_name(file_path));
+    // free broken shader
+    glDeleteShader(shader);
+    free(log_buffer);
+
+    throw std::logic_error("Compilation of " + file_path);
+  }
+
+  return shader;
+}
+
+GLuint program(std::string const& vertex_path, std::string const& fragment_path) {
+  GLuint program = glCreateProgram();
+
+  // load and compile vert and frag shader
+  GLuint vertex_shader = shader(vertex_path, GL_VERTEX_SHADER);
+  GLuint fragment_shader = shader(fragment_path, GL_FRAGMENT_SHADER);
+
+  // attach the shaders to the program
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  // link shaders
+  glLinkProgram(program);
+
+  // check if linking was successfull
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if(success == 0) {
+    // get log length
+    GLint log_size = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
+    // get log
+    GLchar* log_buffer = (GLchar*)malloc(sizeof(GLchar) * log_size);
+    glGetProgramInfoLog(program, log_size, &log_size, log_buffer);
+    // output errors
+    utils::output_log(log_buffer, utils::file_name(vertex_path) + " & " + utils::file_name(fragment_path));
+    // free broken program
+    glDeleteProgram(program);
+    free(log_buffer);
+
+    throw std::logic_error("Linking of " + vertex_path + " & " + fragment_path);
+  }
+  // detach shaders
+  glDetachShader(program, vertex_shader);
+  glDetachShader(program, fragment_shader);
+  // and free them
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  return program;
+}
+
+GLuint program(std::string const& vertex_path, std::string const& geometry_path, std::string const& fragment_path) {
+  GLuint program = glCreateProgram();
+
+  // load and compile vert and frag shader
+  GLuint vertex_shader = shader(vertex_path, GL_VERTEX_SHADER);
+  GLuint geometry_shader = shader(geometry_path, GL_GEOMETRY_SHADER);
+  GLuint fragment_shader = shader(fragment_path, GL_FRAGMENT_SHADER);
+
+  // attach the shaders to the program
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, geometry_shader);
+  glAttachShader(program, fragment_shader);
+  // link shaders
+  glLinkProgram(program);
+
+  // check if linking was successfull
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if(success == 0) {
+    // get log length
+    GLint log_size = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
+    // get log
+    GLchar* log_buffer = (GLchar*)malloc(sizeof(GLchar) * log_size);
+    glGetProgramInfoLog(program, log_size, &log_size, log_buffer);
+    // output errors
+    utils::output_log(log_buffer, utils::file_name(vertex_path) + " & " + utils::file_name(geometry_path) + " & " + utils::file_name(fragment_path));
+    // free broken program
+    glDeleteProgram(program);
+    free(log_buffer);
+
+    throw std::logic_error("Linking of " + vertex_path + " & " + geometry_path + " & " + fragment_path);
+  }
+  // detach shaders
+  glDetachShader(program, vertex_shader);
+  glDetachShader(program, geometry_shader);
+  glDetachShader(program, fragment_shader);
+  // and free them
+  glDeleteShader(vertex_shader);
+  glDeleteShader(geometry_shader);
+  glDeleteShader(fragment_shader);
+
+  return program;
+}
+
 };
\ No newline at end of file
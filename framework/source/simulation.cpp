@@ -0,0 +1,121 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+
+// marks the latest slot as not yet picked up by the reader
+static const unsigned FRESH_FLAG = 4u;
+static const unsigned SLOT_MASK = 3u;
+// steps to catch up per wakeup before skipping time, prevents spiralling behind
+static const unsigned MAX_CATCHUP_STEPS = 8;
+
+Simulation::Simulation(step_function const& step, std::size_t num_objects, double timestep)
+ :m_step{step}
+ ,m_num_objects{num_objects}
+ ,m_timestep{timestep}
+ ,m_snapshots{}
+ ,m_write_slot{0}
+ ,m_read_slot{1}
+ ,m_latest_slot{2}
+ ,m_start{}
+ ,m_running{false}
+ ,m_thread{}
+ ,m_step_transforms(num_objects)
+{
+  for (auto& snapshot : m_snapshots) {
+    snapshot.time = 0.0;
+    snapshot.previous.resize(num_objects);
+    snapshot.current.resize(num_objects);
+  }
+}
+
+Simulation::~Simulation() {
+  stop();
+}
+
+void Simulation::start() {
+  stop();
+  m_start = std::chrono::steady_clock::now();
+
+  // initial state, so a snapshot exists before the first frame
+  m_step(0.0, m_step_transforms);
+  simulation_snapshot& initial = m_snapshots[m_write_slot];
+  initial.time = 0.0;
+  for (std::size_t i = 0; i < m_num_objects; ++i) {
+    initial.current[i] = transform_state{m_step_transforms[i]};
+  }
+  initial.previous = initial.current;
+  publish();
+
+  m_running = true;
+  m_thread = std::thread{&Simulation::run, this};
+}
+
+void Simulation::stop() {
+  m_running = false;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+double Simulation::time() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+double Simulation::timestep() const {
+  return m_timestep;
+}
+
+void Simulation::publish() {
+  simulation_snapshot const& written = m_snapshots[m_write_slot];
+  // next slot continues from the published states
+  unsigned previous_latest = m_latest_slot.exchange(m_write_slot | FRESH_FLAG);
+  m_write_slot = previous_latest & SLOT_MASK;
+  simulation_snapshot& next = m_snapshots[m_write_slot];
+  next.time = written.time;
+  next.previous = written.previous;
+  next.current = written.current;
+}
+
+void Simulation::run() {
+  while (m_running) {
+    simulation_snapshot& snapshot = m_snapshots[m_write_slot];
+    double now = time();
+
+    unsigned steps = 0;
+    while (snapshot.time + m_timestep <= now && steps < MAX_CATCHUP_STEPS) {
+      snapshot.time += m_timestep;
+      m_step(snapshot.time, m_step_transforms);
+      std::swap(snapshot.previous, snapshot.current);
+      for (std::size_t i = 0; i < m_num_objects; ++i) {
+        snapshot.current[i] = transform_state{m_step_transforms[i]};
+      }
+      ++steps;
+    }
+    // fell too far behind, drop the backlog instead of stalling
+    if (steps == MAX_CATCHUP_STEPS) {
+      snapshot.time = std::max(snapshot.time, now - m_timestep);
+    }
+    if (steps > 0) {
+      publish();
+    }
+
+    double next_step = m_snapshots[m_write_slot].time + m_timestep;
+    std::this_thread::sleep_until(m_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(next_step)));
+  }
+}
+
+void Simulation::interpolate(std::vector<glm::fmat4>& transforms) {
+  // pick up newer snapshot if one was published
+  if (m_latest_slot.load() & FRESH_FLAG) {
+    m_read_slot = m_latest_slot.exchange(m_read_slot) & SLOT_MASK;
+  }
+  simulation_snapshot const& snapshot = m_snapshots[m_read_slot];
+
+  // render one step in the past, between previous and current state
+  float alpha = float(std::min(1.0, std::max(0.0, (time() - snapshot.time) / m_timestep)));
+
+  transforms.resize(m_num_objects);
+  for (std::size_t i = 0; i < m_num_objects; ++i) {
+    transforms[i] = ::interpolate(snapshot.previous[i], snapshot.current[i], alpha).matrix();
+  }
+}
@@ -0,0 +1,771 @@
+#include "software_rasterizer.hpp"
+#include "jobs.hpp"
+#include "memory_accounting.hpp"
+#include "simd_lanes.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+const unsigned SoftwareRasterizer::TILE_SIZE;
+
+// primitive kind in the top bits of a primitive code
+static const std::uint32_t KIND_SHIFT = 30;
+static const std::uint32_t INDEX_MASK = (1u << KIND_SHIFT) - 1;
+static const std::uint32_t KIND_TRIANGLE = 0;
+static const std::uint32_t KIND_POINT = 1;
+static const std::uint32_t KIND_LINE = 2;
+// inputs set up per job when queueing draws
+static const std::size_t SETUP_BLOCK = 1 << 10;
+// primitives binned per job, fewer are binned on one thread
+static const std::size_t BIN_BLOCK = 1 << 12;
+// vertex positions snap to 1/256 pixel, like 8 bits of subpixel precision
+static const float SUBPIXEL = 256.0f;
+// colour of silhouettes in the cel shaded permutation
+static const glm::fvec3 OUTLINE_COLOUR{0.850f, 0.968f, 0.956f};
+
+///////////////////////////// lanes ////////////////////////////////
+// four pixels of a row, with a scalar fallback of the same interface
+#ifdef SIMD_LANES_SSE
+struct float4 {
+  __m128 v;
+};
+static inline float4 splat(float f) { return float4{_mm_set1_ps(f)}; }
+static inline float4 ramp(float base, float step) {
+  return float4{_mm_add_ps(_mm_set1_ps(base), _mm_mul_ps(_mm_set1_ps(step), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)))};
+}
+static inline float4 operator+(float4 a, float4 b) { return float4{_mm_add_ps(a.v, b.v)}; }
+static inline float4 operator*(float4 a, float4 b) { return float4{_mm_mul_ps(a.v, b.v)}; }
+static inline float4 load(float const* p) { return float4{_mm_loadu_ps(p)}; }
+static inline void store(float* p, float4 a) { _mm_storeu_ps(p, a.v); }
+// bit i set where lane i compares true
+static inline int greater_equal(float4 a, float4 b) { return _mm_movemask_ps(_mm_cmpge_ps(a.v, b.v)); }
+static inline int greater(float4 a, float4 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a.v, b.v)); }
+static inline int less(float4 a, float4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+#else
+struct float4 {
+  float v[4];
+};
+static inline float4 splat(float f) { return float4{{f, f, f, f}}; }
+static inline float4 ramp(float base, float step) {
+  return float4{{base, base + step, base + 2.0f * step, base + 3.0f * step}};
+}
+static inline float4 operator+(float4 a, float4 b) {
+  return float4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+static inline float4 operator*(float4 a, float4 b) {
+  return float4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+static inline float4 load(float const* p) { return float4{{p[0], p[1], p[2], p[3]}}; }
+static inline void store(float* p, float4 a) { std::copy(a.v, a.v + 4, p); }
+static inline int greater_equal(float4 a, float4 b) {
+  int mask = 0;
+  for (int i = 0; i < 4; ++i) mask |= (a.v[i] >= b.v[i]) << i;
+  return mask;
+}
+static inline int greater(float4 a, float4 b) {
+  int mask = 0;
+  for (int i = 0; i < 4; ++i) mask |= (a.v[i] > b.v[i]) << i;
+  return mask;
+}
+static inline int less(float4 a, float4 b) {
+  int mask = 0;
+  for (int i = 0; i < 4; ++i) mask |= (a.v[i] < b.v[i]) << i;
+  return mask;
+}
+#endif
+
+///////////////////////////// helpers ////////////////////////////////
+// unorm conversion as gl does when writing 8 bit targets
+static inline std::uint32_t pack(glm::fvec3 const& c) {
+  glm::fvec3 clamped = glm::clamp(c, glm::fvec3{0.0f}, glm::fvec3{1.0f}) * 255.0f + 0.5f;
+  return std::uint32_t(clamped.r) | (std::uint32_t(clamped.g) << 8) | (std::uint32_t(clamped.b) << 16) | (255u << 24);
+}
+
+static inline glm::fvec3 unpack(std::uint32_t c) {
+  return glm::fvec3{float(c & 255u), float((c >> 8) & 255u), float((c >> 16) & 255u)} * (1.0f / 255.0f);
+}
+
+// floats of one attribute per vertex, absent attributes read nothing
+struct attribute_reader {
+  attribute_reader(model const& m, model::attribute const& attribute)
+   :data{nullptr}
+   ,stride{std::size_t(m.vertex_bytes) / sizeof(GLfloat)}
+  {
+    auto offset = m.offsets.find(attribute);
+    if (offset != m.offsets.end() && !m.data.empty()) {
+      data = m.data.data() + reinterpret_cast<std::size_t>(offset->second) / sizeof(GLfloat);
+    }
+  }
+
+  GLfloat const* operator[](std::size_t vertex) const {
+    return data + vertex * stride;
+  }
+
+  GLfloat const* data;
+  std::size_t stride;
+};
+
+static inline glm::fvec3 to_window(glm::fvec4 const& clip, float width, float height, float& inverse_w) {
+  inverse_w = 1.0f / clip.w;
+  float x = (clip.x * inverse_w * 0.5f + 0.5f) * width;
+  float y = (clip.y * inverse_w * 0.5f + 0.5f) * height;
+  return glm::fvec3{std::round(x * SUBPIXEL) / SUBPIXEL, std::round(y * SUBPIXEL) / SUBPIXEL, clip.z * inverse_w * 0.5f + 0.5f};
+}
+
+// bilinear filtering with repeat wrapping of an 8 bit image
+static glm::fvec3 sample_texture(pixel_data const& texture, glm::fvec2 const& texcoord) {
+  std::size_t components = texture.channels == GL_RGBA ? 4 : texture.channels == GL_RGB ? 3 : texture.channels == GL_RG ? 2 : 1;
+  int width = int(texture.width);
+  int height = int(texture.height);
+  float u = texcoord.x * float(width) - 0.5f;
+  float v = texcoord.y * float(height) - 0.5f;
+  float fu = std::floor(u);
+  float fv = std::floor(v);
+  float tu = u - fu;
+  float tv = v - fv;
+  int x0 = int(fu) % width;
+  int y0 = int(fv) % height;
+  x0 += x0 < 0 ? width : 0;
+  y0 += y0 < 0 ? height : 0;
+  int x1 = x0 + 1 < width ? x0 + 1 : 0;
+  int y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+  std::uint8_t const* pixels = texture.pixels.data();
+  auto texel = [&](int x, int y) {
+    std::uint8_t const* p = pixels + (std::size_t(y) * std::size_t(width) + std::size_t(x)) * components;
+    return glm::fvec3{float(p[0]), components > 1 ? float(p[1]) : 0.0f, components > 2 ? float(p[2]) : 0.0f};
+  };
+  glm::fvec3 bottom = glm::mix(texel(x0, y0), texel(x1, y0), tu);
+  glm::fvec3 top = glm::mix(texel(x0, y1), texel(x1, y1), tu);
+  return glm::mix(bottom, top, tv) * (1.0f / 255.0f);
+}
+
+static glm::fvec3 shade(raster_material const& material, glm::fvec3 const& camera, glm::fvec3 const& position, glm::fvec3 normal, glm::fvec2 const& texcoord) {
+  glm::fvec3 base = material.colour;
+  if (material.texture) {
+    base *= sample_texture(*material.texture, texcoord);
+  }
+  if (!material.lit) {
+    return base;
+  }
+  normal = glm::normalize(normal);
+  glm::fvec3 light_dir = glm::normalize(material.light_position - position);
+  glm::fvec3 view_dir = glm::normalize(camera - position);
+  float lambertian = std::max(glm::dot(light_dir, normal), 0.0f);
+  float specular = std::pow(std::max(glm::dot(glm::normalize(view_dir + light_dir), normal), 0.0f), material.glossiness);
+  glm::fvec3 colour = material.ambient * base + lambertian * material.diffuse * base + glm::fvec3{material.specular * specular};
+  if (material.cel_shading) {
+    if (glm::dot(normal, view_dir) < 0.3f) {
+      return OUTLINE_COLOUR;
+    }
+    return glm::ceil(colour * 4.0f) / 4.0f;
+  }
+  return colour;
+}
+
+// run fn(i, output) for every input on blocks of SETUP_BLOCK in parallel,
+// then append the outputs of all blocks in input order
+template<typename T, typename F>
+static void setup_blocks(std::size_t count, std::vector<std::vector<T>>& blocks, std::vector<T>& primitives,
+                         std::vector<std::uint32_t>& codes, std::uint32_t kind, F const& fn) {
+  std::size_t num_blocks = (count + SETUP_BLOCK - 1) / SETUP_BLOCK;
+  if (blocks.size() < num_blocks) {
+    blocks.resize(num_blocks);
+  }
+  jobs::parallel_for(0, num_blocks, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t b = first; b < last; ++b) {
+      std::vector<T>& output = blocks[b];
+      output.clear();
+      std::size_t end = std::min(count, (b + 1) * SETUP_BLOCK);
+      for (std::size_t i = b * SETUP_BLOCK; i < end; ++i) {
+        fn(i, output);
+      }
+    }
+  });
+  for (std::size_t b = 0; b < num_blocks; ++b) {
+    for (T const& primitive : blocks[b]) {
+      codes.push_back((kind << KIND_SHIFT) | std::uint32_t(primitives.size()));
+      primitives.push_back(primitive);
+    }
+  }
+}
+
+///////////////////////////// rasterization ////////////////////////////////
+struct tile_target {
+  std::uint32_t* colour;
+  float* depth;
+  unsigned width;
+  // pixel rectangle of the tile, inclusive
+  int min_x, min_y, max_x, max_y;
+};
+
+static void raster_triangle(SoftwareRasterizer::triangle const& tri, raster_material const& material, glm::fvec3 const& camera, tile_target const& target) {
+  int x0 = std::max(tri.min_x, target.min_x);
+  int x1 = std::min(tri.max_x, target.max_x);
+  int y0 = std::max(tri.min_y, target.min_y);
+  int y1 = std::min(tri.max_y, target.max_y);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+  // edge i lies opposite vertex i, positive inside for counter-clockwise order
+  double a[3], b[3], c[3];
+  bool inclusive[3];
+  for (unsigned i = 0; i < 3; ++i) {
+    glm::fvec4 const& from = tri.window[(i + 1) % 3];
+    glm::fvec4 const& to = tri.window[(i + 2) % 3];
+    a[i] = double(from.y) - double(to.y);
+    b[i] = double(to.x) - double(from.x);
+    c[i] = -(a[i] * double(from.x) + b[i] * double(from.y));
+    // left and top edges own the pixels on them
+    inclusive[i] = a[i] > 0.0 || (a[i] == 0.0 && b[i] < 0.0);
+  }
+  double area = c[0] + a[0] * double(tri.window[0].x) + b[0] * double(tri.window[0].y);
+  float inverse_area = float(1.0 / area);
+
+  float4 zero = splat(0.0f);
+  float4 one = splat(1.0f);
+  float4 z0 = splat(tri.window[0].z), z1 = splat(tri.window[1].z), z2 = splat(tri.window[2].z);
+  float4 step[3];
+  for (unsigned i = 0; i < 3; ++i) {
+    step[i] = splat(float(a[i] * 4.0));
+  }
+
+  for (int y = y0; y <= y1; ++y) {
+    double center_y = double(y) + 0.5;
+    float4 edge[3];
+    for (unsigned i = 0; i < 3; ++i) {
+      edge[i] = ramp(float(a[i] * (double(x0) + 0.5) + b[i] * center_y + c[i]), float(a[i]));
+    }
+    std::size_t row = std::size_t(y) * target.width;
+    for (int x = x0; x <= x1; x += 4) {
+      int mask = (x1 - x >= 3) ? 15 : (1 << (x1 - x + 1)) - 1;
+      for (unsigned i = 0; i < 3; ++i) {
+        mask &= inclusive[i] ? greater_equal(edge[i], zero) : greater(edge[i], zero);
+      }
+      if (mask) {
+        // barycentric weights in screen space interpolate depth
+        float4 l1 = edge[1] * splat(inverse_area);
+        float4 l2 = edge[2] * splat(inverse_area);
+        float4 l0 = one + l1 * splat(-1.0f) + l2 * splat(-1.0f);
+        float4 depth = l0 * z0 + l1 * z1 + l2 * z2;
+        // the last group of a row may reach past the image
+        float stored[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        float* depth_row = target.depth + row + std::size_t(x);
+        for (int lane = 0; lane < 4 && x + lane <= x1; ++lane) {
+          stored[lane] = depth_row[lane];
+        }
+        mask &= less(depth, load(stored)) & greater_equal(depth, zero) & greater_equal(one, depth);
+        if (mask) {
+          float w[3][4];
+          store(w[0], l0 * splat(tri.window[0].w));
+          store(w[1], l1 * splat(tri.window[1].w));
+          store(w[2], l2 * splat(tri.window[2].w));
+          float d[4];
+          store(d, depth);
+          for (int lane = 0; lane < 4; ++lane) {
+            if (!(mask & (1 << lane))) {
+              continue;
+            }
+            // perspective correct weights for the attributes
+            float sum = w[0][lane] + w[1][lane] + w[2][lane];
+            float p0 = w[0][lane] / sum, p1 = w[1][lane] / sum, p2 = w[2][lane] / sum;
+            glm::fvec3 position = tri.world[0] * p0 + tri.world[1] * p1 + tri.world[2] * p2;
+            glm::fvec3 normal = tri.normal[0] * p0 + tri.normal[1] * p1 + tri.normal[2] * p2;
+            glm::fvec2 texcoord = tri.texcoord[0] * p0 + tri.texcoord[1] * p1 + tri.texcoord[2] * p2;
+            target.colour[row + std::size_t(x + lane)] = pack(shade(material, camera, position, normal, texcoord));
+            if (material.depth_write) {
+              depth_row[lane] = d[lane];
+            }
+          }
+        }
+      }
+      for (unsigned i = 0; i < 3; ++i) {
+        edge[i] = edge[i] + step[i];
+      }
+    }
+  }
+}
+
+static void raster_point(SoftwareRasterizer::point const& p, tile_target const& target) {
+  if (p.x < target.min_x || p.x > target.max_x || p.y < target.min_y || p.y > target.max_y) {
+    return;
+  }
+  std::size_t index = std::size_t(p.y) * target.width + std::size_t(p.x);
+  if (p.depth < target.depth[index]) {
+    target.depth[index] = p.depth;
+    target.colour[index] = p.colour;
+  }
+}
+
+// one pixel per column or row along the major axis, pixel centers in [start, end)
+static void raster_line(SoftwareRasterizer::line const& l, tile_target const& target) {
+  glm::fvec3 from = l.window[0];
+  glm::fvec3 to = l.window[1];
+  bool x_major = std::abs(to.x - from.x) >= std::abs(to.y - from.y);
+  int major_axis = x_major ? 0 : 1;
+  int minor_axis = 1 - major_axis;
+  if (to[major_axis] < from[major_axis]) {
+    std::swap(from, to);
+  }
+  float length = to[major_axis] - from[major_axis];
+  if (length <= 0.0f) {
+    return;
+  }
+  int tile_min[2] = {target.min_x, target.min_y};
+  int tile_max[2] = {target.max_x, target.max_y};
+  int first = std::max(int(std::ceil(from[major_axis] - 0.5f)), tile_min[major_axis]);
+  int last = std::min(int(std::ceil(to[major_axis] - 0.5f)) - 1, tile_max[major_axis]);
+  for (int major = first; major <= last; ++major) {
+    float t = (float(major) + 0.5f - from[major_axis]) / length;
+    int minor = int(std::floor(from[minor_axis] + t * (to[minor_axis] - from[minor_axis])));
+    if (minor < tile_min[minor_axis] || minor > tile_max[minor_axis]) {
+      continue;
+    }
+    float depth = from.z + t * (to.z - from.z);
+    int x = x_major ? major : minor;
+    int y = x_major ? minor : major;
+    std::size_t index = std::size_t(y) * target.width + std::size_t(x);
+    if (depth < target.depth[index] && depth >= 0.0f && depth <= 1.0f) {
+      target.depth[index] = depth;
+      target.colour[index] = l.colour;
+    }
+  }
+}
+
+///////////////////////////// material ////////////////////////////////
+raster_material::raster_material()
+ :texture{nullptr}
+ ,colour{1.0f}
+ ,texcoord_scale{1.0f}
+ ,texcoord_offset{0.0f}
+ ,lit{true}
+ ,light_position{0.0f}
+ ,ambient{0.3f}
+ ,diffuse{0.8f}
+ ,specular{0.2f}
+ ,glossiness{3.0f}
+ ,cel_shading{false}
+ ,depth_write{true}
+{}
+
+///////////////////////////// rasterizer ////////////////////////////////
+SoftwareRasterizer::SoftwareRasterizer(unsigned width, unsigned height)
+ :m_width{0}
+ ,m_height{0}
+ ,m_tiles_x{0}
+ ,m_tiles_y{0}
+ ,m_colour{}
+ ,m_depth{}
+ ,m_post_target{}
+ ,m_view_projection{}
+ ,m_camera_position{0.0f}
+ ,m_draws{}
+ ,m_triangles{}
+ ,m_points{}
+ ,m_lines{}
+ ,m_primitives{}
+ ,m_num_flushed{0}
+ ,m_bins{}
+ ,m_num_binned{0}
+{
+  resize(width, height);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() {
+  memory_accounting::release_host(this);
+}
+
+void SoftwareRasterizer::resize(unsigned width, unsigned height) {
+  if (width == 0 || height == 0) {
+    std::cerr << "Software rasterizer size " << width << "x" << height << " is empty" << std::endl;
+    throw std::invalid_argument("empty software rasterizer");
+  }
+  m_width = width;
+  m_height = height;
+  m_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+  m_colour.assign(std::size_t(width) * height, pack(glm::fvec3{0.0f}));
+  m_depth.assign(std::size_t(width) * height, 1.0f);
+  m_bins.clear();
+  track_memory();
+}
+
+void SoftwareRasterizer::track_memory() const {
+  std::size_t bytes = sizeof(std::uint32_t) * (m_colour.size() + m_post_target.size()) + sizeof(float) * m_depth.size();
+  memory_accounting::track_host(this, memory_accounting::RENDER_TARGETS, bytes, "software framebuffer");
+}
+
+unsigned SoftwareRasterizer::width() const {
+  return m_width;
+}
+
+unsigned SoftwareRasterizer::height() const {
+  return m_height;
+}
+
+void SoftwareRasterizer::clear(glm::fvec3 const& colour) {
+  std::fill(m_colour.begin(), m_colour.end(), pack(colour));
+  std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+  m_draws.clear();
+  m_triangles.clear();
+  m_points.clear();
+  m_lines.clear();
+  m_primitives.clear();
+}
+
+void SoftwareRasterizer::set_camera(glm::fmat4 const& view, glm::fmat4 const& projection) {
+  m_view_projection = projection * view;
+  m_camera_position = glm::fvec3{glm::inverse(view)[3]};
+}
+
+void SoftwareRasterizer::draw_triangles(model const& m, glm::fmat4 const& transform, raster_material const& material) {
+  attribute_reader positions{m, model::POSITION};
+  attribute_reader normals{m, model::NORMAL};
+  attribute_reader texcoords{m, model::TEXCOORD};
+  if (!positions.data || m.indices.size() < 3) {
+    return;
+  }
+  unsigned draw = unsigned(m_draws.size());
+  m_draws.push_back(draw_state{material});
+
+  // vertex processing
+  glm::fmat4 clip_transform = m_view_projection * transform;
+  glm::fmat3 normal_matrix = glm::inverseTranspose(glm::fmat3{transform});
+  m_clip_positions.resize(m.vertex_num);
+  m_world_positions.resize(m.vertex_num);
+  m_world_normals.resize(m.vertex_num);
+  m_texcoords.resize(m.vertex_num);
+  jobs::parallel_for(0, m.vertex_num, SETUP_BLOCK, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      GLfloat const* p = positions[i];
+      glm::fvec4 position{p[0], p[1], p[2], 1.0f};
+      m_clip_positions[i] = clip_transform * position;
+      m_world_positions[i] = glm::fvec3{transform * position};
+      m_world_normals[i] = normals.data ? normal_matrix * glm::fvec3{normals[i][0], normals[i][1], normals[i][2]} : glm::fvec3{0.0f};
+      m_texcoords[i] = texcoords.data ? glm::fvec2{texcoords[i][0], texcoords[i][1]} * material.texcoord_scale + material.texcoord_offset : glm::fvec2{0.0f};
+    }
+  });
+
+  // clip against the near plane, other planes are handled by the pixel bounds
+  float width = float(m_width);
+  float height = float(m_height);
+  setup_blocks(m.indices.size() / 3, m_triangle_blocks, m_triangles, m_primitives, KIND_TRIANGLE, [&](std::size_t t, std::vector<triangle>& output) {
+    GLuint const* index = &m.indices[t * 3];
+    glm::fvec4 const* clip[3] = {&m_clip_positions[index[0]], &m_clip_positions[index[1]], &m_clip_positions[index[2]]};
+    // outside of one plane of the view volume
+    for (int axis = 0; axis < 3; ++axis) {
+      if ((*clip[0])[axis] > clip[0]->w && (*clip[1])[axis] > clip[1]->w && (*clip[2])[axis] > clip[2]->w) {
+        return;
+      }
+      if ((*clip[0])[axis] < -clip[0]->w && (*clip[1])[axis] < -clip[1]->w && (*clip[2])[axis] < -clip[2]->w) {
+        return;
+      }
+    }
+
+    // polygon after clipping, up to four vertices
+    struct clip_vertex {
+      glm::fvec4 clip;
+      glm::fvec3 world;
+      glm::fvec3 normal;
+      glm::fvec2 texcoord;
+    };
+    clip_vertex input[3];
+    for (unsigned v = 0; v < 3; ++v) {
+      input[v] = clip_vertex{*clip[v], m_world_positions[index[v]], m_world_normals[index[v]], m_texcoords[index[v]]};
+    }
+    clip_vertex polygon[4];
+    unsigned num = 0;
+    for (unsigned v = 0; v < 3; ++v) {
+      clip_vertex const& current = input[v];
+      clip_vertex const& next = input[(v + 1) % 3];
+      float d_current = current.clip.z + current.clip.w;
+      float d_next = next.clip.z + next.clip.w;
+      if (d_current >= 0.0f) {
+        polygon[num++] = current;
+      }
+      if ((d_current >= 0.0f) != (d_next >= 0.0f)) {
+        float s = d_current / (d_current - d_next);
+        polygon[num++] = clip_vertex{glm::mix(current.clip, next.clip, s), glm::mix(current.world, next.world, s),
+                                     glm::mix(current.normal, next.normal, s), glm::mix(current.texcoord, next.texcoord, s)};
+      }
+    }
+
+    for (unsigned fan = 1; fan + 1 < num; ++fan) {
+      unsigned corners[3] = {0, fan, fan + 1};
+      triangle tri{};
+      tri.draw = draw;
+      for (unsigned v = 0; v < 3; ++v) {
+        clip_vertex const& vertex = polygon[corners[v]];
+        float inverse_w = 0.0f;
+        glm::fvec3 window = to_window(vertex.clip, width, height, inverse_w);
+        tri.window[v] = glm::fvec4{window, inverse_w};
+        tri.world[v] = vertex.world;
+        tri.normal[v] = vertex.normal;
+        tri.texcoord[v] = vertex.texcoord;
+      }
+      float area = (tri.window[1].x - tri.window[0].x) * (tri.window[2].y - tri.window[0].y) -
+                   (tri.window[2].x - tri.window[0].x) * (tri.window[1].y - tri.window[0].y);
+      if (area == 0.0f) {
+        continue;
+      }
+      // no face culling, clockwise triangles are turned around
+      if (area < 0.0f) {
+        std::swap(tri.window[1], tri.window[2]);
+        std::swap(tri.world[1], tri.world[2]);
+        std::swap(tri.normal[1], tri.normal[2]);
+        std::swap(tri.texcoord[1], tri.texcoord[2]);
+      }
+      float min_x = std::min(tri.window[0].x, std::min(tri.window[1].x, tri.window[2].x));
+      float max_x = std::max(tri.window[0].x, std::max(tri.window[1].x, tri.window[2].x));
+      float min_y = std::min(tri.window[0].y, std::min(tri.window[1].y, tri.window[2].y));
+      float max_y = std::max(tri.window[0].y, std::max(tri.window[1].y, tri.window[2].y));
+      tri.min_x = std::max(0, int(std::floor(min_x - 0.5f)));
+      tri.min_y = std::max(0, int(std::floor(min_y - 0.5f)));
+      tri.max_x = std::min(int(m_width) - 1, int(std::ceil(max_x - 0.5f)));
+      tri.max_y = std::min(int(m_height) - 1, int(std::ceil(max_y - 0.5f)));
+      if (tri.min_x <= tri.max_x && tri.min_y <= tri.max_y) {
+        output.push_back(tri);
+      }
+    }
+  });
+}
+
+void SoftwareRasterizer::draw_points(model const& m, GLint first, GLsizei count, glm::fmat4 const& transform) {
+  attribute_reader positions{m, model::POSITION};
+  attribute_reader colours{m, model::NORMAL};
+  if (!positions.data || count <= 0) {
+    return;
+  }
+  glm::fmat4 clip_transform = m_view_projection * transform;
+  float width = float(m_width);
+  float height = float(m_height);
+  setup_blocks(std::size_t(count), m_point_blocks, m_points, m_primitives, KIND_POINT, [&](std::size_t i, std::vector<point>& output) {
+    std::size_t vertex = std::size_t(first) + i;
+    GLfloat const* p = positions[vertex];
+    glm::fvec4 clip = clip_transform * glm::fvec4{p[0], p[1], p[2], 1.0f};
+    // points are clipped by their center
+    if (clip.w <= 0.0f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w) {
+      return;
+    }
+    float inverse_w = 0.0f;
+    glm::fvec3 window = to_window(clip, width, height, inverse_w);
+    point result{};
+    result.x = std::min(int(window.x), int(m_width) - 1);
+    result.y = std::min(int(window.y), int(m_height) - 1);
+    result.depth = window.z;
+    result.colour = colours.data ? pack(glm::fvec3{colours[vertex][0], colours[vertex][1], colours[vertex][2]}) : pack(glm::fvec3{1.0f});
+    output.push_back(result);
+  });
+}
+
+void SoftwareRasterizer::draw_line_loop(model const& m, GLint first, GLsizei count, glm::fmat4 const& transform, glm::fvec3 const& colour) {
+  attribute_reader positions{m, model::POSITION};
+  if (!positions.data || count < 2) {
+    return;
+  }
+  glm::fmat4 clip_transform = m_view_projection * transform;
+  std::uint32_t packed = pack(colour);
+  float width = float(m_width);
+  float height = float(m_height);
+  setup_blocks(std::size_t(count), m_line_blocks, m_lines, m_primitives, KIND_LINE, [&](std::size_t i, std::vector<line>& output) {
+    GLfloat const* p0 = positions[std::size_t(first) + i];
+    GLfloat const* p1 = positions[std::size_t(first) + (i + 1) % std::size_t(count)];
+    glm::fvec4 clip[2] = {clip_transform * glm::fvec4{p0[0], p0[1], p0[2], 1.0f}, clip_transform * glm::fvec4{p1[0], p1[1], p1[2], 1.0f}};
+    float d0 = clip[0].z + clip[0].w;
+    float d1 = clip[1].z + clip[1].w;
+    if (d0 < 0.0f && d1 < 0.0f) {
+      return;
+    }
+    // move the end behind the near plane onto it
+    if (d0 < 0.0f) {
+      clip[0] = glm::mix(clip[0], clip[1], d0 / (d0 - d1));
+    }
+    else if (d1 < 0.0f) {
+      clip[1] = glm::mix(clip[1], clip[0], d1 / (d1 - d0));
+    }
+    line result{};
+    result.colour = packed;
+    float inverse_w = 0.0f;
+    result.window[0] = to_window(clip[0], width, height, inverse_w);
+    result.window[1] = to_window(clip[1], width, height, inverse_w);
+    result.min_x = std::max(0, int(std::floor(std::min(result.window[0].x, result.window[1].x))));
+    result.min_y = std::max(0, int(std::floor(std::min(result.window[0].y, result.window[1].y))));
+    result.max_x = std::min(int(m_width) - 1, int(std::floor(std::max(result.window[0].x, result.window[1].x))));
+    result.max_y = std::min(int(m_height) - 1, int(std::floor(std::max(result.window[0].y, result.window[1].y))));
+    if (result.min_x <= result.max_x && result.min_y <= result.max_y) {
+      output.push_back(result);
+    }
+  });
+}
+
+void SoftwareRasterizer::bin() {
+  std::size_t num_tiles = std::size_t(m_tiles_x) * m_tiles_y;
+  std::size_t num = m_primitives.size();
+  std::size_t ranges = std::max(std::size_t(1), std::min(std::size_t(jobs::concurrency()), num / BIN_BLOCK));
+  if (m_bins.size() < ranges) {
+    m_bins.resize(ranges);
+  }
+  std::size_t range = (num + ranges - 1) / ranges;
+
+  jobs::parallel_for(0, ranges, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t r = first; r < last; ++r) {
+      std::vector<std::vector<primitive_code>>& bins = m_bins[r];
+      bins.resize(num_tiles);
+      for (auto& tile : bins) {
+        tile.clear();
+      }
+      std::size_t end = std::min(num, (r + 1) * range);
+      for (std::size_t i = r * range; i < end; ++i) {
+        primitive_code code = m_primitives[i];
+        std::uint32_t index = code & INDEX_MASK;
+        int min_x, min_y, max_x, max_y;
+        switch (code >> KIND_SHIFT) {
+          case KIND_TRIANGLE: {
+            triangle const& tri = m_triangles[index];
+            min_x = tri.min_x; min_y = tri.min_y; max_x = tri.max_x; max_y = tri.max_y;
+            break;
+          }
+          case KIND_POINT: {
+            point const& p = m_points[index];
+            min_x = max_x = p.x; min_y = max_y = p.y;
+            break;
+          }
+          default: {
+            line const& l = m_lines[index];
+            min_x = l.min_x; min_y = l.min_y; max_x = l.max_x; max_y = l.max_y;
+            break;
+          }
+        }
+        for (int ty = min_y / int(TILE_SIZE); ty <= max_y / int(TILE_SIZE); ++ty) {
+          for (int tx = min_x / int(TILE_SIZE); tx <= max_x / int(TILE_SIZE); ++tx) {
+            bins[std::size_t(ty) * m_tiles_x + std::size_t(tx)].push_back(code);
+          }
+        }
+      }
+    }
+  });
+  // ranges unused this frame keep no stale references
+  for (std::size_t r = ranges; r < m_bins.size(); ++r) {
+    m_bins[r].clear();
+  }
+
+  m_num_binned = 0;
+  for (auto const& bins : m_bins) {
+    for (auto const& tile : bins) {
+      m_num_binned += tile.size();
+    }
+  }
+}
+
+void SoftwareRasterizer::rasterize_tile(unsigned tile) {
+  tile_target target{};
+  target.colour = m_colour.data();
+  target.depth = m_depth.data();
+  target.width = m_width;
+  target.min_x = int((tile % m_tiles_x) * TILE_SIZE);
+  target.min_y = int((tile / m_tiles_x) * TILE_SIZE);
+  target.max_x = std::min(target.min_x + int(TILE_SIZE), int(m_width)) - 1;
+  target.max_y = std::min(target.min_y + int(TILE_SIZE), int(m_height)) - 1;
+
+  for (auto const& bins : m_bins) {
+    if (bins.empty()) {
+      continue;
+    }
+    for (primitive_code code : bins[tile]) {
+      std::uint32_t index = code & INDEX_MASK;
+      switch (code >> KIND_SHIFT) {
+        case KIND_TRIANGLE: {
+          triangle const& tri = m_triangles[index];
+          raster_triangle(tri, m_draws[tri.draw].material, m_camera_position, target);
+          break;
+        }
+        case KIND_POINT:
+          raster_point(m_points[index], target);
+          break;
+        default:
+          raster_line(m_lines[index], target);
+          break;
+      }
+    }
+  }
+}
+
+void SoftwareRasterizer::flush() {
+  bin();
+  jobs::parallel_for(0, std::size_t(m_tiles_x) * m_tiles_y, 1, [this](std::size_t begin, std::size_t end) {
+    for (std::size_t tile = begin; tile < end; ++tile) {
+      rasterize_tile(unsigned(tile));
+    }
+  });
+  m_num_flushed = m_primitives.size();
+  m_draws.clear();
+  m_triangles.clear();
+  m_points.clear();
+  m_lines.clear();
+  m_primitives.clear();
+}
+
+void SoftwareRasterizer::post_process(post_function const& pass) {
+  if (m_post_target.size() != m_colour.size()) {
+    m_post_target.resize(m_colour.size());
+    track_memory();
+  }
+  jobs::parallel_for(0, m_height, 8, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t y = begin; y < end; ++y) {
+      for (unsigned x = 0; x < m_width; ++x) {
+        m_post_target[y * m_width + x] = pack(pass(*this, x, unsigned(y)));
+      }
+    }
+  });
+  m_colour.swap(m_post_target);
+}
+
+glm::fvec3 SoftwareRasterizer::colour(unsigned x, unsigned y) const {
+  return unpack(m_colour[std::size_t(y) * m_width + x]);
+}
+
+pixel_data SoftwareRasterizer::image() const {
+  std::vector<std::uint8_t> pixels(m_colour.size() * 3);
+  for (std::size_t i = 0; i < m_colour.size(); ++i) {
+    pixels[3 * i] = std::uint8_t(m_colour[i] & 255u);
+    pixels[3 * i + 1] = std::uint8_t((m_colour[i] >> 8) & 255u);
+    pixels[3 * i + 2] = std::uint8_t((m_colour[i] >> 16) & 255u);
+  }
+  return pixel_data{pixels, GL_RGB, GL_UNSIGNED_BYTE, m_width, m_height};
+}
+
+std::size_t SoftwareRasterizer::num_primitives() const {
+  return m_num_flushed;
+}
+
+std::size_t SoftwareRasterizer::num_binned() const {
+  return m_num_binned;
+}
+
+void write_ppm(std::string const& path, pixel_data const& image) {
+  std::size_t components = image.channels == GL_RGBA ? 4 : 3;
+  std::ofstream file{path, std::ios::binary};
+  if (!file) {
+    std::cerr << "File \'" << path << "\' could not be written" << std::endl;
+    throw std::invalid_argument(path);
+  }
+  file << "P6\n" << image.width << " " << image.height << "\n255\n";
+  // ppm starts with the top row
+  std::vector<char> row(image.width * 3);
+  for (std::size_t y = image.height; y-- > 0;) {
+    std::uint8_t const* source = image.pixels.data() + y * image.width * components;
+    for (std::size_t x = 0; x < image.width; ++x) {
+      row[3 * x] = char(source[x * components]);
+      row[3 * x + 1] = char(source[x * components + 1]);
+      row[3 * x + 2] = char(source[x * components + 2]);
+    }
+    file.write(row.data(), std::streamsize(row.size()));
+  }
+}
@@ -0,0 +1,392 @@
+#include "sphere_geometry.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+static const double PI = 3.14159265358979323846;
+// quads per row of a uv sphere band, two rows of vertices fit a cache of 16
+static const unsigned BAND_SEGMENTS = 7;
+
+// vertices of both generators before they are interleaved, normals and tangents follow from these
+struct sphere_vertices {
+  std::vector<glm::fvec3> positions;
+  std::vector<glm::fvec2> texcoords;
+};
+
+// scoring after Forsyth, "Linear-Speed Vertex Cache Optimisation"
+static const unsigned CACHE_SIZE = 32;
+// vertices with more remaining triangles share the last valence score
+static const unsigned MAX_VALENCE = 32;
+
+struct score_table {
+  float cache[CACHE_SIZE + 1];
+  float valence[MAX_VALENCE + 1];
+
+  score_table() {
+    // not in the cache
+    cache[0] = 0.0f;
+    for (unsigned position = 0; position < CACHE_SIZE; ++position) {
+      // the vertices of the last triangle get a fixed score so it is not reused right away
+      if (position < 3) {
+        cache[position + 1] = 0.75f;
+      }
+      else {
+        cache[position + 1] = std::pow(1.0f - float(position - 3) / float(CACHE_SIZE - 3), 1.5f);
+      }
+    }
+    valence[0] = -1.0f;
+    // prefer vertices with few triangles left to finish them off
+    for (unsigned remaining = 1; remaining <= MAX_VALENCE; ++remaining) {
+      valence[remaining] = 2.0f / std::sqrt(float(remaining));
+    }
+  }
+};
+
+static float vertex_score(int cache_position, unsigned remaining_triangles) {
+  static const score_table table{};
+  if (remaining_triangles == 0) {
+    return -1.0f;
+  }
+  return table.cache[cache_position + 1] + table.valence[std::min(remaining_triangles, MAX_VALENCE)];
+}
+
+// normal, texcoord, tangent and bitangent follow from position and longitude
+static model interleave(sphere_vertices const& vertices, std::vector<GLuint> const& indices, model::attrib_flag_t attributes, bool reorder_triangles) {
+  attributes |= model::POSITION;
+  std::vector<GLfloat> data{};
+  // at most 14 floats per vertex
+  data.reserve(vertices.positions.size() * 14);
+  for (std::size_t i = 0; i < vertices.positions.size(); ++i) {
+    glm::fvec3 const& position = vertices.positions[i];
+    glm::fvec2 const& texcoord = vertices.texcoords[i];
+    // derivative of the position by longitude, also defined at the poles
+    double longitude = 2.0 * PI * double(texcoord.x);
+    glm::fvec3 tangent{float(-std::sin(longitude)), 0.0f, float(-std::cos(longitude))};
+    glm::fvec3 bitangent = glm::cross(position, tangent);
+
+    data.insert(data.end(), {position.x, position.y, position.z});
+    if (attributes & model::NORMAL) {
+      data.insert(data.end(), {position.x, position.y, position.z});
+    }
+    if (attributes & model::TEXCOORD) {
+      data.insert(data.end(), {texcoord.x, texcoord.y});
+    }
+    if (attributes & model::TANGENT) {
+      data.insert(data.end(), {tangent.x, tangent.y, tangent.z});
+    }
+    if (attributes & model::BITANGENT) {
+      data.insert(data.end(), {bitangent.x, bitangent.y, bitangent.z});
+    }
+  }
+  model mesh{data, attributes, indices};
+  if (reorder_triangles) {
+    sphere_geometry::optimize_vertex_cache(mesh.indices, mesh.vertex_num);
+  }
+  sphere_geometry::optimize_vertex_fetch(mesh);
+  return mesh;
+}
+
+static void push_vertex(sphere_vertices& vertices, glm::fvec3 const& position, float u) {
+  vertices.positions.push_back(position);
+  float v = 1.0f - float(std::acos(double(glm::clamp(position.y, -1.0f, 1.0f))) / PI);
+  vertices.texcoords.push_back(glm::fvec2{u, v});
+}
+
+// longitude in [0, 1), counterclockwise around y starting at x
+static float longitude(glm::fvec3 const& position) {
+  float u = float(std::atan2(double(-position.z), double(position.x)) / (2.0 * PI));
+  return u < 0.0f ? u + 1.0f : u;
+}
+
+namespace sphere_geometry {
+
+model uv_sphere(unsigned rings, unsigned segments, model::attrib_flag_t attributes) {
+  rings = std::max(2u, rings);
+  segments = std::max(3u, segments);
+
+  sphere_vertices vertices{};
+  vertices.positions.reserve(std::size_t(rings + 1) * (segments + 1));
+  vertices.texcoords.reserve(std::size_t(rings + 1) * (segments + 1));
+  for (unsigned r = 0; r <= rings; ++r) {
+    double polar = PI * double(r) / double(rings);
+    for (unsigned s = 0; s <= segments; ++s) {
+      // pole vertices are split per segment, centered over the triangle they belong to
+      double offset = (r == 0 || r == rings) ? 0.5 : 0.0;
+      float u = float((double(s) + offset) / double(segments));
+      double azimuth = 2.0 * PI * double(u);
+      glm::fvec3 position{float(std::sin(polar) * std::cos(azimuth)), float(std::cos(polar)), float(-std::sin(polar) * std::sin(azimuth))};
+      vertices.positions.push_back(position);
+      vertices.texcoords.push_back(glm::fvec2{u, 1.0f - float(r) / float(rings)});
+    }
+  }
+
+  // the grid is walked from pole to pole in narrow bands of segments, so a
+  // cache holding two rows of a band transforms each vertex about once
+  std::vector<GLuint> indices{};
+  indices.reserve(std::size_t(rings - 1) * segments * 6);
+  for (unsigned band = 0; band < segments; band += BAND_SEGMENTS) {
+    for (unsigned r = 0; r < rings; ++r) {
+      for (unsigned s = band; s < std::min(segments, band + BAND_SEGMENTS); ++s) {
+        // quad between two rings, counterclockwise seen from outside
+        GLuint north = r * (segments + 1) + s;
+        GLuint south = north + segments + 1;
+        if (r > 0) {
+          indices.insert(indices.end(), {north, south, north + 1});
+        }
+        if (r + 1 < rings) {
+          indices.insert(indices.end(), {north + 1, south, south + 1});
+        }
+      }
+    }
+  }
+  return interleave(vertices, indices, attributes, false);
+}
+
+model icosphere(unsigned subdivisions, model::attrib_flag_t attributes) {
+  // a pole at each end of y and two staggered rings of five in between
+  std::vector<glm::fvec3> positions{glm::fvec3{0.0f, 1.0f, 0.0f}};
+  float ring_height = float(1.0 / std::sqrt(5.0));
+  float ring_radius = 2.0f * ring_height;
+  for (unsigned ring = 0; ring < 2; ++ring) {
+    for (unsigned i = 0; i < 5; ++i) {
+      double azimuth = 2.0 * PI * (double(i) + 0.5 * double(ring)) / 5.0;
+      float height = ring == 0 ? ring_height : -ring_height;
+      positions.push_back(glm::fvec3{ring_radius * float(std::cos(azimuth)), height, -ring_radius * float(std::sin(azimuth))});
+    }
+  }
+  positions.push_back(glm::fvec3{0.0f, -1.0f, 0.0f});
+
+  std::vector<GLuint> triangles{};
+  for (GLuint i = 0; i < 5; ++i) {
+    GLuint upper = 1 + i;
+    GLuint upper_next = 1 + (i + 1) % 5;
+    GLuint lower = 6 + i;
+    GLuint lower_next = 6 + (i + 1) % 5;
+    triangles.insert(triangles.end(), {0, upper, upper_next});
+    triangles.insert(triangles.end(), {upper, lower, upper_next});
+    triangles.insert(triangles.end(), {upper_next, lower, lower_next});
+    triangles.insert(triangles.end(), {11, lower_next, lower});
+  }
+
+  for (unsigned level = 0; level < subdivisions; ++level) {
+    // edges shared by two triangles get one midpoint
+    std::unordered_map<std::uint64_t, GLuint> midpoints{};
+    auto midpoint = [&positions, &midpoints](GLuint a, GLuint b) {
+      std::uint64_t key = (std::uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+      auto found = midpoints.find(key);
+      if (found != midpoints.end()) {
+        return found->second;
+      }
+      GLuint index = GLuint(positions.size());
+      positions.push_back(glm::normalize(positions[a] + positions[b]));
+      midpoints.emplace(key, index);
+      return index;
+    };
+
+    std::vector<GLuint> split{};
+    split.reserve(triangles.size() * 4);
+    for (std::size_t t = 0; t < triangles.size(); t += 3) {
+      GLuint a = triangles[t];
+      GLuint b = triangles[t + 1];
+      GLuint c = triangles[t + 2];
+      GLuint ab = midpoint(a, b);
+      GLuint bc = midpoint(b, c);
+      GLuint ca = midpoint(c, a);
+      split.insert(split.end(), {a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca});
+    }
+    triangles.swap(split);
+  }
+
+  sphere_vertices vertices{};
+  for (glm::fvec3 const& position : positions) {
+    push_vertex(vertices, position, longitude(position));
+  }
+  // copies of vertices with u + 1 for triangles crossing the seam
+  std::unordered_map<GLuint, GLuint> wrapped{};
+  for (std::size_t t = 0; t < triangles.size(); t += 3) {
+    GLuint* corners = &triangles[t];
+    float min_u = 1.0f;
+    float max_u = 0.0f;
+    for (unsigned i = 0; i < 3; ++i) {
+      if (corners[i] != 0 && corners[i] != 11) {
+        min_u = std::min(min_u, vertices.texcoords[corners[i]].x);
+        max_u = std::max(max_u, vertices.texcoords[corners[i]].x);
+      }
+    }
+    if (max_u - min_u > 0.5f) {
+      for (unsigned i = 0; i < 3; ++i) {
+        if (corners[i] == 0 || corners[i] == 11 || vertices.texcoords[corners[i]].x >= 0.5f) {
+          continue;
+        }
+        auto found = wrapped.find(corners[i]);
+        if (found == wrapped.end()) {
+          GLuint index = GLuint(vertices.positions.size());
+          push_vertex(vertices, vertices.positions[corners[i]], vertices.texcoords[corners[i]].x + 1.0f);
+          found = wrapped.emplace(corners[i], index).first;
+        }
+        corners[i] = found->second;
+      }
+    }
+    // the longitude of a pole is undefined, each triangle gets its own centered between the others
+    for (unsigned i = 0; i < 3; ++i) {
+      if (corners[i] == 0 || corners[i] == 11) {
+        float u = 0.5f * (vertices.texcoords[corners[(i + 1) % 3]].x + vertices.texcoords[corners[(i + 2) % 3]].x);
+        GLuint index = GLuint(vertices.positions.size());
+        push_vertex(vertices, vertices.positions[corners[i]], u);
+        corners[i] = index;
+      }
+    }
+  }
+  return interleave(vertices, triangles, attributes, true);
+}
+
+void optimize_vertex_cache(std::vector<GLuint>& indices, std::size_t num_vertices) {
+  std::size_t num_triangles = indices.size() / 3;
+  if (num_triangles == 0) {
+    return;
+  }
+  // triangles using each vertex, the live ones are kept at the front of each range
+  std::vector<unsigned> remaining(num_vertices, 0);
+  for (GLuint index : indices) {
+    ++remaining[index];
+  }
+  std::vector<std::size_t> first_triangle(num_vertices + 1, 0);
+  for (std::size_t v = 0; v < num_vertices; ++v) {
+    first_triangle[v + 1] = first_triangle[v] + remaining[v];
+  }
+  std::vector<std::size_t> adjacency(indices.size());
+  std::vector<std::size_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    adjacency[fill[indices[i]]++] = i / 3;
+  }
+
+  std::vector<int> cache_position(num_vertices, -1);
+  std::vector<float> scores(num_vertices);
+  for (std::size_t v = 0; v < num_vertices; ++v) {
+    scores[v] = vertex_score(-1, remaining[v]);
+  }
+  std::vector<float> triangle_scores(num_triangles);
+  std::vector<bool> emitted(num_triangles, false);
+  std::size_t best = 0;
+  for (std::size_t t = 0; t < num_triangles; ++t) {
+    triangle_scores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+    if (triangle_scores[t] > triangle_scores[best]) {
+      best = t;
+    }
+  }
+
+  std::vector<GLuint> ordered{};
+  ordered.reserve(indices.size());
+  std::vector<GLuint> cache{};
+  std::vector<GLuint> next_cache{};
+  // lowest triangle that may not be emitted yet, for when the cache yields no candidate
+  std::size_t scan = 0;
+  while (ordered.size() < indices.size()) {
+    emitted[best] = true;
+    GLuint const* corners = &indices[best * 3];
+    ordered.insert(ordered.end(), corners, corners + 3);
+
+    next_cache.assign(corners, corners + 3);
+    for (unsigned i = 0; i < 3; ++i) {
+      GLuint v = corners[i];
+      // move the triangle behind the live ones of its vertex
+      std::size_t begin = first_triangle[v];
+      std::size_t end = begin + remaining[v];
+      auto found = std::find(adjacency.begin() + std::ptrdiff_t(begin), adjacency.begin() + std::ptrdiff_t(end), best);
+      // degenerate triangles list a vertex twice
+      if (found != adjacency.begin() + std::ptrdiff_t(end)) {
+        std::iter_swap(found, adjacency.begin() + std::ptrdiff_t(end - 1));
+        --remaining[v];
+      }
+    }
+    for (GLuint v : cache) {
+      if (v != corners[0] && v != corners[1] && v != corners[2]) {
+        next_cache.push_back(v);
+      }
+    }
+    // vertices pushed out of the cache still change score, so they are updated once more;
+    // the scores of their live triangles change by the same amount
+    for (std::size_t i = 0; i < next_cache.size(); ++i) {
+      GLuint v = next_cache[i];
+      cache_position[v] = i < CACHE_SIZE ? int(i) : -1;
+      float score = vertex_score(cache_position[v], remaining[v]);
+      float change = score - scores[v];
+      scores[v] = score;
+      for (std::size_t a = first_triangle[v]; a < first_triangle[v] + remaining[v]; ++a) {
+        triangle_scores[adjacency[a]] += change;
+      }
+    }
+
+    float best_score = -1.0f;
+    for (std::size_t i = 0; i < std::min(next_cache.size(), std::size_t(CACHE_SIZE)); ++i) {
+      GLuint v = next_cache[i];
+      for (std::size_t a = first_triangle[v]; a < first_triangle[v] + remaining[v]; ++a) {
+        if (triangle_scores[adjacency[a]] > best_score) {
+          best_score = triangle_scores[adjacency[a]];
+          best = adjacency[a];
+        }
+      }
+    }
+    next_cache.resize(std::min(next_cache.size(), std::size_t(CACHE_SIZE)));
+    cache.swap(next_cache);
+
+    if (best_score < 0.0f && ordered.size() < indices.size()) {
+      while (emitted[scan]) {
+        ++scan;
+      }
+      best = scan;
+    }
+  }
+  indices.swap(ordered);
+}
+
+void optimize_vertex_fetch(model& mesh) {
+  if (mesh.indices.empty()) {
+    return;
+  }
+  std::size_t components = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+  std::vector<GLuint> remap(mesh.vertex_num, GLuint(mesh.vertex_num));
+  std::vector<GLfloat> data{};
+  data.reserve(mesh.data.size());
+  GLuint next = 0;
+  for (GLuint& index : mesh.indices) {
+    if (remap[index] == mesh.vertex_num) {
+      remap[index] = next++;
+      data.insert(data.end(), mesh.data.begin() + std::ptrdiff_t(index * components), mesh.data.begin() + std::ptrdiff_t((index + 1) * components));
+    }
+    index = remap[index];
+  }
+  // unreferenced vertices are dropped
+  mesh.data.swap(data);
+  mesh.vertex_num = next;
+}
+
+float average_cache_miss_ratio(std::vector<GLuint> const& indices, std::size_t num_vertices, unsigned cache_size) {
+  if (indices.size() < 3) {
+    return 0.0f;
+  }
+  std::vector<bool> cached(num_vertices, false);
+  std::deque<GLuint> fifo{};
+  std::size_t misses = 0;
+  for (GLuint index : indices) {
+    if (cached[index]) {
+      continue;
+    }
+    ++misses;
+    cached[index] = true;
+    fifo.push_back(index);
+    if (fifo.size() > cache_size) {
+      cached[fifo.front()] = false;
+      fifo.pop_front();
+    }
+  }
+  return float(misses) / float(indices.size() / 3);
+}
+
+};
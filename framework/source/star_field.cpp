@@ -0,0 +1,204 @@
+#include "star_field.hpp"
+#include "jobs.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// stars per thread before generation is split across cores
+static const std::size_t PARALLEL_GRAIN = 1 << 14;
+
+///////////////////////////// philox ////////////////////////////////
+// round multipliers and key increments from the reference implementation
+static const std::uint32_t PHILOX_M0 = 0xD2511F53u;
+static const std::uint32_t PHILOX_M1 = 0xCD9E8D57u;
+static const std::uint32_t PHILOX_W0 = 0x9E3779B9u;
+static const std::uint32_t PHILOX_W1 = 0xBB67AE85u;
+
+philox4x32::philox4x32(std::uint64_t seed) {
+  key[0] = std::uint32_t(seed);
+  key[1] = std::uint32_t(seed >> 32);
+}
+
+void philox4x32::generate(std::uint32_t const counter[4], std::uint32_t result[4]) const {
+  std::uint32_t c0 = counter[0];
+  std::uint32_t c1 = counter[1];
+  std::uint32_t c2 = counter[2];
+  std::uint32_t c3 = counter[3];
+  std::uint32_t k0 = key[0];
+  std::uint32_t k1 = key[1];
+
+  for (unsigned round = 0; round < 10; ++round) {
+    std::uint64_t product0 = std::uint64_t(PHILOX_M0) * c0;
+    std::uint64_t product1 = std::uint64_t(PHILOX_M1) * c2;
+    std::uint32_t hi0 = std::uint32_t(product0 >> 32);
+    std::uint32_t lo0 = std::uint32_t(product0);
+    std::uint32_t hi1 = std::uint32_t(product1 >> 32);
+    std::uint32_t lo1 = std::uint32_t(product1);
+
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  result[0] = c0;
+  result[1] = c1;
+  result[2] = c2;
+  result[3] = c3;
+}
+
+float philox4x32::to_unit(std::uint32_t value) {
+  // use upper 24 bits, exactly representable as float
+  return float(value >> 8) * (1.0f / 16777216.0f);
+}
+
+namespace star_generator {
+
+// call fn(range, begin, end) for contiguous ranges of [0, count) as jobs,
+// the split only depends on the number of ranges
+template<typename F>
+void parallel_ranges(std::size_t count, unsigned ranges, F const& fn) {
+  std::size_t range = (count + ranges - 1) / ranges;
+  jobs::parallel_for(0, ranges, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t r = first; r < last; ++r) {
+      std::size_t begin = std::min(count, r * range);
+      fn(unsigned(r), begin, std::min(count, begin + range));
+    }
+  });
+}
+
+star_field generate(std::size_t num_stars, std::uint64_t seed, float extent, unsigned chunks_per_axis, unsigned threads) {
+  if (threads == 0) {
+    threads = jobs::concurrency();
+  }
+  threads = unsigned(std::max(std::size_t(1), std::min(std::size_t(threads), num_stars / PARALLEL_GRAIN)));
+
+  std::size_t num_chunks = std::size_t(chunks_per_axis) * chunks_per_axis * chunks_per_axis;
+  float cell_scale = float(chunks_per_axis) / (2.0f * extent);
+
+  philox4x32 rng{seed};
+
+  std::vector<glm::fvec3> positions(num_stars);
+  std::vector<glm::fvec3> colours(num_stars);
+  std::vector<float> brightness(num_stars);
+  std::vector<unsigned> cells(num_stars);
+  // star count per chunk for each thread range
+  std::vector<std::vector<unsigned>> histograms(threads, std::vector<unsigned>(num_chunks, 0));
+
+  // generate stars, star i only depends on seed and i
+  parallel_ranges(num_stars, threads, [&](unsigned t, std::size_t begin, std::size_t end) {
+    std::uint32_t counter[4] = {0, 0, 0, 0};
+    std::uint32_t random[4];
+    for (std::size_t i = begin; i < end; ++i) {
+      counter[0] = std::uint32_t(i);
+      counter[1] = std::uint32_t(std::uint64_t(i) >> 32);
+      // first block for position
+      counter[2] = 0;
+      rng.generate(counter, random);
+      glm::fvec3 position{philox4x32::to_unit(random[0]), philox4x32::to_unit(random[1]), philox4x32::to_unit(random[2])};
+      positions[i] = (position * 2.0f - 1.0f) * extent;
+      // second block for brightness and colour temperature
+      counter[2] = 1;
+      rng.generate(counter, random);
+      // most stars are faint, few are bright
+      float intensity = philox4x32::to_unit(random[0]);
+      brightness[i] = intensity * intensity * intensity;
+      glm::fvec3 tint = glm::mix(glm::fvec3{1.0f, 0.75f, 0.55f}, glm::fvec3{0.65f, 0.75f, 1.0f}, philox4x32::to_unit(random[1]));
+      colours[i] = tint * (0.2f + 0.8f * brightness[i]);
+
+      glm::uvec3 cell{glm::clamp((positions[i] + extent) * cell_scale, glm::fvec3{0.0f}, glm::fvec3{float(chunks_per_axis - 1)})};
+      cells[i] = cell.x + chunks_per_axis * (cell.y + chunks_per_axis * cell.z);
+      ++histograms[t][cells[i]];
+    }
+  });
+
+  // chunk offsets, each thread range scatters behind the ranges before it
+  std::vector<unsigned> chunk_first(num_chunks + 1, 0);
+  std::vector<std::vector<unsigned>> scatter_offsets(threads, std::vector<unsigned>(num_chunks, 0));
+  for (std::size_t c = 0; c < num_chunks; ++c) {
+    unsigned offset = chunk_first[c];
+    for (unsigned t = 0; t < threads; ++t) {
+      scatter_offsets[t][c] = offset;
+      offset += histograms[t][c];
+    }
+    chunk_first[c + 1] = offset;
+  }
+
+  // stable counting sort of star indices by chunk
+  std::vector<unsigned> order(num_stars);
+  parallel_ranges(num_stars, threads, [&](unsigned t, std::size_t begin, std::size_t end) {
+    std::vector<unsigned>& offsets = scatter_offsets[t];
+    for (std::size_t i = begin; i < end; ++i) {
+      order[offsets[cells[i]]++] = unsigned(i);
+    }
+  });
+
+  // sort chunks by brightness, ties stay in index order, and write interleaved vertices
+  std::vector<float> vertex_data(num_stars * 6);
+  std::vector<star_chunk> chunks(num_chunks);
+  // chunks differ in size, so idle threads steal single chunks
+  jobs::parallel_for(0, num_chunks, threads > 1 ? 1 : num_chunks, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t c = begin; c < end; ++c) {
+      auto chunk_begin = order.begin() + chunk_first[c];
+      auto chunk_end = order.begin() + chunk_first[c + 1];
+      std::stable_sort(chunk_begin, chunk_end, [&brightness](unsigned a, unsigned b) {
+        return brightness[a] > brightness[b];
+      });
+
+      star_chunk& chunk = chunks[c];
+      chunk.first = GLint(chunk_first[c]);
+      chunk.count = GLsizei(chunk_first[c + 1] - chunk_first[c]);
+      chunk.min = glm::fvec3{extent};
+      chunk.max = glm::fvec3{-extent};
+      for (unsigned i = chunk_first[c]; i < chunk_first[c + 1]; ++i) {
+        glm::fvec3 const& position = positions[order[i]];
+        glm::fvec3 const& colour = colours[order[i]];
+        chunk.min = glm::min(chunk.min, position);
+        chunk.max = glm::max(chunk.max, position);
+        float* vertex = &vertex_data[std::size_t(i) * 6];
+        vertex[0] = position.x;
+        vertex[1] = position.y;
+        vertex[2] = position.z;
+        vertex[3] = colour.r;
+        vertex[4] = colour.g;
+        vertex[5] = colour.b;
+      }
+    }
+  });
+
+  star_field field{};
+  field.vertices = model{vertex_data, model::POSITION | model::NORMAL};
+  // empty chunks are never drawn
+  for (auto const& chunk : chunks) {
+    if (chunk.count > 0) {
+      field.chunks.push_back(chunk);
+      field.bounds.add(chunk.min, chunk.max);
+    }
+  }
+  return field;
+}
+
+GLsizei lod_count(star_chunk const& chunk, glm::fmat4 const& view, glm::fmat4 const& projection, float viewport_height, float stars_per_pixel) {
+  glm::fvec3 center{(chunk.min + chunk.max) * 0.5f};
+  float radius = glm::length(chunk.max - chunk.min) * 0.5f;
+  float distance = glm::length(glm::fvec3{view * glm::fvec4{center, 1.0f}});
+  // camera inside chunk, draw everything
+  if (distance <= radius) {
+    return chunk.count;
+  }
+  // projected radius in pixels, clamped to the screen
+  float aspect = projection[1][1] / projection[0][0];
+  float screen_area = viewport_height * viewport_height * aspect;
+  float pixel_radius = radius / std::sqrt(distance * distance - radius * radius) * projection[1][1] * viewport_height * 0.5f;
+  float area = std::min(3.14159265f * pixel_radius * pixel_radius, screen_area);
+
+  GLsizei count = GLsizei(std::ceil(area * stars_per_pixel));
+  return std::max(GLsizei(1), std::min(chunk.count, count));
+}
+
+};
@@ -0,0 +1,346 @@
+#include "transform.hpp"
+#include "jobs.hpp"
+#include "simd_lanes.hpp"
+
+#include <glm/geometric.hpp>
+
+// transforms per job, a multiple of every lane width
+static const std::size_t PARALLEL_GRAIN = 1 << 13;
+// below this count, handing out jobs costs more than it saves
+static const std::size_t PARALLEL_THRESHOLD = 1 << 15;
+
+transform_state::transform_state()
+ :translation{0.0f}
+ ,rotation{}
+ ,scale{1.0f}
+{}
+
+transform_state::transform_state(glm::fmat4 const& matrix)
+ :translation{matrix[3]}
+ ,rotation{}
+ ,scale{glm::length(glm::fvec3{matrix[0]}), glm::length(glm::fvec3{matrix[1]}), glm::length(glm::fvec3{matrix[2]})}
+{
+  glm::fmat3 rotation_matrix{glm::fvec3{matrix[0]} / scale.x,
+                             glm::fvec3{matrix[1]} / scale.y,
+                             glm::fvec3{matrix[2]} / scale.z};
+  rotation = glm::quat_cast(rotation_matrix);
+}
+
+transform_state::transform_state(glm::fvec3 const& t, glm::fquat const& r, glm::fvec3 const& s)
+ :translation{t}
+ ,rotation{r}
+ ,scale{s}
+{}
+
+glm::fmat4 transform_state::matrix() const {
+  glm::fmat3 rotation_matrix = glm::mat3_cast(rotation);
+  glm::fmat4 result{};
+  result[0] = glm::fvec4{rotation_matrix[0] * scale.x, 0.0f};
+  result[1] = glm::fvec4{rotation_matrix[1] * scale.y, 0.0f};
+  result[2] = glm::fvec4{rotation_matrix[2] * scale.z, 0.0f};
+  result[3] = glm::fvec4{translation, 1.0f};
+  return result;
+}
+
+transform_state interpolate(transform_state const& a, transform_state const& b, float alpha) {
+  transform_state result{};
+  result.translation = glm::mix(a.translation, b.translation, alpha);
+  result.rotation = glm::slerp(a.rotation, b.rotation, alpha);
+  result.scale = glm::mix(a.scale, b.scale, alpha);
+  return result;
+}
+
+///////////////////////////// transform set ////////////////////////////////
+std::size_t transform_set::add(transform_state const& state) {
+  translation_x.push_back(state.translation.x);
+  translation_y.push_back(state.translation.y);
+  translation_z.push_back(state.translation.z);
+  rotation_x.push_back(state.rotation.x);
+  rotation_y.push_back(state.rotation.y);
+  rotation_z.push_back(state.rotation.z);
+  rotation_w.push_back(state.rotation.w);
+  scale_x.push_back(state.scale.x);
+  scale_y.push_back(state.scale.y);
+  scale_z.push_back(state.scale.z);
+  return scale_x.size() - 1;
+}
+
+void transform_set::set(std::size_t i, transform_state const& state) {
+  translation_x[i] = state.translation.x;
+  translation_y[i] = state.translation.y;
+  translation_z[i] = state.translation.z;
+  rotation_x[i] = state.rotation.x;
+  rotation_y[i] = state.rotation.y;
+  rotation_z[i] = state.rotation.z;
+  rotation_w[i] = state.rotation.w;
+  scale_x[i] = state.scale.x;
+  scale_y[i] = state.scale.y;
+  scale_z[i] = state.scale.z;
+}
+
+void transform_set::clear() {
+  translation_x.clear();
+  translation_y.clear();
+  translation_z.clear();
+  rotation_x.clear();
+  rotation_y.clear();
+  rotation_z.clear();
+  rotation_w.clear();
+  scale_x.clear();
+  scale_y.clear();
+  scale_z.clear();
+}
+
+std::size_t transform_set::size() const {
+  return scale_x.size();
+}
+
+///////////////////////////// lanes ////////////////////////////////
+// the kernels below are written once for a lane type holding one float per
+// object; matrices are arrays of lanes indexed [column][row] like glm, affine
+// ones omit the constant last row. the lane types add moving whole matrices
+
+// one object at a time for the remainder
+struct scalar_lanes : simd::scalar {
+  static void load_affine(glm::fmat4 const* m, type out[4][3]) {
+    for (unsigned c = 0; c < 4; ++c) {
+      for (unsigned r = 0; r < 3; ++r) {
+        out[c][r] = (*m)[c][r];
+      }
+    }
+  }
+  static void store(type const in[4][4], glm::fmat4* m) {
+    for (unsigned c = 0; c < 4; ++c) {
+      (*m)[c] = glm::fvec4{in[c][0], in[c][1], in[c][2], in[c][3]};
+    }
+  }
+};
+
+#ifdef SIMD_LANES_SSE
+struct sse_lanes : simd::sse {
+  // columns of four matrices transposed into rows of four objects
+  static void load_affine(glm::fmat4 const* m, type out[4][3]) {
+    for (unsigned c = 0; c < 4; ++c) {
+      __m128 r0 = _mm_loadu_ps(&m[0][c][0]);
+      __m128 r1 = _mm_loadu_ps(&m[1][c][0]);
+      __m128 r2 = _mm_loadu_ps(&m[2][c][0]);
+      __m128 r3 = _mm_loadu_ps(&m[3][c][0]);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      out[c][0] = type{r0};
+      out[c][1] = type{r1};
+      out[c][2] = type{r2};
+    }
+  }
+  static void store(type const in[4][4], glm::fmat4* m) {
+    for (unsigned c = 0; c < 4; ++c) {
+      __m128 r0 = in[c][0].v, r1 = in[c][1].v, r2 = in[c][2].v, r3 = in[c][3].v;
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&m[0][c][0], r0);
+      _mm_storeu_ps(&m[1][c][0], r1);
+      _mm_storeu_ps(&m[2][c][0], r2);
+      _mm_storeu_ps(&m[3][c][0], r3);
+    }
+  }
+};
+#endif
+
+#ifdef SIMD_LANES_AVX
+// matrices are moved as two halves of four, avx has no cheaper 8x4 transpose
+struct avx_lanes : simd::avx {
+  static void load_affine(glm::fmat4 const* m, type out[4][3]) {
+    simd::sse_float low[4][3];
+    simd::sse_float high[4][3];
+    sse_lanes::load_affine(m, low);
+    sse_lanes::load_affine(m + 4, high);
+    for (unsigned c = 0; c < 4; ++c) {
+      for (unsigned r = 0; r < 3; ++r) {
+        out[c][r] = type{_mm256_insertf128_ps(_mm256_castps128_ps256(low[c][r].v), high[c][r].v, 1)};
+      }
+    }
+  }
+  static void store(type const in[4][4], glm::fmat4* m) {
+    simd::sse_float low[4][4];
+    simd::sse_float high[4][4];
+    for (unsigned c = 0; c < 4; ++c) {
+      for (unsigned r = 0; r < 4; ++r) {
+        low[c][r] = simd::sse_float{_mm256_castps256_ps128(in[c][r].v)};
+        high[c][r] = simd::sse_float{_mm256_extractf128_ps(in[c][r].v, 1)};
+      }
+    }
+    sse_lanes::store(low, m);
+    sse_lanes::store(high, m + 4);
+  }
+};
+#endif
+
+///////////////////////////// kernels ////////////////////////////////
+// affine a * b with a the same for all lanes
+template<typename L>
+static inline void multiply(glm::fmat4 const& a, typename L::type const b[4][3], typename L::type out[4][3]) {
+  typedef typename L::type T;
+  T m[4][3];
+  for (unsigned c = 0; c < 4; ++c) {
+    for (unsigned r = 0; r < 3; ++r) {
+      m[c][r] = L::set1(a[c][r]);
+    }
+  }
+  for (unsigned c = 0; c < 4; ++c) {
+    for (unsigned r = 0; r < 3; ++r) {
+      out[c][r] = m[0][r] * b[c][0] + m[1][r] * b[c][1] + m[2][r] * b[c][2];
+    }
+  }
+  for (unsigned r = 0; r < 3; ++r) {
+    out[3][r] = out[3][r] + m[3][r];
+  }
+}
+
+// inverse transpose of an affine matrix: the 3x3 part inverted through cross products of
+// its columns, the translation moves to the last row as -(inverse * translation)
+template<typename L>
+static inline void inverse_transpose(typename L::type const m[4][3], typename L::type out[4][4]) {
+  typedef typename L::type T;
+  T const* a = m[0];
+  T const* b = m[1];
+  T const* c = m[2];
+  T cross_bc[3] = {b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0]};
+  T cross_ca[3] = {c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0]};
+  T cross_ab[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+  T inv_det = L::set1(1.0f) / (a[0] * cross_bc[0] + a[1] * cross_bc[1] + a[2] * cross_bc[2]);
+  T zero = L::set1(0.0f);
+  for (unsigned r = 0; r < 3; ++r) {
+    out[0][r] = cross_bc[r] * inv_det;
+    out[1][r] = cross_ca[r] * inv_det;
+    out[2][r] = cross_ab[r] * inv_det;
+    out[3][r] = zero;
+  }
+  for (unsigned col = 0; col < 3; ++col) {
+    out[col][3] = zero - (out[col][0] * m[3][0] + out[col][1] * m[3][1] + out[col][2] * m[3][2]);
+  }
+  out[3][3] = L::set1(1.0f);
+}
+
+// affine matrix with its constant last row
+template<typename L>
+static inline void expand(typename L::type const m[4][3], typename L::type out[4][4]) {
+  for (unsigned c = 0; c < 4; ++c) {
+    for (unsigned r = 0; r < 3; ++r) {
+      out[c][r] = m[c][r];
+    }
+    out[c][3] = L::set1(c == 3 ? 1.0f : 0.0f);
+  }
+}
+
+// compose transforms from i until fewer than a lane width are left, returns first one not done
+template<typename L>
+static std::size_t compose_lanes(transform_set const& s, glm::fmat4 const& parent, glm::fmat4 const& view, std::size_t i, std::size_t end,
+                                 glm::fmat4* worlds, glm::fmat4* model_views, glm::fmat4* normals) {
+  typedef typename L::type T;
+  T one = L::set1(1.0f);
+  T two = L::set1(2.0f);
+  for (; i + L::width <= end; i += L::width) {
+    T qx = L::load(&s.rotation_x[i]), qy = L::load(&s.rotation_y[i]), qz = L::load(&s.rotation_z[i]), qw = L::load(&s.rotation_w[i]);
+    T sx = L::load(&s.scale_x[i]), sy = L::load(&s.scale_y[i]), sz = L::load(&s.scale_z[i]);
+    T xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    T xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    T wx = qw * qx, wy = qw * qy, wz = qw * qz;
+    // translation * rotation * scale as in scene_graph
+    T local[4][3] = {{(one - two * (yy + zz)) * sx, two * (xy + wz) * sx, two * (xz - wy) * sx},
+                     {two * (xy - wz) * sy, (one - two * (xx + zz)) * sy, two * (yz + wx) * sy},
+                     {two * (xz + wy) * sz, two * (yz - wx) * sz, (one - two * (xx + yy)) * sz},
+                     {L::load(&s.translation_x[i]), L::load(&s.translation_y[i]), L::load(&s.translation_z[i])}};
+    T world[4][3];
+    T model_view[4][3];
+    T full[4][4];
+    multiply<L>(parent, local, world);
+    multiply<L>(view, world, model_view);
+    expand<L>(world, full);
+    L::store(full, worlds + i);
+    expand<L>(model_view, full);
+    L::store(full, model_views + i);
+    inverse_transpose<L>(model_view, full);
+    L::store(full, normals + i);
+  }
+  return i;
+}
+
+template<typename L>
+static std::size_t view_lanes(glm::fmat4 const& view, glm::fmat4 const* worlds, std::size_t i, std::size_t end,
+                              glm::fmat4* model_views, glm::fmat4* normals) {
+  typedef typename L::type T;
+  for (; i + L::width <= end; i += L::width) {
+    T world[4][3];
+    T model_view[4][3];
+    T full[4][4];
+    L::load_affine(worlds + i, world);
+    multiply<L>(view, world, model_view);
+    if (model_views) {
+      expand<L>(model_view, full);
+      L::store(full, model_views + i);
+    }
+    inverse_transpose<L>(model_view, full);
+    L::store(full, normals + i);
+  }
+  return i;
+}
+
+// widest instruction set first, scalar code finishes the range
+static void compose_range(transform_set const& s, glm::fmat4 const& parent, glm::fmat4 const& view, std::size_t begin, std::size_t end,
+                          glm::fmat4* worlds, glm::fmat4* model_views, glm::fmat4* normals) {
+  std::size_t i = begin;
+#ifdef SIMD_LANES_AVX
+  i = compose_lanes<avx_lanes>(s, parent, view, i, end, worlds, model_views, normals);
+#endif
+#ifdef SIMD_LANES_SSE
+  i = compose_lanes<sse_lanes>(s, parent, view, i, end, worlds, model_views, normals);
+#endif
+  compose_lanes<scalar_lanes>(s, parent, view, i, end, worlds, model_views, normals);
+}
+
+static void view_range(glm::fmat4 const& view, glm::fmat4 const* worlds, std::size_t begin, std::size_t end,
+                       glm::fmat4* model_views, glm::fmat4* normals) {
+  std::size_t i = begin;
+#ifdef SIMD_LANES_AVX
+  i = view_lanes<avx_lanes>(view, worlds, i, end, model_views, normals);
+#endif
+#ifdef SIMD_LANES_SSE
+  i = view_lanes<sse_lanes>(view, worlds, i, end, model_views, normals);
+#endif
+  view_lanes<scalar_lanes>(view, worlds, i, end, model_views, normals);
+}
+
+namespace transforms {
+
+// split [0, count) into ranges of whole lanes for the job threads or run fn on all of it
+template<typename F>
+static void split(std::size_t count, F const& fn) {
+  if (count < PARALLEL_THRESHOLD || jobs::concurrency() < 2) {
+    fn(0, count);
+    return;
+  }
+  jobs::parallel_for(0, count, PARALLEL_GRAIN, fn);
+}
+
+void compose(transform_set const& locals, glm::fmat4 const& parent, glm::fmat4 const& view,
+             std::vector<glm::fmat4>& worlds, std::vector<glm::fmat4>& model_views, std::vector<glm::fmat4>& normals) {
+  std::size_t count = locals.size();
+  worlds.resize(count);
+  model_views.resize(count);
+  normals.resize(count);
+  split(count, [&](std::size_t first, std::size_t last) {
+    compose_range(locals, parent, view, first, last, worlds.data(), model_views.data(), normals.data());
+  });
+}
+
+void view_matrices(glm::fmat4 const& view, glm::fmat4 const* worlds, std::size_t count, glm::fmat4* model_views, glm::fmat4* normals) {
+  split(count, [&](std::size_t first, std::size_t last) {
+    view_range(view, worlds, first, last, model_views, normals);
+  });
+}
+
+glm::fmat4 normal_matrix(glm::fmat4 const& model_view) {
+  glm::fmat4 result{};
+  view_range(glm::fmat4{}, &model_view, 0, 1, nullptr, &result);
+  return result;
+}
+
+};
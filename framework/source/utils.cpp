@@ -6,6 +6,8 @@
 // use gl definitions from glbinding 
 using namespace gl;
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -102,16 +104,14 @@ void output_log(GLchar const* log_buffer, std::string const& prefix) {
 }
 
 std::string read_file(std::string const& name) {
-  std::ifstream ifile(name);
+  std::ifstream ifile(name, std::ios::binary);
 
   if(ifile) {
-    std::string filetext;
-    
-    while(ifile.good()) {
-      std::string line;
-      std::getline(ifile, line);
-      filetext.append(line + "\n");
-    }
+    // read whole file at once instead of line by line
+    ifile.seekg(0, std::ios::end);
+    std::string filetext(static_cast<std::size_t>(ifile.tellg()), '\0');
+    ifile.seekg(0, std::ios::beg);
+    ifile.read(&filetext[0], std::streamsize(filetext.size()));
     
     return filetext; 
   }
@@ -122,4 +122,20 @@ std::string read_file(std::string const& name) {
   }
 }
 
+double percentile(std::vector<double> const& sorted, double p) {
+  std::size_t rank = std::size_t(std::ceil(p * double(sorted.size())));
+  return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+std::string json_quoted(std::string const& text) {
+  std::string result{"\""};
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
 };
@@ -0,0 +1,7 @@
+// replays a gl call trace written with --capture and reports its frame times
+// and the time spent in each gl function
+#include "launcher.hpp"
+
+int main(int argc, char* argv[]) {
+  Launcher::replay(argc, argv);
+}
@@ -0,0 +1,23 @@
+#version 150
+
+//one direction of a separable 9 tap gaussian, the taps between texels use
+//bilinear filtering so 5 samples are enough
+in vec2 pass_TexCoord;
+
+uniform sampler2D ColourTex;
+//texel offset along the blur direction in texture coordinates
+uniform vec2 Direction;
+
+out vec4 out_Color;
+
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main() {
+    vec3 colour = texture(ColourTex, pass_TexCoord).rgb * weights[0];
+    for (int i = 1; i < 3; ++i) {
+        colour += texture(ColourTex, pass_TexCoord + Direction * offsets[i]).rgb * weights[i];
+        colour += texture(ColourTex, pass_TexCoord - Direction * offsets[i]).rgb * weights[i];
+    }
+    out_Color = vec4(colour, 1.0);
+}
@@ -0,0 +1,19 @@
+//normal mapping shared by the forward and geometry pass shaders
+uniform sampler2D NormalMapIndex;
+
+vec3 bumpMappedNormal(vec3 normal, vec3 tangent, vec2 texcoord) {
+    vec3 bumpyNormal = vec3(texture(NormalMapIndex, texcoord));
+    //black texels have no direction, normalizing them gives nan
+    if (dot(bumpyNormal, bumpyNormal) == 0.0) {
+        return normal;
+    }
+    bumpyNormal = normalize(bumpyNormal);
+    //translate to tangent space by scaling
+    bumpyNormal = vec3((bumpyNormal.x - 0.5) * 2.0, (bumpyNormal.y - 0.5) * 2.0, bumpyNormal.z);
+
+    tangent = normalize(tangent);
+    //calculate bitangent using cross product of N and T
+    vec3 bitangent = cross(normal, tangent);
+    mat3 tangentMatrix = transpose(mat3(tangent, bitangent, normal));
+    return normalize(tangentMatrix * bumpyNormal);
+}
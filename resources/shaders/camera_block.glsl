@@ -0,0 +1,5 @@
+//camera matrices shared by all programs, uniform buffer is bound to binding point 4
+layout (std140) uniform CameraBlock {
+    mat4 ViewMatrix;
+    mat4 ProjectionMatrix;
+};
@@ -0,0 +1,39 @@
+//point lights binned into clusters of screen tiles and depth slices on the cpu
+//two texels per light: view space position and radius, then colour
+uniform samplerBuffer LightData;
+//first index and count of each cluster's lights, followed by the light indices
+uniform usamplerBuffer ClusterLights;
+//tiles in x and y, depth slices
+uniform ivec3 ClusterGrid;
+//tiles per pixel
+uniform vec2 TileScale;
+//slice of a view depth is log(depth) * x + y
+uniform vec2 SliceMapping;
+
+//blinn-phong lighting by the lights of this fragment's cluster only
+vec3 clusteredLighting(vec3 position, vec3 normal, vec3 viewDir, vec3 baseColor, float diffuseK, float specularK, float glossiness) {
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * TileScale), ClusterGrid.xy - 1);
+    int slice = clamp(int(log(-position.z) * SliceMapping.x + SliceMapping.y), 0, ClusterGrid.z - 1);
+    int cluster = tile.x + ClusterGrid.x * (tile.y + ClusterGrid.y * slice);
+    int first = int(texelFetch(ClusterLights, 2 * cluster).r);
+    int count = int(texelFetch(ClusterLights, 2 * cluster + 1).r);
+    
+    vec3 lit = vec3(0.0);
+    for (int i = first; i < first + count; ++i) {
+        int light = 2 * int(texelFetch(ClusterLights, i).r);
+        vec4 positionRadius = texelFetch(LightData, light);
+        vec3 lightColour = texelFetch(LightData, light + 1).rgb;
+        
+        vec3 toLight = positionRadius.xyz - position;
+        float distance = length(toLight);
+        //smooth falloff reaching zero at the radius
+        float falloff = clamp(1.0 - (distance * distance) / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        falloff *= falloff;
+        
+        vec3 pointDir = toLight / max(distance, 0.0001);
+        float pointLambertian = max(dot(pointDir, normal), 0.0);
+        float pointSpecular = pow(max(dot(normalize(viewDir + pointDir), normal), 0.0), glossiness);
+        lit += falloff * lightColour * (pointLambertian * diffuseK * baseColor + specularK * pointSpecular);
+    }
+    return lit;
+}
@@ -0,0 +1,80 @@
+#version 150
+
+//features are compiled in per permutation
+#ifndef CEL_SHADING
+#define CEL_SHADING 0
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 0
+#endif
+
+#include "octahedral.glsl"
+#if POINT_LIGHTS
+#include "clustered_lights.glsl"
+#endif
+
+//lighting pass of deferred shading, reads the geometry buffer once per pixel
+//and shades it like the forward planet shader
+uniform sampler2D GAlbedo;
+uniform sampler2D GNormal;
+uniform sampler2D GDepth;
+//view space positions from window coordinates and depth
+uniform mat4 InverseProjection;
+uniform vec2 ViewportSize;
+//view space position of the sun
+uniform vec3 SunPosition;
+
+out vec4 out_Color;
+
+float ambientK = 0.3;
+float diffuseK = 0.8;
+float specularK = 0.2;
+float glossiness = 3.0;
+vec3 specularColour = vec3(1.0, 1.0, 1.0);
+vec3 outlineColour = vec3(0.850, 0.968, 0.956);
+
+void main() {
+    
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(GDepth, texel, 0).r;
+    //nothing was drawn here
+    if (depth == 1.0) {
+        discard;
+    }
+    
+    vec4 albedo = texelFetch(GAlbedo, texel, 0);
+    vec4 packedNormal = texelFetch(GNormal, texel, 0);
+    vec3 normal = decodeOctahedral(vec2(unpackUnorm16(packedNormal.xy), unpackUnorm16(packedNormal.zw)));
+    
+    vec4 ndc = vec4(gl_FragCoord.xy / ViewportSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 view = InverseProjection * ndc;
+    vec3 position = view.xyz / view.w;
+    
+    //the sun is lit from the camera
+    vec3 lightPosition = albedo.a > 0.5 ? vec3(0.0) : SunPosition;
+    vec3 lightDir = normalize(lightPosition - position);
+    vec3 viewDir = normalize(-position);
+    vec3 baseColor = albedo.rgb;
+    
+    vec3 ambient = ambientK * baseColor;
+    float lambertian = max(dot(lightDir, normal), 0.0);
+    vec3 diffuse = lambertian * baseColor * diffuseK;
+    vec3 halfwayVector = normalize(viewDir + lightDir);
+    float specularIntensity = pow(max(dot(halfwayVector, normal), 0.0), glossiness);
+    vec3 specular = specularK * specularColour * specularIntensity;
+    
+    out_Color = vec4(ambient + diffuse + specular, 1.0);
+    
+#if POINT_LIGHTS
+    out_Color.rgb += clusteredLighting(position, normal, viewDir, baseColor, diffuseK, specularK, glossiness);
+#endif
+    
+#if CEL_SHADING
+    if (dot(normal, viewDir) < 0.3) {
+        out_Color = vec4(outlineColour, 1.0);
+    }
+    else {
+        out_Color = ceil(out_Color * 4) / 4;
+    }
+#endif
+}
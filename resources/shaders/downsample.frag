@@ -0,0 +1,33 @@
+#version 150
+
+//halves resolution with a 4 tap box filter, each tap averages 2x2 texels
+//through bilinear filtering; the bright pass keeps only glowing parts for bloom
+#ifndef BRIGHT_PASS
+#define BRIGHT_PASS 0
+#endif
+
+in vec2 pass_TexCoord;
+
+uniform sampler2D ColourTex;
+//size of one source texel in texture coordinates
+uniform vec2 TexelSize;
+
+out vec4 out_Color;
+
+//luminance above which colours start to bloom
+const float threshold = 0.75;
+
+void main() {
+    vec3 colour = texture(ColourTex, pass_TexCoord + TexelSize * vec2(-1.0, -1.0)).rgb;
+    colour += texture(ColourTex, pass_TexCoord + TexelSize * vec2( 1.0, -1.0)).rgb;
+    colour += texture(ColourTex, pass_TexCoord + TexelSize * vec2(-1.0,  1.0)).rgb;
+    colour += texture(ColourTex, pass_TexCoord + TexelSize * vec2( 1.0,  1.0)).rgb;
+    colour *= 0.25;
+
+#if BRIGHT_PASS
+    float luminance = dot(colour, vec3(0.2126, 0.7152, 0.0722));
+    colour *= max(luminance - threshold, 0.0) / max(luminance, 0.0001);
+#endif
+
+    out_Color = vec4(colour, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 150
+
+//fullscreen triangle generated from the vertex id, drawn without attributes
+out vec2 pass_TexCoord;
+
+void main(void)
+{
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    pass_TexCoord = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 150
+#extension GL_ARB_explicit_attrib_location : require
+
+//features are compiled in per permutation
+#ifndef BUMP_MAP
+#define BUMP_MAP 0
+#endif
+
+#include "octahedral.glsl"
+#if BUMP_MAP
+#include "bump_map.glsl"
+#endif
+
+//geometry pass of deferred shading, surfaces are lit later by deferred.frag
+in vec3 pass_Normal;
+in vec2 pass_Texcoord;
+in vec3 pass_Tangent;
+
+uniform sampler2D ColourTex;
+//0 for bodies lit by the sun, 1 for the sun itself, lit from the camera
+uniform float Material;
+
+//albedo and material
+layout(location = 0) out vec4 out_Albedo;
+//view space normal, both octahedral coordinates as 16 bits
+layout(location = 1) out vec4 out_Normal;
+
+void main() {
+    
+    vec3 normal = normalize(pass_Normal);
+    
+#if BUMP_MAP
+    //same tangent space mapping as the forward shader
+    normal = bumpMappedNormal(normal, pass_Tangent, pass_Texcoord);
+#endif
+    
+    out_Albedo = vec4(texture(ColourTex, pass_Texcoord).rgb, Material);
+    vec2 encoded = encodeOctahedral(normal);
+    out_Normal = vec4(packUnorm16(encoded.x), packUnorm16(encoded.y));
+}
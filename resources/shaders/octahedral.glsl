@@ -0,0 +1,31 @@
+//unit vectors folded onto an octahedron and its lower half unfolded over the
+//corners, giving two coordinates in [0, 1] (Cigolle et al. 2014)
+vec2 octahedralWrap(vec2 v) {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeOctahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.z >= 0.0 ? n.xy : octahedralWrap(n.xy);
+    return folded * 0.5 + 0.5;
+}
+
+vec3 decodeOctahedral(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = octahedralWrap(n.xy);
+    }
+    return normalize(n);
+}
+
+//16 bit value in [0, 1] split into high and low byte of two rgba8 channels
+vec2 packUnorm16(float v) {
+    float bits = floor(clamp(v, 0.0, 1.0) * 65535.0 + 0.5);
+    float high = floor(bits / 256.0);
+    return vec2(high, bits - high * 256.0) / 255.0;
+}
+
+float unpackUnorm16(vec2 bytes) {
+    return dot(floor(bytes * 255.0 + 0.5), vec2(256.0, 1.0)) / 65535.0;
+}
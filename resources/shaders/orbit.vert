@@ -3,19 +3,22 @@
 // vertex attributes of VAO
 layout(location = 0) in vec3 in_Position;
 
-layout (std140) uniform CameraBlock {
-    mat4 ViewMatrix;
-    mat4 ProjectionMatrix;
-};
+#include "camera_block.glsl"
 
-//Matrix Uniforms as specified with glUniformMatrix4fv
-uniform mat4 ModelMatrix;
-//uniform mat4 ViewMatrix;
-//uniform mat4 ProjectionMatrix;
+//one orbit transform per instance, mapping the shared unit circle onto the orbit
+//stored as 4 consecutive rgba32f texels
+uniform samplerBuffer InstanceTransforms;
+//first transform of this draw call in the buffer
+uniform int InstanceOffset;
 
 
 void main(void)
 {
+    int base = (InstanceOffset + gl_InstanceID) * 4;
+    mat4 ModelMatrix = mat4(texelFetch(InstanceTransforms, base),
+                            texelFetch(InstanceTransforms, base + 1),
+                            texelFetch(InstanceTransforms, base + 2),
+                            texelFetch(InstanceTransforms, base + 3));
 
 	gl_Position = (ProjectionMatrix  * ViewMatrix * ModelMatrix) * vec4(in_Position, 1.0);
 
@@ -8,15 +8,24 @@ in vec4 gl_FragCoord;
 
 //assigbnment 5
 uniform sampler2D TexID;
-uniform int PP_FLAG;
+//blurred bright parts at lower resolution
+uniform sampler2D BloomTex;
 
 out vec4 out_Color;
 
-//define binary flags
-#define GREYSCALE 1
-#define H_MIRRORED 2
-#define V_MIRRORED 4
-#define BLUR 8
+//effects are compiled in per permutation instead of checking flag bits
+#ifndef GREYSCALE
+#define GREYSCALE 0
+#endif
+#ifndef H_MIRRORED
+#define H_MIRRORED 0
+#endif
+#ifndef V_MIRRORED
+#define V_MIRRORED 0
+#endif
+#ifndef BLOOM
+#define BLOOM 0
+#endif
 
 void main() {
     
@@ -27,60 +36,42 @@ void main() {
 //        out_Color = vec4(0.0, 0.0, 0.0, 1.0);
     
     
-    vec2 newCoord = vec2(pass_TexCoord.x / 4.0, pass_TexCoord.y / 4.0);
+    vec2 newCoord = pass_TexCoord;
     
     //horizontal mirroring
-    if ( (PP_FLAG & H_MIRRORED ) == H_MIRRORED ) {
-        //flip texture y(v) co-ordinate to horizontally mirror
-        newCoord = vec2(newCoord.x, 1.0 - newCoord.y);
-    }
+#if H_MIRRORED
+    //flip texture y(v) co-ordinate to horizontally mirror
+    newCoord = vec2(newCoord.x, 1.0 - newCoord.y);
+#endif
     
     //vertical mirroring
-    if ( (PP_FLAG & V_MIRRORED ) == V_MIRRORED ) {
-        //flip texture x(u) co-ordinate to vertically mirror
-        newCoord = vec2(1.0 - newCoord.x, newCoord.y);
-    }
+#if V_MIRRORED
+    //flip texture x(u) co-ordinate to vertically mirror
+    newCoord = vec2(1.0 - newCoord.x, newCoord.y);
+#endif
     
     
     out_Color = texture(TexID, newCoord);
     
     
     
-    //blurring
-    if ( (PP_FLAG & BLUR ) == BLUR ) {
-        
-        //calc pixel size as a vec2 (x and y)
-        vec2 pixelSize = newCoord / vec2(gl_FragCoord);
-        
-        //sample colour with predefined and adjusted co-ordinates for 9 pixel kernel
-        vec3 sumColour = vec3(out_Color) * 0.25;//centre
-        
-        //min(newCoord.y - pixelSize.y, 0.0)
-        
-        sumColour += 0.125 * vec3(texture(TexID, vec2(max(newCoord.x - pixelSize.x, 0.0), newCoord.y)));//left
-        sumColour += 0.125 * vec3(texture(TexID, vec2(min(newCoord.x + pixelSize.x, 1.0), newCoord.y)));//right
-        sumColour += 0.125 * vec3(texture(TexID, vec2(newCoord.x, min(newCoord.y + pixelSize.y, 1.0))));//top
-        sumColour += 0.125 * vec3(texture(TexID, vec2(newCoord.x, max(newCoord.y - pixelSize.y, 0.0))));//bottom
-        
-        
-        sumColour += 0.0625 * vec3(texture(TexID, vec2(max(newCoord.x - pixelSize.x, 0.0), min(newCoord.y + pixelSize.y, 1.0))));//left top
-        sumColour += 0.0625 * vec3(texture(TexID, vec2(max(newCoord.x - pixelSize.x, 0.0), max(newCoord.y - pixelSize.y, 0.0))));//left bottom
-        sumColour += 0.0625 * vec3(texture(TexID, vec2(min(newCoord.x + pixelSize.x, 1.0), min(newCoord.y + pixelSize.y, 1.0))));//right top
-        sumColour += 0.0625 * vec3(texture(TexID, vec2(min(newCoord.x + pixelSize.x, 1.0), max(newCoord.y - pixelSize.y, 0.0))));//right bottom
-        
-        
-        //sum together and output
-        out_Color = vec4(sumColour, 1.0);
-        
-    }
+    //blurring is done by earlier passes at lower resolution
+    
+    //bloom
+#if BLOOM
+    //add glow of bright parts, upsampled by bilinear filtering
+    out_Color = vec4(vec3(out_Color) + texture(BloomTex, newCoord).rgb * 1.5, 1.0);
+#endif
     
     //greyscale
-    if ( (PP_FLAG & GREYSCALE ) == GREYSCALE ) {
+#if GREYSCALE
+    {
         //calculate luminescance preserving grey value and assign to output
         vec3 greyVec = vec3(0.2126, 0.7152, 0.0722) * vec3(out_Color);
         float grey = dot(greyVec, vec3(1.0, 1.0, 1.0));
         out_Color = vec4(grey, grey, grey, 1.0);
     }
+#endif
     
     
 
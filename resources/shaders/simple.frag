@@ -1,5 +1,16 @@
 #version 150
 
+//features are compiled in per permutation
+#ifndef BUMP_MAP
+#define BUMP_MAP 0
+#endif
+#ifndef CEL_SHADING
+#define CEL_SHADING 0
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 0
+#endif
+
 //with additions from https://en.wikipedia.org/wiki/Blinn%E2%80%93Phong_shading_model
 
 
@@ -9,15 +20,19 @@ in vec3 pass_Normal;
 in vec3 pass_VertexViewPosition;
 in vec3 pass_LightSourceViewPosition;
 in vec3 pass_diffuseColour;
-in float pass_ShaderMode;
 in vec2 pass_Texcoord;
 in vec3 pass_Tangent;
 
 //assignment 4
 uniform sampler2D ColourTex;
 //assignment 4 extn
-uniform sampler2D NormalMapIndex;
-uniform bool UseBumpMap;
+#if BUMP_MAP
+#include "bump_map.glsl"
+#endif
+
+#if POINT_LIGHTS
+#include "clustered_lights.glsl"
+#endif
 
 out vec4 out_Color;
 
@@ -33,13 +48,7 @@ void main() {
     
     
     
-    //adjust co-ordinates to better fit over planets
-    //something weird going on with texture mapping...
-    float y = (pass_Texcoord.y + 1.0) * 0.5;
-    float x = (pass_Texcoord.x + 1.0) * 0.25;
-    vec2 newCoord = vec2(x, y);
-//
-    vec4 colour = texture(ColourTex, newCoord);
+    vec4 colour = texture(ColourTex, pass_Texcoord);
     //vec3 baseColour = pass_diffuseColour;
     
     //assignment4 extn--------------------------------------------------
@@ -49,23 +58,9 @@ void main() {
     
     vec3 normal = normalize(pass_Normal);
     
-    if (UseBumpMap) {
-        
-        vec3 bumpyNormal = normalize(vec3(texture(NormalMapIndex, pass_Texcoord)));
-        //translate to tangent space by scaling
-        bumpyNormal = vec3((bumpyNormal.x - 0.5) * 2.0, (bumpyNormal.y - 0.5) * 2.0, bumpyNormal.z);
-
-        vec3 tangent = normalize(pass_Tangent);
-
-        //calculate bitangent using cross product of N and T
-        vec3 bitangent = cross(normal, tangent);
-        //create matrix
-        mat3 tangentMatrix = transpose(mat3(tangent,bitangent,normal));
-        bumpyNormal = tangentMatrix * bumpyNormal;
-
-        normal = normalize(bumpyNormal);
-        
-    }
+#if BUMP_MAP
+    normal = bumpMappedNormal(normal, pass_Tangent, pass_Texcoord);
+#endif
     
     
     
@@ -108,8 +103,14 @@ void main() {
     out_Color = vec4(ambient + diffuse + specular, 1.0);
     
     
+#if POINT_LIGHTS
+    out_Color.rgb += clusteredLighting(pass_VertexViewPosition, normal, viewDir, baseColor, diffuseK, specularK, glossiness);
+#endif
+    
+    
     //cel shading=============
-    if (pass_ShaderMode == 2.0) {
+#if CEL_SHADING
+    {
         
         //calc. cos of angle between normal and view direction
         float viewAngleCosine = dot(normal, viewDir);
@@ -129,6 +130,7 @@ void main() {
             
         }
     }
+#endif
     
     
     //out_Color = vec4(1.0, 1.0, 1.0, 1.0);
@@ -3,10 +3,7 @@
 #version 150
 #extension GL_ARB_explicit_attrib_location : require
 
-layout (std140) uniform CameraBlock {
-    mat4 ViewMatrix;
-    mat4 ProjectionMatrix;
-};
+#include "camera_block.glsl"
 
 // vertex attributes of VAO
 layout(location = 0) in vec3 in_Position;
@@ -22,7 +19,6 @@ uniform mat4 NormalMatrix;
 //assignment 3:
 uniform vec3 SunPosition;
 uniform vec3 DiffuseColour;
-uniform int ShaderMode;
 
 
 
@@ -31,7 +27,6 @@ out vec3 pass_Normal;
 out vec3 pass_VertexViewPosition;
 out vec3 pass_LightSourceViewPosition;
 out vec3 pass_diffuseColour;
-out float pass_ShaderMode;
 //assignment 4:
 out vec2 pass_Texcoord;
 //ass4 extn
@@ -48,9 +43,6 @@ void main(void)
     pass_LightSourceViewPosition = SunPosition;
     pass_diffuseColour = DiffuseColour;
     
-    //cast to float because fragment shader doesn't accept an int
-    pass_ShaderMode = float(ShaderMode);
-    
     //assignment4
     pass_Texcoord = in_Texcoord;
     
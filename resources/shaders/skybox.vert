@@ -3,10 +3,7 @@
 #version 150
 #extension GL_ARB_explicit_attrib_location : require
 
-layout (std140) uniform CameraBlock {
-    mat4 ViewMatrix;
-    mat4 ProjectionMatrix;
-};
+#include "camera_block.glsl"
 
 // vertex attributes of VAO
 layout(location = 0) in vec3 in_Position;
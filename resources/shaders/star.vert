@@ -5,10 +5,7 @@ layout(location = 0) in vec3 in_Position;
 layout(location = 1) in vec3 in_Colour;
 
 
-layout (std140) uniform CameraBlock {
-    mat4 ViewMatrix;
-    mat4 ProjectionMatrix;
-};
+#include "camera_block.glsl"
 
 //Matrix Uniforms as specified with glUniformMatrix4fv
 //uniform mat4 ViewMatrix;
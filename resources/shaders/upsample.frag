@@ -0,0 +1,19 @@
+#version 150
+
+//doubles resolution with a tent filter, the result is blended additively
+//onto the next larger level of the chain
+in vec2 pass_TexCoord;
+
+uniform sampler2D ColourTex;
+//size of one source texel in texture coordinates
+uniform vec2 TexelSize;
+
+out vec4 out_Color;
+
+void main() {
+    vec3 colour = texture(ColourTex, pass_TexCoord + TexelSize * vec2(-0.5, -0.5)).rgb;
+    colour += texture(ColourTex, pass_TexCoord + TexelSize * vec2( 0.5, -0.5)).rgb;
+    colour += texture(ColourTex, pass_TexCoord + TexelSize * vec2(-0.5,  0.5)).rgb;
+    colour += texture(ColourTex, pass_TexCoord + TexelSize * vec2( 0.5,  0.5)).rgb;
+    out_Color = vec4(colour * 0.25, 1.0);
+}